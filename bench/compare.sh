@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+# Compare two bench/run.sh result files case by case: seconds before and
+# after, and the ratio. A case more than BENCH_TOLERANCE percent slower
+# (default 10; cases under 50 ms are too noisy and never count) is a
+# regression, and the exit code is 1 if there is any.
+#
+#   bench/compare.sh bench/results/OLD.json bench/results/NEW.json
+
+set -euo pipefail
+
+OLD="${1:?usage: bench/compare.sh <old.json> <new.json>}"
+NEW="${2:?usage: bench/compare.sh <old.json> <new.json>}"
+: "${BENCH_TOLERANCE:=10}"
+
+awk -v tol="$BENCH_TOLERANCE" '
+  # "key": value from one result line (one result per line, see run.sh)
+  function get(line, key,    i, v) {
+    i = index(line, "\"" key "\": ")
+    if (!i) return ""
+    v = substr(line, i + length(key) + 4)
+    sub(/[,}].*/, "", v)
+    gsub(/"/, "", v)
+    return v
+  }
+  /"commit":/ { c = get($0, "commit"); if (FNR == NR) oldc = c; else newc = c }
+  /"case":/ {
+    k = sprintf("%5sx  %s", get($0, "scale"), get($0, "case"))
+    s = get($0, "seconds") + 0
+    if (FNR == NR) { old[k] = s; next }
+    if (!(k in seen)) { order[n++] = k; seen[k] = 1 }
+    cur[k] = s
+  }
+  END {
+    printf "%-36s %10s %10s %8s   (%s -> %s)\n", "case", "old_s", "new_s", "ratio", oldc, newc
+    bad = 0
+    for (i = 0; i < n; i++) {
+      k = order[i]
+      if (!(k in old)) { printf "%-36s %10s %10.4f %8s\n", k, "-", cur[k], "new"; continue }
+      r = old[k] > 0 ? cur[k] / old[k] : 0
+      flag = ""
+      if (old[k] >= 0.05 && r > 1 + tol / 100) { flag = "  REGRESSION"; bad++ }
+      else if (old[k] >= 0.05 && r < 1 - tol / 100) flag = "  faster"
+      printf "%-36s %10.4f %10.4f %8.2f%s\n", k, old[k], cur[k], r, flag
+    }
+    if (bad) { printf "%d case(s) more than %s%% slower\n", bad, tol; exit 1 }
+  }
+' "$OLD" "$NEW"
@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+# Load a synthetic dataset of scale S into an empty (truncated) database:
+#
+#   2 bookmakers, 10*S runners, 500*S bettors, 200*S events (from 30 days
+#   ago to 3 days ahead), 40 quotes per event (moneyline and total 2.5,
+#   both bookmakers, 5 snapshots) and 20000*S open single bets placed in the
+#   2 hours before their event. Event 1 is the hot event: it takes 1% of
+#   the bets, so settling it grows with the scale.
+#
+# Rows are generated server-side (INSERT ... SELECT over a numbers table),
+# so loading 100x takes a minute rather than hours.
+#
+#   bench/load.sh 10
+
+set -euo pipefail
+
+S="${1:?usage: bench/load.sh <scale>}"
+: "${DB_HOST:=127.0.0.1}"
+: "${DB_PORT:=3306}"
+: "${DB_NAME:=gigam_bench}"
+: "${DB_USER:=gigam_user}"
+: "${DB_PASS:=gigam_pass}"
+
+D="(SELECT 0 d UNION ALL SELECT 1 UNION ALL SELECT 2 UNION ALL SELECT 3 UNION ALL SELECT 4
+    UNION ALL SELECT 5 UNION ALL SELECT 6 UNION ALL SELECT 7 UNION ALL SELECT 8 UNION ALL SELECT 9)"
+
+mysql -h "$DB_HOST" -P "$DB_PORT" -u "$DB_USER" -p"$DB_PASS" "$DB_NAME" <<SQL_EOF
+SET @S := $S;
+SET @bets := 20000*@S, @events := 200*@S, @bettors := 500*@S, @runners := 10*@S;
+
+DROP TABLE IF EXISTS bench_seq;
+CREATE TABLE bench_seq (n INT NOT NULL PRIMARY KEY) ENGINE=InnoDB;
+INSERT INTO bench_seq
+  SELECT a.d + 10*b.d + 100*c.d + 1000*e.d + 10000*f.d + 100000*g.d + 1000000*h.d AS n
+  FROM $D a, $D b, $D c, $D e, $D f, $D g, $D h
+  WHERE a.d + 10*b.d + 100*c.d + 1000*e.d + 10000*f.d + 100000*g.d + 1000000*h.d < GREATEST(@bets, @events*40);
+
+INSERT INTO sports(id,name) VALUES(1,'Bench');
+INSERT INTO leagues(id,sport_id,name) VALUES(1,1,'Bench League');
+INSERT INTO teams(id,league_id,name) SELECT n+1, 1, CONCAT('Bench Team ',n+1) FROM bench_seq WHERE n < 20;
+INSERT INTO bookmakers(id,name,currency) VALUES(1,'Bench A','USD'),(2,'Bench B','USD');
+
+INSERT INTO users(id,username,display_name) SELECT n+1, CONCAT('bench_runner',n+1), CONCAT('Runner ',n+1) FROM bench_seq WHERE n < @runners;
+INSERT INTO runners(id,user_id,bookmaker_id,name,is_default,commission_scheme,commission_rate)
+  SELECT n+1, n+1, 1 + n%2, CONCAT('Runner ',n+1), n < 2, IF(n%4 < 2,'net','handle'), 10
+  FROM bench_seq WHERE n < @runners;
+INSERT INTO bettors(id,runner_id,code,display_name) SELECT n+1, 1 + n%@runners, CONCAT('BB',n+1), CONCAT('Bettor ',n+1)
+  FROM bench_seq WHERE n < @bettors;
+
+INSERT INTO events(id,league_id,starts_at,home_team_id,away_team_id)
+  SELECT n+1, 1, NOW() - INTERVAL 30 DAY + INTERVAL FLOOR(n*33*86400/@events) SECOND,
+         1 + n%20, 1 + (n + 1 + (n DIV 20)%19)%20
+  FROM bench_seq WHERE n < @events;
+
+-- k = n%8: bookmaker 1 + k%2, selection k DIV 2 (HOME, AWAY, OVER, UNDER)
+INSERT INTO quotes(event_id,bookmaker_id,market_type,side,line_q,price_e4,captured_at)
+  SELECT e.id, 1 + s.n%2, IF(s.n%8 < 4,'moneyline','total'), ELT(1 + (s.n%8) DIV 2,'HOME','AWAY','OVER','UNDER'),
+         IF(s.n%8 < 4, NULL, 10), 17000 + (s.n*7919)%6000, e.starts_at - INTERVAL (5 - (s.n DIV 8)%5) HOUR
+  FROM bench_seq s JOIN events e ON e.id = s.n DIV 40 + 1
+  WHERE s.n < @events*40;
+
+INSERT INTO bets(bookmaker_id,event_id,placed_at,stake_cents,market_type,pick_side,line_q,price_e4,runner_id,bettor_id)
+  SELECT 1 + (s.n%@bettors%@runners)%2, e.id, e.starts_at - INTERVAL s.n%7200 SECOND, 1000 + (s.n*37)%99000,
+         IF(s.n%8 < 4,'moneyline','total'), ELT(1 + (s.n%8) DIV 2,'HOME','AWAY','OVER','UNDER'),
+         IF(s.n%8 < 4, NULL, 10), 18000 + s.n%5000, 1 + s.n%@bettors%@runners, 1 + s.n%@bettors
+  FROM bench_seq s JOIN events e ON e.id = IF(s.n%100 = 0, 1, 1 + s.n%@events)
+  WHERE s.n < @bets;
+
+DROP TABLE bench_seq;
+ANALYZE TABLE events, quotes, bets, bettors, runners;
+SQL_EOF
@@ -0,0 +1,163 @@
+#!/usr/bin/env bash
+# End-to-end database benchmark: whole gigamctl commands against a local
+# MariaDB/MySQL at growing data sizes. For each scale (bench/load.sh) it
+# times bet placement and quote ingestion throughput, settling the hot
+# event, settling every past event through a feed, every report kind (and
+# pnl through the cache, miss then hit) and the risk commands, then writes
+# one JSON file with the host, the commit and a result per (scale, case).
+#
+# It works on its own database (BENCH_DB_NAME, default gigam_bench), which
+# it creates (DB_ROOT_USER / DB_ROOT_PASS), migrates and truncates; the
+# DB_NAME database is never touched.
+#
+#   DB_ROOT_PASS=... make bench-db
+#   BENCH_SCALES="1 10" BENCH_CONCURRENCY=16 ./bench/run.sh
+#   ./bench/compare.sh bench/results/OLD.json bench/results/NEW.json
+
+set -euo pipefail
+cd "$(dirname "$0")/.."
+
+: "${DB_HOST:=127.0.0.1}"
+: "${DB_PORT:=3306}"
+: "${DB_USER:=gigam_user}"
+: "${DB_PASS:=gigam_pass}"
+: "${BENCH_DB_NAME:=gigam_bench}"
+: "${BENCH_SCALES:=1 10 100}"
+: "${BENCH_PLACE_N:=2000}"        # bet place / quote add commands per scale
+: "${BENCH_CONCURRENCY:=8}"       # of those, at once
+: "${BENCH_BOOTSTRAP:=1}"         # 0: the database already exists
+: "${BENCH_OUT_DIR:=bench/results}"
+export DB_HOST DB_PORT DB_USER DB_PASS
+export DB_NAME="$BENCH_DB_NAME"
+# the primary alone: no replica, no shards, no capture, no cached reports
+unset DB_REPLICA_HOST GIGAM_SHARDS GIGAM_SHARD_MAP GIGAM_SHARD GIGAM_CAPTURE
+
+[ -x ./gigamctl ] || { echo "build gigamctl first (make)"; exit 1; }
+
+q () {
+  mysql -N -h "$DB_HOST" -P "$DB_PORT" -u "$DB_USER" -p"$DB_PASS" "$DB_NAME" -e "$1"
+}
+
+json_str () {
+  local s=${1//\\/\\\\}
+  s=${s//\"/\\\"}
+  printf '"%s"' "${s//$'\t'/ }"
+}
+
+now_ns () { date +%s%N; }
+
+COMMIT=$(git rev-parse --short=12 HEAD 2>/dev/null || echo unknown)
+DIRTY=false
+[ -n "$(git status --porcelain --untracked-files=no 2>/dev/null)" ] && DIRTY=true
+STAMP=$(date -u +%Y%m%dT%H%M%SZ)
+mkdir -p "$BENCH_OUT_DIR"
+OUT="$BENCH_OUT_DIR/$STAMP-$COMMIT.json"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+: > "$WORK/results"
+
+# case NAME OPS CMD...: time CMD (output discarded) and add a result line;
+# OPS is the work done (bets, events...), 0 if the case has none
+case_run () {
+  local name=$1 ops=$2; shift 2
+  local t0 t1 rc=0
+  t0=$(now_ns)
+  "$@" >/dev/null 2>"$WORK/err" || rc=$?
+  t1=$(now_ns)
+  [ "$rc" = 0 ] || { echo "   $name failed (exit $rc):"; head -3 "$WORK/err"; }
+  add_result "$name" "$ops" "$t0" "$t1" "$rc" ""
+}
+
+# add_result NAME OPS T0 T1 RC EXTRA_JSON
+add_result () {
+  local secs rate
+  secs=$(awk -v a="$3" -v b="$4" 'BEGIN{printf "%.4f", (b-a)/1e9}')
+  rate=$(awk -v n="$2" -v s="$secs" 'BEGIN{printf "%.1f", (s > 0 ? n/s : 0)}')
+  printf '    {"scale": %s, "case": "%s", "seconds": %s, "ops": %s, "ops_per_s": %s, "rc": %s%s}' \
+    "$SCALE" "$1" "$secs" "$2" "$rate" "$5" "$6" >> "$WORK/results"
+  printf ',\n' >> "$WORK/results"
+  printf '   %-26s %10ss%s%s\n' "$1" "$secs" "$([ "$2" = 0 ] || printf ' %12s ops/s' "$rate")" "$([ "$5" = 0 ] || echo "  FAILED")"
+}
+
+# replay_case NAME CAPTURE: the commands at full speed; p50/p99 from replay
+replay_case () {
+  local name=$1 cap=$2 n t0 t1 rc=0
+  n=$(wc -l < "$cap")
+  t0=$(now_ns)
+  ./gigamctl replay "$cap" --speed max --concurrency "$BENCH_CONCURRENCY" --format csv > "$WORK/replay.csv" 2>/dev/null || rc=$?
+  t1=$(now_ns)
+  local errs p50 p99
+  errs=$(awk -F, '$1=="all"{print $3}' "$WORK/replay.csv"); p50=$(awk -F, '$1=="all"{print $4}' "$WORK/replay.csv")
+  p99=$(awk -F, '$1=="all"{print $6}' "$WORK/replay.csv")
+  [ "${errs:-1}" = 0 ] || rc=1
+  add_result "$name" "$n" "$t0" "$t1" "$rc" ", \"p50_ms\": ${p50:-0}, \"p99_ms\": ${p99:-0}, \"errors\": ${errs:-0}"
+}
+
+echo ">> $BENCH_DB_NAME on $DB_HOST:$DB_PORT, scales: $BENCH_SCALES"
+[ "$BENCH_BOOTSTRAP" = 1 ] && ./scripts/bootstrap_mysql.sh >/dev/null
+./scripts/migrate.sh >/dev/null
+
+DB_VERSION=$(q "SELECT VERSION()")
+CPU=$(awk -F': ' '/^model name/{print $2; exit}' /proc/cpuinfo 2>/dev/null || true)
+MEM_MB=$(awk '/^MemTotal/{printf "%d", $2/1024}' /proc/meminfo 2>/dev/null || echo 0)
+TODAY=$(date +%Y-%m-%d)
+FROM=$(date -d '-31 days' +%Y-%m-%d)
+RPT=(--from "$FROM" --to "$TODAY" --no-cache)
+
+for SCALE in $BENCH_SCALES; do
+  echo ">> scale ${SCALE}x"
+  ./scripts/reset_truncate.sh >/dev/null
+  case_run load "$((20000*SCALE))" ./bench/load.sh "$SCALE"
+
+  EVENTS=$((200*SCALE)); BETTORS=$((500*SCALE)); RUNNERS=$((10*SCALE))
+  FUTURE=$(q "SELECT MIN(id) FROM events WHERE starts_at > NOW()")
+
+  # bet placement and quote ingestion: one gigamctl per command, as clients issue them
+  : > "$WORK/place.tsv"; : > "$WORK/quotes.tsv"
+  for ((i=0; i<BENCH_PLACE_N; i++)); do
+    ev=$((FUTURE + i % (EVENTS - FUTURE + 1))); bettor=$((1 + i % BETTORS)); runner=$((1 + (i % BETTORS) % RUNNERS))
+    printf '0\t0\t0\tbet\tplace\t--bookmaker-id\t%d\t--event-id\t%d\t--runner-id\t%d\t--bettor-id\t%d\t--market\tmoneyline\t--side\tHOME\t--price\t1.9%d\t--stake\t%d\n' \
+      $((1 + (runner - 1) % 2)) "$ev" "$runner" "$bettor" $((i % 10)) $((1000 + i)) >> "$WORK/place.tsv"
+    printf '0\t0\t0\tquote\tadd\t--event-id\t%d\t--bookmaker-id\t%d\t--market\ttotal\t--side\tOVER\t--line\t2.5\t--price\t1.8%d\n' \
+      "$ev" $((1 + i % 2)) $((i % 10)) >> "$WORK/quotes.tsv"
+  done
+  replay_case bet_place "$WORK/place.tsv"
+  replay_case quote_add "$WORK/quotes.tsv"
+
+  # settlement: the hot event, then every other past event through a feed
+  ./gigamctl event set-score --event-id 1 --home 2 --away 1 --final >/dev/null
+  case_run settle_event "$(q "SELECT COUNT(*) FROM bets WHERE event_id=1 AND status='open'")" ./gigamctl settle event --event-id 1
+  q "SELECT CONCAT(id,' ',(id*7)%4,'-',(id*3)%3,' final') FROM events WHERE id>1 AND starts_at < NOW() - INTERVAL 3 HOUR" > "$WORK/feed"
+  case_run settle_follow "$(wc -l < "$WORK/feed")" ./gigamctl settle follow --feed "$WORK/feed" --workers 4
+
+  # reports over the settled bets (bookmaker 1), then across both bookmakers
+  for kind in pnl runner-commissions bettor-balances runner-balances clv; do
+    case_run "report_$kind" 0 ./gigamctl report "$kind" --bookmaker-id 1 "${RPT[@]}"
+  done
+  mkdir -p "$WORK/rpt"
+  case_run report_all 0 ./gigamctl report all --bookmaker-id 1 --out-dir "$WORK/rpt" "${RPT[@]}"
+  case_run report_pnl_all_bookmakers 0 ./gigamctl report pnl --bookmaker-id all --parallel 4 "${RPT[@]}"
+  # the cache: a miss computes and stores, a hit is the watermark query alone
+  rm -rf "$WORK/cache"
+  case_run report_pnl_cache_miss 0 env GIGAM_CACHE_DIR="$WORK/cache" ./gigamctl report pnl --bookmaker-id 1 --from "$FROM" --to "$TODAY"
+  case_run report_pnl_cache_hit 0 env GIGAM_CACHE_DIR="$WORK/cache" ./gigamctl report pnl --bookmaker-id 1 --from "$FROM" --to "$TODAY"
+
+  # risk over the open (future) bets
+  case_run risk_list 0 ./gigamctl risk list --event-id "$FUTURE"
+  case_run risk_mtm_all 0 ./gigamctl risk mtm --all
+  case_run risk_velocity 0 ./gigamctl risk velocity --bookmaker-id 1 --since 31d
+  case_run risk_parlays 0 ./gigamctl risk parlays --bookmaker-id 1
+done
+
+{
+  printf '{\n  "suite": "gigam-bench-db",\n  "version": 1,\n'
+  printf '  "commit": "%s",\n  "dirty": %s,\n  "started_at": "%s",\n' "$COMMIT" "$DIRTY" "$STAMP"
+  printf '  "host": {"hostname": %s, "os": %s, "cpu": %s, "cores": %s, "mem_mb": %s, "db_version": %s},\n' \
+    "$(json_str "$(hostname)")" "$(json_str "$(uname -srm)")" "$(json_str "$CPU")" "$(nproc)" "$MEM_MB" "$(json_str "$DB_VERSION")"
+  printf '  "config": {"scales": [%s], "place_n": %s, "concurrency": %s},\n' \
+    "$(echo $BENCH_SCALES | tr ' ' ',')" "$BENCH_PLACE_N" "$BENCH_CONCURRENCY"
+  printf '  "results": [\n'
+  sed '$ s/,$//' "$WORK/results"
+  printf '  ]\n}\n'
+} > "$OUT"
+echo "OK $OUT"
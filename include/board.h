@@ -0,0 +1,33 @@
+#ifndef GIGAM_BOARD_H
+#define GIGAM_BOARD_H
+
+/* quote board: the market across bookmakers for upcoming events.
+ *
+ * One scan reads every quote of the scheduled events starting in the
+ * window (newest first within each event and market). Each (event, market)
+ * is then grouped in memory: the latest quote per bookmaker and selection,
+ * the best price per selection and who offers it, and per line the
+ * overround of the best prices, Σ 1/price over the market's book sides
+ * (market.h) divided by how often they cover each result, minus 1. A
+ * negative overround is an arbitrage across bookmakers. Asian split quotes
+ * are left out; correct_score has no book, so no overround. */
+
+#include "db.h"
+#include "reportfmt.h"
+
+typedef struct {
+  long league_id;      /* 0 = all leagues */
+  long within_s;       /* events starting in [now, now + within_s) */
+  int arb_only;        /* only markets with an arbitrage */
+} board_opts_t;
+
+/* "24h", "90m", "2d", "3600" -> seconds; -1 if malformed. */
+long board_parse_window(const char* s);
+
+/* One row per selection (event_id, starts_at, market, line, side,
+ * best_price, bookmaker_id, books, overround_pct, arb), read from n
+ * databases at once (one per shard, see shard.h). Returns the gigamctl
+ * exit code: 0, 1 (--out not writable), 5 (database). */
+int board_run(MYSQL* const* conns, int n, const board_opts_t* o, rf_format_t fmt, const char* out_path);
+
+#endif
@@ -12,11 +12,37 @@ typedef struct {
   char pass[128];
 } db_config_t;
 
+/* DB_HOST, DB_PORT, DB_NAME, DB_USER, DB_PASS; after db_route(), the
+ * routed config instead (gigamctl routes each command to its shard). */
 void db_load_env(db_config_t* cfg);
+void db_route(const db_config_t* cfg);   /* NULL: back to the environment */
 MYSQL* db_connect(const db_config_t* cfg);
+/* The read replica (DB_REPLICA_HOST; DB_REPLICA_PORT, _NAME, _USER, _PASS
+ * default to the primary's) if it is up and at most DB_REPLICA_MAX_LAG
+ * seconds behind (default 30); db_load_env then returns it, so pools of
+ * the same command read there too. NULL if none is configured or it is
+ * unfit, saying why on stderr: the caller stays on the primary. */
+MYSQL* db_connect_replica(void);
 void db_disconnect(MYSQL* conn);
 int db_exec(MYSQL* conn, const char* sql);
+/* mysql_real_escape_string into out (truncated to outsz-1); NULL -> "" */
+void db_escape(MYSQL* c, const char* in, char* out, size_t outsz);
 void db_print_result(MYSQL_RES* res);
+/* Send sql on every connection before reading any reply, so the servers
+ * run it at the same time; then mysql_use_result/store_result each.
+ * Returns 0, or -1 (printed) if any connection failed. */
+int db_exec_all(MYSQL* const* conns, int n, const char* sql);
+
+/* Run ntasks tasks on up to nconn concurrent connections (one thread per
+ * connection, tasks handed out in order). Returns the number of failed
+ * tasks, or -1 if no connection could be opened. */
+typedef int (*db_task_fn)(MYSQL* conn, size_t task, void* ud);
+int db_parallel(const db_config_t* cfg, size_t ntasks, int nconn, db_task_fn fn, void* ud);
+/* The same over several databases: task t runs on cfgs[task_cfg[t]], each
+ * database with its own pool of up to nconn connections, all at once.
+ * Returns -1 if a database with tasks could not be reached. */
+int db_parallel_sharded(const db_config_t* cfgs, int ncfg, const int* task_cfg, size_t ntasks, int nconn,
+                        db_task_fn fn, void* ud);
 
 int cli_dispatch(int argc, char** argv);
 
@@ -0,0 +1,30 @@
+#ifndef GIGAM_FIXTURES_H
+#define GIGAM_FIXTURES_H
+
+/* event import: a season of fixtures from one CSV file.
+ *
+ * Rows are league,kickoff,home,away: the league by id or name, the kickoff
+ * as YYYY-MM-DD HH:MM[:SS], both teams by name within the league (a header
+ * row, blank lines and '#' lines are skipped). The league and team tables
+ * are read once into hash tables, names compared case-insensitively as the
+ * schema's collation does. The teams not found are created with multi-row
+ * INSERTs and read back, then the events go in with multi-row INSERTs, all
+ * in one transaction. A fixture already stored (same league, kickoff and
+ * teams) is skipped, so a file can be imported again after adding rows. */
+
+#include "db.h"
+
+typedef struct {
+  long rows;           /* fixtures in the file */
+  long created;        /* events inserted */
+  long skipped;        /* already stored, or repeated in the file */
+  long teams;          /* teams created */
+} fixtures_stats_t;
+
+/* Import into conns[0]; conns[1..n-1] (the other shards, shard.h) then get
+ * the file's teams and events under the same ids. batch is the rows per
+ * INSERT. Returns the gigamctl exit code: 0, 1 (file unreadable), 2 (bad
+ * rows, reported on stderr; nothing written), 5 (database). */
+int fixtures_import(MYSQL* const* conns, int n, const char* path, long batch, fixtures_stats_t* st);
+
+#endif
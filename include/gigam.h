@@ -0,0 +1,162 @@
+#ifndef GIGAM_GIGAM_H
+#define GIGAM_GIGAM_H
+
+/* libgigam: the bet/quote/settlement/risk operations behind gigamctl, for
+ * in-process callers. A context owns (or borrows) one MySQL connection and
+ * is not thread-safe; use one context per thread.
+ *
+ * Every call returns GIGAM_OK or an error code whose value is the gigamctl
+ * exit code for the same failure; gigam_errmsg() describes the last one. */
+
+#include "db.h"
+
+typedef enum {
+  GIGAM_OK     = 0,
+  GIGAM_EIO    = 1,   /* local file (journal) error */
+  GIGAM_EINVAL = 2,   /* invalid argument or state (e.g. event not final) */
+  GIGAM_EDB    = 5    /* database error, or a referenced row is missing */
+} gigam_rc_t;
+
+typedef struct gigam_ctx gigam_ctx_t;
+
+/* Open a context with its own connection; NULL if it cannot connect. */
+gigam_ctx_t* gigam_open(const db_config_t* cfg);
+/* Wrap an existing connection; gigam_close() will not close it. */
+gigam_ctx_t* gigam_wrap(MYSQL* conn);
+void         gigam_close(gigam_ctx_t* g);
+MYSQL*       gigam_conn(gigam_ctx_t* g);
+/* Rows per keyset chunk (id > last ORDER BY id LIMIT n) of the settle and
+ * risk scans; values < 1 restore the default. */
+#define GIGAM_SCAN_CHUNK 1000
+void         gigam_set_scan_chunk(gigam_ctx_t* g, long rows);
+const char*  gigam_errmsg(const gigam_ctx_t* g);
+
+/* market / side (see market.h for the rule table):
+ *   moneyline, threeway       HOME|AWAY|DRAW
+ *   spread                    HOME|AWAY, line = handicap
+ *   total, team_total_home,
+ *   team_total_away           OVER|UNDER, line = goals
+ *   btts                      YES|NO
+ *   correct_score             SCORE, line/line_b = home/away goals
+ *   double_chance             HOME_DRAW|HOME_AWAY|DRAW_AWAY
+ *   dnb                       HOME|AWAY (draw refunds)
+ * Quarter lines (x.25/x.75) settle as two half stakes on the neighbouring
+ * lines; asian with line_b/price_b gives the split explicitly.
+ * Prices are in ten-thousandths and lines in quarter goals (market.h:
+ * mkt_parse_price / mkt_parse_line read them from decimal text). */
+typedef struct {
+  long event_id, bookmaker_id;
+  const char* market;
+  const char* side;
+  int line_q; long price_e4;
+  int asian;
+  int line_b_q; long price_b_e4;
+} gigam_quote_t;
+
+typedef struct {
+  long bookmaker_id, event_id, runner_id, bettor_id;
+  const char* market;
+  const char* side;
+  int line_q; long price_e4;
+  long stake_cents;
+  int asian;
+  int line_b_q; long price_b_e4;
+  const char* bet_key;   /* optional client key [A-Za-z0-9_-]{1,64}; retries with the same key are no-ops */
+} gigam_bet_t;
+
+/* Book P&L if the event ended h-a, in cents (negative = book pays), for
+ * every score up to GIGAM_RISK_GOALS-1 goals a side. Each scenario holds
+ * its worst score: home/away win, draw, over/under 2.5 goals. */
+#define GIGAM_RISK_GOALS 10
+typedef struct {
+  long long home, away, draw, over, under;
+  long long worst; int worst_home, worst_away;
+  long long grid[GIGAM_RISK_GOALS][GIGAM_RISK_GOALS];
+} gigam_exposure_t;
+
+int gigam_quote_add(gigam_ctx_t* g, const gigam_quote_t* q, long long* quote_id);
+/* Links the bet to the latest matching quote of the bookmaker, if any.
+ * With a bet_key already stored, *bet_id is the existing bet. */
+int gigam_bet_place(gigam_ctx_t* g, const gigam_bet_t* b, long long* bet_id);
+/* Shape check done by gigam_bet_place: NULL if valid, else the reason. */
+const char* gigam_bet_invalid(const gigam_bet_t* b);
+/* "(...)" row for INSERT INTO bets(GIGAM_BET_COLUMNS); 0, or -1 if n is too small. */
+#define GIGAM_BET_COLUMNS "bookmaker_id,event_id,quote_id,stake_cents,market_type,pick_side,line_q,is_asian,price_e4,price_b_e4,line_b_q,runner_id,bettor_id,status,bet_key"
+int gigam_bet_values(const gigam_bet_t* b, char* buf, size_t n);
+/* Parlay: one stake over 2..GIGAM_PARLAY_MAX_LEGS legs on distinct events.
+ * Legs use the single-bet market rules; the offered price is the product
+ * of the leg prices. A combined price above GIGAM_PARLAY_MAX_PRICE_E4 (it
+ * must fit bets.price_e4, an INT) or a potential payout above
+ * GIGAM_PARLAY_MAX_PAYOUT cents is refused, which also keeps settlement
+ * and risk arithmetic inside int64. */
+#define GIGAM_PARLAY_MAX_LEGS 16
+#define GIGAM_PARLAY_MAX_PRICE_E4 1000000000L       /* 100000.0 */
+#define GIGAM_PARLAY_MAX_PAYOUT   100000000000LL    /* 1,000,000,000.00 */
+typedef struct {
+  long event_id;
+  const char* market;
+  const char* side;
+  int line_q; long price_e4;
+  int asian;
+  int line_b_q; long price_b_e4;
+} gigam_leg_t;
+
+typedef struct {
+  long bookmaker_id, runner_id, bettor_id;
+  long stake_cents;
+  const gigam_leg_t* legs;
+  int nlegs;
+  const char* bet_key;
+} gigam_parlay_t;
+
+/* Runs in its own transaction: the bets row and its bet_legs. */
+int gigam_parlay_place(gigam_ctx_t* g, const gigam_parlay_t* p, long long* bet_id);
+
+/* Settle every open bet of a final event and book runner commissions.
+ * Open parlay legs on the event are settled too (a void event refunds its
+ * singles and counts its legs as 1.0); a parlay settles when a leg loses
+ * or its last leg is settled. Bets are read in chunks of the scan chunk
+ * size and each chunk commits on its own, together with the ledger
+ * postings of the bets it settles (ledger.h). If a chunk fails, the ones
+ * before it stay settled (counted in *settled) and settling the event
+ * again picks up the rest: only open bets are read and booked. */
+int gigam_settle_event(gigam_ctx_t* g, long event_id, long long* settled);
+int gigam_risk_event(gigam_ctx_t* g, long event_id, gigam_exposure_t* ex);
+/* Fill the scenarios from ex->grid; for grids summed across databases. */
+void gigam_exposure_scenarios(gigam_exposure_t* ex);
+
+/* Re-settle a final event under a corrected score, in one transaction.
+ * Only picks whose outcome changes are read (see mkt_outcome_key); each bet
+ * whose money moves gets a settlement_adjustments row with the deltas and,
+ * if its commission moves, a compensating runner_commissions row. Parlays
+ * with a changed leg are re-priced, or reopened when that leg had settled
+ * them early. */
+typedef struct {
+  int old_home, old_away;
+  long picks_changed;           /* distinct picks (singles + legs) whose outcome changed */
+  long long bets;               /* bets adjusted */
+  long long reopened;           /* parlays back to open */
+  long long payout_delta, profit_delta, commission_delta;   /* cents */
+} gigam_correction_t;
+int gigam_settle_correct(gigam_ctx_t* g, long event_id, int home, int away, gigam_correction_t* out);
+
+/* Book liability of open parlays across events: the worst joint outcome
+ * over every event their open legs touch (scores up to GIGAM_RISK_GOALS-1).
+ * Events linked by no parlay are searched apart, and a branch and bound
+ * cuts the joint outcomes that cannot be worse. Past the node budget each
+ * component left keeps the worst scenario it found (cut counts them), and
+ * worst_bound is then a floor on the real worst case. */
+typedef struct {
+  long parlays, legs, events;
+  long components;              /* groups of events linked by parlays */
+  double scenarios;             /* joint outcome classes, summed over the components */
+  long long nodes;              /* of those, search nodes visited */
+  long long stake_cents;        /* open parlay stakes */
+  long long worst;              /* book P&L in the worst scenario, cents */
+  long long worst_bound;        /* no scenario is worse; == worst when cut is 0 */
+  long cut;                     /* components searched only up to the budget */
+  char worst_desc[256];         /* "event 12 1-0, event 15 0-2" */
+} gigam_parlay_risk_t;
+int gigam_risk_parlays(gigam_ctx_t* g, long bookmaker_id, gigam_parlay_risk_t* out);
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef GIGAM_HMAP_H
+#define GIGAM_HMAP_H
+
+/* Open-addressing hash map keyed by 64-bit ids with fixed-size values
+ * stored inline. Used by the client-side aggregation engines (reports,
+ * risk) so they never round-trip to the database per key.
+ *
+ * Values are zero-initialised on insert. Pointers returned by hmap_get /
+ * hmap_put stay valid until the next hmap_put that creates a key or the
+ * next hmap_del. */
+
+#include <stddef.h>
+#include <stdbool.h>
+
+typedef struct {
+  long long*     keys;
+  unsigned char* used;
+  unsigned char* vals;
+  size_t val_size;
+  size_t cap;   /* always a power of two (or 0) */
+  size_t len;
+} hmap_t;
+
+void  hmap_init(hmap_t* m, size_t val_size);
+void  hmap_free(hmap_t* m);
+void* hmap_get(const hmap_t* m, long long key);
+/* Returns the value slot for key, creating it if missing; NULL on OOM. */
+void* hmap_put(hmap_t* m, long long key, bool* created);
+/* Removes key (false if absent). The table never shrinks, so a map that
+ * evicts idle keys stays sized to its peak live count. */
+bool  hmap_del(hmap_t* m, long long key);
+/* Iterate: size_t pos=0; while (hmap_next(m,&pos,&key,&val)) {...} */
+bool  hmap_next(const hmap_t* m, size_t* pos, long long* key, void** val);
+
+#endif
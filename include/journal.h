@@ -0,0 +1,56 @@
+#ifndef GIGAM_JOURNAL_H
+#define GIGAM_JOURNAL_H
+
+/* Bet acceptance journal: an append-only local file that accepted bets are
+ * written to before they reach MySQL, so acceptance latency is one local
+ * fsync (shared by concurrent appenders) instead of one database commit.
+ *
+ * DIR/bets.journal  one line per bet: "<crc32> key\tbm\tevent\t...\n"
+ * DIR/applied       byte offset up to which the journal is in MySQL
+ * DIR/rejected.log  journaled bets MySQL refused, with the reason
+ *
+ * A flusher drains the journal in multi-row transactions. Every bet carries
+ * a bet_key (generated when the caller has none), so lines applied before a
+ * crash but after the last offset update are no-ops when replayed. One
+ * process owns a journal at a time (fcntl lock on the file). */
+
+#include "gigam.h"
+
+typedef enum {
+  GIGAM_FSYNC_ALWAYS = 0,   /* append returns after the data is on disk */
+  GIGAM_FSYNC_INTERVAL,     /* gigam_journal_sync() from the flusher tick */
+  GIGAM_FSYNC_NONE          /* left to the OS */
+} gigam_fsync_t;
+
+typedef struct gigam_journal gigam_journal_t;
+
+typedef struct {
+  unsigned long long appended, applied, rejected, syncs, flushes;
+  long long size, applied_offset;   /* pending bytes = size - applied_offset */
+  long long pending;                /* bets not yet in MySQL */
+  long long torn;                   /* bytes of a partial last record cut at open */
+} gigam_journal_stats_t;
+
+/* Opens (creating DIR if needed), takes the lock and cuts a torn tail left
+ * by a crash. NULL on failure, with the reason in err. */
+gigam_journal_t* gigam_journal_open(const char* dir, gigam_fsync_t policy, char* err, size_t errsz);
+void             gigam_journal_close(gigam_journal_t* j);
+const char*      gigam_journal_errmsg(const gigam_journal_t* j);
+gigam_fsync_t    gigam_journal_policy(const gigam_journal_t* j);
+
+/* Append n validated bets with one write (and, under ALWAYS, one shared
+ * fsync). keys[i] receives each bet's key. Thread-safe. */
+int gigam_journal_append(gigam_journal_t* j, const gigam_bet_t* bets, int n, char (*keys)[65]);
+/* fsync if anything was appended since the last sync. Thread-safe. */
+int gigam_journal_sync(gigam_journal_t* j);
+
+/* Apply up to max_rows pending bets in one transaction; *applied gets how
+ * many lines were consumed (inserted, duplicate or rejected). Only one
+ * thread may flush at a time. */
+int gigam_journal_flush(gigam_ctx_t* g, gigam_journal_t* j, int max_rows, long* applied);
+
+void gigam_journal_stats(gigam_journal_t* j, gigam_journal_stats_t* st);
+/* Read-only look at a journal another process may own (`journal status`). */
+int  gigam_journal_peek(const char* dir, gigam_journal_stats_t* st);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef GIGAM_JSON_H
+#define GIGAM_JSON_H
+
+/* Minimal JSON reader for request bodies: flat objects whose values are
+ * strings, numbers, booleans or null, and arrays of such objects. Nested
+ * values are rejected. Strings are unescaped into the object's own storage. */
+
+#include <stddef.h>
+
+#define JSON_MAX_FIELDS 32
+
+typedef struct {
+  const char* key[JSON_MAX_FIELDS];
+  const char* val[JSON_MAX_FIELDS];   /* NULL for JSON null */
+  int n;
+  char buf[2048];                     /* keys and unescaped values */
+  size_t used;
+} json_obj_t;
+
+/* Parse one object at *p (leading whitespace allowed); advances *p past
+ * it. Returns 0, or -1 on malformed input / overflow. */
+int json_parse_object(const char** p, json_obj_t* o);
+
+/* Array of objects: call with *p at '[' first; returns 1 and fills o for
+ * each element, 0 at the closing ']', -1 on error. */
+int json_array_next(const char** p, int* first, json_obj_t* o);
+
+const char* json_get(const json_obj_t* o, const char* key);
+long        json_get_long(const json_obj_t* o, const char* key, long def);
+double      json_get_double(const json_obj_t* o, const char* key, double def);
+int         json_get_bool(const json_obj_t* o, const char* key, int def);
+
+#endif
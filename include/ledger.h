@@ -0,0 +1,63 @@
+#ifndef GIGAM_LEDGER_H
+#define GIGAM_LEDGER_H
+
+/* Double-entry ledger (schema/006_ledger.sql).
+ *
+ * Every settlement, commission, payout and score-correction adjustment is
+ * posted as two ledger_entries rows that sum to zero: one on the bettor or
+ * runner account and its contra on the bookmaker's 'book' account. Bettor
+ * and runner accounts keep a running balance in ledger_balances, updated in
+ * the caller's transaction; the entry records the balance after it. The
+ * book side has no balance row, since every settlement would queue on it;
+ * its balance is minus the sum of its accounts.
+ *
+ * Signs follow the balance reports: a bettor account holds what the bettor
+ * owes (-profit, less payouts), a runner account what is owed to the runner
+ * (commissions, less payouts). */
+
+#include "db.h"
+#include <stdio.h>
+
+typedef enum { LEDGER_BETTOR = 0, LEDGER_RUNNER } ledger_kind_t;
+typedef enum { LEDGER_SETTLEMENT = 0, LEDGER_COMMISSION, LEDGER_PAYOUT, LEDGER_ADJUSTMENT } ledger_src_t;
+
+/* Post amount_cents to (kind, owner) and its contra to the book. bet_id 0
+ * for payouts. Zero amounts post nothing. Returns 0, or -1 (mysql_error). */
+int ledger_post(MYSQL* c, ledger_src_t src, long long source_id, long bet_id, long bookmaker_id,
+                ledger_kind_t kind, long owner_id, long long amount_cents);
+
+/* Postings collected over a whole settlement and written at its end: one
+ * balance update per account, accounts locked in (kind, owner) order. */
+typedef struct ledger_batch ledger_batch_t;
+ledger_batch_t* ledger_batch_new(void);
+void ledger_batch_free(ledger_batch_t* b);
+int  ledger_batch_add(ledger_batch_t* b, ledger_src_t src, long long source_id, long bet_id, long bookmaker_id,
+                      ledger_kind_t kind, long owner_id, long long amount_cents);
+/* Writes and empties the batch. Returns 0, or -1 (mysql_error). */
+int  ledger_batch_post(MYSQL* c, ledger_batch_t* b);
+
+/* Current balance: a point read of ledger_balances (0 if the account has
+ * no entries yet). Returns 0, or -1. */
+int ledger_balance(MYSQL* c, ledger_kind_t kind, long owner_id, long long* balance_cents, long long* entries);
+
+/* Balance for a period: entries of one bookmaker's bettor or runner
+ * accounts posted in [from, to] (YYYY-MM-DD), a range read of idx_le_book,
+ * one row per account: id, name, non-payout entries, payouts (positive)
+ * and their sum. Unlike report bettor-balances / runner-balances, entries
+ * are dated when posted: a settle correct adjustment falls on the day of
+ * the correction, and accounts with only payouts in the range appear. */
+void ledger_period_sql(ledger_kind_t kind, long bookmaker_id, const char* from, const char* to, char* q, size_t n);
+
+typedef struct {
+  long accounts;    /* accounts compared */
+  long drift;       /* accounts whose source, entries and balance disagree */
+  long unbalanced;  /* bookmakers whose entries do not sum to zero */
+} ledger_verify_t;
+
+/* Recompute every bettor/runner balance from bets, runner_commissions and
+ * payouts, split into owner-id ranges over up to `parallel` connections,
+ * and compare with the sum of its entries and its running balance. Drifted
+ * accounts are written to out. Returns 0 (see res), or -1 on DB errors. */
+int ledger_verify(const db_config_t* cfg, int parallel, FILE* out, ledger_verify_t* res);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef GIGAM_MARKET_H
+#define GIGAM_MARKET_H
+
+/* Market rules: one entry per bets.market_type, indexed by its ENUM code
+ * (market_type+0), so settlement and risk dispatch with an array lookup.
+ * Names are only compared at the input boundary (CLI, JSON).
+ *
+ * The enum orders below ARE the MySQL ENUM orders of market_type and
+ * pick_side/side (schema/001_core.sql + 003_markets.sql); new values are
+ * only ever appended.
+ *
+ * Numbers are fixed point end to end: prices in ten-thousandths
+ * (price_e4: 1.95 -> 19500), lines in quarter goals (line_q: -0.75 -> -3;
+ * a correct_score 2-1 is line_q 8, line_b_q 4). They are parsed from and
+ * formatted to decimal text without floating point, so every engine that
+ * settles the same bet gets the same cents. */
+
+#include <stddef.h>
+
+typedef enum {
+  MKT_NONE = 0,
+  MKT_MONEYLINE, MKT_THREEWAY, MKT_SPREAD, MKT_TOTAL,
+  MKT_BTTS, MKT_CORRECT_SCORE, MKT_DOUBLE_CHANCE, MKT_DNB,
+  MKT_TEAM_TOTAL_HOME, MKT_TEAM_TOTAL_AWAY,
+  MKT_COUNT
+} mkt_market_t;
+
+typedef enum {
+  SIDE_NONE = 0,
+  SIDE_HOME, SIDE_AWAY, SIDE_DRAW, SIDE_OVER, SIDE_UNDER,
+  SIDE_YES, SIDE_NO, SIDE_HOME_DRAW, SIDE_HOME_AWAY, SIDE_DRAW_AWAY, SIDE_SCORE,
+  SIDE_COUNT
+} mkt_side_t;
+
+#define MKT_F_LINE     0x1   /* line is a handicap / goal line */
+#define MKT_F_QUARTER  0x2   /* x.25 / x.75 lines settle as two half stakes */
+#define MKT_F_SCORE    0x4   /* line / line_b are the picked home / away score */
+#define MKT_F_HANDICAP 0x8   /* line is the picked team's: AWAY +x pairs with HOME -x */
+
+#define MKT_PRICE_ONE 10000L   /* price_e4 of decimal odds 1.0 */
+
+/* +1 win, 0 push (stake back), -1 lose */
+typedef int (*mkt_outcome_fn)(mkt_side_t side, int line_q, int line_b_q, int home, int away);
+
+typedef struct {
+  const char* name;
+  unsigned sides;            /* bit (1u << side) per accepted side */
+  unsigned flags;
+  mkt_outcome_fn outcome;
+  unsigned book;             /* sides whose prices price every result (0: none do) */
+  int cover;                 /* times each result is covered by the book sides */
+} mkt_rule_t;
+
+extern const mkt_rule_t mkt_rules[MKT_COUNT];
+extern const char* const mkt_side_names[SIDE_COUNT];
+
+mkt_market_t mkt_market_code(const char* name);   /* MKT_NONE if unknown */
+mkt_side_t   mkt_side_code(const char* name);     /* SIDE_NONE if unknown */
+
+/* NULL if side and lines fit the market, else the reason. */
+const char* mkt_check(mkt_market_t m, mkt_side_t s, int line_q, int line_b_q, int asian);
+
+/* "1.95" -> 19500; at most 4 decimals, no exponent. 0, or -1 if malformed. */
+int  mkt_parse_price(const char* s, long* price_e4);
+/* "-0.75" -> -3; a multiple of 0.25. 0, or -1 if malformed. */
+int  mkt_parse_line(const char* s, int* line_q);
+void mkt_fmt_price(long price_e4, char* buf, size_t n);   /* "1.9500" */
+void mkt_fmt_line(int line_q, char* buf, size_t n);       /* "-0.75", "2.5", "1" */
+
+typedef struct {
+  mkt_market_t market;
+  mkt_side_t side;
+  int line_q, line_b_q;
+  long price_e4, price_b_e4;
+  int asian;
+  long long stake_cents;
+} mkt_bet_t;
+
+/* Player payout and profit in cents for a final score. Asian bets with an
+ * explicit second line and quarter lines settle as two half stakes (the odd
+ * cent on the second). A winning part pays stake * price_e4 / 10000,
+ * rounded half up. */
+void mkt_settle(const mkt_bet_t* b, int home, int away, long long* payout, long long* profit);
+
+/* Parlay leg return per unit staked, in millionths: the payout of a
+ * 1,000,000 stake (price on a win, 1 on a push, 0 on a loss, between for
+ * quarter lines); exact for any price_e4. */
+#define MKT_FACTOR_ONE 1000000LL
+long long mkt_leg_factor(const mkt_bet_t* leg, int home, int away);
+/* Apply one leg factor to a running parlay payout, rounded half up. Legs
+ * are applied in leg_no order. Exact without a wider type for payouts up
+ * to 9e12 cents (parlays are capped far below, see gigam_parlay_place). */
+long long mkt_apply_factor(long long payout, long long factor_e6);
+
+/* Win/push/lose of each stake part for a score, packed: two bets of the same
+ * pick (prices and stakes aside) settle alike iff their keys are equal, and
+ * a score correction changes a pick's payouts iff it changes its key. */
+int mkt_outcome_key(const mkt_bet_t* b, int home, int away);
+
+#endif
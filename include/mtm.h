@@ -0,0 +1,36 @@
+#ifndef GIGAM_MTM_H
+#define GIGAM_MTM_H
+
+/* risk mtm: open single bets marked to the current market.
+ *
+ * The latest quote of every pick (bookmaker, event, market, side, line) on
+ * the events with open bets is loaded once into an in-memory hash table;
+ * the open bets are then streamed and each is priced with one lookup, so
+ * the run is two scans however many bets are open. A bet taken at price p
+ * and now quoted at q has a fair cash-out value of stake * p / q (rounded
+ * half up to the cent); the book's mark-to-market P&L is stake - value.
+ * Bets whose pick has no quote are unpriced and valued at their stake.
+ * An explicit asian split is valued as its two half stakes, each at the
+ * quote of its own line, and is priced only when both are; open parlays
+ * are in risk parlays. */
+
+#include "db.h"
+#include "reportfmt.h"
+
+typedef enum { MTM_BY_EVENT = 0, MTM_BY_RUNNER, MTM_BY_BETTOR } mtm_by_t;
+
+typedef struct {
+  long event_id;       /* 0 = every event with open bets */
+  long bookmaker_id;   /* 0 = all bookmakers */
+  mtm_by_t by;
+} mtm_opts_t;
+
+/* One row per event, runner or bettor: <by>_id, bets, priced, stake_usd,
+ * cashout_usd, mtm_usd; worst book P&L first. Returns the gigamctl exit
+ * code: 0, 1 (--out not writable), 5 (database or memory). */
+int mtm_run(MYSQL* c, const mtm_opts_t* o, rf_format_t fmt, const char* out_path);
+/* The same over several databases (shard.h) read at once, one connection
+ * each, their sums merged before ranking. */
+int mtm_run_sharded(const db_config_t* cfgs, int n, const mtm_opts_t* o, rf_format_t fmt, const char* out_path);
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef GIGAM_RCACHE_H
+#define GIGAM_RCACHE_H
+
+/* On-disk cache of rendered report output.
+ *
+ * Entries live in $GIGAM_CACHE_DIR (default ~/.cache/gigamctl), one file
+ * per normalized parameter key. Each stores the watermark of the data it
+ * was computed from; a lookup whose current watermark differs is stale and
+ * the caller recomputes and replaces it. */
+
+#include "db.h"
+#include <stdio.h>
+
+/* What a report over (bookmaker, range) depends on: the newest settlement,
+ * bet and payout inside the range, and the bookmaker's newest score
+ * correction (settle correct rewrites settled bets in place). The count and
+ * profit sum of the settled bets catch what moves no maximum: a bet
+ * leaving the range, or one rewritten without a correction row. */
+typedef struct {
+  char settled_max[32];
+  long long settled_n;
+  long long profit_sum;
+  long long last_bet_id;
+  long long last_payout_id;
+  long long last_adjust_id;
+} rcache_mark_t;
+
+typedef enum { RCACHE_HIT = 0, RCACHE_MISS, RCACHE_STALE } rcache_result_t;
+
+/* Read the current watermark; returns 0 on success. */
+int rcache_mark(MYSQL* c, long bm, const char* from, const char* to, rcache_mark_t* m);
+
+/* On RCACHE_HIT *data (malloc'd, caller frees) holds the cached bytes. */
+rcache_result_t rcache_get(const char* key, const rcache_mark_t* m, char** data, size_t* len);
+int  rcache_put(const char* key, const rcache_mark_t* m, const char* data, size_t len);
+
+/* Count a hit/miss/stale/bypass in the cache's stats file. */
+void rcache_count(const char* what);
+
+/* `cache stats` / `cache clear` */
+int  rcache_stats(FILE* out);
+int  rcache_clear(void);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef GIGAM_REPLAY_H
+#define GIGAM_REPLAY_H
+
+/* Workload capture and timed replay.
+ *
+ * With GIGAM_CAPTURE=<file> every gigamctl command appends one line to the
+ * file when it ends: its start (unix ms), its duration (us), its exit code
+ * and its arguments, tab-separated (tab, newline and backslash escaped as
+ * \t \n \\). Lines go out in one O_APPEND write, so concurrent commands can
+ * share the file.
+ *
+ * replay re-issues the captured commands in start order, each at its
+ * recorded offset from the first divided by --speed, on up to --concurrency
+ * at once. Each runs as a child gigamctl (output discarded) against the
+ * DB_* database of the replay, and is timed from spawn to exit. */
+
+#include <stdbool.h>
+#include <time.h>
+#include "reportfmt.h"
+
+typedef struct {
+  const char* path;    /* NULL: capture off */
+  long long start_ms;
+  struct timespec t0;
+} capture_t;
+
+void capture_begin(capture_t* cap);
+/* append the command's line; a capture that cannot be written warns once
+ * and never changes the command's result */
+void capture_end(const capture_t* cap, int argc, char** argv, int rc);
+
+typedef struct {
+  const char* file;
+  double speed;        /* 2 = twice as fast as recorded; 0 = back to back */
+  int concurrency;
+} replay_opts_t;
+
+/* One row per command type (command and subcommand) and a last "all" row:
+ * count, errors (nonzero exit), p50/p90/p99/max latency in ms, and the
+ * recorded p50 for comparison. A summary with the lag behind the schedule
+ * goes to stderr. Returns the gigamctl exit code: 0, 1 (file unreadable or
+ * --out not writable), 2 (nothing to replay). */
+int replay_run(const replay_opts_t* o, rf_format_t fmt, const char* out_path);
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef GIGAM_REPORT_H
+#define GIGAM_REPORT_H
+
+/* Report SQL, result printing and the DB-backed report engines. */
+
+#include "db.h"
+#include "rptagg.h"
+#include "reportfmt.h"
+
+/* WHERE fragment for col within [from, to] (whole days); takes from, to. */
+#define RANGE_SQL(col) col ">=STR_TO_DATE('%s','%%Y-%%m-%%d') AND " col "<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY)"
+
+/* Payouts (p) with their owner's runner (r): a payout belongs to
+ * r.bookmaker_id, through the runner or the bettor's runner. */
+#define PAY_BETTOR_FROM "FROM payouts_bettor p JOIN bettors bt ON bt.id=p.bettor_id JOIN runners r ON r.id=bt.runner_id "
+#define PAY_RUNNER_FROM "FROM payouts_runner p JOIN runners r ON r.id=p.runner_id "
+
+/* The SQL behind each report kind (dates already validated). */
+int report_sql(rpt_kind_t kind, long bm, const char* from, const char* to, char* q, size_t n);
+
+/* Print a result set; returns 0, or 1 if out_path cannot be opened. */
+int report_print(MYSQL_RES* r, rf_format_t fmt, FILE* out, const char* out_path);
+
+/* Render a result set into a malloc'd buffer; 0 on success. */
+int report_render(MYSQL_RES* r, rf_format_t fmt, char** buf, size_t* len);
+
+/* One report through the on-disk cache (rcache.h): served from disk while
+ * the range's watermark is unchanged, else recomputed and stored. */
+int report_run_cached(MYSQL* c, const db_config_t* cfg, rpt_kind_t kind, long bm,
+                      const char* from, const char* to, rf_format_t fmt, const char* out_path);
+
+/* One report for one bookmaker. */
+typedef struct {
+  rpt_kind_t kind;
+  long bm;
+  int shard;           /* index into the configs of report_run_jobs */
+} report_job_t;
+
+/* Run independent report queries concurrently on up to `parallel`
+ * connections per database, each job on cfgs[job.shard]. Each result is formatted as soon as it arrives: into
+ * out_dir/<kind>_bm<id>.<ext> when out_dir is set, else to stdout behind a
+ * "# report=<kind> bookmaker_id=<id>" line. Returns the CLI exit code. */
+int report_run_jobs(const db_config_t* cfgs, int ncfg, const report_job_t* jobs, size_t njobs, int parallel,
+                    const char* from, const char* to, rf_format_t fmt, const char* out_dir);
+
+/* Fill every report aggregate for bookmaker bm and [from,to] from a single
+ * streamed scan of bets (joined with runner_commissions) plus the two
+ * grouped payout tables. Returns 0 on success. */
+int report_scan_all(MYSQL* c, long bm, const char* from, const char* to, rpt_agg_t* out);
+
+/* Same aggregates, but [from_day,to_day] is split into chunk_days-long
+ * chunks whose grouped partial sums run on up to `parallel` connections and
+ * are merged here as they complete (progress on stderr). Names are not
+ * loaded. Returns 0 on success. */
+int report_scan_chunked(const db_config_t* cfg, long bm, int from_day, int to_day, int chunk_days,
+                        int parallel, rpt_agg_t* out);
+
+/* Resolve runners.name / bettors.code for the ids present in the aggregate. */
+int report_load_names(MYSQL* c, rpt_agg_t* a);
+
+/* Write every report kind into dir as <kind>.<json|csv|txt>. */
+int report_write_all(const rpt_agg_t* a, const char* dir, rf_format_t fmt);
+
+/* Closing-line value of the single bets placed in [from,to], per bettor
+ * (by NULL or "bettor") or per runner: each bet's price against the
+ * bookmaker's last quote for its pick captured before the event started.
+ * Bets and quotes stream on two connections (c and one from cfg), both
+ * sorted by pick, and meet in a client-side as-of merge: one pass over
+ * each. clv_pct is stake-weighted over the bets with a closing quote.
+ * Returns the CLI exit code. */
+int report_clv(MYSQL* c, const db_config_t* cfg, long bm, const char* from, const char* to,
+               const char* by, rf_format_t fmt, const char* out_path);
+
+#endif
@@ -3,6 +3,9 @@
 
 // Minimal, warning-free C11 formatting sink for table/json/csv.
 // Designed to avoid breaking existing code: push headers, push rows, end.
+// Output is byte-identical to the historical CLI printers (db_print_result
+// for table, print_result_json/csv for json/csv), so SQL-backed and
+// client-computed reports look the same.
 
 #include <stdio.h>
 #include <stddef.h>
@@ -21,7 +24,8 @@ typedef enum {
 // Opaque context
 typedef struct rf_ctx rf_ctx_t;
 
-// Crear el sink. Si out_path != NULL y fmt es JSON o CSV, el módulo intentará abrir ese archivo.
+// Crear el sink. Si out_path != NULL y fmt es JSON o CSV, el módulo intentará abrir ese archivo
+// (devuelve NULL si no se puede abrir).
 // Para TABLE, se ignora out_path y se usa siempre 'out' (típicamente stdout).
 // Si out_path es NULL, se escribe en 'out'.
 rf_ctx_t* rf_begin(rf_format_t fmt,
@@ -30,7 +34,8 @@ rf_ctx_t* rf_begin(rf_format_t fmt,
                    const char* const * headers,
                    size_t ncols);
 
-// Agregar una fila (array de ncols strings, ya formateados). Se copian internamente.
+// Agregar una fila (array de ncols strings, ya formateados). Se escribe de inmediato.
+// Una celda NULL equivale a SQL NULL: "NULL" en table, "" en json/csv.
 bool rf_row(rf_ctx_t* ctx, const char* const * cells);
 
 // Terminar. Cierra archivo si lo abrió internamente. Devuelve true si todo OK.
@@ -39,6 +44,7 @@ bool rf_end(rf_ctx_t* ctx);
 // Helpers
 rf_format_t rf_format_from_str(const char* s);   // "table" | "json" | "csv" (default table)
 const char* rf_format_name(rf_format_t f);
+void rf_json_escape(FILE* f, const char* s);     // literal JSON con comillas
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,70 @@
+#ifndef GIGAM_RPTAGG_H
+#define GIGAM_RPTAGG_H
+
+/* Client-side report aggregates.
+ *
+ * Engines that compute the `report` subcommands without running the SQL
+ * GROUP BY (snapshot files, streaming scans) fill an rpt_agg_t and hand it
+ * to rpt_emit(), which renders the exact rows, column aliases, ordering
+ * and ROUND(x/100,2) formatting of the SQL reports in src/cli.c. */
+
+#include "hmap.h"
+#include "reportfmt.h"
+#include <stdio.h>
+
+typedef enum {
+  RPT_PNL = 0,
+  RPT_PNL_RUNNER,
+  RPT_PNL_BETTOR,
+  RPT_RUNNER_COMMISSIONS,
+  RPT_BETTOR_BALANCES,
+  RPT_RUNNER_BALANCES,
+  RPT_KIND_COUNT
+} rpt_kind_t;
+
+/* Per-runner or per-bettor accumulator (all money in cents). */
+typedef struct {
+  long long bets, handle_cents, profit_cents;  /* settled bets in range */
+  long long comm_cents, comm_items;            /* runner_commissions in range */
+  long long paid_cents;                        /* payouts_* in range */
+  const char* name;                            /* runners.name / bettors.code */
+} rpt_acc_t;
+
+typedef struct rpt_arena rpt_arena_t;
+
+typedef struct {
+  long long bets, handle_cents, profit_cents;  /* global pnl */
+  hmap_t runners;                              /* runner_id -> rpt_acc_t */
+  hmap_t bettors;                              /* bettor_id -> rpt_acc_t */
+  rpt_arena_t* names;                          /* owns copied names */
+} rpt_agg_t;
+
+void rpt_agg_init(rpt_agg_t* a);
+void rpt_agg_free(rpt_agg_t* a);
+rpt_acc_t* rpt_runner(rpt_agg_t* a, long long runner_id);
+rpt_acc_t* rpt_bettor(rpt_agg_t* a, long long bettor_id);
+/* Copy name into the aggregate's arena (no-op when acc already named). */
+void rpt_set_name(rpt_agg_t* a, rpt_acc_t* acc, const char* name);
+/* dst += src; names are copied when dst has none. */
+int  rpt_agg_merge(rpt_agg_t* dst, const rpt_agg_t* src);
+
+/* One settled bet / commission / payout row. */
+void rpt_add_bet(rpt_agg_t* a, long long runner_id, long long bettor_id,
+                 long long stake_cents, long long profit_cents);
+void rpt_add_commission(rpt_agg_t* a, long long runner_id, long long commission_cents);
+void rpt_add_bettor_payout(rpt_agg_t* a, long long bettor_id, long long amount_cents);
+void rpt_add_runner_payout(rpt_agg_t* a, long long runner_id, long long amount_cents);
+
+/* "pnl" + --by runner|bettor|NULL, "runner-commissions", ...; -1 if unknown. */
+int rpt_kind_from(const char* sub, const char* by);
+const char* rpt_kind_name(rpt_kind_t k);
+
+/* Render one report; returns 0 on success, 1 if --out cannot be opened. */
+int rpt_emit(const rpt_agg_t* a, rpt_kind_t kind, rf_format_t fmt, FILE* out, const char* out_path);
+
+/* Helpers shared by the engines. */
+int  rpt_parse_day(const char* ymd, int* day);          /* days since 1970-01-01 */
+void rpt_fmt_day(int day, char* buf, size_t n);          /* inverse: YYYY-MM-DD */
+void rpt_fmt_cents(long long cents, char* buf, size_t n); /* ROUND(cents/100,2) */
+
+#endif
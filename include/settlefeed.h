@@ -0,0 +1,34 @@
+#ifndef GIGAM_SETTLEFEED_H
+#define GIGAM_SETTLEFEED_H
+
+/* settle follow: score feed -> events -> settlement, without an operator.
+ *
+ * Feed lines (file or FIFO, read until EOF; '#' starts a comment):
+ *   <event_id> <home>-<away> live|final
+ *   <event_id> void
+ * Updates are written to events in batches (one UPDATE per batch, last
+ * line per event wins). Each event that turns final or void is queued for
+ * settlement on a pool of workers with their own connections; the reader
+ * blocks while the queue is full. Per event it prints the bets settled and
+ * the time from reading the final line to the settle commit.
+ *
+ * With shards every batch goes to each shard at once (events are on all of
+ * them) and a worker settles its event on every shard, one context each. */
+
+#include "shard.h"
+
+typedef struct {
+  const char* feed;   /* path; "-" = stdin */
+  int workers;        /* settlement connections */
+  int queue;          /* pending events before the reader waits */
+  int batch;          /* max updates per UPDATE */
+  int batch_ms;       /* max wait before a partial batch is written */
+  long chunk_rows;    /* settlement scan chunk (gigam_set_scan_chunk) */
+} settle_feed_opts_t;
+
+/* Malformed lines are reported on stderr and skipped. Returns the gigamctl
+ * exit code: 0, 1 (feed unreadable), 5 (database, or an event failed to
+ * settle). */
+int settle_follow(MYSQL* const* conns, const shard_map_t* shards, const settle_feed_opts_t* o);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef GIGAM_SHARD_H
+#define GIGAM_SHARD_H
+
+/* Bookmaker shards: which database holds each bookmaker's rows.
+ *
+ * The map is read from the file named by GIGAM_SHARDS, or inline from
+ * GIGAM_SHARD_MAP with ';' between entries. One entry per line:
+ *
+ *   # name  host[:port][/dbname]  bookmaker ids
+ *   a       127.0.0.1:3307        1-99,150
+ *   b       127.0.0.1:3308/gigam  100-149,151-,*
+ *
+ * Ids are N, N-M, N- (and up) or * (any id no other entry claims); ranges
+ * of different shards must not overlap. Port and database default to
+ * DB_PORT and DB_NAME, and every shard uses DB_USER / DB_PASS. Without a
+ * map there is one shard, the DB_* database, holding every bookmaker.
+ *
+ * Commands that name no bookmaker run on the first shard listed, or the
+ * one named by GIGAM_SHARD. */
+
+#include "db.h"
+
+#define SHARD_MAX       16
+#define SHARD_RULES_MAX 64
+
+typedef struct {
+  char name[32];
+  db_config_t cfg;
+} shard_t;
+
+typedef struct { long lo, hi; int shard; } shard_rule_t;
+
+typedef struct {
+  shard_t s[SHARD_MAX]; int n;
+  shard_rule_t rule[SHARD_RULES_MAX]; int nrule;
+  int fallback;        /* shard of "*", -1 if none */
+  int home;            /* shard of commands that name no bookmaker */
+} shard_map_t;
+
+/* From the environment, as above. Returns 0, or -1 with the reason on
+ * stderr. */
+int shard_map_load(shard_map_t* m);
+/* Parse map text over base (DB_* defaults); 0, or -1 with err set. */
+int shard_map_parse(shard_map_t* m, const char* text, const db_config_t* base, char* err, size_t errsz);
+/* Shard index of a bookmaker; -1 if no entry covers it. */
+int shard_of(const shard_map_t* m, long bookmaker_id);
+
+#endif
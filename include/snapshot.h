@@ -0,0 +1,110 @@
+#ifndef GIGAM_SNAPSHOT_H
+#define GIGAM_SNAPSHOT_H
+
+/* Columnar snapshot of settled bets, commissions and payouts.
+ *
+ * File layout (native little-endian, every section 8-byte aligned):
+ *
+ *   snap_header_t                     magic "GIGSNAP1", table directory
+ *   per table:
+ *     snap_block_t[nblocks]           row ranges with min/max day
+ *     column 0 .. column ncols-1      fixed-width arrays, nrows each
+ *   string heap                       NUL-terminated names + dictionaries
+ *
+ * Ids and cents are int64, days are int32 days since 1970-01-01, enums are
+ * uint8 codes whose labels live in a per-column dictionary. Rows are
+ * written ordered by day, so the per-block min/max lets readers skip
+ * whole blocks outside a --from/--to range. */
+
+#include "db.h"
+#include "rptagg.h"
+#include <stdint.h>
+
+#define SNAP_MAGIC      "GIGSNAP1"
+#define SNAP_VERSION    1u
+#define SNAP_BLOCK_ROWS 65536u
+#define SNAP_MAX_COLS   12
+#define SNAP_MAX_DICT   16
+
+typedef enum { SNAP_I64 = 1, SNAP_I32 = 2, SNAP_U8 = 3, SNAP_U32 = 4 } snap_coltype_t;
+
+typedef enum {
+  SNAP_BETS = 0,        /* settled bets */
+  SNAP_COMMISSIONS,     /* runner_commissions joined with their bet */
+  SNAP_BETTOR_PAYOUTS,  /* payouts_bettor */
+  SNAP_RUNNER_PAYOUTS,  /* payouts_runner */
+  SNAP_RUNNERS,         /* dimension: id, bookmaker_id, name */
+  SNAP_BETTORS,         /* dimension: id, runner_id, code */
+  SNAP_NTABLES
+} snap_table_id_t;
+
+/* column indexes per table */
+enum { SB_ID, SB_BOOKMAKER, SB_RUNNER, SB_BETTOR, SB_STAKE, SB_PROFIT, SB_DAY, SB_RESULT, SB_MARKET, SB_SIDE, SB_NCOLS };
+enum { SC_ID, SC_BET, SC_RUNNER, SC_BOOKMAKER, SC_CENTS, SC_DAY, SC_SCHEME, SC_NCOLS };
+enum { SP_ID, SP_OWNER, SP_CENTS, SP_DAY, SP_NCOLS };
+enum { SD_ID, SD_PARENT, SD_NAME, SD_NCOLS };
+
+typedef struct {
+  uint64_t row_start;
+  uint32_t nrows;
+  int32_t  min_day;
+  int32_t  max_day;
+  uint32_t pad;
+} snap_block_t;
+
+typedef struct {
+  uint32_t type;        /* snap_coltype_t */
+  uint32_t ndict;       /* dictionary entries for SNAP_U8 enum columns */
+  uint64_t off;         /* file offset of the column array */
+  uint32_t dict[SNAP_MAX_DICT]; /* heap offsets of the labels, code == index */
+} snap_col_t;
+
+typedef struct {
+  uint64_t nrows;
+  uint32_t ncols;
+  uint32_t nblocks;
+  int32_t  day_col;     /* -1 when the table has no day column */
+  uint32_t pad;
+  uint64_t blocks_off;
+  snap_col_t cols[SNAP_MAX_COLS];
+} snap_table_t;
+
+typedef struct {
+  char     magic[8];
+  uint32_t version;
+  uint32_t ntables;
+  int64_t  created_unix;
+  uint64_t heap_off, heap_len;
+  snap_table_t tables[SNAP_NTABLES];
+} snap_header_t;
+
+/* Mapped snapshot (read side). */
+typedef struct {
+  const unsigned char* base;
+  size_t size;
+  const snap_header_t* hdr;
+} snap_t;
+
+/* Scope of a snapshot write: bookmaker 0 = all, NULL dates = unbounded. */
+typedef struct {
+  long bookmaker_id;
+  const char* from;
+  const char* to;
+} snap_scope_t;
+
+typedef struct {
+  uint64_t rows[SNAP_NTABLES];
+} snap_stats_t;
+
+int  snap_write(MYSQL* c, const snap_scope_t* scope, const char* path, snap_stats_t* st);
+
+int  snap_open(const char* path, snap_t* s);
+void snap_close(snap_t* s);
+const void* snap_column(const snap_t* s, int table, int col);
+const char* snap_string(const snap_t* s, uint32_t heap_off);
+
+/* Aggregate the report inputs for bookmaker bm and [from_day,to_day]
+ * using nthreads workers; names are resolved from the dimensions. */
+int  snap_aggregate(const snap_t* s, long bm, int from_day, int to_day, int nthreads, rpt_agg_t* out);
+
+#endif
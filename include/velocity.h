@@ -0,0 +1,43 @@
+#ifndef GIGAM_VELOCITY_H
+#define GIGAM_VELOCITY_H
+
+/* risk velocity: betting bursts and copy-betting in recent bets.
+ *
+ * The bookmaker's bets of the last --since are streamed in placed_at order
+ * (idx_bets_book_placed, schema/009) through one ring buffer that holds
+ * just the bets still inside the sliding window. Every bettor and runner
+ * with a bet in the window keeps a running count and stake; a bet leaving
+ * the ring is taken off its bettor and runner, and one left with nothing
+ * in the window is dropped, so memory follows the active bettors rather
+ * than the day's bets. Crossing --max-bets or --max-stake-cents opens a
+ * flag that stays open, tracking its peak, until the bettor (or runner)
+ * goes a whole window without betting.
+ *
+ * Follow detection: the last bettor on each single pick (event, market,
+ * side, line) is remembered for --follow-secs. A different bettor landing
+ * on the same pick inside that time follows them. Follows are counted on
+ * the follower while it stays in the window (its VEL_LEADERS most followed
+ * bettors); reaching --follow-min flags the pair on the follower. */
+
+#include "db.h"
+#include "reportfmt.h"
+
+typedef struct {
+  long bookmaker_id;
+  long since_s;                     /* bets placed in [now - since_s, now] */
+  long window_s;                    /* sliding window */
+  long max_bets;                    /* per bettor in the window; 0 = off */
+  long long max_stake_cents;        /* per bettor in the window; 0 = off */
+  long runner_max_bets;             /* per runner; 0 = off */
+  long long runner_max_stake_cents; /* per runner; 0 = off */
+  long follow_s;                    /* 0 = no follow detection */
+  long follow_min;
+} velocity_opts_t;
+
+/* One row per flag in the order raised: entity (bettor|runner), id, flag
+ * (rate|stake|follow), first_at, peak_bets, peak_stake_usd, leader_id,
+ * follows. Returns the gigamctl exit code: 0, 1 (--out not writable),
+ * 5 (database or memory). */
+int velocity_run(MYSQL* c, const velocity_opts_t* o, rf_format_t fmt, const char* out_path);
+
+#endif
@@ -0,0 +1,11 @@
+-- Client idempotency key for bets (journal replay, retried requests).
+-- migrate.sh applies every file on each run, so the ALTER is guarded.
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bets ADD COLUMN bet_key VARCHAR(64) NULL, ADD UNIQUE KEY uq_bets_key (bet_key)',
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND COLUMN_NAME='bet_key');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
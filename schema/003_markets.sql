@@ -0,0 +1,24 @@
+-- Markets from the rule table (include/market.h): btts, correct_score,
+-- double_chance, dnb, team totals. Values are appended so existing ENUM
+-- codes (market_type+0, side+0) keep their meaning; guarded for re-runs.
+
+SET @mk := "ENUM('moneyline','threeway','spread','total','btts','correct_score','double_chance','dnb','team_total_home','team_total_away') NOT NULL";
+SET @sd := "ENUM('HOME','AWAY','DRAW','OVER','UNDER','YES','NO','HOME_DRAW','HOME_AWAY','DRAW_AWAY','SCORE') NOT NULL";
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  CONCAT('ALTER TABLE quotes MODIFY market_type ', @mk, ', MODIFY side ', @sd),
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='quotes' AND COLUMN_NAME='market_type' AND COLUMN_TYPE LIKE '%team_total_away%');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  CONCAT('ALTER TABLE bets MODIFY market_type ', @mk, ', MODIFY pick_side ', @sd),
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND COLUMN_NAME='market_type' AND COLUMN_TYPE LIKE '%team_total_away%');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
@@ -0,0 +1,44 @@
+-- Parlays: a bets row with bet_type='parlay' (event/market/side repeat
+-- leg 1) plus one bet_legs row per leg. Events can be voided (called
+-- off): singles are refunded and legs count as 1.0. Guarded for re-runs.
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  "ALTER TABLE events MODIFY status ENUM('scheduled','live','final','void') NOT NULL DEFAULT 'scheduled'",
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='events' AND COLUMN_NAME='status' AND COLUMN_TYPE LIKE '%void%');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  "ALTER TABLE bets ADD COLUMN bet_type ENUM('single','parlay') NOT NULL DEFAULT 'single'",
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND COLUMN_NAME='bet_type');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+CREATE TABLE IF NOT EXISTS bet_legs (
+  id BIGINT PRIMARY KEY AUTO_INCREMENT,
+  bet_id BIGINT NOT NULL,
+  leg_no TINYINT NOT NULL,
+  event_id BIGINT NOT NULL,
+  quote_id BIGINT NULL,
+  market_type ENUM('moneyline','threeway','spread','total','btts','correct_score','double_chance','dnb','team_total_home','team_total_away') NOT NULL,
+  pick_side ENUM('HOME','AWAY','DRAW','OVER','UNDER','YES','NO','HOME_DRAW','HOME_AWAY','DRAW_AWAY','SCORE') NOT NULL,
+  line DOUBLE NULL,
+  is_asian TINYINT NOT NULL DEFAULT 0,
+  line_b DOUBLE NULL,
+  price_decimal DOUBLE NOT NULL,
+  price_decimal_b DOUBLE NULL,
+  status ENUM('open','settled','void') NOT NULL DEFAULT 'open',
+  result ENUM('win','lose','push') NULL,
+  factor DOUBLE NULL,               -- return per unit staked: price, 1.0 (push/void), 0, or a quarter-line mix
+  UNIQUE KEY uq_leg (bet_id, leg_no),
+  KEY idx_legs_evt (event_id, status),
+  CONSTRAINT fk_leg_bet FOREIGN KEY (bet_id) REFERENCES bets(id),
+  CONSTRAINT fk_leg_event FOREIGN KEY (event_id) REFERENCES events(id),
+  CONSTRAINT fk_leg_quote FOREIGN KEY (quote_id) REFERENCES quotes(id)
+) ENGINE=InnoDB;
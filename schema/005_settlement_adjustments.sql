@@ -0,0 +1,116 @@
+-- Finance tables the commission/payout code has always written to, plus
+-- score-correction adjustments. Guarded for re-runs and for databases
+-- where the finance tables already exist.
+
+CREATE TABLE IF NOT EXISTS runner_commissions (
+  id BIGINT PRIMARY KEY AUTO_INCREMENT,
+  bet_id BIGINT NOT NULL,
+  runner_id BIGINT NOT NULL,
+  commission_cents BIGINT NOT NULL,
+  scheme ENUM('net','handle') NOT NULL,
+  rate DECIMAL(5,2) NOT NULL,
+  adjustment_id BIGINT NOT NULL DEFAULT 0,   -- 0 = settlement, else settlement_adjustments.id
+  created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  UNIQUE KEY uq_rc_bet_adj (bet_id, runner_id, adjustment_id),
+  KEY idx_rc_runner (runner_id),
+  CONSTRAINT fk_rc_bet FOREIGN KEY (bet_id) REFERENCES bets(id),
+  CONSTRAINT fk_rc_runner FOREIGN KEY (runner_id) REFERENCES runners(id)
+) ENGINE=InnoDB;
+
+CREATE TABLE IF NOT EXISTS payouts_runner (
+  id BIGINT PRIMARY KEY AUTO_INCREMENT,
+  runner_id BIGINT NOT NULL,
+  amount_cents BIGINT NOT NULL,
+  note VARCHAR(255) NULL,
+  period_from DATE NULL,
+  period_to DATE NULL,
+  created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  KEY idx_pr_runner (runner_id, created_at),
+  CONSTRAINT fk_pr_runner FOREIGN KEY (runner_id) REFERENCES runners(id)
+) ENGINE=InnoDB;
+
+CREATE TABLE IF NOT EXISTS payouts_bettor (
+  id BIGINT PRIMARY KEY AUTO_INCREMENT,
+  bettor_id BIGINT NOT NULL,
+  amount_cents BIGINT NOT NULL,
+  note VARCHAR(255) NULL,
+  period_from DATE NULL,
+  period_to DATE NULL,
+  created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  KEY idx_pb_bettor (bettor_id, created_at),
+  CONSTRAINT fk_pb_bettor FOREIGN KEY (bettor_id) REFERENCES bettors(id)
+) ENGINE=InnoDB;
+
+-- pre-existing runner_commissions: one row per (bet, runner) becomes one
+-- per (bet, runner, adjustment)
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE runner_commissions ADD COLUMN adjustment_id BIGINT NOT NULL DEFAULT 0',
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='runner_commissions' AND COLUMN_NAME='adjustment_id');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE runner_commissions ADD UNIQUE KEY uq_rc_bet_adj (bet_id, runner_id, adjustment_id)',
+  'DO 0')
+  FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='runner_commissions' AND INDEX_NAME='uq_rc_bet_adj');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+-- any other unique key on runner_commissions would reject adjustment rows
+SET @ix := (SELECT MIN(INDEX_NAME) FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='runner_commissions' AND NON_UNIQUE=0
+    AND INDEX_NAME NOT IN ('PRIMARY','uq_rc_bet_adj'));
+SET @s := IF(@ix IS NULL, 'DO 0', CONCAT('ALTER TABLE runner_commissions DROP INDEX `', @ix, '`'));
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+-- One row per bet whose money changed under a score correction; the bets
+-- row itself holds the corrected result, these are the deltas applied.
+CREATE TABLE IF NOT EXISTS settlement_adjustments (
+  id BIGINT PRIMARY KEY AUTO_INCREMENT,
+  bet_id BIGINT NOT NULL,
+  event_id BIGINT NOT NULL,
+  bookmaker_id BIGINT NOT NULL,
+  runner_id BIGINT NOT NULL,
+  bettor_id BIGINT NOT NULL,
+  old_home INT NOT NULL,
+  old_away INT NOT NULL,
+  new_home INT NOT NULL,
+  new_away INT NOT NULL,
+  old_result ENUM('win','lose','push') NULL,
+  new_result ENUM('win','lose','push') NULL,   -- NULL: parlay reopened
+  payout_delta_cents BIGINT NOT NULL,
+  profit_delta_cents BIGINT NOT NULL,
+  commission_delta_cents BIGINT NOT NULL,
+  created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  KEY idx_adj_bet (bet_id),
+  KEY idx_adj_book (bookmaker_id, id),
+  KEY idx_adj_evt (event_id),
+  CONSTRAINT fk_adj_bet FOREIGN KEY (bet_id) REFERENCES bets(id)
+) ENGINE=InnoDB;
+
+-- settle correct reads the distinct picks of an event from these indexes
+-- and then only the bets of picks whose outcome changed
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bets ADD KEY idx_bets_pick (event_id, status, bet_type, market_type, pick_side, line, line_b, is_asian)',
+  'DO 0')
+  FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND INDEX_NAME='idx_bets_pick');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bet_legs ADD KEY idx_legs_pick (event_id, status, market_type, pick_side, line, line_b, is_asian)',
+  'DO 0')
+  FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bet_legs' AND INDEX_NAME='idx_legs_pick');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
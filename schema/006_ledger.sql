@@ -0,0 +1,75 @@
+-- Double-entry ledger: every settlement, commission, payout and score
+-- correction posts an account entry and its contra on the bookmaker's book
+-- (see include/ledger.h). ledger_balances holds the running balance of each
+-- bettor/runner account.
+
+CREATE TABLE IF NOT EXISTS ledger_entries (
+  id BIGINT PRIMARY KEY AUTO_INCREMENT,
+  kind ENUM('bettor','runner','book') NOT NULL,
+  owner_id BIGINT NOT NULL,                 -- bettors.id, runners.id or bookmakers.id
+  bookmaker_id BIGINT NOT NULL,
+  amount_cents BIGINT NOT NULL,
+  balance_after_cents BIGINT NULL,          -- NULL on book entries and opening entries
+  source ENUM('settlement','commission','payout','adjustment') NOT NULL,
+  source_id BIGINT NOT NULL,                -- bets / runner_commissions / payouts_* / settlement_adjustments id
+  bet_id BIGINT NULL,
+  created_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP,
+  KEY idx_le_owner (kind, owner_id, id),
+  KEY idx_le_book (bookmaker_id, kind, created_at),
+  KEY idx_le_src (source, source_id)
+) ENGINE=InnoDB;
+
+CREATE TABLE IF NOT EXISTS ledger_balances (
+  kind ENUM('bettor','runner') NOT NULL,
+  owner_id BIGINT NOT NULL,
+  bookmaker_id BIGINT NOT NULL,
+  balance_cents BIGINT NOT NULL DEFAULT 0,
+  entries BIGINT NOT NULL DEFAULT 0,
+  updated_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP ON UPDATE CURRENT_TIMESTAMP,
+  PRIMARY KEY (kind, owner_id)
+) ENGINE=InnoDB;
+
+-- Opening entries for databases settled before the ledger existed: only
+-- while ledger_entries is still empty, so re-runs post nothing. Settled bets
+-- carry their corrected profit, so adjustments are already in them.
+SET @empty := (SELECT COUNT(*)=0 FROM ledger_entries);
+
+INSERT INTO ledger_entries(kind,owner_id,bookmaker_id,amount_cents,source,source_id,bet_id,created_at)
+SELECT x.kind, x.owner_id, x.bookmaker_id, x.amount_cents, 'settlement', x.id, x.id, x.settled_at FROM (
+  SELECT 'bettor' AS kind, bettor_id AS owner_id, bookmaker_id, -profit_cents AS amount_cents, id, COALESCE(settled_at,NOW()) AS settled_at
+    FROM bets WHERE status='settled' AND profit_cents<>0
+  UNION ALL
+  SELECT 'book', bookmaker_id, bookmaker_id, profit_cents, id, COALESCE(settled_at,NOW())
+    FROM bets WHERE status='settled' AND profit_cents<>0
+) x WHERE @empty;
+
+INSERT INTO ledger_entries(kind,owner_id,bookmaker_id,amount_cents,source,source_id,bet_id,created_at)
+SELECT x.kind, x.owner_id, x.bookmaker_id, x.amount_cents,
+       IF(x.adjustment_id>0,'adjustment','commission'), IF(x.adjustment_id>0,x.adjustment_id,x.id), x.bet_id, x.created_at FROM (
+  SELECT 'runner' AS kind, rc.runner_id AS owner_id, b.bookmaker_id, rc.commission_cents AS amount_cents,
+         rc.adjustment_id, rc.id, rc.bet_id, rc.created_at
+    FROM runner_commissions rc JOIN bets b ON b.id=rc.bet_id WHERE rc.commission_cents<>0
+  UNION ALL
+  SELECT 'book', b.bookmaker_id, b.bookmaker_id, -rc.commission_cents, rc.adjustment_id, rc.id, rc.bet_id, rc.created_at
+    FROM runner_commissions rc JOIN bets b ON b.id=rc.bet_id WHERE rc.commission_cents<>0
+) x WHERE @empty;
+
+INSERT INTO ledger_entries(kind,owner_id,bookmaker_id,amount_cents,source,source_id,created_at)
+SELECT x.kind, x.owner_id, x.bookmaker_id, x.amount_cents, 'payout', x.id, x.created_at FROM (
+  SELECT 'runner' AS kind, p.runner_id AS owner_id, r.bookmaker_id, -p.amount_cents AS amount_cents, p.id, p.created_at
+    FROM payouts_runner p JOIN runners r ON r.id=p.runner_id
+  UNION ALL
+  SELECT 'book', r.bookmaker_id, r.bookmaker_id, p.amount_cents, p.id, p.created_at
+    FROM payouts_runner p JOIN runners r ON r.id=p.runner_id
+  UNION ALL
+  SELECT 'bettor', p.bettor_id, r.bookmaker_id, -p.amount_cents, p.id, p.created_at
+    FROM payouts_bettor p JOIN bettors bt ON bt.id=p.bettor_id JOIN runners r ON r.id=bt.runner_id
+  UNION ALL
+  SELECT 'book', r.bookmaker_id, r.bookmaker_id, p.amount_cents, p.id, p.created_at
+    FROM payouts_bettor p JOIN bettors bt ON bt.id=p.bettor_id JOIN runners r ON r.id=bt.runner_id
+) x WHERE @empty AND x.amount_cents<>0;
+
+INSERT INTO ledger_balances(kind,owner_id,bookmaker_id,balance_cents,entries)
+SELECT IF(kind='bettor','bettor','runner'), owner_id, MIN(bookmaker_id), SUM(amount_cents), COUNT(*)
+  FROM ledger_entries WHERE @empty AND kind<>'book' GROUP BY kind, owner_id
+ON DUPLICATE KEY UPDATE balance_cents=VALUES(balance_cents), entries=VALUES(entries);
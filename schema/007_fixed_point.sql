@@ -0,0 +1,114 @@
+-- Fixed-point odds and lines (see include/market.h): prices in
+-- ten-thousandths (price_e4), lines in quarter goals (line_q), parlay leg
+-- returns in millionths (factor_e6). The integer columns are the stored
+-- values; the old DOUBLE columns become DECIMAL views of them, so existing
+-- readers (bet list, ad-hoc SQL) keep working with exact values.
+--
+-- Each table converts once: @conv is set while its price_decimal is still
+-- a stored column; the views are added while price_decimal is missing.
+-- Backfill rounds the doubles to the nearest unit.
+
+-- quotes
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE quotes ADD COLUMN line_q INT NULL, ADD COLUMN line_b_q INT NULL, ADD COLUMN price_e4 INT NOT NULL DEFAULT 0, ADD COLUMN price_b_e4 INT NULL',
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='quotes' AND COLUMN_NAME='price_e4');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @conv := (SELECT COUNT(*) FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='quotes' AND COLUMN_NAME='price_decimal' AND EXTRA NOT LIKE '%GENERATED%');
+SET @s := IF(@conv,
+  'UPDATE quotes SET line_q=ROUND(line*4), line_b_q=ROUND(line_b*4), price_e4=ROUND(price_decimal*10000), price_b_e4=ROUND(price_decimal_b*10000)',
+  'DO 0');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := IF(@conv,
+  'ALTER TABLE quotes DROP COLUMN line, DROP COLUMN line_b, DROP COLUMN price_decimal, DROP COLUMN price_decimal_b',
+  'DO 0');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE quotes ADD COLUMN line DECIMAL(8,2) AS (line_q/4) VIRTUAL, ADD COLUMN line_b DECIMAL(8,2) AS (line_b_q/4) VIRTUAL, ADD COLUMN price_decimal DECIMAL(10,4) AS (price_e4/10000) VIRTUAL, ADD COLUMN price_decimal_b DECIMAL(10,4) AS (price_b_e4/10000) VIRTUAL',
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='quotes' AND COLUMN_NAME='price_decimal');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+-- bets
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bets ADD COLUMN line_q INT NULL, ADD COLUMN line_b_q INT NULL, ADD COLUMN price_e4 INT NOT NULL DEFAULT 0, ADD COLUMN price_b_e4 INT NULL',
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND COLUMN_NAME='price_e4');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @conv := (SELECT COUNT(*) FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND COLUMN_NAME='price_decimal' AND EXTRA NOT LIKE '%GENERATED%');
+SET @s := IF(@conv,
+  'UPDATE bets SET line_q=ROUND(line*4), line_b_q=ROUND(line_b*4), price_e4=ROUND(price_decimal*10000), price_b_e4=ROUND(price_decimal_b*10000)',
+  'DO 0');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := IF(@conv,
+  'ALTER TABLE bets DROP KEY idx_bets_pick, DROP COLUMN line, DROP COLUMN line_b, DROP COLUMN price_decimal, DROP COLUMN price_decimal_b',
+  'DO 0');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bets ADD COLUMN line DECIMAL(8,2) AS (line_q/4) VIRTUAL, ADD COLUMN line_b DECIMAL(8,2) AS (line_b_q/4) VIRTUAL, ADD COLUMN price_decimal DECIMAL(10,4) AS (price_e4/10000) VIRTUAL, ADD COLUMN price_decimal_b DECIMAL(10,4) AS (price_b_e4/10000) VIRTUAL, ADD KEY idx_bets_pick (event_id, status, bet_type, market_type, pick_side, line_q, line_b_q, is_asian)',
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND COLUMN_NAME='price_decimal');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+-- bet_legs
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bet_legs ADD COLUMN line_q INT NULL, ADD COLUMN line_b_q INT NULL, ADD COLUMN price_e4 INT NOT NULL DEFAULT 0, ADD COLUMN price_b_e4 INT NULL, ADD COLUMN factor_e6 BIGINT NULL',
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bet_legs' AND COLUMN_NAME='price_e4');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @conv := (SELECT COUNT(*) FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bet_legs' AND COLUMN_NAME='price_decimal' AND EXTRA NOT LIKE '%GENERATED%');
+SET @s := IF(@conv,
+  'UPDATE bet_legs SET line_q=ROUND(line*4), line_b_q=ROUND(line_b*4), price_e4=ROUND(price_decimal*10000), price_b_e4=ROUND(price_decimal_b*10000), factor_e6=ROUND(factor*1000000)',
+  'DO 0');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := IF(@conv,
+  'ALTER TABLE bet_legs DROP KEY idx_legs_pick, DROP COLUMN line, DROP COLUMN line_b, DROP COLUMN price_decimal, DROP COLUMN price_decimal_b, DROP COLUMN factor',
+  'DO 0');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bet_legs ADD COLUMN line DECIMAL(8,2) AS (line_q/4) VIRTUAL, ADD COLUMN line_b DECIMAL(8,2) AS (line_b_q/4) VIRTUAL, ADD COLUMN price_decimal DECIMAL(10,4) AS (price_e4/10000) VIRTUAL, ADD COLUMN price_decimal_b DECIMAL(10,4) AS (price_b_e4/10000) VIRTUAL, ADD COLUMN factor DECIMAL(14,6) AS (factor_e6/1000000) VIRTUAL, ADD KEY idx_legs_pick (event_id, status, market_type, pick_side, line_q, line_b_q, is_asian)',
+  'DO 0')
+  FROM information_schema.COLUMNS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bet_legs' AND COLUMN_NAME='price_decimal');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
@@ -0,0 +1,31 @@
+-- Keyset pages for the list commands (cli.c: list_run): each filter the
+-- lists accept is an equality prefix of an index that ends in the sort key,
+-- so --after seeks straight to the next page. InnoDB appends id to every
+-- secondary index; it is spelled out where the order depends on it.
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bets ADD KEY idx_bets_book_status (bookmaker_id, status, id)',
+  'DO 0')
+  FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND INDEX_NAME='idx_bets_book_status');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE quotes ADD KEY idx_quotes_evt_book (event_id, bookmaker_id, id)',
+  'DO 0')
+  FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='quotes' AND INDEX_NAME='idx_quotes_evt_book');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE events ADD KEY idx_events_start (starts_at, id), ADD KEY idx_events_status (status, starts_at, id), ADD KEY idx_events_league (league_id, starts_at, id)',
+  'DO 0')
+  FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='events' AND INDEX_NAME='idx_events_start');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
@@ -0,0 +1,11 @@
+-- risk velocity (src/velocity.c) streams one bookmaker's recent bets in
+-- placed_at order; id breaks ties so the window sees a stable order.
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bets ADD KEY idx_bets_book_placed (bookmaker_id, placed_at, id)',
+  'DO 0')
+  FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND INDEX_NAME='idx_bets_book_placed');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
@@ -0,0 +1,13 @@
+-- Report cache watermark (src/rcache.c: rcache_mark): MAX(settled_at),
+-- COUNT(*), SUM(profit_cents) and MAX(id) over one bookmaker's bets settled
+-- in a range. With this index they are one range read of the index alone,
+-- never the rows, so a cache hit costs far less than the report it saves.
+
+SET @s := (SELECT IF(COUNT(*)=0,
+  'ALTER TABLE bets ADD KEY idx_bets_book_settled (bookmaker_id, settled_at, profit_cents, id)',
+  'DO 0')
+  FROM information_schema.STATISTICS
+  WHERE TABLE_SCHEMA=DATABASE() AND TABLE_NAME='bets' AND INDEX_NAME='idx_bets_book_settled');
+PREPARE st FROM @s;
+EXECUTE st;
+DEALLOCATE PREPARE st;
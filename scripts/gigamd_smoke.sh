@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+# Smoke test for gigamd against the local database (run `make migrate seed` first).
+# Starts gigamd, posts quotes and concurrent bets, reads risk and /metrics.
+
+set -euo pipefail
+
+: "${DB_HOST:=127.0.0.1}"
+: "${DB_PORT:=3306}"
+: "${DB_NAME:=gigam_db}"
+: "${DB_USER:=gigam_user}"
+: "${DB_PASS:=gigam_pass}"
+: "${GIGAMD_PORT:=18080}"
+: "${BETS:=500}"
+: "${CONCURRENCY:=32}"
+
+q () {
+  mysql -N -h "$DB_HOST" -P "$DB_PORT" -u "$DB_USER" -p"$DB_PASS" "$DB_NAME" -e "$1"
+}
+
+BM=$(q "SELECT id FROM bookmakers WHERE name='DemoBook'")
+RUNNER=$(q "SELECT id FROM runners WHERE bookmaker_id=$BM AND is_default=1 LIMIT 1")
+BETTOR=$(q "SELECT id FROM bettors WHERE runner_id=$RUNNER LIMIT 1")
+q "INSERT INTO events(league_id,starts_at,home_team_id,away_team_id)
+   SELECT l.id, NOW(), (SELECT MIN(id) FROM teams WHERE league_id=l.id), (SELECT MAX(id) FROM teams WHERE league_id=l.id)
+   FROM leagues l WHERE l.name='Premier Demo'"
+EVENT=$(q "SELECT MAX(id) FROM events")
+URL="http://127.0.0.1:$GIGAMD_PORT"
+
+./gigamd --port "$GIGAMD_PORT" --workers 8 &
+PID=$!
+trap 'kill $PID 2>/dev/null || true' EXIT
+sleep 0.5
+
+echo ">> quotes"
+curl -sf -XPOST "$URL/quotes" -d "[
+  {\"event_id\":$EVENT,\"bookmaker_id\":$BM,\"market\":\"moneyline\",\"side\":\"HOME\",\"price\":1.95},
+  {\"event_id\":$EVENT,\"bookmaker_id\":$BM,\"market\":\"moneyline\",\"side\":\"AWAY\",\"price\":2.05}]"
+
+echo ">> $BETS bets, $CONCURRENCY concurrent"
+BODY="{\"bookmaker_id\":$BM,\"event_id\":$EVENT,\"runner_id\":$RUNNER,\"bettor_id\":$BETTOR,\"market\":\"moneyline\",\"side\":\"HOME\",\"price\":1.95,\"stake_cents\":1000}"
+seq "$BETS" | xargs -P "$CONCURRENCY" -I{} curl -sf -o /dev/null -XPOST "$URL/bet" -d "$BODY"
+echo "bets stored: $(q "SELECT COUNT(*) FROM bets WHERE event_id=$EVENT")"
+
+echo ">> risk"
+curl -sf "$URL/risk/event/$EVENT"
+
+echo ">> metrics (bet route)"
+curl -sf "$URL/metrics" | grep -E 'route="bet"|group'
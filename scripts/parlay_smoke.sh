@@ -0,0 +1,67 @@
+#!/usr/bin/env bash
+# Smoke test for concurrent parlay settlement against the local database (run
+# `make migrate seed` first). Each round places two-leg parlays over a fresh
+# pair of events and settles both events at once: two `settle event` runs
+# side by side, then one feed line per event through `settle follow`. No
+# parlay may stay open once all its legs are settled.
+
+set -euo pipefail
+
+: "${DB_HOST:=127.0.0.1}"
+: "${DB_PORT:=3306}"
+: "${DB_NAME:=gigam_db}"
+: "${DB_USER:=gigam_user}"
+: "${DB_PASS:=gigam_pass}"
+: "${ROUNDS:=20}"
+: "${PARLAYS:=20}"
+export DB_HOST DB_PORT DB_NAME DB_USER DB_PASS
+
+q () {
+  mysql -N -h "$DB_HOST" -P "$DB_PORT" -u "$DB_USER" -p"$DB_PASS" "$DB_NAME" -e "$1"
+}
+
+BM=$(q "SELECT id FROM bookmakers WHERE name='DemoBook'")
+RUNNER=$(q "SELECT id FROM runners WHERE bookmaker_id=$BM AND is_default=1 LIMIT 1")
+BETTOR=$(q "SELECT id FROM bettors WHERE runner_id=$RUNNER LIMIT 1")
+
+new_event () {
+  q "INSERT INTO events(league_id,starts_at,home_team_id,away_team_id)
+     SELECT l.id, NOW(), (SELECT MIN(id) FROM teams WHERE league_id=l.id), (SELECT MAX(id) FROM teams WHERE league_id=l.id)
+     FROM leagues l WHERE l.name='Premier Demo'; SELECT LAST_INSERT_ID()"
+}
+
+# PARLAYS two-leg parlays over events $1 and $2 (both legs win at 1-0)
+place () {
+  for _ in $(seq "$PARLAYS"); do
+    ./gigamctl bet parlay --bookmaker-id "$BM" --runner-id "$RUNNER" --bettor-id "$BETTOR" --stake 1000 \
+      --leg "$1:moneyline:HOME@1.90" --leg "$2:moneyline:HOME@2.10" >/dev/null
+  done
+}
+
+stuck () {
+  q "SELECT COUNT(*) FROM bets b WHERE b.bet_type='parlay' AND b.status='open' AND b.event_id IN ($1,$2)
+     AND NOT EXISTS (SELECT 1 FROM bet_legs l WHERE l.bet_id=b.id AND l.status='open')"
+}
+
+echo ">> $ROUNDS rounds x $PARLAYS parlays, two settle event runs at once"
+for r in $(seq "$ROUNDS"); do
+  A=$(new_event); B=$(new_event)
+  place "$A" "$B"
+  ./gigamctl event set-score --event-id "$A" --home 1 --away 0 --final >/dev/null
+  ./gigamctl event set-score --event-id "$B" --home 1 --away 0 --final >/dev/null
+  ./gigamctl settle event --event-id "$A" >/dev/null & P1=$!
+  ./gigamctl settle event --event-id "$B" >/dev/null & P2=$!
+  wait "$P1"; wait "$P2"
+  n=$(stuck "$A" "$B")
+  [ "$n" = 0 ] || { echo "FAIL: round $r left $n parlays open with every leg settled"; exit 1; }
+done
+
+echo ">> $ROUNDS rounds x $PARLAYS parlays, settle follow --workers 2"
+for r in $(seq "$ROUNDS"); do
+  A=$(new_event); B=$(new_event)
+  place "$A" "$B"
+  printf '%s 1-0 final\n%s 1-0 final\n' "$A" "$B" | ./gigamctl settle follow --feed - --workers 2 >/dev/null
+  n=$(stuck "$A" "$B")
+  [ "$n" = 0 ] || { echo "FAIL: round $r left $n parlays open with every leg settled"; exit 1; }
+done
+echo "OK parlays"
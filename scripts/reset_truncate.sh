@@ -12,10 +12,14 @@ set -euo pipefail
 SQL=$(cat <<'SQL_EOF'
 SET FOREIGN_KEY_CHECKS=0;
 
+TRUNCATE TABLE ledger_entries;
+TRUNCATE TABLE ledger_balances;
+TRUNCATE TABLE settlement_adjustments;
 TRUNCATE TABLE runner_commissions;
 TRUNCATE TABLE payouts_runner;
 TRUNCATE TABLE payouts_bettor;
 
+TRUNCATE TABLE bet_legs;
 TRUNCATE TABLE bets;
 TRUNCATE TABLE quotes;
 TRUNCATE TABLE events;
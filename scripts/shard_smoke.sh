@@ -0,0 +1,86 @@
+#!/usr/bin/env bash
+# Smoke test for bookmaker shards against two local servers (default ports
+# 3307 and 3308, each with an empty DB_NAME database the DB_USER can use):
+# bookmaker 1 lives on shard a, bookmaker 2 on shard b. Migrates both, seeds
+# the reference tables through gigamctl (written to both), places a bet per
+# bookmaker and reads the cross-bookmaker commands.
+#
+#   docker run -d -p 3307:3306 -e MARIADB_ROOT_PASSWORD=root mariadb
+#   docker run -d -p 3308:3306 -e MARIADB_ROOT_PASSWORD=root mariadb
+#   DB_USER=root DB_PASS=root DB_NAME=gigam_db make smoke-shards
+
+set -euo pipefail
+
+: "${DB_HOST:=127.0.0.1}"
+: "${DB_NAME:=gigam_db}"
+: "${DB_USER:=gigam_user}"
+: "${DB_PASS:=gigam_pass}"
+: "${SHARD_A_PORT:=3307}"
+: "${SHARD_B_PORT:=3308}"
+export DB_HOST DB_NAME DB_USER DB_PASS
+
+export GIGAM_SHARD_MAP="a $DB_HOST:$SHARD_A_PORT 1; b $DB_HOST:$SHARD_B_PORT 2-"
+unset GIGAM_SHARDS GIGAM_SHARD
+
+q () {
+  mysql -N -h "$DB_HOST" -P "$1" -u "$DB_USER" -p"$DB_PASS" "$DB_NAME" -e "$2"
+}
+
+for port in "$SHARD_A_PORT" "$SHARD_B_PORT"; do
+  mysql -h "$DB_HOST" -P "$port" -u "$DB_USER" -p"$DB_PASS" -e "CREATE DATABASE IF NOT EXISTS \`$DB_NAME\`"
+  DB_PORT=$port ./scripts/migrate.sh >/dev/null
+done
+
+echo ">> bookmakers: 1 on a, 2 on b; b's own rows numbered from 1000000"
+q "$SHARD_A_PORT" "INSERT IGNORE INTO bookmakers(id,name,currency) VALUES(1,'Shard A Book','USD')"
+q "$SHARD_B_PORT" "INSERT IGNORE INTO bookmakers(id,name,currency) VALUES(2,'Shard B Book','USD')"
+for t in users runners bettors quotes bets; do
+  q "$SHARD_B_PORT" "ALTER TABLE $t AUTO_INCREMENT=1000000"
+done
+
+echo ">> reference rows, written to both shards"
+./gigamctl sport create --name Soccer
+SPORT=$(q "$SHARD_A_PORT" "SELECT id FROM sports WHERE name='Soccer'")
+./gigamctl league create --sport-id "$SPORT" --name "Shard League"
+LEAGUE=$(q "$SHARD_A_PORT" "SELECT id FROM leagues WHERE name='Shard League'")
+./gigamctl team create --league-id "$LEAGUE" --name "Shard Home"
+./gigamctl team create --league-id "$LEAGUE" --name "Shard Away"
+HOME_T=$(q "$SHARD_A_PORT" "SELECT id FROM teams WHERE name='Shard Home'")
+AWAY_T=$(q "$SHARD_A_PORT" "SELECT id FROM teams WHERE name='Shard Away'")
+./gigamctl event create --league-id "$LEAGUE" --starts-at "$(date -d '+1 hour' '+%Y-%m-%d %H:%M')" \
+  --home-id "$HOME_T" --away-id "$AWAY_T"
+EVENT=$(q "$SHARD_A_PORT" "SELECT MAX(id) FROM events")
+[ "$(q "$SHARD_B_PORT" "SELECT COUNT(*) FROM events WHERE id=$EVENT")" = 1 ] || { echo "event $EVENT missing on b"; exit 1; }
+
+echo ">> a runner, a bettor, quotes and a bet per bookmaker"
+for bm in 1 2; do
+  if [ "$bm" = 1 ]; then port=$SHARD_A_PORT; shard=a; price=1.95; else port=$SHARD_B_PORT; shard=b; price=2.10; fi
+  ./gigamctl runner create --bookmaker-id "$bm" --user "runner_bm$bm" --name "Runner $bm" --default
+  RUNNER=$(q "$port" "SELECT id FROM runners WHERE bookmaker_id=$bm AND is_default=1 LIMIT 1")
+  GIGAM_SHARD=$shard ./gigamctl bettor create --runner-id "$RUNNER" --code "S$bm" --name "Bettor $bm"
+  BETTOR=$(q "$port" "SELECT id FROM bettors WHERE runner_id=$RUNNER LIMIT 1")
+  ./gigamctl quote add --event-id "$EVENT" --bookmaker-id "$bm" --market moneyline --side HOME --price "$price"
+  ./gigamctl quote add --event-id "$EVENT" --bookmaker-id "$bm" --market moneyline --side AWAY --price 1.90
+  ./gigamctl bet place --bookmaker-id "$bm" --event-id "$EVENT" --runner-id "$RUNNER" --bettor-id "$BETTOR" \
+    --market moneyline --side HOME --price "$price" --stake 1000
+done
+[ "$(q "$SHARD_A_PORT" "SELECT COUNT(*) FROM bets WHERE bookmaker_id=2")" = 0 ] || { echo "bookmaker 2 bet on a"; exit 1; }
+
+echo ">> quote board (both bookmakers)"
+./gigamctl quote board --starts-within 2h
+echo ">> risk mtm --all (both shards)"
+./gigamctl risk mtm --all
+echo ">> risk list (grids summed)"
+./gigamctl risk list --event-id "$EVENT"
+
+echo ">> final score, settle on both shards"
+./gigamctl event set-score --event-id "$EVENT" --home 1 --away 0 --final
+./gigamctl settle event --event-id "$EVENT"
+for port in "$SHARD_A_PORT" "$SHARD_B_PORT"; do
+  [ "$(q "$port" "SELECT COUNT(*) FROM bets WHERE event_id=$EVENT AND status='open'")" = 0 ] || { echo "open bets left on :$port"; exit 1; }
+done
+
+echo ">> report pnl --bookmaker-id all"
+TODAY=$(date '+%Y-%m-%d')
+./gigamctl report pnl --bookmaker-id all --from "$TODAY" --to "$TODAY"
+echo "OK shards"
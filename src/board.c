@@ -0,0 +1,215 @@
+#include "board.h"
+#include "market.h"
+#include "rptagg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+long board_parse_window(const char* s) {
+  char* end; long v = strtol(s, &end, 10);
+  if (end == s || v <= 0) return -1;
+  long mult = 1;
+  if (*end == 'm') mult = 60;
+  else if (*end == 'h') mult = 3600;
+  else if (*end == 'd') mult = 86400;
+  else if (*end) return -1;
+  if (*end && end[1]) return -1;
+  if (v > 366L*86400/mult) return -1;
+  return v * mult;
+}
+
+/* one quote of the current (event, market) group */
+typedef struct {
+  int mline;          /* the line pairing the book sides (HOME's for handicaps) */
+  int side, line_q, line_b_q;
+  long bm;
+  long long id;
+  long price;
+} bq_t;
+
+/* best price of one selection */
+typedef struct {
+  int mline, side, line_q, line_b_q;
+  long best, bm;
+  int books;
+} bsel_t;
+
+typedef struct {
+  bq_t* q; size_t nq, cap;
+  bsel_t* s; size_t ns, scap;
+  long event; int market;
+  char starts[24];
+} bgroup_t;
+
+static int bq_cmp(const void* pa, const void* pb) {
+  const bq_t* a = (const bq_t*)pa; const bq_t* b = (const bq_t*)pb;
+  if (a->mline != b->mline) return a->mline < b->mline ? -1 : 1;
+  if (a->side != b->side) return a->side < b->side ? -1 : 1;
+  if (a->line_q != b->line_q) return a->line_q < b->line_q ? -1 : 1;
+  if (a->line_b_q != b->line_b_q) return a->line_b_q < b->line_b_q ? -1 : 1;
+  if (a->bm != b->bm) return a->bm < b->bm ? -1 : 1;
+  return (a->id < b->id) - (a->id > b->id);   /* newest first */
+}
+
+static bool same_sel(const bq_t* a, const bq_t* b) {
+  return a->mline == b->mline && a->side == b->side && a->line_q == b->line_q && a->line_b_q == b->line_b_q;
+}
+
+/* Σ 1/price of the book sides over one line, in millionths; -1 if a book
+ * side has no quote. */
+static long long book_implied(const mkt_rule_t* r, const bsel_t* s, size_t n) {
+  unsigned seen = 0; long long sum = 0;
+  for (size_t i=0;i<n;i++) {
+    if (!(r->book & (1u << s[i].side))) continue;
+    seen |= 1u << s[i].side;
+    sum += (10000000000LL + s[i].best/2) / s[i].best;
+  }
+  return seen == r->book ? sum : -1;
+}
+
+/* Reduce the group to its selections and print them line by line. */
+static int flush_group(bgroup_t* g, const board_opts_t* o, rf_ctx_t* rf) {
+  if (!g->nq) return 0;
+  qsort(g->q, g->nq, sizeof(bq_t), bq_cmp);
+  g->ns = 0;
+  for (size_t i=0;i<g->nq;) {
+    if (g->ns == g->scap) {
+      size_t cap = g->scap ? g->scap*2 : 64;
+      bsel_t* ns = (bsel_t*)realloc(g->s, cap*sizeof(bsel_t));
+      if (!ns) return -1;
+      g->s = ns; g->scap = cap;
+    }
+    bsel_t* s = &g->s[g->ns++];
+    s->mline = g->q[i].mline; s->side = g->q[i].side; s->line_q = g->q[i].line_q; s->line_b_q = g->q[i].line_b_q;
+    s->best = 0; s->bm = 0; s->books = 0;
+    size_t j = i;
+    while (j < g->nq && same_sel(&g->q[j], &g->q[i])) {
+      /* first row of each bookmaker is its latest quote */
+      const bq_t* latest = &g->q[j];
+      s->books++;
+      if (latest->price > s->best) { s->best = latest->price; s->bm = latest->bm; }
+      while (j < g->nq && same_sel(&g->q[j], &g->q[i]) && g->q[j].bm == latest->bm) j++;
+    }
+    i = j;
+  }
+
+  const mkt_rule_t* r = &mkt_rules[g->market];
+  char evs[24], line[24], price[24], bms[24], books[16], over[24];
+  snprintf(evs, sizeof(evs), "%ld", g->event);
+  for (size_t i=0;i<g->ns;) {
+    size_t j = i;
+    while (j < g->ns && g->s[j].mline == g->s[i].mline) j++;
+    long long implied = r->book ? book_implied(r, &g->s[i], j-i) : -1;
+    long long bp = implied < 0 ? 0 : (implied + r->cover*50) / (r->cover*100) - 10000;
+    bool arb = implied >= 0 && bp < 0;
+    if (implied >= 0) rpt_fmt_cents(bp, over, sizeof(over));   /* basis points -> percent */
+    if (!o->arb_only || arb) {
+      for (size_t k=i;k<j;k++) {
+        const bsel_t* s = &g->s[k];
+        if (r->flags & MKT_F_SCORE) snprintf(line, sizeof(line), "%d-%d", s->line_q/4, s->line_b_q/4);
+        else if (r->flags & MKT_F_LINE) mkt_fmt_line(s->line_q, line, sizeof(line));
+        else snprintf(line, sizeof(line), "-");
+        mkt_fmt_price(s->best, price, sizeof(price));
+        snprintf(bms, sizeof(bms), "%ld", s->bm);
+        snprintf(books, sizeof(books), "%d", s->books);
+        const char* row[10] = { evs, g->starts, r->name, line, mkt_side_names[s->side], price, bms, books,
+                                implied >= 0 ? over : NULL, implied >= 0 ? (arb ? "1" : "0") : NULL };
+        rf_row(rf, row);
+      }
+    }
+    i = j;
+  }
+  g->nq = 0;
+  return 0;
+}
+
+/* one database's stream, positioned on its next row */
+typedef struct {
+  MYSQL* c; MYSQL_RES* r; MYSQL_ROW row;
+  long long ts; long ev; int m;
+} bsrc_t;
+
+static void src_next(bsrc_t* s) {
+  s->row = mysql_fetch_row(s->r);
+  if (s->row) { s->ev = atol(s->row[0]); s->m = atoi(s->row[2]); s->ts = atoll(s->row[9]); }
+}
+
+/* streams are each in (starts_at, event, market) order */
+static bool src_before(const bsrc_t* a, const bsrc_t* b) {
+  if (a->ts != b->ts) return a->ts < b->ts;
+  if (a->ev != b->ev) return a->ev < b->ev;
+  return a->m < b->m;
+}
+
+int board_run(MYSQL* const* conns, int n, const board_opts_t* o, rf_format_t fmt, const char* out_path) {
+  char league[48] = "";
+  if (o->league_id > 0) snprintf(league, sizeof(league), " AND e.league_id=%ld", o->league_id);
+  /* events by (status, starts_at) or (league_id, starts_at), then each
+   * event's quotes through idx_quotes_evt_book (schema/008) */
+  char q[1024];
+  snprintf(q, sizeof(q),
+    "SELECT q.event_id,DATE_FORMAT(e.starts_at,'%%Y-%%m-%%d %%H:%%i'),q.market_type+0,q.side+0,"
+    "COALESCE(q.line_q,0),COALESCE(q.line_b_q,0),q.bookmaker_id,q.price_e4,q.id,UNIX_TIMESTAMP(e.starts_at) "
+    "FROM events e JOIN quotes q ON q.event_id=e.id "
+    "WHERE e.status='scheduled' AND e.starts_at>=NOW() AND e.starts_at<DATE_ADD(NOW(), INTERVAL %ld SECOND)%s AND q.is_asian=0 "
+    "ORDER BY e.starts_at,e.id,q.market_type+0", o->within_s, league);
+  /* with several databases (shard.h) each runs the scan at once and the
+   * ordered streams are merged, so a group gathers every bookmaker's quotes */
+  bsrc_t* src = (bsrc_t*)calloc((size_t)n, sizeof(bsrc_t));
+  if (!src) return 5;
+  int rc = db_exec_all(conns, n, q) != 0 ? 5 : 0;
+  for (int i=0;i<n && !rc;i++) {
+    src[i].c = conns[i];
+    src[i].r = mysql_use_result(conns[i]);
+    if (!src[i].r) { fprintf(stderr, "SQL error: %s\n", mysql_error(conns[i])); rc = 5; }
+  }
+  rf_ctx_t* rf = NULL;
+  static const char* hdr[] = { "event_id","starts_at","market","line","side","best_price","bookmaker_id","books","overround_pct","arb" };
+  if (!rc && !(rf = rf_begin(fmt, stdout, out_path, hdr, 10))) {
+    fprintf(stderr, "quote board: unable to open output file: %s\n", out_path ? out_path : "");
+    rc = 1;
+  }
+  if (rc) {
+    for (int i=0;i<n;i++) if (src[i].r) mysql_free_result(src[i].r);
+    free(src);
+    return rc;
+  }
+
+  bgroup_t g; memset(&g, 0, sizeof(g));
+  bool oom = false;
+  for (int i=0;i<n;i++) src_next(&src[i]);
+  for (;;) {
+    bsrc_t* s = NULL;
+    for (int i=0;i<n;i++) if (src[i].row && (!s || src_before(&src[i], s))) s = &src[i];
+    if (!s) break;
+    MYSQL_ROW row = s->row;
+    long ev = s->ev; int m = s->m; int sd = atoi(row[3]);
+    if (m <= MKT_NONE || m >= MKT_COUNT || sd <= SIDE_NONE || sd >= SIDE_COUNT || atol(row[7]) <= MKT_PRICE_ONE) { src_next(s); continue; }
+    if (g.nq && (ev != g.event || m != g.market)) {
+      if (flush_group(&g, o, rf) != 0) { oom = true; break; }
+    }
+    if (!g.nq) { g.event = ev; g.market = m; snprintf(g.starts, sizeof(g.starts), "%s", row[1] ? row[1] : ""); }
+    if (g.nq == g.cap) {
+      size_t cap = g.cap ? g.cap*2 : 256;
+      bq_t* nq = (bq_t*)realloc(g.q, cap*sizeof(bq_t));
+      if (!nq) { oom = true; break; }
+      g.q = nq; g.cap = cap;
+    }
+    bq_t* b = &g.q[g.nq++];
+    b->side = sd; b->line_q = atoi(row[4]); b->line_b_q = atoi(row[5]);
+    b->bm = atol(row[6]); b->price = atol(row[7]); b->id = atoll(row[8]);
+    unsigned fl = mkt_rules[m].flags;
+    b->mline = (fl & MKT_F_SCORE) ? 0 : (fl & MKT_F_HANDICAP) && sd == SIDE_AWAY ? -b->line_q : b->line_q;
+    src_next(s);
+  }
+  for (int i=0;i<n && !rc;i++) {
+    if (mysql_errno(src[i].c)) { fprintf(stderr, "SQL error: %s\n", mysql_error(src[i].c)); rc = 5; }
+  }
+  if (!rc && (oom || flush_group(&g, o, rf) != 0)) { fprintf(stderr, "quote board: out of memory\n"); rc = 5; }
+  for (int i=0;i<n;i++) mysql_free_result(src[i].r);
+  free(src);
+  free(g.q); free(g.s);
+  if (!rf_end(rf) && !rc) rc = 1;
+  return rc;
+}
@@ -1,9 +1,26 @@
 #include "db.h"
+#include "gigam.h"
+#include "market.h"
+#include "reportfmt.h"
+#include "rptagg.h"
+#include "snapshot.h"
+#include "report.h"
+#include "rcache.h"
+#include "journal.h"
+#include "settlefeed.h"
+#include "ledger.h"
+#include "board.h"
+#include "mtm.h"
+#include "velocity.h"
+#include "shard.h"
+#include "fixtures.h"
+#include "replay.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <stdarg.h>
 
 /* ---------- Helpers / UX ---------- */
 
@@ -18,170 +35,358 @@ static void usage_root(void) {
     "  runner    create|list|set-default|payout\n"
     "            create flags: --bookmaker-id --user --name [--default] [--scheme net|handle] [--rate <0..100>]\n"
     "  bettor    create|list|payout\n"
-    "  event     create|list|set-score|finalize\n"
-    "  quote     add|list\n"
-    "  bet       place|list\n"
-    "  settle    event\n"
+    "  event     create|list|set-score|finalize|void\n"
+    "            import --file <csv|-> [--batch 1000]  (rows league,kickoff,home,away; teams created by name)\n"
+    "  quote     add|list|board\n"
+    "            board [--league-id N] [--starts-within 24h] [--arb-only]  (best price and overround across bookmakers)\n"
+    "  bet       place|parlay|list\n"
+    "            parlay flags: --bookmaker-id --runner-id --bettor-id --stake --leg EVENT:MARKET:SIDE[:LINE|:H-A]@PRICE (2-16x) [--bet-key]\n"
+    "            list flags: --bookmaker-id [--event-id] [--runner-id] [--bettor-id] [--status] [--from --to]\n"
+    "  <x> list  [--limit N (default 0 = all; bet list 200)] [--after <cursor>] [--format table|json|csv] [--out <file>]\n"
+    "            (a full page prints the next cursor on stderr)\n"
+    "  settle    event --event-id N [--chunk-rows 1000]  (keyset chunks, one transaction each)\n"
+    "            correct --event-id N --home H --away A  (re-settle a final event under a corrected score)\n"
+    "            follow --feed <file|fifo|-> [--workers 4] [--queue 64] [--batch 200] [--batch-ms 200] [--chunk-rows 1000]\n"
     "  report    pnl|runner-commissions|bettor-balances|runner-balances [--format table|json|csv] [--out <file>]\n"
-    "  risk      list\n"
+    "            clv --bookmaker-id N [--by bettor|runner]  (bet price vs the closing quote)\n"
+    "            <kind>,<kind>... --bookmaker-id N,N...|all [--parallel N] [--out-dir <dir>]\n"
+    "            [--chunk day|week]  (long ranges: parallel partial sums per chunk)\n"
+    "            all --out-dir <dir>  (every report from one scan)\n"
+    "            [--snapshot <file> [--threads N]]  (offline, no DB)\n"
+    "  snapshot  --out <file> [--bookmaker-id] [--from --to]\n"
+    "  cache     stats|clear  (report result cache; report --no-cache bypasses it)\n"
+    "  journal   status|replay --dir <dir>  (gigamd --journal bet journal)\n"
+    "  risk      list --event-id N [--chunk-rows 1000] | parlays [--bookmaker-id N]\n"
+    "            mtm --event-id N|--all [--bookmaker-id N] [--by event|runner|bettor]  (open bets at current prices)\n"
+    "            velocity --bookmaker-id N [--window 5m] [--since 24h] [--max-bets 20] [--max-stake-cents N]\n"
+    "                     [--runner-max-bets N] [--runner-max-stake-cents N] [--follow-secs 10] [--follow-min 3]\n"
+    "  ledger    balance --bettor-id N | --runner-id N\n"
+    "            period --bookmaker-id N --from YYYY-MM-DD --to YYYY-MM-DD [--runners]  (entries posted in the range)\n"
+    "            verify [--parallel N]  (recompute balances from bets, commissions and payouts)\n"
+    "  replay    <capture> [--speed 1x|Nx|max] [--concurrency 8]  (GIGAM_CAPTURE=<file> records commands)\n"
   );
 }
 
-static int exec_and_print(MYSQL* c, const char* sql) {
-  if (db_exec(c, sql) != 0) {
-    return -1;
+/* release a libgigam context, reporting its error if the call failed */
+static int gigam_done(gigam_ctx_t* g, int rc) {
+  if (rc) fprintf(stderr, "%s\n", gigam_errmsg(g));
+  gigam_close(g);
+  return rc;
+}
+
+/* ---------- Shards (shard.h) ---------- */
+
+static shard_map_t g_shards;   /* loaded by cli_dispatch */
+static int g_cur;              /* shard of the command's connection */
+static MYSQL* g_extra;         /* opened by shard_switch, closed by cli_dispatch */
+
+/* the shard a command runs on: its bookmaker's, the first for the
+ * reference tables, else the home shard; -1 if the bookmaker has none */
+static int route_shard(int argc, char** argv) {
+  const char* cmd = argv[1];
+  if (!strcmp(cmd,"sport") || !strcmp(cmd,"league") || !strcmp(cmd,"team") || !strcmp(cmd,"event")) return 0;
+  for (int i=2;i<argc;i++) {
+    const char* v = NULL;
+    if (!strcmp(argv[i],"--bookmaker-id") && i+1<argc) v = argv[i+1];
+    else if (!strncmp(argv[i],"--bookmaker-id=",15)) v = argv[i]+15;
+    if (!v) continue;
+    char* end; long bm = strtol(v,&end,10);
+    if (end==v || *end || bm<=0) break;   /* a list or "all": the command fans out */
+    int s = shard_of(&g_shards,bm);
+    if (s<0) fprintf(stderr,"bookmaker %ld is on no shard\n", bm);
+    return s;
   }
-  MYSQL_RES* r = mysql_store_result(c);
-  if (r) {
-    db_print_result(r);
-    mysql_free_result(r);
+  return g_shards.home;
+}
+
+/* listings, reports and the other scans that write nothing: the read
+ * replica takes them when it is fit (db_connect_replica). There is one
+ * replica for one primary, so with a shard map these reads stay on the
+ * shards and DB_REPLICA_* is ignored (cli_run says so on stderr). */
+static bool read_only(int argc, char** argv) {
+  const char* cmd = argv[1];
+  const char* sub = argc>2 ? argv[2] : "";
+  if (!strcmp(cmd,"report") || !strcmp(cmd,"snapshot")) return true;
+  if (!strcmp(cmd,"quote") && !strcmp(sub,"board")) return true;
+  if (!strcmp(cmd,"risk")) return !strcmp(sub,"mtm") || !strcmp(sub,"velocity");
+  return !strcmp(sub,"list");
+}
+
+/* move the command to another shard (db_load_env follows) */
+static MYSQL* shard_switch(MYSQL* c, int shard) {
+  if (shard==g_cur) return c;
+  MYSQL* nc = db_connect(&g_shards.s[shard].cfg);
+  if (!nc) { fprintf(stderr,"shard %s: DB connect failed\n", g_shards.s[shard].name); return NULL; }
+  db_route(&g_shards.s[shard].cfg);
+  db_disconnect(g_extra);
+  g_extra = nc; g_cur = shard;
+  return nc;
+}
+
+/* a connection per shard, c for the one it is on */
+static void shards_close(MYSQL* c, MYSQL** conns) {
+  for (int i=0;i<g_shards.n;i++) if (conns[i]!=c) db_disconnect(conns[i]);
+}
+
+static int shards_open(MYSQL* c, MYSQL** conns) {
+  memset(conns, 0, (size_t)g_shards.n*sizeof(MYSQL*));
+  for (int i=0;i<g_shards.n;i++) {
+    conns[i] = i==g_cur ? c : db_connect(&g_shards.s[i].cfg);
+    if (!conns[i]) {
+      fprintf(stderr,"shard %s: DB connect failed\n", g_shards.s[i].name);
+      shards_close(c,conns);
+      return 5;
+    }
   }
   return 0;
 }
 
-static void esc_str(MYSQL* c, const char* in, char* out, size_t outsz) {
-  if (!in) { out[0]='\0'; return; }
-  size_t n = strlen(in);
-  char* tmp = (char*)malloc(n*2+1);
-  if(!tmp){ out[0]='\0'; return; }
-  unsigned long m = mysql_real_escape_string(c, tmp, in, n);
-  if ((size_t)m >= outsz) m = (unsigned long)(outsz - 1);
-  memcpy(out, tmp, (size_t)m);
-  out[m]='\0';
-  free(tmp);
+/* Run fn(conn, shard, ud) on every shard at once, or on c when there is one
+ * database; fn leaves its exit code in rcs[shard] (zeroed by the caller).
+ * Returns the first nonzero one, 5 if a shard could not be reached. */
+static int each_shard(MYSQL* c, db_task_fn fn, void* ud, const int* rcs) {
+  if (g_shards.n==1) { fn(c,0,ud); return rcs[0]; }
+  db_config_t cfgs[SHARD_MAX]; int ix[SHARD_MAX];
+  for (int i=0;i<g_shards.n;i++) { cfgs[i] = g_shards.s[i].cfg; ix[i] = i; }
+  int failed = db_parallel_sharded(cfgs, g_shards.n, ix, (size_t)g_shards.n, 1, fn, ud);
+  if (failed<0) { fprintf(stderr,"DB connect failed\n"); return 5; }
+  for (int i=0;i<g_shards.n;i++) if (rcs[i]) return rcs[i];
+  return failed ? 5 : 0;
 }
 
-/* ---------- Report formatting helpers (table|json|csv) ---------- */
-
-typedef enum {
-  RF_TABLE = 0,
-  RF_JSON  = 1,
-  RF_CSV   = 2
-} rf_format_t;
-
-static rf_format_t rf_format_from_str(const char* s) {
-  if (!s) return RF_TABLE;
-  char buf[16]; size_t n=0;
-  for (; s[n] && n<sizeof(buf)-1; ++n) {
-    char ch = s[n];
-    if (ch >= 'A' && ch <= 'Z') ch = (char)(ch - 'A' + 'a');
-    buf[n] = ch;
-  }
-  buf[n]=0;
-  if (strcmp(buf,"json")==0) return RF_JSON;
-  if (strcmp(buf,"csv")==0)  return RF_CSV;
-  return RF_TABLE;
+/* Sports, leagues, teams and events are the same on every shard: written
+ * on the first (where cli_dispatch connects for them), then replayed on
+ * the others. */
+static int ref_replay(const char* q) {
+  int rc = 0;
+  for (int i=0;i<g_shards.n;i++) {
+    if (i==g_cur) continue;
+    MYSQL* o = db_connect(&g_shards.s[i].cfg);
+    if (!o || db_exec(o,q)!=0) { fprintf(stderr,"shard %s: not updated\n", g_shards.s[i].name); rc = 5; }
+    db_disconnect(o);
+  }
+  return rc;
 }
 
-static void json_escape(FILE* f, const char* s) {
-  if (!s) s="";
-  fputc('"', f);
-  for (const unsigned char* p=(const unsigned char*)s; *p; ++p) {
-    unsigned char ch=*p;
-    switch(ch){
-      case '\\': fputs("\\\\",f); break;
-      case '\"': fputs("\\\"",f); break;
-      case '\b': fputs("\\b", f); break;
-      case '\f': fputs("\\f", f); break;
-      case '\n': fputs("\\n", f); break;
-      case '\r': fputs("\\r", f); break;
-      case '\t': fputs("\\t", f); break;
-      default:
-        if (ch < 0x20) fprintf(f,"\\u%04x", ch);
-        else fputc(ch,f);
-    }
-  }
-  fputc('"', f);
+/* A reference row (id 0: a new one, else that row, created or rewritten);
+ * the other shards get it under the id it got here. The replay is an
+ * upsert by id, so running the command again with --id <id> fixes the
+ * shards a failed replay missed, without a second row anywhere. */
+static int ref_insert(MYSQL* c, const char* table, const char* cols, const char* vals, const char* upd, unsigned long long id) {
+  bool sharded = g_shards.n>1;
+  char q[1024], ids[32] = "";
+  if (id) snprintf(ids,sizeof(ids),"%llu,", id);
+  snprintf(q,sizeof(q),"INSERT INTO %s(%s%s) VALUES(%s%s) ON DUPLICATE KEY UPDATE %s%s", table, id ? "id," : "", cols, ids, vals,
+           sharded ? "id=LAST_INSERT_ID(id)," : "", upd);
+  if (db_exec(c,q)!=0) return 5;
+  if (!sharded) return 0;
+  unsigned long long got = (unsigned long long)mysql_insert_id(c);
+  if (!got) got = id;
+  snprintf(q,sizeof(q),"INSERT INTO %s(id,%s) VALUES(%llu,%s) ON DUPLICATE KEY UPDATE %s", table, cols, got, vals, upd);
+  if (ref_replay(q)==0) return 0;
+  fprintf(stderr,"%s %llu: rerun with --id %llu to update the shards not updated\n", table, got, got);
+  return 5;
 }
 
-static void csv_escape(FILE* f, const char* s) {
-  if (!s) s="";
-  bool need_quotes=false;
-  for (const char* p=s; *p; ++p) {
-    if (*p==',' || *p=='"' || *p=='\n' || *p=='\r') { need_quotes=true; break; }
+/* --id of the create commands: the row to write (see ref_insert) */
+static bool ref_id_arg(const char* s, unsigned long long* id) {
+  char* end; long long v = strtoll(s,&end,10);
+  if (end==s || *end || v<=0) { fprintf(stderr,"--id must be a positive id\n"); return false; }
+  *id = (unsigned long long)v;
+  return true;
+}
+
+/* payout row (ins) and its ledger posting, in one transaction */
+static int record_payout(MYSQL* c, const char* ins, ledger_kind_t kind, long owner, long amount) {
+  char q[256];
+  if (kind==LEDGER_RUNNER) snprintf(q,sizeof(q),"SELECT bookmaker_id FROM runners WHERE id=%ld", owner);
+  else snprintf(q,sizeof(q),"SELECT r.bookmaker_id FROM bettors bt JOIN runners r ON r.id=bt.runner_id WHERE bt.id=%ld", owner);
+  if (db_exec(c,"START TRANSACTION")!=0) return 5;
+  long bm=0;
+  if (db_exec(c,q)!=0) goto rollback;
+  MYSQL_RES* r = mysql_store_result(c);
+  MYSQL_ROW row = r ? mysql_fetch_row(r) : NULL;
+  if (row) bm = atol(row[0]);
+  if (r) mysql_free_result(r);
+  if (!bm) {
+    fprintf(stderr,"%s %ld not found\n", kind==LEDGER_RUNNER ? "runner" : "bettor", owner);
+    if (mysql_query(c,"ROLLBACK")!=0) { /* nothing written */ }
+    return 2;
   }
-  if (!need_quotes && s[0] != ' ') { fputs(s, f); return; }
-  fputc('"', f);
-  for (const char* p=s; *p; ++p) {
-    if (*p=='"') fputc('"', f);
-    fputc(*p, f);
+  if (db_exec(c,ins)!=0) goto rollback;
+  if (ledger_post(c,LEDGER_PAYOUT,(long long)mysql_insert_id(c),0,bm,kind,owner,-(long long)amount)!=0) {
+    fprintf(stderr,"SQL error: %s\n", mysql_error(c));
+    goto rollback;
   }
-  fputc('"', f);
+  if (db_exec(c,"COMMIT")!=0) goto rollback;
+  return 0;
+rollback:
+  if (mysql_query(c,"ROLLBACK")!=0) { /* keep the first error */ }
+  return 5;
 }
 
-static int print_result_json(MYSQL_RES* r, FILE* out) {
-  unsigned int nf = mysql_num_fields(r);
-  MYSQL_FIELD* flds = mysql_fetch_fields(r);
-  fputs("[\n", out);
-  bool first=true;
-  MYSQL_ROW row;
-  while ((row=mysql_fetch_row(r))) {
-    unsigned long* lengths = mysql_fetch_lengths(r);
-    (void)lengths; /* values are C-strings; lengths unused for now */
-    if (!first) fputs(",\n", out);
-    first=false;
-    fputs("  {", out);
-    for (unsigned int i=0;i<nf;i++) {
-      if (i) fputs(", ", out);
-      json_escape(out, flds[i].name ? flds[i].name : "");
-      fputs(": ", out);
-      json_escape(out, row[i] ? row[i] : "");
-    }
-    fputs("}", out);
-  }
-  fputs("\n]\n", out);
+/* "2-1" -> line=2, line_b=1 (correct_score picks), in quarter goals */
+static int parse_score(const char* s, int* home_q, int* away_q) {
+  int h, a; char tail;
+  if (sscanf(s, "%d-%d%c", &h, &a, &tail) != 2 || h < 0 || a < 0 || h > 999 || a > 999) return -1;
+  *home_q = 4*h; *away_q = 4*a;
   return 0;
 }
 
-static int print_result_csv(MYSQL_RES* r, FILE* out) {
-  unsigned int nf = mysql_num_fields(r);
-  MYSQL_FIELD* flds = mysql_fetch_fields(r);
-  /* header */
-  for (unsigned int i=0;i<nf;i++) {
-    if (i) fputc(',', out);
-    csv_escape(out, flds[i].name ? flds[i].name : "");
+/* --price / --line values: exact decimal text, never through a double */
+static int opt_price(const char* flag, const char* s, long* e4) {
+  if (mkt_parse_price(s, e4) == 0) return 0;
+  fprintf(stderr, "invalid %s '%s': decimal odds with up to 4 decimals\n", flag, s);
+  return -1;
+}
+
+static int opt_line(const char* flag, const char* s, int* q) {
+  if (mkt_parse_line(s, q) == 0) return 0;
+  fprintf(stderr, "invalid %s '%s': a multiple of 0.25\n", flag, s);
+  return -1;
+}
+
+/* "12:total:OVER:2.5@1.9", "15:correct_score:SCORE:2-1@9.0"; buf keeps
+ * the market/side strings the leg points into */
+static int parse_leg(const char* s, gigam_leg_t* l, char* buf, size_t n) {
+  snprintf(buf, n, "%s", s);
+  char* at = strrchr(buf, '@');
+  if (!at) return -1;
+  *at = 0;
+  if (mkt_parse_price(at+1, &l->price_e4)) return -1;
+  char* ev = buf;
+  char* mk = strchr(ev, ':'); if (!mk) return -1; *mk++ = 0;
+  char* sd = strchr(mk, ':'); if (!sd) return -1; *sd++ = 0;
+  char* ln = strchr(sd, ':'); if (ln) *ln++ = 0;
+  l->event_id = atol(ev); l->market = mk; l->side = sd;
+  l->line_q = 0; l->line_b_q = 0; l->asian = 0; l->price_b_e4 = 0;
+  if (ln) {
+    if (!strcmp(mk, "correct_score")) { if (parse_score(ln, &l->line_q, &l->line_b_q)) return -1; }
+    else if (mkt_parse_line(ln, &l->line_q)) return -1;
   }
-  fputc('\n', out);
-  /* rows */
-  MYSQL_ROW row;
-  while ((row=mysql_fetch_row(r))) {
-    for (unsigned int i=0;i<nf;i++) {
-      if (i) fputc(',', out);
-      csv_escape(out, row[i] ? row[i] : "");
-    }
-    fputc('\n', out);
+  return l->event_id > 0 && l->price_e4 > MKT_PRICE_ONE ? 0 : -1;
+}
+
+/* ---------- LIST: filters, keyset pages, table/json/csv ---------- */
+
+/* Flags shared by every list subcommand. A full page prints
+ * "next: --after <cursor>" on stderr; the cursor is the sort key of its
+ * last row, so the next page is an index seek past it (schema/008), never
+ * an OFFSET scan over the pages before. */
+typedef struct {
+  long limit;            /* rows per page, 0 = all (streamed) */
+  const char* after;     /* cursor printed by the previous page */
+  rf_format_t fmt;
+  const char* out;
+} list_opts_t;
+
+/* lists print every row unless --limit asks for pages; bet list kept the
+ * 200 newest it always showed */
+#define LIST_DEFAULT_LIMIT 0
+#define BET_LIST_DEFAULT_LIMIT 200
+#define LIST_LONGOPTS {"limit",1,0,'n'},{"after",1,0,'A'},{"format",1,0,'F'},{"out",1,0,'O'}
+#define LIST_SHORTOPTS "n:A:F:O:"
+
+static int list_opt(list_opts_t* lo, int ch, const char* arg) {
+  if(ch=='n') lo->limit=atol(arg);
+  else if(ch=='A') lo->after=arg;
+  else if(ch=='F') lo->fmt=rf_format_from_str(arg);
+  else if(ch=='O') lo->out=arg;
+  else return 0;
+  return 1;
+}
+
+/* --after: "<id>" or "<key>.<id>" (digits); *key stays 0 for the first */
+static int list_cursor(const char* s, long long* key, long* id) {
+  const char* p=s; int dots=0;
+  if (!*p) return -1;
+  for (; *p; p++) {
+    if (*p=='.') { if (++dots>1 || p==s || !p[1]) return -1; }
+    else if (*p<'0' || *p>'9') return -1;
+  }
+  *key=0;
+  if (dots) return sscanf(s,"%lld.%ld",key,id)==2 ? 0 : -1;
+  return sscanf(s,"%ld",id)==1 ? 0 : -1;
+}
+
+/* append "WHERE cond" / " AND cond" to w */
+static void where_and(char* w, size_t n, const char* fmt, ...) {
+  size_t len=strlen(w);
+  if (len+6>=n) return;
+  len += (size_t)snprintf(w+len, n-len, len ? " AND " : " WHERE ");
+  va_list ap; va_start(ap,fmt);
+  vsnprintf(w+len, n-len, fmt, ap);
+  va_end(ap);
+}
+
+/* --from/--to YYYY-MM-DD on col (whole days); 0, or 2 after printing why */
+static int where_days(char* w, size_t n, const char* col, const char* from, const char* to) {
+  int d;
+  if ((from && rpt_parse_day(from,&d)!=0) || (to && rpt_parse_day(to,&d)!=0)) {
+    fprintf(stderr,"--from/--to must be YYYY-MM-DD\n");
+    return 2;
   }
+  if (from) where_and(w,n,"%s>=STR_TO_DATE('%s','%%Y-%%m-%%d')", col, from);
+  if (to) where_and(w,n,"%s<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY)", col, to);
   return 0;
 }
 
-static int print_result_table(MYSQL_RES* r) {
-  /* mantener comportamiento existente */
-  db_print_result(r);
+/* keyset condition on an id-ordered list; 0, or 2 on a malformed cursor */
+static int where_after_id(char* w, size_t n, const list_opts_t* lo, const char* col, bool desc) {
+  long long key; long id;
+  if (!lo->after) return 0;
+  if (list_cursor(lo->after,&key,&id)!=0 || key) { fprintf(stderr,"invalid --after cursor\n"); return 2; }
+  where_and(w,n,"%s%c%ld", col, desc ? '<' : '>', id);
   return 0;
 }
 
-static int print_formatted(MYSQL_RES* r, rf_format_t fmt, const char* out_path) {
-  if (!r) return 0;
-  if (fmt == RF_TABLE) {
-    /* table siempre va a stdout, ignoramos out_path */
-    return print_result_table(r);
+/* Run q (a SELECT whose last column is the row's cursor, ORDER BY the
+ * cursor's key) for one page and stream it out through reportfmt; the
+ * cursor column is not printed. */
+static int list_run(MYSQL* c, const list_opts_t* lo, char* q, size_t n) {
+  if (lo->limit<0) { fprintf(stderr,"--limit must be >= 0\n"); return 2; }
+  size_t len=strlen(q);
+  if (lo->limit>0) snprintf(q+len, n-len, " LIMIT %ld", lo->limit+1);
+  if (db_exec(c,q)!=0) return 5;
+  MYSQL_RES* r = mysql_use_result(c);
+  if (!r) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); return 5; }
+  unsigned int nf = mysql_num_fields(r);
+  MYSQL_FIELD* flds = mysql_fetch_fields(r);
+  const char* hdr[32]; unsigned int nh = nf>1 ? nf-1 : 0;
+  if (nh>32) nh=32;
+  for (unsigned int i=0;i<nh;i++) hdr[i] = flds[i].name;
+  rf_ctx_t* rf = rf_begin(lo->fmt, stdout, lo->out, hdr, nh);
+  if (!rf) {
+    mysql_free_result(r);
+    fprintf(stderr,"list: unable to open output file: %s\n", lo->out ? lo->out : "");
+    return 1;
   }
-  FILE* out = stdout;
-  FILE* opened = NULL;
-  if (out_path && *out_path) {
-    opened = fopen(out_path, "wb");
-    if (!opened) {
-      fprintf(stderr, "report: unable to open output file: %s\n", out_path);
-      return 1;
-    }
-    out = opened;
+  long rows=0; bool more=false; char cursor[64]="";
+  MYSQL_ROW row;
+  while ((row=mysql_fetch_row(r))) {
+    if (lo->limit>0 && rows==lo->limit) { more=true; continue; }
+    rf_row(rf,(const char* const*)row);
+    snprintf(cursor,sizeof(cursor),"%s", row[nf-1] ? row[nf-1] : "");
+    rows++;
   }
-  int rc = 0;
-  if (fmt == RF_JSON) rc = print_result_json(r, out);
-  else                rc = print_result_csv(r, out);
+  bool err = mysql_errno(c)!=0;
+  if (err) fprintf(stderr,"SQL error: %s\n", mysql_error(c));
+  mysql_free_result(r);
+  bool ok = rf_end(rf);
+  if (err) return 5;
+  if (more) fprintf(stderr,"next: --after %s\n", cursor);
+  return ok ? 0 : 1;
+}
 
-  if (opened) fclose(opened);
-  return rc;
+/* the common case: an id-ordered list with optional filters already in w */
+static int list_by_id(MYSQL* c, const list_opts_t* lo, const char* cols, const char* from_sql,
+                      char* w, size_t wn, const char* id_col, bool desc) {
+  int rc = where_after_id(w,wn,lo,id_col,desc);
+  if (rc) return rc;
+  char q[2048];
+  snprintf(q,sizeof(q),"SELECT %s,%s AS _cursor FROM %s%s ORDER BY %s%s",
+           cols, id_col, from_sql, w, id_col, desc ? " DESC" : "");
+  return list_run(c,lo,q,sizeof(q));
 }
 
 /* ---------- SPORT ---------- */
@@ -191,25 +396,34 @@ static int cmd_sport(int argc, char** argv, MYSQL* c) {
   const char* sub = argv[1]; optind=1;
 
   if (!strcmp(sub,"create")) {
-    const char* name=NULL; static struct option o[]={{"name",1,0,'n'},{0,0,0,0}};
+    const char* name=NULL; unsigned long long id=0;
+    static struct option o[]={{"name",1,0,'n'},{"id",1,0,'i'},{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"n:",o,&ix))!=-1){
-      if(ch=='n') name=optarg; else return 2;
+    while((ch=getopt_long(argc-1,argv+1,"n:i:",o,&ix))!=-1){
+      if(ch=='n') name=optarg;
+      else if(ch=='i') { if (!ref_id_arg(optarg,&id)) return 2; }
+      else return 2;
     }
     if(!name){
       fprintf(stderr,"required: --name\n");
       return 2;
     }
-    char ne[256]; esc_str(c,name,ne,sizeof(ne));
-    char q[512];
-    snprintf(q,sizeof(q),"INSERT INTO sports(name) VALUES('%s') ON DUPLICATE KEY UPDATE name=VALUES(name)", ne);
-    if (db_exec(c,q)!=0) { return 5; }
+    char ne[256]; db_escape(c,name,ne,sizeof(ne));
+    char v[512]; snprintf(v,sizeof(v),"'%s'", ne);
+    if (ref_insert(c,"sports","name",v,"name=VALUES(name)",id)!=0) { return 5; }
     printf("OK\n");
     return 0;
   }
 
   if (!strcmp(sub,"list")) {
-    return exec_and_print(c,"SELECT id,name FROM sports ORDER BY id");
+    list_opts_t lo={LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={LIST_LONGOPTS,{0,0,0,0}};
+    int ch,ix=0;
+    while((ch=getopt_long(argc-1,argv+1,LIST_SHORTOPTS,o,&ix))!=-1){
+      if(!list_opt(&lo,ch,optarg)) return 2;
+    }
+    char w[256]="";
+    return list_by_id(c,&lo,"id,name","sports",w,sizeof(w),"id",false);
   }
 
   fprintf(stderr,"unknown sport subcommand\n");
@@ -223,39 +437,37 @@ static int cmd_league(int argc, char** argv, MYSQL* c) {
   const char* sub = argv[1]; optind=1;
 
   if (!strcmp(sub,"create")) {
-    long sport_id=0; const char* name=NULL;
-    static struct option o[]={{"sport-id",1,0,'s'},{"name",1,0,'n'},{0,0,0,0}};
+    long sport_id=0; const char* name=NULL; unsigned long long id=0;
+    static struct option o[]={{"sport-id",1,0,'s'},{"name",1,0,'n'},{"id",1,0,'i'},{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"s:n:",o,&ix))!=-1){
+    while((ch=getopt_long(argc-1,argv+1,"s:n:i:",o,&ix))!=-1){
       if(ch=='s') sport_id=atol(optarg);
       else if(ch=='n') name=optarg;
+      else if(ch=='i') { if (!ref_id_arg(optarg,&id)) return 2; }
       else return 2;
     }
     if(!sport_id||!name){
       fprintf(stderr,"required: --sport-id --name\n");
       return 2;
     }
-    char ne[256]; esc_str(c,name,ne,sizeof(ne));
-    char q[1024];
-    snprintf(q,sizeof(q),"INSERT INTO leagues(sport_id,name) VALUES(%ld,'%s') ON DUPLICATE KEY UPDATE name=VALUES(name)", sport_id, ne);
-    if (db_exec(c,q)!=0) { return 5; }
+    char ne[256]; db_escape(c,name,ne,sizeof(ne));
+    char v[512]; snprintf(v,sizeof(v),"%ld,'%s'", sport_id, ne);
+    if (ref_insert(c,"leagues","sport_id,name",v,"name=VALUES(name)",id)!=0) { return 5; }
     printf("OK\n");
     return 0;
   }
 
   if (!strcmp(sub,"list")) {
-    long sport_id=0; static struct option o[]={{"sport-id",1,0,'s'},{0,0,0,0}};
+    long sport_id=0; list_opts_t lo={LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={{"sport-id",1,0,'s'},LIST_LONGOPTS,{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"s:",o,&ix))!=-1){
-      if(ch=='s') sport_id=atol(optarg); else return 2;
-    }
-    if (sport_id>0) {
-      char q[512];
-      snprintf(q,sizeof(q),"SELECT id,name,sport_id FROM leagues WHERE sport_id=%ld ORDER BY id", sport_id);
-      return exec_and_print(c,q);
-    } else {
-      return exec_and_print(c,"SELECT id,name,sport_id FROM leagues ORDER BY id");
+    while((ch=getopt_long(argc-1,argv+1,"s:" LIST_SHORTOPTS,o,&ix))!=-1){
+      if(ch=='s') sport_id=atol(optarg);
+      else if(!list_opt(&lo,ch,optarg)) return 2;
     }
+    char w[256]="";
+    if (sport_id>0) where_and(w,sizeof(w),"sport_id=%ld",sport_id);
+    return list_by_id(c,&lo,"id,name,sport_id","leagues",w,sizeof(w),"id",false);
   }
 
   fprintf(stderr,"unknown league subcommand\n");
@@ -269,39 +481,37 @@ static int cmd_team(int argc, char** argv, MYSQL* c) {
   const char* sub=argv[1]; optind=1;
 
   if (!strcmp(sub,"create")) {
-    long league_id=0; const char* name=NULL;
-    static struct option o[]={{"league-id",1,0,'l'},{"name",1,0,'n'},{0,0,0,0}};
+    long league_id=0; const char* name=NULL; unsigned long long id=0;
+    static struct option o[]={{"league-id",1,0,'l'},{"name",1,0,'n'},{"id",1,0,'i'},{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"l:n:",o,&ix))!=-1){
+    while((ch=getopt_long(argc-1,argv+1,"l:n:i:",o,&ix))!=-1){
       if(ch=='l') league_id=atol(optarg);
       else if(ch=='n') name=optarg;
+      else if(ch=='i') { if (!ref_id_arg(optarg,&id)) return 2; }
       else return 2;
     }
     if(!league_id||!name){
       fprintf(stderr,"required: --league-id --name\n");
       return 2;
     }
-    char ne[256]; esc_str(c,name,ne,sizeof(ne));
-    char q[1024];
-    snprintf(q,sizeof(q),"INSERT INTO teams(league_id,name) VALUES(%ld,'%s') ON DUPLICATE KEY UPDATE name=VALUES(name)", league_id, ne);
-    if (db_exec(c,q)!=0) { return 5; }
+    char ne[256]; db_escape(c,name,ne,sizeof(ne));
+    char v[512]; snprintf(v,sizeof(v),"%ld,'%s'", league_id, ne);
+    if (ref_insert(c,"teams","league_id,name",v,"name=VALUES(name)",id)!=0) { return 5; }
     printf("OK\n");
     return 0;
   }
 
   if (!strcmp(sub,"list")) {
-    long league_id=0; static struct option o[]={{"league-id",1,0,'l'},{0,0,0,0}};
+    long league_id=0; list_opts_t lo={LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={{"league-id",1,0,'l'},LIST_LONGOPTS,{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"l:",o,&ix))!=-1){
-      if(ch=='l') league_id=atol(optarg); else return 2;
-    }
-    if (league_id>0) {
-      char q[512];
-      snprintf(q,sizeof(q),"SELECT id,name,league_id FROM teams WHERE league_id=%ld ORDER BY id", league_id);
-      return exec_and_print(c,q);
-    } else {
-      return exec_and_print(c,"SELECT id,name,league_id FROM teams ORDER BY id");
+    while((ch=getopt_long(argc-1,argv+1,"l:" LIST_SHORTOPTS,o,&ix))!=-1){
+      if(ch=='l') league_id=atol(optarg);
+      else if(!list_opt(&lo,ch,optarg)) return 2;
     }
+    char w[256]="";
+    if (league_id>0) where_and(w,sizeof(w),"league_id=%ld",league_id);
+    return list_by_id(c,&lo,"id,name,league_id","teams",w,sizeof(w),"id",false);
   }
 
   fprintf(stderr,"unknown team subcommand\n");
@@ -327,7 +537,7 @@ static int cmd_bookmaker(int argc, char** argv, MYSQL* c) {
       fprintf(stderr,"required: --name\n");
       return 2;
     }
-    char ne[256], ce[16]; esc_str(c,name,ne,sizeof(ne)); esc_str(c,currency,ce,sizeof(ce));
+    char ne[256], ce[16]; db_escape(c,name,ne,sizeof(ne)); db_escape(c,currency,ce,sizeof(ce));
     char q[1024];
     snprintf(q,sizeof(q),"INSERT INTO bookmakers(name,currency) VALUES('%s','%s') ON DUPLICATE KEY UPDATE currency=VALUES(currency)", ne, ce);
     if (db_exec(c,q)!=0) { return 5; }
@@ -336,7 +546,14 @@ static int cmd_bookmaker(int argc, char** argv, MYSQL* c) {
   }
 
   if (!strcmp(sub,"list")) {
-    return exec_and_print(c,"SELECT id,name,currency,created_at FROM bookmakers ORDER BY id");
+    list_opts_t lo={LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={LIST_LONGOPTS,{0,0,0,0}};
+    int ch,ix=0;
+    while((ch=getopt_long(argc-1,argv+1,LIST_SHORTOPTS,o,&ix))!=-1){
+      if(!list_opt(&lo,ch,optarg)) return 2;
+    }
+    char w[256]="";
+    return list_by_id(c,&lo,"id,name,currency,created_at","bookmakers",w,sizeof(w),"id",false);
   }
 
   fprintf(stderr,"unknown bookmaker subcommand\n");
@@ -386,7 +603,7 @@ static int cmd_runner(int argc, char** argv, MYSQL* c) {
       return 2;
     }
 
-    char ue[256], ne[256]; esc_str(c,user,ue,sizeof(ue)); esc_str(c,name,ne,sizeof(ne));
+    char ue[256], ne[256]; db_escape(c,user,ue,sizeof(ue)); db_escape(c,name,ne,sizeof(ne));
     char q1[1024];
     snprintf(q1,sizeof(q1),
       "INSERT INTO users(username,display_name) VALUES('%s','%s') "
@@ -406,18 +623,21 @@ static int cmd_runner(int argc, char** argv, MYSQL* c) {
   }
 
   if (!strcmp(sub,"list")) {
-    long bm=0; static struct option o[]={{"bookmaker-id",1,0,'b'},{0,0,0,0}};
+    long bm=0; list_opts_t lo={LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={{"bookmaker-id",1,0,'b'},LIST_LONGOPTS,{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"b:",o,&ix))!=-1){
-      if(ch=='b') bm=atol(optarg); else return 2;
+    while((ch=getopt_long(argc-1,argv+1,"b:" LIST_SHORTOPTS,o,&ix))!=-1){
+      if(ch=='b') bm=atol(optarg);
+      else if(!list_opt(&lo,ch,optarg)) return 2;
     }
     if(!bm){
       fprintf(stderr,"required: --bookmaker-id\n");
       return 2;
     }
-    char q[1024];
-    snprintf(q,sizeof(q),"SELECT r.id,r.name,r.is_default,u.username, r.commission_scheme, r.commission_rate FROM runners r JOIN users u ON u.id=r.user_id WHERE r.bookmaker_id=%ld ORDER BY r.id", bm);
-    return exec_and_print(c,q);
+    char w[256]="";
+    where_and(w,sizeof(w),"r.bookmaker_id=%ld",bm);
+    return list_by_id(c,&lo,"r.id,r.name,r.is_default,u.username, r.commission_scheme, r.commission_rate",
+                      "runners r JOIN users u ON u.id=r.user_id",w,sizeof(w),"r.id",false);
   }
 
   if (!strcmp(sub,"set-default")) {
@@ -460,10 +680,10 @@ static int cmd_runner(int argc, char** argv, MYSQL* c) {
       fprintf(stderr,"required: --runner-id --amount-cents [--note] [--from --to]\n");
       return 2;
     }
-    char ne[256]; esc_str(c,note,ne,sizeof(ne));
+    char ne[256]; db_escape(c,note,ne,sizeof(ne));
     char q[1024];
     if(from&&to){
-      char fe[32],te[32]; esc_str(c,from,fe,sizeof(fe)); esc_str(c,to,te,sizeof(te));
+      char fe[32],te[32]; db_escape(c,from,fe,sizeof(fe)); db_escape(c,to,te,sizeof(te));
       snprintf(q,sizeof(q),
         "INSERT INTO payouts_runner(runner_id,amount_cents,note,period_from,period_to) "
         "VALUES(%ld,%ld,'%s',STR_TO_DATE('%s','%%Y-%%m-%%d'),STR_TO_DATE('%s','%%Y-%%m-%%d'))",
@@ -471,7 +691,8 @@ static int cmd_runner(int argc, char** argv, MYSQL* c) {
     } else {
       snprintf(q,sizeof(q),"INSERT INTO payouts_runner(runner_id,amount_cents,note) VALUES(%ld,%ld,'%s')", runner, amount, ne);
     }
-    if (db_exec(c,q)!=0) { return 5; }
+    int rc = record_payout(c,q,LEDGER_RUNNER,runner,amount);
+    if (rc) return rc;
     printf("OK runner payout recorded\n");
     return 0;
   }
@@ -500,7 +721,7 @@ static int cmd_bettor(int argc, char** argv, MYSQL* c) {
       fprintf(stderr,"required: --runner-id --code [--name]\n");
       return 2;
     }
-    char ce[128], ne[256]; esc_str(c,code,ce,sizeof(ce)); esc_str(c,name,ne,sizeof(ne));
+    char ce[128], ne[256]; db_escape(c,code,ce,sizeof(ce)); db_escape(c,name,ne,sizeof(ne));
     char q[1024];
     snprintf(q,sizeof(q),"INSERT INTO bettors(runner_id,code,display_name) VALUES(%ld,'%s','%s') ON DUPLICATE KEY UPDATE display_name=VALUES(display_name)", runner, ce, ne);
     if (db_exec(c,q)!=0) { return 5; }
@@ -509,18 +730,20 @@ static int cmd_bettor(int argc, char** argv, MYSQL* c) {
   }
 
   if (!strcmp(sub,"list")) {
-    long runner=0; static struct option o[]={{"runner-id",1,0,'r'},{0,0,0,0}};
+    long runner=0; list_opts_t lo={LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={{"runner-id",1,0,'r'},LIST_LONGOPTS,{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"r:",o,&ix))!=-1){
-      if(ch=='r') runner=atol(optarg); else return 2;
+    while((ch=getopt_long(argc-1,argv+1,"r:" LIST_SHORTOPTS,o,&ix))!=-1){
+      if(ch=='r') runner=atol(optarg);
+      else if(!list_opt(&lo,ch,optarg)) return 2;
     }
     if(!runner){
       fprintf(stderr,"required: --runner-id\n");
       return 2;
     }
-    char q[512];
-    snprintf(q,sizeof(q),"SELECT id,code,display_name,created_at FROM bettors WHERE runner_id=%ld ORDER BY id", runner);
-    return exec_and_print(c,q);
+    char w[256]="";
+    where_and(w,sizeof(w),"runner_id=%ld",runner);
+    return list_by_id(c,&lo,"id,code,display_name,created_at","bettors",w,sizeof(w),"id",false);
   }
 
   if (!strcmp(sub,"payout")) {
@@ -539,10 +762,10 @@ static int cmd_bettor(int argc, char** argv, MYSQL* c) {
       fprintf(stderr,"required: --bettor-id --amount-cents [--note] [--from --to]\n");
       return 2;
     }
-    char ne[256]; esc_str(c,note,ne,sizeof(ne));
+    char ne[256]; db_escape(c,note,ne,sizeof(ne));
     char q[1024];
     if(from&&to){
-      char fe[32],te[32]; esc_str(c,from,fe,sizeof(fe)); esc_str(c,to,te,sizeof(te));
+      char fe[32],te[32]; db_escape(c,from,fe,sizeof(fe)); db_escape(c,to,te,sizeof(te));
       snprintf(q,sizeof(q),
         "INSERT INTO payouts_bettor(bettor_id,amount_cents,note,period_from,period_to) "
         "VALUES(%ld,%ld,'%s',STR_TO_DATE('%s','%%Y-%%m-%%d'),STR_TO_DATE('%s','%%Y-%%m-%%d'))",
@@ -550,7 +773,8 @@ static int cmd_bettor(int argc, char** argv, MYSQL* c) {
     } else {
       snprintf(q,sizeof(q),"INSERT INTO payouts_bettor(bettor_id,amount_cents,note) VALUES(%ld,%ld,'%s')", bettor, amount, ne);
     }
-    if (db_exec(c,q)!=0) { return 5; }
+    int rc = record_payout(c,q,LEDGER_BETTOR,bettor,amount);
+    if (rc) return rc;
     printf("OK bettor payout recorded\n");
     return 0;
   }
@@ -562,34 +786,60 @@ static int cmd_bettor(int argc, char** argv, MYSQL* c) {
 /* ---------- EVENT ---------- */
 
 static int cmd_event(int argc, char** argv, MYSQL* c) {
-  if (argc < 2) { fprintf(stderr,"event create|list|set-score|finalize\n"); return 2; }
+  if (argc < 2) { fprintf(stderr,"event create|list|set-score|finalize|void|import\n"); return 2; }
   const char* sub=argv[1]; optind=1;
 
   if (!strcmp(sub,"create")) {
-    long league=0, home=0, away=0; const char* starts=NULL;
-    static struct option o[]={{"league-id",1,0,'l'},{"starts-at",1,0,'t'},{"home-id",1,0,'h'},{"away-id",1,0,'a'},{0,0,0,0}};
+    long league=0, home=0, away=0; const char* starts=NULL; unsigned long long id=0;
+    static struct option o[]={{"league-id",1,0,'l'},{"starts-at",1,0,'t'},{"home-id",1,0,'h'},{"away-id",1,0,'a'},{"id",1,0,'i'},{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"l:t:h:a:",o,&ix))!=-1){
+    while((ch=getopt_long(argc-1,argv+1,"l:t:h:a:i:",o,&ix))!=-1){
       if(ch=='l') league=atol(optarg);
       else if(ch=='t') starts=optarg;
       else if(ch=='h') home=atol(optarg);
       else if(ch=='a') away=atol(optarg);
+      else if(ch=='i') { if (!ref_id_arg(optarg,&id)) return 2; }
       else return 2;
     }
     if(!league||!home||!away||!starts){
       fprintf(stderr,"required: --league-id --starts-at --home-id --away-id\n");
       return 2;
     }
-    char se[64]; esc_str(c,starts,se,sizeof(se));
-    char q[512];
-    snprintf(q,sizeof(q),"INSERT INTO events(league_id,starts_at,home_team_id,away_team_id) VALUES(%ld,'%s',%ld,%ld)", league, se, home, away);
-    if (db_exec(c,q)!=0) { return 5; }
+    char se[64]; db_escape(c,starts,se,sizeof(se));
+    char v[256]; snprintf(v,sizeof(v),"%ld,'%s',%ld,%ld", league, se, home, away);
+    if (ref_insert(c,"events","league_id,starts_at,home_team_id,away_team_id",v,
+                   "league_id=VALUES(league_id),starts_at=VALUES(starts_at),home_team_id=VALUES(home_team_id),away_team_id=VALUES(away_team_id)",id)!=0) { return 5; }
     printf("OK\n");
     return 0;
   }
 
   if (!strcmp(sub,"list")) {
-    return exec_and_print(c,"SELECT id,league_id,DATE_FORMAT(starts_at,'%%Y-%%m-%%d %%H:%%i') AS starts_at,home_team_id,away_team_id,status FROM events ORDER BY starts_at");
+    long league=0; const char* status=NULL; const char* from=NULL; const char* to=NULL;
+    list_opts_t lo={LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={{"league-id",1,0,'l'},{"status",1,0,'s'},{"from",1,0,'f'},{"to",1,0,'t'},LIST_LONGOPTS,{0,0,0,0}};
+    int ch,ix=0;
+    while((ch=getopt_long(argc-1,argv+1,"l:s:f:t:" LIST_SHORTOPTS,o,&ix))!=-1){
+      if(ch=='l') league=atol(optarg);
+      else if(ch=='s') status=optarg;
+      else if(ch=='f') from=optarg;
+      else if(ch=='t') to=optarg;
+      else if(!list_opt(&lo,ch,optarg)) return 2;
+    }
+    char w[512]="";
+    if (league>0) where_and(w,sizeof(w),"league_id=%ld",league);
+    if (status) { char se[32]; db_escape(c,status,se,sizeof(se)); where_and(w,sizeof(w),"status='%s'",se); }
+    if (where_days(w,sizeof(w),"starts_at",from,to)) return 2;
+    /* ordered by (starts_at, id): the cursor carries both */
+    if (lo.after) {
+      long long key; long id;
+      if (list_cursor(lo.after,&key,&id)!=0 || !key) { fprintf(stderr,"invalid --after cursor\n"); return 2; }
+      where_and(w,sizeof(w),"(starts_at>STR_TO_DATE('%lld','%%Y%%m%%d%%H%%i%%s') OR (starts_at=STR_TO_DATE('%lld','%%Y%%m%%d%%H%%i%%s') AND id>%ld))",
+                key, key, id);
+    }
+    char q[1024];
+    snprintf(q,sizeof(q),"SELECT id,league_id,DATE_FORMAT(starts_at,'%%Y-%%m-%%d %%H:%%i') AS starts_at,home_team_id,away_team_id,status,"
+                         "CONCAT(DATE_FORMAT(starts_at,'%%Y%%m%%d%%H%%i%%s'),'.',id) AS _cursor FROM events%s ORDER BY starts_at,id", w);
+    return list_run(c,&lo,q,sizeof(q));
   }
 
   if (!strcmp(sub,"set-score")) {
@@ -609,7 +859,7 @@ static int cmd_event(int argc, char** argv, MYSQL* c) {
     }
     char q[256];
     snprintf(q,sizeof(q),"UPDATE events SET home_score=%d, away_score=%d%s WHERE id=%ld", home, away, fin?", status='final'":"", event);
-    if (db_exec(c,q)!=0) { return 5; }
+    if (db_exec(c,q)!=0 || ref_replay(q)!=0) { return 5; }
     printf("OK\n");
     return 0;
   }
@@ -626,11 +876,61 @@ static int cmd_event(int argc, char** argv, MYSQL* c) {
     }
     char q[256];
     snprintf(q,sizeof(q),"UPDATE events SET status='final' WHERE id=%ld", event);
-    if (db_exec(c,q)!=0) { return 5; }
+    if (db_exec(c,q)!=0 || ref_replay(q)!=0) { return 5; }
     printf("OK event finalized\n");
     return 0;
   }
 
+  if (!strcmp(sub,"void")) {
+    long event=0; static struct option o[]={{"event-id",1,0,'e'},{0,0,0,0}};
+    int ch,ix=0;
+    while((ch=getopt_long(argc-1,argv+1,"e:",o,&ix))!=-1){
+      if(ch=='e') event=atol(optarg); else return 2;
+    }
+    if(!event){
+      fprintf(stderr,"required: --event-id\n");
+      return 2;
+    }
+    char q[256];
+    snprintf(q,sizeof(q),"UPDATE events SET status='void' WHERE id=%ld AND status<>'final'", event);
+    if (db_exec(c,q)!=0) { return 5; }
+    if (mysql_affected_rows(c)==0) {
+      /* already void here: replay anyway, so a rerun reaches shards an earlier run missed */
+      char chk[128]; snprintf(chk,sizeof(chk),"SELECT 1 FROM events WHERE id=%ld AND status='void'", event);
+      if (db_exec(c,chk)!=0) { return 5; }
+      MYSQL_RES* r = mysql_store_result(c);
+      bool isvoid = r && mysql_fetch_row(r);
+      if (r) mysql_free_result(r);
+      if (!isvoid) { fprintf(stderr,"event %ld not found or final\n", event); return 2; }
+    }
+    if (ref_replay(q)!=0) { return 5; }
+    printf("OK event voided (settle event refunds its bets)\n");
+    return 0;
+  }
+
+  if (!strcmp(sub,"import")) {
+    const char* file=NULL; long batch=1000;
+    static struct option o[]={{"file",1,0,'f'},{"batch",1,0,'b'},{0,0,0,0}};
+    int ch,ix=0;
+    while((ch=getopt_long(argc-1,argv+1,"f:b:",o,&ix))!=-1){
+      if(ch=='f') file=optarg;
+      else if(ch=='b') batch=atol(optarg);
+      else return 2;
+    }
+    if(!file||batch<1){
+      fprintf(stderr,"required: --file <csv|-> (--batch >= 1)\n");
+      return 2;
+    }
+    MYSQL* conns[SHARD_MAX];
+    if (shards_open(c,conns)!=0) return 5;
+    fixtures_stats_t st;
+    int rc = fixtures_import(conns,g_shards.n,file,batch,&st);
+    shards_close(c,conns);
+    if (rc) return rc;
+    printf("OK %ld events imported, %ld already present; %ld teams created\n", st.created, st.skipped, st.teams);
+    return 0;
+  }
+
   fprintf(stderr,"unknown event subcommand\n");
   return 2;
 }
@@ -638,70 +938,88 @@ static int cmd_event(int argc, char** argv, MYSQL* c) {
 /* ---------- QUOTE ---------- */
 
 static int cmd_quote(int argc, char** argv, MYSQL* c) {
-  if (argc < 2) { fprintf(stderr,"quote add|list\n"); return 2; }
+  if (argc < 2) { fprintf(stderr,"quote add|list|board\n"); return 2; }
   const char* sub=argv[1]; optind=1;
 
   if (!strcmp(sub,"add")) {
     long event=0,bm=0; const char* market=NULL; const char* side=NULL;
-    double line=0.0,line_b=0.0,price=0.0,price_b=0.0; int asian=0;
+    int line=0,line_b=0; long price=0,price_b=0; int asian=0;
     static struct option o[]={
       {"event-id",1,0,'e'},{"bookmaker-id",1,0,'b'},{"market",1,0,'m'},{"side",1,0,'s'},
-      {"line",1,0,'l'},{"price",1,0,'p'},{"asian",0,0,'a'},{"line-b",1,0,'L'},{"price-b",1,0,'P'},{0,0,0,0}};
+      {"line",1,0,'l'},{"price",1,0,'p'},{"asian",0,0,'a'},{"line-b",1,0,'L'},{"price-b",1,0,'P'},{"score",1,0,'S'},{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"e:b:m:s:l:p:aL:P:",o,&ix))!=-1){
+    while((ch=getopt_long(argc-1,argv+1,"e:b:m:s:l:p:aL:P:S:",o,&ix))!=-1){
       if(ch=='e') event=atol(optarg);
       else if(ch=='b') bm=atol(optarg);
       else if(ch=='m') market=optarg;
       else if(ch=='s') side=optarg;
-      else if(ch=='l') line=atof(optarg);
-      else if(ch=='p') price=atof(optarg);
+      else if(ch=='l'){ if(opt_line("--line",optarg,&line)) return 2; }
+      else if(ch=='p'){ if(opt_price("--price",optarg,&price)) return 2; }
       else if(ch=='a') asian=1;
-      else if(ch=='L') line_b=atof(optarg);
-      else if(ch=='P') price_b=atof(optarg);
+      else if(ch=='L'){ if(opt_line("--line-b",optarg,&line_b)) return 2; }
+      else if(ch=='P'){ if(opt_price("--price-b",optarg,&price_b)) return 2; }
+      else if(ch=='S'){ if(parse_score(optarg,&line,&line_b)){ fprintf(stderr,"--score expects H-A\n"); return 2; } }
       else return 2;
     }
-    if(!event||!bm||!market||!side||price<=1.0){
+    if(!event||!bm||!market||!side||price<=MKT_PRICE_ONE){
       fprintf(stderr,"required: --event-id --bookmaker-id --market --side --price\n");
       return 2;
     }
-    if (asian && (price_b<=1.0)) {
+    if (asian && (price_b<=MKT_PRICE_ONE)) {
       fprintf(stderr,"asian requires: --price-b (and usually --line-b)\n");
       return 2;
     }
-    char me[32], se[16]; esc_str(c,market,me,sizeof(me)); esc_str(c,side,se,sizeof(se));
-    char line_sql[32], lineb_sql[32], priceb_sql[32];
-    if (!strcmp(me,"moneyline")||!strcmp(me,"threeway")) snprintf(line_sql,sizeof(line_sql),"NULL");
-    else snprintf(line_sql,sizeof(line_sql),"%.2f", line);
-    if (asian) { snprintf(lineb_sql,sizeof(lineb_sql),"%.2f", line_b); snprintf(priceb_sql,sizeof(priceb_sql),"%.4f", price_b); }
-    else { snprintf(lineb_sql,sizeof(lineb_sql),"NULL"); snprintf(priceb_sql,sizeof(priceb_sql),"NULL"); }
-
-    char q[1024];
-    snprintf(q,sizeof(q),
-      "INSERT INTO quotes(event_id,bookmaker_id,market_type,side,line,is_asian,line_b,price_decimal,price_decimal_b) "
-      "VALUES(%ld,%ld,'%s','%s',%s,%d,%s,%.4f,%s)",
-      event,bm,me,se,line_sql,asian,lineb_sql,price,priceb_sql);
-    if (db_exec(c,q)!=0) { return 5; }
+    gigam_quote_t qt = { event, bm, market, side, line, price, asian, line_b, price_b };
+    gigam_ctx_t* g = gigam_wrap(c); if (!g) return 5;
+    int rc = gigam_done(g, gigam_quote_add(g, &qt, NULL));
+    if (rc) return rc;
     printf("OK\n");
     return 0;
   }
 
   if (!strcmp(sub,"list")) {
-    long event=0,bm=0; static struct option o[]={{"event-id",1,0,'e'},{"bookmaker-id",1,0,'b'},{0,0,0,0}};
+    long event=0,bm=0; const char* market=NULL; list_opts_t lo={LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={{"event-id",1,0,'e'},{"bookmaker-id",1,0,'b'},{"market",1,0,'m'},LIST_LONGOPTS,{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"e:b:",o,&ix))!=-1){
+    while((ch=getopt_long(argc-1,argv+1,"e:b:m:" LIST_SHORTOPTS,o,&ix))!=-1){
       if(ch=='e') event=atol(optarg);
       else if(ch=='b') bm=atol(optarg);
-      else return 2;
+      else if(ch=='m') market=optarg;
+      else if(!list_opt(&lo,ch,optarg)) return 2;
     }
     if(!event||!bm){
       fprintf(stderr,"required: --event-id --bookmaker-id\n");
       return 2;
     }
-    char q[1024];
-    snprintf(q,sizeof(q),
-      "SELECT id,market_type,side,COALESCE(CAST(line AS CHAR),'-') AS line,is_asian,COALESCE(CAST(line_b AS CHAR),'-') AS line_b,price_decimal,COALESCE(CAST(price_decimal_b AS CHAR),'-') AS price_b,DATE_FORMAT(captured_at,'%%Y-%%m-%%d %%H:%%i:%%s') AS captured_at "
-      "FROM quotes WHERE event_id=%ld AND bookmaker_id=%ld ORDER BY id DESC", event, bm);
-    return exec_and_print(c,q);
+    char w[512]="";
+    where_and(w,sizeof(w),"event_id=%ld AND bookmaker_id=%ld",event,bm);
+    if (market) { char me[32]; db_escape(c,market,me,sizeof(me)); where_and(w,sizeof(w),"market_type='%s'",me); }
+    return list_by_id(c,&lo,
+      "id,market_type,side,COALESCE(CAST(line AS CHAR),'-') AS line,is_asian,COALESCE(CAST(line_b AS CHAR),'-') AS line_b,price_decimal,COALESCE(CAST(price_decimal_b AS CHAR),'-') AS price_b,DATE_FORMAT(captured_at,'%Y-%m-%d %H:%i:%s') AS captured_at",
+      "quotes",w,sizeof(w),"id",true);
+  }
+
+  if (!strcmp(sub,"board")) {
+    board_opts_t bo = { 0, 86400, 0 };
+    const char* out=NULL; rf_format_t fmt=RF_TABLE;
+    static struct option o[]={{"league-id",1,0,'l'},{"starts-within",1,0,'w'},{"arb-only",0,0,'a'},{"format",1,0,'F'},{"out",1,0,'O'},{0,0,0,0}};
+    int ch,ix=0;
+    while((ch=getopt_long(argc-1,argv+1,"l:w:aF:O:",o,&ix))!=-1){
+      if(ch=='l') bo.league_id=atol(optarg);
+      else if(ch=='w'){
+        bo.within_s=board_parse_window(optarg);
+        if(bo.within_s<0){ fprintf(stderr,"--starts-within: N[m|h|d] (seconds without a unit)\n"); return 2; }
+      }
+      else if(ch=='a') bo.arb_only=1;
+      else if(ch=='F') fmt=rf_format_from_str(optarg);
+      else if(ch=='O') out=optarg;
+      else return 2;
+    }
+    MYSQL* conns[SHARD_MAX];
+    if (shards_open(c,conns)!=0) return 5;
+    int rc = board_run(conns,g_shards.n,&bo,fmt,out);
+    shards_close(c,conns);
+    return rc;
   }
 
   fprintf(stderr,"unknown quote subcommand\n");
@@ -711,273 +1029,318 @@ static int cmd_quote(int argc, char** argv, MYSQL* c) {
 /* ---------- BET ---------- */
 
 static int cmd_bet(int argc, char** argv, MYSQL* c) {
-  if (argc < 2) { fprintf(stderr,"bet place|list\n"); return 2; }
+  if (argc < 2) { fprintf(stderr,"bet place|parlay|list\n"); return 2; }
   const char* sub=argv[1]; optind=1;
 
   if (!strcmp(sub,"place")) {
     long bm=0,event=0,runner=0,bettor=0; const char* market=NULL; const char* side=NULL;
-    double line=0.0, line_b=0.0, price=0.0, price_b=0.0; long stake=0; int asian=0;
+    int line=0, line_b=0; long price=0, price_b=0; long stake=0; int asian=0; const char* key=NULL;
     static struct option o[]={
       {"bookmaker-id",1,0,'b'},{"event-id",1,0,'e'},{"runner-id",1,0,'r'},{"bettor-id",1,0,'t'},
       {"market",1,0,'m'},{"side",1,0,'s'},{"line",1,0,'l'},{"price",1,0,'p'},{"stake",1,0,'k'},
-      {"asian",0,0,'a'},{"line-b",1,0,'L'},{"price-b",1,0,'P'},{0,0,0,0}};
+      {"asian",0,0,'a'},{"line-b",1,0,'L'},{"price-b",1,0,'P'},{"bet-key",1,0,'K'},{"score",1,0,'S'},{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"b:e:r:t:m:s:l:p:k:aL:P:",o,&ix))!=-1){
+    while((ch=getopt_long(argc-1,argv+1,"b:e:r:t:m:s:l:p:k:aL:P:K:S:",o,&ix))!=-1){
       if(ch=='b') bm=atol(optarg);
       else if(ch=='e') event=atol(optarg);
       else if(ch=='r') runner=atol(optarg);
       else if(ch=='t') bettor=atol(optarg);
       else if(ch=='m') market=optarg;
       else if(ch=='s') side=optarg;
-      else if(ch=='l') line=atof(optarg);
-      else if(ch=='p') price=atof(optarg);
+      else if(ch=='l'){ if(opt_line("--line",optarg,&line)) return 2; }
+      else if(ch=='p'){ if(opt_price("--price",optarg,&price)) return 2; }
       else if(ch=='k') stake=atol(optarg);
       else if(ch=='a') asian=1;
-      else if(ch=='L') line_b=atof(optarg);
-      else if(ch=='P') price_b=atof(optarg);
+      else if(ch=='L'){ if(opt_line("--line-b",optarg,&line_b)) return 2; }
+      else if(ch=='P'){ if(opt_price("--price-b",optarg,&price_b)) return 2; }
+      else if(ch=='K') key=optarg;
+      else if(ch=='S'){ if(parse_score(optarg,&line,&line_b)){ fprintf(stderr,"--score expects H-A\n"); return 2; } }
       else return 2;
     }
-    if(!bm||!event||!runner||!bettor||!market||!side||price<=1.0||stake<=0){
+    if(!bm||!event||!runner||!bettor||!market||!side||price<=MKT_PRICE_ONE||stake<=0){
       fprintf(stderr,"required: --bookmaker-id --event-id --runner-id --bettor-id --market --side --price --stake\n");
       return 2;
     }
 
-    char me[32], se[16]; esc_str(c,market,me,sizeof(me)); esc_str(c,side,se,sizeof(se));
-    char line_sql[32], priceb_sql[32], lineb_sql[32];
-    if(!strcmp(me,"moneyline")||!strcmp(me,"threeway")) snprintf(line_sql,sizeof(line_sql),"NULL");
-    else snprintf(line_sql,sizeof(line_sql),"%.2f", line);
-    if(asian){ snprintf(priceb_sql,sizeof(priceb_sql),"%.4f", price_b); snprintf(lineb_sql,sizeof(lineb_sql),"%.2f", line_b); }
-    else { snprintf(priceb_sql,sizeof(priceb_sql),"NULL"); snprintf(lineb_sql,sizeof(lineb_sql),"NULL"); }
+    gigam_bet_t bt = { bm, event, runner, bettor, market, side, line, price, stake, asian, line_b, price_b, key };
+    gigam_ctx_t* g = gigam_wrap(c); if (!g) return 5;
+    long long id = 0;
+    int rc = gigam_done(g, gigam_bet_place(g, &bt, &id));
+    if (rc) return rc;
+    printf("OK bet_id=%lld\n", id);
+    return 0;
+  }
 
-    char qset[1024];
-    if(!strcmp(me,"moneyline")||!strcmp(me,"threeway")){
-      snprintf(qset,sizeof(qset),
-        "SET @qid := (SELECT id FROM quotes WHERE event_id=%ld AND bookmaker_id=%ld AND market_type='%s' AND side='%s' ORDER BY id DESC LIMIT 1);",
-        event,bm,me,se);
-    } else {
-      snprintf(qset,sizeof(qset),
-        "SET @qid := (SELECT id FROM quotes WHERE event_id=%ld AND bookmaker_id=%ld AND market_type='%s' AND side='%s' AND COALESCE(line,0)=%.2f ORDER BY id DESC LIMIT 1);",
-        event,bm,me,se,line);
-    }
-    if (db_exec(c,qset)!=0) { return 5; }
-
-    char ins[1024];
-    snprintf(ins,sizeof(ins),
-      "INSERT INTO bets(bookmaker_id,event_id,quote_id,stake_cents,market_type,pick_side,line,is_asian,price_decimal,price_decimal_b,line_b,runner_id,bettor_id,status) "
-      "VALUES(%ld,%ld,@qid,%ld,'%s','%s',%s,%d,%.4f,%s,%s,%ld,%ld,'open')",
-      bm,event,stake,me,se,line_sql,asian,price,priceb_sql,lineb_sql,runner,bettor);
-    if (db_exec(c,ins)!=0) { return 5; }
-    printf("OK\n");
+  if (!strcmp(sub,"parlay")) {
+    long bm=0,runner=0,bettor=0,stake=0; const char* key=NULL;
+    gigam_leg_t legs[GIGAM_PARLAY_MAX_LEGS]; char legbuf[GIGAM_PARLAY_MAX_LEGS][128]; int nlegs=0;
+    static struct option o[]={
+      {"bookmaker-id",1,0,'b'},{"runner-id",1,0,'r'},{"bettor-id",1,0,'t'},{"stake",1,0,'k'},
+      {"leg",1,0,'g'},{"bet-key",1,0,'K'},{0,0,0,0}};
+    int ch,ix=0;
+    while((ch=getopt_long(argc-1,argv+1,"b:r:t:k:g:K:",o,&ix))!=-1){
+      if(ch=='b') bm=atol(optarg);
+      else if(ch=='r') runner=atol(optarg);
+      else if(ch=='t') bettor=atol(optarg);
+      else if(ch=='k') stake=atol(optarg);
+      else if(ch=='K') key=optarg;
+      else if(ch=='g'){
+        if(nlegs==GIGAM_PARLAY_MAX_LEGS){ fprintf(stderr,"at most %d legs\n", GIGAM_PARLAY_MAX_LEGS); return 2; }
+        if(parse_leg(optarg,&legs[nlegs],legbuf[nlegs],sizeof(legbuf[nlegs]))){
+          fprintf(stderr,"--leg expects EVENT:MARKET:SIDE[:LINE|:H-A]@PRICE, got '%s'\n", optarg); return 2;
+        }
+        nlegs++;
+      }
+      else return 2;
+    }
+    if(!bm||!runner||!bettor||stake<=0||nlegs<2){
+      fprintf(stderr,"required: --bookmaker-id --runner-id --bettor-id --stake and 2+ --leg\n");
+      return 2;
+    }
+
+    gigam_parlay_t pl = { bm, runner, bettor, stake, legs, nlegs, key };
+    gigam_ctx_t* g = gigam_wrap(c); if (!g) return 5;
+    long long id = 0;
+    int rc = gigam_done(g, gigam_parlay_place(g, &pl, &id));
+    if (rc) return rc;
+    printf("OK bet_id=%lld\n", id);
     return 0;
   }
 
   if (!strcmp(sub,"list")) {
-    long bm=0; static struct option o[]={{"bookmaker-id",1,0,'b'},{0,0,0,0}};
+    long bm=0, event=0, runner=0, bettor=0; const char* status=NULL; const char* from=NULL; const char* to=NULL;
+    list_opts_t lo={BET_LIST_DEFAULT_LIMIT,NULL,RF_TABLE,NULL};
+    static struct option o[]={{"bookmaker-id",1,0,'b'},{"event-id",1,0,'e'},{"runner-id",1,0,'r'},{"bettor-id",1,0,'u'},
+      {"status",1,0,'s'},{"from",1,0,'f'},{"to",1,0,'t'},LIST_LONGOPTS,{0,0,0,0}};
     int ch,ix=0;
-    while((ch=getopt_long(argc-1,argv+1,"b:",o,&ix))!=-1){
-      if(ch=='b') bm=atol(optarg); else return 2;
+    while((ch=getopt_long(argc-1,argv+1,"b:e:r:u:s:f:t:" LIST_SHORTOPTS,o,&ix))!=-1){
+      if(ch=='b') bm=atol(optarg);
+      else if(ch=='e') event=atol(optarg);
+      else if(ch=='r') runner=atol(optarg);
+      else if(ch=='u') bettor=atol(optarg);
+      else if(ch=='s') status=optarg;
+      else if(ch=='f') from=optarg;
+      else if(ch=='t') to=optarg;
+      else if(!list_opt(&lo,ch,optarg)) return 2;
     }
     if(!bm){
       fprintf(stderr,"required: --bookmaker-id\n");
       return 2;
     }
-    char q[1024];
-    snprintf(q,sizeof(q),
-      "SELECT b.id AS bet_id, DATE_FORMAT(b.placed_at,'%%Y-%%m-%%d %%H:%%i:%%s') AS placed_at, b.market_type,b.pick_side,COALESCE(CAST(b.line AS CHAR),'-') AS line,b.is_asian,b.price_decimal,ROUND(b.stake_cents/100,2) AS stake_usd,b.status "
-      "FROM bets b WHERE b.bookmaker_id=%ld ORDER BY b.id DESC LIMIT 200", bm);
-    return exec_and_print(c,q);
+    /* newest first; each filter is the prefix of an index ending in id */
+    char w[768]="";
+    where_and(w,sizeof(w),"b.bookmaker_id=%ld",bm);
+    if (event>0) where_and(w,sizeof(w),"b.event_id=%ld",event);
+    if (runner>0) where_and(w,sizeof(w),"b.runner_id=%ld",runner);
+    if (bettor>0) where_and(w,sizeof(w),"b.bettor_id=%ld",bettor);
+    if (status) { char se[32]; db_escape(c,status,se,sizeof(se)); where_and(w,sizeof(w),"b.status='%s'",se); }
+    if (where_days(w,sizeof(w),"b.placed_at",from,to)) return 2;
+    return list_by_id(c,&lo,
+      "b.id AS bet_id, DATE_FORMAT(b.placed_at,'%Y-%m-%d %H:%i:%s') AS placed_at, b.market_type,b.pick_side,COALESCE(CAST(b.line AS CHAR),'-') AS line,b.is_asian,b.price_decimal,ROUND(b.stake_cents/100,2) AS stake_usd,b.status,b.bet_type",
+      "bets b",w,sizeof(w),"b.id",true);
   }
 
   fprintf(stderr,"unknown bet subcommand\n");
   return 2;
 }
 
-/* ---------- SETTLEMENT HELPERS ---------- */
-
-static int get_event_scores(MYSQL* c, long event_id, int* home, int* away, int* is_final) {
-  char q[256]; snprintf(q,sizeof(q),"SELECT home_score,away_score,(status='final') FROM events WHERE id=%ld", event_id);
-  if (db_exec(c,q)!=0) return -1;
-  MYSQL_RES* r = mysql_store_result(c); if(!r) return -1;
-  MYSQL_ROW row = mysql_fetch_row(r);
-  if (!row) { mysql_free_result(r); return -1; }
-  *home = row[0]?atoi(row[0]):0;
-  *away = row[1]?atoi(row[1]):0;
-  *is_final = row[2]?atoi(row[2]):0;
-  mysql_free_result(r);
-  return 0;
-}
+/* ---------- SETTLE ---------- */
 
-static void settle_one_leg(double stake_cents_half, double price, int cmp, long long* out_payout, long long* out_profit) {
-  long long stake = (long long)(stake_cents_half + 0.5);
-  if (cmp > 0) {
-    long long payout = (long long)(stake * price + 0.5);
-    long long profit = payout - stake;
-    *out_payout += payout;
-    *out_profit += profit;
-  } else if (cmp == 0) {
-    *out_payout += stake; /* push */
-  } else {
-    *out_profit -= stake; /* lose -> book wins stake (negative for player) */
-  }
+/* settle event / settle correct on every shard: each holds bets on it */
+typedef struct {
+  long event, chunk; int home, away;
+  gigam_correction_t cr[SHARD_MAX];
+  int rc[SHARD_MAX];
+} settle_fan_t;
+
+static int settle_event_task(MYSQL* c, size_t s, void* ud) {
+  settle_fan_t* f = (settle_fan_t*)ud;
+  gigam_ctx_t* g = gigam_wrap(c); if (!g) return f->rc[s] = 5;
+  gigam_set_scan_chunk(g, f->chunk);
+  return f->rc[s] = gigam_done(g, gigam_settle_event(g, f->event, NULL));
 }
 
-/* ---------- SETTLE ---------- */
+static int settle_correct_task(MYSQL* c, size_t s, void* ud) {
+  settle_fan_t* f = (settle_fan_t*)ud;
+  gigam_ctx_t* g = gigam_wrap(c); if (!g) return f->rc[s] = 5;
+  return f->rc[s] = gigam_done(g, gigam_settle_correct(g, f->event, f->home, f->away, &f->cr[s]));
+}
 
-static int settle_compute(
-  const char* market, const char* side, int is_asian,
-  double line, double line_b, double price, double price_b,
-  long long stake_cents, int home_score, int away_score,
-  long long* payout_cents, long long* profit_cents, const char** out_result)
-{
-  *payout_cents=0; *profit_cents=0; *out_result="lose";
-  int cmp=0, cmp_b=0;
-
-  if (!strcmp(market,"moneyline")) {
-    int w = (home_score>away_score)?1:(home_score<away_score?-1:0);
-    if (!strcmp(side,"HOME")) cmp=(w>0)?1:(w==0?0:-1);
-    else if (!strcmp(side,"AWAY")) cmp=(w<0)?1:(w==0?0:-1);
-    else if (!strcmp(side,"DRAW")) cmp=(w==0)?1:-1;
-    if (w==0 && (strcmp(side,"DRAW")!=0)) cmp=0;
-    settle_one_leg((double)stake_cents, price, cmp, payout_cents, profit_cents);
-  } else if (!strcmp(market,"threeway")) {
-    int w = (home_score>away_score)?1:(home_score<away_score?-1:0);
-    if (!strcmp(side,"HOME")) cmp=(w>0)?1:-1;
-    else if (!strcmp(side,"AWAY")) cmp=(w<0)?1:-1;
-    else if (!strcmp(side,"DRAW")) cmp=(w==0)?1:-1;
-    settle_one_leg((double)stake_cents, price, cmp, payout_cents, profit_cents);
-  } else if (!strcmp(market,"spread")) {
-    if (!strcmp(side,"HOME")) {
-      if (is_asian && (line - (int)line != 0.0)) {
-        double adj1 = (double)home_score + line;
-        double adj2 = (double)home_score + line_b;
-        cmp   = (adj1>away_score)?1:((adj1==away_score)?0:-1);
-        cmp_b = (adj2>away_score)?1:((adj2==away_score)?0:-1);
-        settle_one_leg(stake_cents*0.5, price, cmp, payout_cents, profit_cents);
-        settle_one_leg(stake_cents*0.5, price_b>1.0?price_b:price, cmp_b, payout_cents, profit_cents);
-      } else {
-        double adj = (double)home_score + line;
-        cmp = (adj>away_score)?1:((adj==away_score)?0:-1);
-        settle_one_leg((double)stake_cents, price, cmp, payout_cents, profit_cents);
-      }
-    } else {
-      if (is_asian && (line - (int)line != 0.0)) {
-        double adj1 = (double)away_score + line;
-        double adj2 = (double)away_score + line_b;
-        cmp   = (adj1>home_score)?1:((adj1==home_score)?0:-1);
-        cmp_b = (adj2>home_score)?1:((adj2==home_score)?0:-1);
-        settle_one_leg(stake_cents*0.5, price, cmp, payout_cents, profit_cents);
-        settle_one_leg(stake_cents*0.5, price_b>1.0?price_b:price, cmp_b, payout_cents, profit_cents);
-      } else {
-        double adj = (double)away_score + line;
-        cmp = (adj>home_score)?1:((adj==home_score)?0:-1);
-        settle_one_leg((double)stake_cents, price, cmp, payout_cents, profit_cents);
-      }
+static int cmd_settle(int argc, char** argv, MYSQL* c) {
+  if (argc>=2 && !strcmp(argv[1],"follow")){
+    settle_feed_opts_t so = { NULL, 4, 64, 200, 200, GIGAM_SCAN_CHUNK };
+    static struct option o[]={{"feed",1,0,'f'},{"workers",1,0,'w'},{"queue",1,0,'q'},{"batch",1,0,'n'},{"batch-ms",1,0,'t'},{"chunk-rows",1,0,'c'},{0,0,0,0}};
+    int ch,ix=0; optind=1;
+    while((ch=getopt_long(argc-1,argv+1,"f:w:q:n:t:c:",o,&ix))!=-1){
+      if(ch=='f') so.feed=optarg;
+      else if(ch=='w') so.workers=atoi(optarg);
+      else if(ch=='q') so.queue=atoi(optarg);
+      else if(ch=='n') so.batch=atoi(optarg);
+      else if(ch=='t') so.batch_ms=atoi(optarg);
+      else if(ch=='c') so.chunk_rows=atol(optarg);
+      else return 2;
     }
-  } else if (!strcmp(market,"total")) {
-    int sum = home_score + away_score;
-    if (!strcmp(side,"OVER")) cmp = (sum>line)?1:((sum==line)?0:-1);
-    else cmp = (sum<line)?1:((sum==line)?0:-1);
-    if (is_asian && (line - (int)line != 0.0)) {
-      int cmp1 = (!strcmp(side,"OVER"))? ((sum>line)?1:((sum==line)?0:-1)) : ((sum<line)?1:((sum==line)?0:-1));
-      int cmp2 = (!strcmp(side,"OVER"))? ((sum>line_b)?1:((sum==line_b)?0:-1)) : ((sum<line_b)?1:((sum==line_b)?0:-1));
-      settle_one_leg(stake_cents*0.5, price, cmp1, payout_cents, profit_cents);
-      settle_one_leg(stake_cents*0.5, price_b>1.0?price_b:price, cmp2, payout_cents, profit_cents);
-    } else {
-      settle_one_leg((double)stake_cents, price, cmp, payout_cents, profit_cents);
+    if(!so.feed){
+      fprintf(stderr,"required: --feed <file|fifo|->\n");
+      return 2;
     }
+    if(so.workers<1||so.workers>64||so.queue<1||so.batch<1||so.batch>5000||so.batch_ms<0||so.chunk_rows<1){
+      fprintf(stderr,"--workers 1..64, --queue >=1, --batch 1..5000, --batch-ms >=0, --chunk-rows >=1\n");
+      return 2;
+    }
+    MYSQL* conns[SHARD_MAX];
+    if (shards_open(c,conns)!=0) return 5;
+    int rc = settle_follow(conns, &g_shards, &so);
+    shards_close(c,conns);
+    return rc;
+  }
+  if (argc>=2 && !strcmp(argv[1],"correct")){
+    long event=0; int home=-1, away=-1;
+    static struct option o[]={{"event-id",1,0,'e'},{"home",1,0,'h'},{"away",1,0,'a'},{0,0,0,0}};
+    int ch,ix=0; optind=1;
+    while((ch=getopt_long(argc-1,argv+1,"e:h:a:",o,&ix))!=-1){
+      if(ch=='e') event=atol(optarg);
+      else if(ch=='h') home=atoi(optarg);
+      else if(ch=='a') away=atoi(optarg);
+      else return 2;
+    }
+    if(!event||home<0||away<0){
+      fprintf(stderr,"required: --event-id --home --away\n");
+      return 2;
+    }
+    settle_fan_t f; memset(&f,0,sizeof(f));
+    f.event=event; f.home=home; f.away=away;
+    int rc = each_shard(c, settle_correct_task, &f, f.rc);
+    if (rc) return rc;
+    gigam_correction_t cr = f.cr[0];
+    for (int i=1;i<g_shards.n;i++) {
+      cr.picks_changed += f.cr[i].picks_changed; cr.bets += f.cr[i].bets; cr.reopened += f.cr[i].reopened;
+      cr.payout_delta += f.cr[i].payout_delta; cr.profit_delta += f.cr[i].profit_delta; cr.commission_delta += f.cr[i].commission_delta;
+    }
+    printf("OK event %ld corrected %d-%d -> %d-%d\n", event, cr.old_home, cr.old_away, home, away);
+    printf("picks_changed\t%ld\nbets_adjusted\t%lld\nparlays_reopened\t%lld\n", cr.picks_changed, cr.bets, cr.reopened);
+    printf("payout_delta_usd\t%.2f\nprofit_delta_usd\t%.2f\ncommission_delta_usd\t%.2f\n",
+           cr.payout_delta/100.0, cr.profit_delta/100.0, cr.commission_delta/100.0);
+    return 0;
   }
-
-  if (*profit_cents > 0) *out_result="win";
-  else if (*profit_cents < 0) *out_result="lose";
-  else *out_result="push";
-  return 0;
-}
-
-static int cmd_settle(int argc, char** argv, MYSQL* c) {
   if (argc<2 || strcmp(argv[1],"event")!=0){
-    fprintf(stderr,"settle event --event-id X\n"); return 2;
+    fprintf(stderr,"settle event --event-id X | settle follow --feed FILE | settle correct --event-id X --home H --away A\n"); return 2;
   }
-  long event=0; static struct option o[]={{"event-id",1,0,'e'},{0,0,0,0}}; int ch,ix=0; optind=1;
-  while((ch=getopt_long(argc-1,argv+1,"e:",o,&ix))!=-1){
-    if(ch=='e') event=atol(optarg); else return 2;
+  long event=0, chunk=GIGAM_SCAN_CHUNK;
+  static struct option o[]={{"event-id",1,0,'e'},{"chunk-rows",1,0,'c'},{0,0,0,0}}; int ch,ix=0; optind=1;
+  while((ch=getopt_long(argc-1,argv+1,"e:c:",o,&ix))!=-1){
+    if(ch=='e') event=atol(optarg);
+    else if(ch=='c') chunk=atol(optarg);
+    else return 2;
   }
   if(!event){
     fprintf(stderr,"required: --event-id\n");
     return 2;
   }
-  int hs=0,as=0,fin=0;
-  if(get_event_scores(c,event,&hs,&as,&fin)!=0){
-    fprintf(stderr,"event not found\n");
-    return 5;
-  }
-  if(!fin){
-    fprintf(stderr,"event not final; use event set-score --final\n");
+  if(chunk<1){ fprintf(stderr,"--chunk-rows >= 1\n"); return 2; }
+  settle_fan_t f; memset(&f,0,sizeof(f));
+  f.event=event; f.chunk=chunk;
+  int rc = each_shard(c, settle_event_task, &f, f.rc);
+  if (rc) return rc;
+  printf("OK settled event %ld\n", event);
+  return 0;
+}
+
+/* ---------- REPORTS ---------- */
+
+static int report_from_snapshot(const char* path, const char* sub, const char* group, long bm,
+                                const char* from, const char* to, int threads,
+                                rf_format_t fmt, const char* out_path, const char* out_dir) {
+  bool all = !strcmp(sub,"all");
+  int kind = all ? 0 : rpt_kind_from(sub, group);
+  if (kind < 0) { fprintf(stderr,"unknown report subcommand\n"); return 2; }
+  int from_day=0, to_day=0;
+  if (rpt_parse_day(from,&from_day)!=0 || rpt_parse_day(to,&to_day)!=0) {
+    fprintf(stderr,"invalid --from/--to (YYYY-MM-DD)\n");
     return 2;
   }
+  snap_t s;
+  if (snap_open(path,&s)!=0) return 5;
+  rpt_agg_t agg; rpt_agg_init(&agg);
+  int rc = 5;
+  if (snap_aggregate(&s, bm, from_day, to_day, threads, &agg)==0) {
+    rc = all ? report_write_all(&agg, out_dir, fmt) : rpt_emit(&agg, (rpt_kind_t)kind, fmt, stdout, out_path);
+  }
+  rpt_agg_free(&agg);
+  snap_close(&s);
+  return rc;
+}
 
-  char qb[256];
-  snprintf(qb,sizeof(qb),
-    "SELECT id,market_type,pick_side,COALESCE(line,0),is_asian,COALESCE(line_b,0),price_decimal,COALESCE(price_decimal_b,0),stake_cents,runner_id "
-    "FROM bets WHERE event_id=%ld AND status='open'", event);
-  if (db_exec(c,qb)!=0) { return 5; }
-  MYSQL_RES* r = mysql_store_result(c); if(!r){ printf("No open bets.\n"); return 0; }
+/* "pnl,runner-commissions" -> kinds; --by applies to every pnl entry */
+static int parse_report_kinds(const char* list, const char* group, rpt_kind_t* kinds, int max) {
+  char buf[256]; snprintf(buf,sizeof(buf),"%s",list);
+  int n=0;
+  for (char* s=strtok(buf,","); s; s=strtok(NULL,",")) {
+    int k = rpt_kind_from(s, group);
+    if (k<0 || n>=max) return -1;
+    kinds[n++] = (rpt_kind_t)k;
+  }
+  return n;
+}
 
-  MYSQL_ROW row;
-  while((row=mysql_fetch_row(r))){
-    long bet_id=atol(row[0]); const char* market=row[1]; const char* side=row[2];
-    double line=atof(row[3]); int is_asian=atoi(row[4]); double line_b=atof(row[5]);
-    double price=atof(row[6]); double price_b=atof(row[7]); long long stake=atoll(row[8]); long runner_id=atol(row[9]);
-    long long payout=0, profit=0; const char* result="lose";
-    settle_compute(market,side,is_asian,line,line_b,price,price_b,stake,hs,as,&payout,&profit,&result);
-
-    char up[512];
-    snprintf(up,sizeof(up),
-      "UPDATE bets SET status='settled', result='%s', payout_cents=%lld, profit_cents=%lld, settled_at=NOW() WHERE id=%ld",
-      result, (long long)payout, (long long)profit, bet_id);
-    if (db_exec(c,up)!=0){ mysql_free_result(r); return 5; }
-
-    /* runner commission */
-    char qrc[512];
-    snprintf(qrc,sizeof(qrc),"SELECT commission_scheme,commission_rate FROM runners WHERE id=%ld", runner_id);
-    if (db_exec(c,qrc)!=0){ mysql_free_result(r); return 5; }
-    MYSQL_RES* rr = mysql_store_result(c);
-    if (rr){
-      MYSQL_ROW rw = mysql_fetch_row(rr);
-      if (rw){
-        const char* scheme=rw[0]?rw[0]:"net"; double rate=rw[1]?atof(rw[1]):10.0;
-        long long comm=0;
-        if (!strcmp(scheme,"handle")) {
-          comm = (long long)(stake*(rate/100.0)+0.5);
-        } else {
-          long long net_for_book = -profit;
-          long long base = net_for_book>0?net_for_book:0;
-          comm = (long long)(base*(rate/100.0)+0.5);
-        }
-        char insc[512];
-        snprintf(insc,sizeof(insc),
-          "INSERT IGNORE INTO runner_commissions(bet_id,runner_id,commission_cents,scheme,rate) VALUES(%ld,%ld,%lld,'%s',%.2f)",
-          bet_id, runner_id, (long long)comm, scheme, rate);
-        if (db_exec(c,insc)!=0){ mysql_free_result(rr); mysql_free_result(r); return 5; }
+static int cmp_id(const void* a, const void* b) {
+  long x = *(const long*)a, y = *(const long*)b;
+  return (x > y) - (x < y);
+}
+
+/* "3" | "1,2,5" | "all" (every row of bookmakers, over every shard: each
+ * one's own bookmakers); returns count or -1 */
+static int parse_bookmaker_ids(MYSQL* c, const char* list, long** out) {
+  *out = NULL;
+  if (!strcmp(list,"all")) {
+    if (!c) return -1;
+    MYSQL* conns[SHARD_MAX];
+    if (shards_open(c,conns)!=0) return -1;
+    long* ids = NULL; int n=0, rc=0;
+    for (int s=0;s<g_shards.n && !rc;s++) {
+      MYSQL_RES* r = db_exec(conns[s],"SELECT id FROM bookmakers ORDER BY id")==0 ? mysql_store_result(conns[s]) : NULL;
+      if (!r) { rc=-1; break; }
+      long* more = (long*)realloc(ids, ((size_t)n+(size_t)mysql_num_rows(r)+1)*sizeof(long));
+      if (!more) rc=-1;
+      else ids = more;
+      MYSQL_ROW row;
+      while (!rc && (row=mysql_fetch_row(r))) {
+        long id = atol(row[0]);
+        if (shard_of(&g_shards,id)==s) ids[n++] = id;
       }
-      mysql_free_result(rr);
+      mysql_free_result(r);
     }
+    shards_close(c,conns);
+    if (rc) { free(ids); return -1; }
+    if (g_shards.n>1) qsort(ids, (size_t)n, sizeof(long), cmp_id);
+    *out = ids; return n;
   }
-  mysql_free_result(r);
-  printf("OK settled event %ld\n", event);
-  return 0;
+  int cap = 1;
+  for (const char* p=list; *p; p++) if (*p==',') cap++;
+  long* ids = (long*)malloc((size_t)cap*sizeof(long));
+  if (!ids) return -1;
+  int n=0; const char* p=list;
+  while (*p) {
+    char* end; long v = strtol(p,&end,10);
+    if (end==p || v<=0 || (*end && *end!=',')) { free(ids); return -1; }
+    ids[n++] = v;
+    p = *end ? end+1 : end;
+  }
+  *out = ids; return n;
 }
 
-/* ---------- REPORTS ---------- */
-
 static int cmd_report(int argc, char** argv, MYSQL* c) {
   if (argc<2){
-    fprintf(stderr,"report pnl|runner-commissions|bettor-balances|runner-balances [--format table|json|csv] [--out <file>]\n");
+    fprintf(stderr,"report <kind>[,<kind>...]|all [--bookmaker-id N[,N...]|all] [--parallel N] [--chunk day|week] [--no-cache] [--format table|json|csv] [--out <file>] [--out-dir <dir>] [--snapshot <file> [--threads N]]\n"
+                   "  kinds: pnl runner-commissions bettor-balances runner-balances (clv: one at a time)\n");
     return 2;
   }
   const char* sub=argv[1]; optind=1;
 
-  long bm=0; const char* from=NULL; const char* to=NULL; const char* group=NULL;
+  const char* bm_list=NULL; const char* from=NULL; const char* to=NULL; const char* group=NULL;
   const char* out_path=NULL; rf_format_t fmt = RF_TABLE;
+  const char* snap_path=NULL; int threads=0; const char* out_dir=NULL; int parallel=4;
+  const char* chunk=NULL; bool no_cache=false;
 
   static struct option o[]={
     {"bookmaker-id",1,0,'b'},
@@ -986,230 +1349,532 @@ static int cmd_report(int argc, char** argv, MYSQL* c) {
     {"by",1,0,'g'},
     {"format",1,0,'F'},
     {"out",1,0,'O'},
+    {"snapshot",1,0,'S'},
+    {"threads",1,0,'T'},
+    {"out-dir",1,0,'D'},
+    {"parallel",1,0,'P'},
+    {"chunk",1,0,'C'},
+    {"no-cache",0,0,'N'},
     {0,0,0,0}
   };
   int ch,ix=0;
-  while((ch=getopt_long(argc-1,argv+1,"b:f:t:g:F:O:",o,&ix))!=-1){
-    if(ch=='b') bm=atol(optarg);
+  while((ch=getopt_long(argc-1,argv+1,"b:f:t:g:F:O:S:T:D:P:C:N",o,&ix))!=-1){
+    if(ch=='b') bm_list=optarg;
     else if(ch=='f') from=optarg;
     else if(ch=='t') to=optarg;
     else if(ch=='g') group=optarg;
     else if(ch=='F') fmt = rf_format_from_str(optarg);
     else if(ch=='O') out_path=optarg;
+    else if(ch=='S') snap_path=optarg;
+    else if(ch=='T') threads=atoi(optarg);
+    else if(ch=='D') out_dir=optarg;
+    else if(ch=='P') parallel=atoi(optarg);
+    else if(ch=='C') chunk=optarg;
+    else if(ch=='N') no_cache=true;
     else return 2;
   }
+  if(!bm_list||!from||!to){
+    fprintf(stderr,"required: --bookmaker-id --from YYYY-MM-DD --to YYYY-MM-DD\n");
+    return 2;
+  }
+  int d0, d1;
+  if (rpt_parse_day(from,&d0)!=0 || rpt_parse_day(to,&d1)!=0) {
+    fprintf(stderr,"--from/--to must be YYYY-MM-DD\n");
+    return 2;
+  }
+  if (parallel<1) parallel=1;
 
-  /* build query per subcommand and then print formatted */
-  if (!strcmp(sub,"pnl")) {
-    if(!bm||!from||!to){
-      fprintf(stderr,"required: --bookmaker-id --from YYYY-MM-DD --to YYYY-MM-DD\n");
+  /* clv: its own streaming engine, not an aggregate of the other kinds */
+  if (!strcmp(sub,"clv")) {
+    char* end; long cbm = strtol(bm_list,&end,10);
+    if (cbm<=0 || *end || snap_path || out_dir || chunk || (group && strcmp(group,"bettor") && strcmp(group,"runner"))) {
+      fprintf(stderr,"report clv: one --bookmaker-id, [--by bettor|runner], no --snapshot/--out-dir/--chunk\n");
       return 2;
     }
-    char q[1024];
-    if (group && !strcmp(group,"runner")) {
-      snprintf(q,sizeof(q),
-        "SELECT r.id AS runner_id, r.name, COUNT(b.id) AS bets, ROUND(SUM(b.stake_cents)/100,2) AS handle_usd, ROUND(SUM(COALESCE(b.profit_cents,0))/100,2) AS profit_usd "
-        "FROM bets b JOIN runners r ON r.id=b.runner_id "
-        "WHERE b.bookmaker_id=%ld AND b.status='settled' AND b.settled_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND b.settled_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY) "
-        "GROUP BY r.id,r.name ORDER BY profit_usd DESC", bm, from, to);
-    } else if (group && !strcmp(group,"bettor")) {
-      snprintf(q,sizeof(q),
-        "SELECT bt.id AS bettor_id, bt.code, COUNT(b.id) AS bets, ROUND(SUM(b.stake_cents)/100,2) AS handle_usd, ROUND(SUM(COALESCE(b.profit_cents,0))/100,2) AS profit_usd "
-        "FROM bets b JOIN bettors bt ON bt.id=b.bettor_id "
-        "WHERE b.bookmaker_id=%ld AND b.status='settled' AND b.settled_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND b.settled_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY) "
-        "GROUP BY bt.id,bt.code ORDER BY profit_usd ASC", bm, from, to);
-    } else {
-      snprintf(q,sizeof(q),
-        "SELECT COUNT(id) AS bets, ROUND(SUM(stake_cents)/100,2) AS handle_usd, ROUND(SUM(COALESCE(profit_cents,0))/100,2) AS profit_usd "
-        "FROM bets WHERE bookmaker_id=%ld AND status='settled' AND settled_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND settled_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY)",
-        bm, from, to);
-    }
-    if (db_exec(c,q)!=0) { return 5; }
-    MYSQL_RES* r = mysql_store_result(c);
-    if (r) {
-      int rc = print_formatted(r, fmt, out_path);
-      mysql_free_result(r);
-      return rc;
-    }
-    return 0;
+    db_config_t cfg; db_load_env(&cfg);
+    return report_clv(c, &cfg, cbm, from, to, group, fmt, out_path);
+  }
+
+  rpt_kind_t kinds[RPT_KIND_COUNT]; int nkinds=0;
+  if (strcmp(sub,"all")) {
+    nkinds = parse_report_kinds(sub, group, kinds, (int)RPT_KIND_COUNT);
+    if (nkinds<=0) { fprintf(stderr,"unknown report subcommand\n"); return 2; }
+  }
+  long* bms=NULL;
+  int nbm = parse_bookmaker_ids(c, bm_list, &bms);
+  if (nbm<0) {
+    if (!strcmp(bm_list,"all") && c) return 5;
+    fprintf(stderr,"--bookmaker-id must be N, N,N,... or all\n");
+    return 2;
+  }
+  if (nbm==0) { free(bms); return 0; }
+  long bm = bms[0];
+  bool single = nbm==1 && nkinds<=1;
+  for (int b=0;b<nbm;b++) {
+    if (shard_of(&g_shards,bms[b])<0) { fprintf(stderr,"bookmaker %ld is on no shard\n", bms[b]); free(bms); return 2; }
+  }
+  /* one bookmaker ("all" with just one): its shard's connection */
+  if (nbm==1 && c && !(c = shard_switch(c, shard_of(&g_shards,bm)))) { free(bms); return 5; }
+
+  if (!strcmp(sub,"all") && (nbm!=1||!out_dir)) {
+    free(bms);
+    fprintf(stderr,"report all: required: one --bookmaker-id and --out-dir <dir>\n");
+    return 2;
+  }
+  if (!single && strcmp(sub,"all") && (snap_path||out_path)) {
+    free(bms);
+    fprintf(stderr,"several reports: use --out-dir instead of --out; --snapshot takes one report\n");
+    return 2;
   }
 
-  if (!strcmp(sub,"runner-commissions")) {
-    if(!bm||!from||!to){
-      fprintf(stderr,"required: --bookmaker-id --from --to\n");
+  int chunk_days = 0;
+  if (chunk) {
+    if (!strcmp(chunk,"day")) chunk_days=1;
+    else if (!strcmp(chunk,"week")) chunk_days=7;
+    if (!chunk_days || nbm!=1 || snap_path) {
+      free(bms);
+      fprintf(stderr,"--chunk day|week: one --bookmaker-id, not with --snapshot\n");
       return 2;
     }
-    char q[1024];
-    snprintf(q,sizeof(q),
-      "SELECT r.id AS runner_id, r.name, ROUND(SUM(rc.commission_cents)/100,2) AS commissions_usd, COUNT(rc.id) AS items "
-      "FROM runner_commissions rc JOIN bets b ON b.id=rc.bet_id JOIN runners r ON r.id=rc.runner_id "
-      "WHERE b.bookmaker_id=%ld AND b.settled_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND b.settled_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY) "
-      "GROUP BY r.id,r.name ORDER BY commissions_usd DESC", bm, from, to);
-    if (db_exec(c,q)!=0) { return 5; }
-    MYSQL_RES* r = mysql_store_result(c);
-    if (r) {
-      int rc = print_formatted(r, fmt, out_path);
-      mysql_free_result(r);
-      return rc;
-    }
-    return 0;
   }
 
-  if (!strcmp(sub,"bettor-balances")) {
-    if(!bm||!from||!to){
-      fprintf(stderr,"required: --bookmaker-id --from --to\n");
-      return 2;
+  /* offline path: same reports computed from a snapshot file, no DB */
+  if (snap_path) {
+    free(bms);
+    return report_from_snapshot(snap_path, sub, group, bm, from, to, threads, fmt, out_path, out_dir);
+  }
+  if (!c) { free(bms); fprintf(stderr,"DB connect failed\n"); return 5; }
+
+  /* long ranges: parallel per-chunk partial sums merged on the client */
+  if (chunk_days) {
+    free(bms);
+    db_config_t cfg; db_load_env(&cfg);
+    rpt_agg_t agg; rpt_agg_init(&agg);
+    int rc = 5;
+    if (report_scan_chunked(&cfg, bm, d0, d1, chunk_days, parallel, &agg)==0 && report_load_names(c,&agg)==0) {
+      if (!strcmp(sub,"all")) {
+        rc = report_write_all(&agg, out_dir, fmt);
+      } else if (nkinds==1) {
+        rc = rpt_emit(&agg, kinds[0], fmt, stdout, out_path);
+      } else {
+        const char* ext = fmt==RF_JSON ? "json" : (fmt==RF_CSV ? "csv" : "txt");
+        rc = 0;
+        for (int k=0;k<nkinds && rc==0;k++) {
+          if (!out_dir) {
+            printf("# report=%s bookmaker_id=%ld\n", rpt_kind_name(kinds[k]), bm);
+            rc = rpt_emit(&agg, kinds[k], fmt, stdout, NULL);
+            continue;
+          }
+          char path[1024];
+          snprintf(path,sizeof(path),"%s/%s_bm%ld.%s", out_dir, rpt_kind_name(kinds[k]), bm, ext);
+          FILE* f = fopen(path,"wb");
+          if (!f) { fprintf(stderr,"report: unable to open output file: %s\n", path); rc=1; break; }
+          rc = rpt_emit(&agg, kinds[k], fmt, f, NULL);
+          if (fclose(f)!=0 && rc==0) rc=1;
+        }
+      }
     }
-    char q[1024];
-    snprintf(q,sizeof(q),
-      "SELECT bt.id AS bettor_id, bt.code, ROUND(-SUM(COALESCE(b.profit_cents,0))/100,2) AS owed_gross_usd, "
-      "ROUND(COALESCE((SELECT SUM(pr.amount_cents) FROM payouts_bettor pr WHERE pr.bettor_id=bt.id AND pr.created_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND pr.created_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY)),0)/100,2) AS paid_usd, "
-      "ROUND((-SUM(COALESCE(b.profit_cents,0)) - COALESCE((SELECT SUM(pr.amount_cents) FROM payouts_bettor pr WHERE pr.bettor_id=bt.id AND pr.created_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND pr.created_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY)),0))/100,2) AS balance_usd "
-      "FROM bets b JOIN bettors bt ON bt.id=b.bettor_id "
-      "WHERE b.bookmaker_id=%ld AND b.status='settled' AND b.settled_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND b.settled_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY) "
-      "GROUP BY bt.id,bt.code ORDER BY balance_usd DESC", from,to, from,to, bm, from,to);
-    if (db_exec(c,q)!=0) { return 5; }
-    MYSQL_RES* r = mysql_store_result(c);
-    if (r) {
-      int rc = print_formatted(r, fmt, out_path);
-      mysql_free_result(r);
-      return rc;
+    rpt_agg_free(&agg);
+    return rc;
+  }
+
+  /* every report from one scan of the range, one file per report */
+  if (!strcmp(sub,"all")) {
+    free(bms);
+    rpt_agg_t agg; rpt_agg_init(&agg);
+    int rc = 5;
+    if (report_scan_all(c, bm, from, to, &agg)==0) {
+      rc = report_write_all(&agg, out_dir, fmt);
+      if (rc==0) printf("OK wrote %d reports to %s\n", (int)RPT_KIND_COUNT, out_dir);
     }
-    return 0;
+    rpt_agg_free(&agg);
+    return rc;
   }
 
-  if (!strcmp(sub,"runner-balances")) {
-    if(!bm||!from||!to){
-      fprintf(stderr,"required: --bookmaker-id --from --to\n");
-      return 2;
+  /* one report: run it on this connection, through the result cache */
+  if (single) {
+    free(bms);
+    if (!no_cache) {
+      db_config_t cfg; db_load_env(&cfg);
+      return report_run_cached(c, &cfg, kinds[0], bm, from, to, fmt, out_path);
     }
-    char q[1024];
-    snprintf(q,sizeof(q),
-      "SELECT r.id AS runner_id, r.name, "
-      "ROUND(COALESCE(SUM(rc.commission_cents),0)/100,2) AS commissions_usd, "
-      "ROUND(COALESCE((SELECT SUM(pr.amount_cents) FROM payouts_runner pr WHERE pr.runner_id=r.id AND pr.created_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND pr.created_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY)),0)/100,2) AS paid_usd, "
-      "ROUND((COALESCE(SUM(rc.commission_cents),0) - COALESCE((SELECT SUM(pr.amount_cents) FROM payouts_runner pr WHERE pr.runner_id=r.id AND pr.created_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND pr.created_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY)),0))/100,2) AS balance_usd "
-      "FROM runners r LEFT JOIN runner_commissions rc ON rc.runner_id=r.id LEFT JOIN bets b ON b.id=rc.bet_id "
-      "WHERE b.bookmaker_id=%ld AND b.settled_at>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND b.settled_at<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY) "
-      "GROUP BY r.id,r.name ORDER BY balance_usd DESC", from,to, from,to, bm, from,to);
+    rcache_count("bypass");
+    char q[4096];
+    report_sql(kinds[0], bm, from, to, q, sizeof(q));
     if (db_exec(c,q)!=0) { return 5; }
     MYSQL_RES* r = mysql_store_result(c);
     if (r) {
-      int rc = print_formatted(r, fmt, out_path);
+      int rc = report_print(r, fmt, stdout, out_path);
       mysql_free_result(r);
       return rc;
     }
     return 0;
   }
 
-  fprintf(stderr,"unknown report subcommand\n");
+  /* kinds x bookmakers: independent queries over a pool of connections */
+  size_t njobs = (size_t)nkinds * (size_t)nbm;
+  report_job_t* jobs = (report_job_t*)malloc(njobs*sizeof(report_job_t));
+  if (!jobs) { free(bms); return 5; }
+  size_t j=0;
+  for (int b=0;b<nbm;b++) for (int k=0;k<nkinds;k++) {
+    jobs[j].kind=kinds[k]; jobs[j].bm=bms[b]; jobs[j].shard=shard_of(&g_shards,bms[b]); j++;
+  }
+  free(bms);
+  if ((size_t)parallel > njobs) parallel = (int)njobs;
+
+  /* --parallel connections per shard, every shard at once */
+  db_config_t cfgs[SHARD_MAX];
+  for (int i=0;i<g_shards.n;i++) cfgs[i] = g_shards.s[i].cfg;
+  int rc = report_run_jobs(cfgs, g_shards.n, jobs, njobs, parallel, from, to, fmt, out_dir);
+  if (rc==0 && out_dir) printf("OK wrote %zu reports to %s\n", njobs, out_dir);
+  free(jobs);
+  return rc;
+}
+
+static int cmd_snapshot(int argc, char** argv, MYSQL* c) {
+  long bm=0; const char* from=NULL; const char* to=NULL; const char* out=NULL;
+  static struct option o[]={{"out",1,0,'O'},{"bookmaker-id",1,0,'b'},{"from",1,0,'f'},{"to",1,0,'t'},{0,0,0,0}};
+  int ch,ix=0; optind=1;
+  while((ch=getopt_long(argc,argv,"O:b:f:t:",o,&ix))!=-1){
+    if(ch=='O') out=optarg;
+    else if(ch=='b') bm=atol(optarg);
+    else if(ch=='f') from=optarg;
+    else if(ch=='t') to=optarg;
+    else return 2;
+  }
+  if(!out || (!from)!=(!to)){
+    fprintf(stderr,"required: --out <file> [--bookmaker-id] [--from YYYY-MM-DD --to YYYY-MM-DD]\n");
+    return 2;
+  }
+  int d=0;
+  if (from && (rpt_parse_day(from,&d)!=0 || rpt_parse_day(to,&d)!=0)) {
+    fprintf(stderr,"invalid --from/--to (YYYY-MM-DD)\n");
+    return 2;
+  }
+  snap_scope_t scope = { bm, from, to };
+  snap_stats_t st; memset(&st,0,sizeof(st));
+  if (snap_write(c,&scope,out,&st)!=0) { fprintf(stderr,"snapshot failed\n"); return 5; }
+  printf("OK snapshot %s: %llu bets, %llu commissions, %llu bettor payouts, %llu runner payouts\n", out,
+    (unsigned long long)st.rows[SNAP_BETS], (unsigned long long)st.rows[SNAP_COMMISSIONS],
+    (unsigned long long)st.rows[SNAP_BETTOR_PAYOUTS], (unsigned long long)st.rows[SNAP_RUNNER_PAYOUTS]);
+  return 0;
+}
+
+/* ---------- CACHE ---------- */
+
+static int cmd_cache(int argc, char** argv) {
+  if (argc<2){ fprintf(stderr,"cache stats|clear\n"); return 2; }
+  if (!strcmp(argv[1],"stats")) return rcache_stats(stdout);
+  if (!strcmp(argv[1],"clear")) return rcache_clear();
+  fprintf(stderr,"cache stats|clear\n");
   return 2;
 }
 
-/* ---------- RISK ---------- */
+/* ---------- JOURNAL ---------- */
+
+static int cmd_journal(int argc, char** argv, MYSQL* c) {
+  if (argc<2){ fprintf(stderr,"journal status|replay --dir <dir>\n"); return 2; }
+  const char* sub=argv[1]; const char* dir=NULL;
+  static struct option o[]={{"dir",1,0,'d'},{0,0,0,0}}; int ch,ix=0; optind=1;
+  while((ch=getopt_long(argc-1,argv+1,"d:",o,&ix))!=-1){
+    if(ch=='d') dir=optarg; else return 2;
+  }
+  if(!dir){ fprintf(stderr,"required: --dir\n"); return 2; }
+
+  if (!strcmp(sub,"status")) {
+    gigam_journal_stats_t st;
+    if (gigam_journal_peek(dir,&st)!=GIGAM_OK){ fprintf(stderr,"journal: no journal in %s\n",dir); return 1; }
+    printf("dir\t%s\n", dir);
+    printf("bytes\t%lld\n", st.size);
+    printf("applied_offset\t%lld\n", st.applied_offset);
+    printf("pending\t%lld\n", st.pending);
+    printf("rejected\t%llu\n", st.rejected);
+    return 0;
+  }
+
+  if (!strcmp(sub,"replay")) {
+    char err[512];
+    gigam_journal_t* j = gigam_journal_open(dir, GIGAM_FSYNC_ALWAYS, err, sizeof(err));
+    if (!j) { fprintf(stderr,"%s\n",err); return 1; }
+    gigam_ctx_t* g = gigam_wrap(c);
+    if (!g) { gigam_journal_close(j); return 5; }
+    int rc = GIGAM_OK; long n = 0;
+    do rc = gigam_journal_flush(g, j, 1000, &n); while (rc==GIGAM_OK && n>0);
+    gigam_journal_stats_t st; gigam_journal_stats(j,&st);
+    if (rc!=GIGAM_OK) fprintf(stderr,"%s\n",gigam_journal_errmsg(j));
+    else printf("OK replayed %llu bets (%llu rejected, see %s/rejected.log)\n", st.applied, st.rejected, dir);
+    gigam_close(g);
+    gigam_journal_close(j);
+    return rc;
+  }
+
+  fprintf(stderr,"journal status|replay --dir <dir>\n");
+  return 2;
+}
+
+/* ---------- LEDGER ---------- */
+
+static int cmd_ledger(int argc, char** argv, MYSQL* c) {
+  if (argc<2){
+    fprintf(stderr,"ledger balance --bettor-id N|--runner-id N | ledger period --bookmaker-id N --from D --to D [--runners] | ledger verify [--parallel N]\n");
+    return 2;
+  }
+  const char* sub=argv[1]; optind=1;
+  long bettor=0, runner=0, bm=0; int parallel=4; bool runners=false;
+  const char* from=NULL; const char* to=NULL; const char* out=NULL; rf_format_t fmt=RF_TABLE;
+  static struct option o[]={{"bettor-id",1,0,'b'},{"runner-id",1,0,'r'},{"parallel",1,0,'p'},{"bookmaker-id",1,0,'k'},
+    {"from",1,0,'f'},{"to",1,0,'t'},{"runners",0,0,'R'},{"format",1,0,'F'},{"out",1,0,'O'},{0,0,0,0}};
+  int ch,ix=0;
+  while((ch=getopt_long(argc-1,argv+1,"b:r:p:k:f:t:RF:O:",o,&ix))!=-1){
+    if(ch=='b') bettor=atol(optarg);
+    else if(ch=='r') runner=atol(optarg);
+    else if(ch=='p') parallel=atoi(optarg);
+    else if(ch=='k') bm=atol(optarg);
+    else if(ch=='f') from=optarg;
+    else if(ch=='t') to=optarg;
+    else if(ch=='R') runners=true;
+    else if(ch=='F') fmt=rf_format_from_str(optarg);
+    else if(ch=='O') out=optarg;
+    else return 2;
+  }
 
-static long long risk_delta(long long stake_cents, double price, int cmp) {
-  if (cmp > 0) {
-    long long loss = (long long)(stake_cents * (price - 1.0) + 0.5);
-    return -loss;
-  } else if (cmp == 0) {
+  if (!strcmp(sub,"balance")) {
+    if ((bettor>0)==(runner>0)) { fprintf(stderr,"required: --bettor-id N or --runner-id N\n"); return 2; }
+    ledger_kind_t kind = bettor ? LEDGER_BETTOR : LEDGER_RUNNER;
+    long owner = bettor ? bettor : runner;
+    long long bal, n;
+    if (ledger_balance(c,kind,owner,&bal,&n)!=0) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); return 5; }
+    printf("account\t%s %ld\n", bettor ? "bettor" : "runner", owner);
+    printf("balance_usd\t%.2f\n", bal/100.0);
+    printf("entries\t%lld\n", n);
     return 0;
-  } else {
-    return stake_cents;
   }
+
+  if (!strcmp(sub,"period")) {
+    int d0, d1;
+    if (bm<=0 || !from || !to) { fprintf(stderr,"required: --bookmaker-id --from YYYY-MM-DD --to YYYY-MM-DD\n"); return 2; }
+    if (rpt_parse_day(from,&d0)!=0 || rpt_parse_day(to,&d1)!=0) { fprintf(stderr,"--from/--to must be YYYY-MM-DD\n"); return 2; }
+    if (shard_of(&g_shards,bm)<0) { fprintf(stderr,"bookmaker %ld is on no shard\n", bm); return 2; }
+    if (!(c = shard_switch(c, shard_of(&g_shards,bm)))) return 5;
+    char q[2048];
+    ledger_period_sql(runners ? LEDGER_RUNNER : LEDGER_BETTOR, bm, from, to, q, sizeof(q));
+    if (db_exec(c,q)!=0) return 5;
+    MYSQL_RES* r = mysql_store_result(c);
+    if (!r) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); return 5; }
+    int rc = report_print(r, fmt, stdout, out);
+    mysql_free_result(r);
+    return rc;
+  }
+
+  if (!strcmp(sub,"verify")) {
+    if (parallel<1 || parallel>64) { fprintf(stderr,"--parallel must be 1..64\n"); return 2; }
+    db_config_t cfg; db_load_env(&cfg);
+    ledger_verify_t res;
+    if (ledger_verify(&cfg,parallel,stdout,&res)!=0) return 5;
+    fprintf(stderr,"ledger: %ld accounts, %ld drifted, %ld unbalanced books\n", res.accounts, res.drift, res.unbalanced);
+    return res.drift || res.unbalanced ? 1 : 0;
+  }
+
+  fprintf(stderr,"ledger balance|period|verify\n");
+  return 2;
+}
+
+/* ---------- RISK ---------- */
+
+/* risk list on every shard; the grids add up */
+typedef struct {
+  long event, chunk;
+  gigam_exposure_t ex[SHARD_MAX];
+  int rc[SHARD_MAX];
+} risk_fan_t;
+
+static int risk_event_task(MYSQL* c, size_t s, void* ud) {
+  risk_fan_t* f = (risk_fan_t*)ud;
+  gigam_ctx_t* g = gigam_wrap(c); if (!g) return f->rc[s] = 5;
+  gigam_set_scan_chunk(g, f->chunk);
+  return f->rc[s] = gigam_done(g, gigam_risk_event(g, f->event, &f->ex[s]));
 }
 
 static int cmd_risk(int argc, char** argv, MYSQL* c) {
+  if (argc>=2 && !strcmp(argv[1],"parlays")){
+    long bm=0; static struct option o[]={{"bookmaker-id",1,0,'b'},{0,0,0,0}}; int ch,ix=0; optind=1;
+    while((ch=getopt_long(argc-1,argv+1,"b:",o,&ix))!=-1){
+      if(ch=='b') bm=atol(optarg); else return 2;
+    }
+    gigam_parlay_risk_t pr;
+    gigam_ctx_t* g = gigam_wrap(c); if (!g) return 5;
+    int rc = gigam_done(g, gigam_risk_parlays(g, bm, &pr));
+    if (rc) return rc;
+
+    printf("Metric\tValue\n");
+    printf("parlays\t%ld\n", pr.parlays);
+    printf("open_legs\t%ld\n", pr.legs);
+    printf("events\t%ld\n", pr.events);
+    printf("components\t%ld\n", pr.components);
+    printf("scenarios\t%.4g\n", pr.scenarios);
+    printf("nodes\t%lld\n", pr.nodes);
+    printf("stake_usd\t%.2f\n", pr.stake_cents/100.0);
+    printf("worst_usd\t%.2f\n", pr.worst/100.0);
+    printf("worst_bound_usd\t%.2f\n", pr.worst_bound/100.0);
+    printf("cut_components\t%ld\n", pr.cut);
+    printf("worst_scenario\t%s\n", pr.worst_desc[0] ? pr.worst_desc : "-");
+    return 0;
+  }
+  if (argc>=2 && !strcmp(argv[1],"mtm")){
+    mtm_opts_t mo = { 0, 0, MTM_BY_EVENT }; bool all=false;
+    const char* by=NULL; const char* out=NULL; rf_format_t fmt=RF_TABLE;
+    static struct option o[]={{"event-id",1,0,'e'},{"all",0,0,'A'},{"bookmaker-id",1,0,'b'},{"by",1,0,'g'},{"format",1,0,'F'},{"out",1,0,'O'},{0,0,0,0}};
+    int ch,ix=0; optind=1;
+    while((ch=getopt_long(argc-1,argv+1,"e:Ab:g:F:O:",o,&ix))!=-1){
+      if(ch=='e') mo.event_id=atol(optarg);
+      else if(ch=='A') all=true;
+      else if(ch=='b') mo.bookmaker_id=atol(optarg);
+      else if(ch=='g') by=optarg;
+      else if(ch=='F') fmt=rf_format_from_str(optarg);
+      else if(ch=='O') out=optarg;
+      else return 2;
+    }
+    if ((mo.event_id>0)==all) { fprintf(stderr,"required: --event-id N or --all\n"); return 2; }
+    if (by) {
+      if (!strcmp(by,"event")) mo.by=MTM_BY_EVENT;
+      else if (!strcmp(by,"runner")) mo.by=MTM_BY_RUNNER;
+      else if (!strcmp(by,"bettor")) mo.by=MTM_BY_BETTOR;
+      else { fprintf(stderr,"--by event|runner|bettor\n"); return 2; }
+    }
+    if (!mo.bookmaker_id && g_shards.n>1) {
+      db_config_t cfgs[SHARD_MAX];
+      for (int i=0;i<g_shards.n;i++) cfgs[i] = g_shards.s[i].cfg;
+      return mtm_run_sharded(cfgs,g_shards.n,&mo,fmt,out);
+    }
+    return mtm_run(c,&mo,fmt,out);
+  }
+  if (argc>=2 && !strcmp(argv[1],"velocity")){
+    velocity_opts_t vo = { 0, 86400, 300, 20, 0, 0, 0, 10, 3 };
+    const char* out=NULL; rf_format_t fmt=RF_TABLE;
+    static struct option o[]={{"bookmaker-id",1,0,'b'},{"window",1,0,'w'},{"since",1,0,'s'},{"max-bets",1,0,'n'},
+      {"max-stake-cents",1,0,'k'},{"runner-max-bets",1,0,'N'},{"runner-max-stake-cents",1,0,'K'},
+      {"follow-secs",1,0,'f'},{"follow-min",1,0,'m'},{"format",1,0,'F'},{"out",1,0,'O'},{0,0,0,0}};
+    int ch,ix=0; optind=1;
+    while((ch=getopt_long(argc-1,argv+1,"b:w:s:n:k:N:K:f:m:F:O:",o,&ix))!=-1){
+      if(ch=='b') vo.bookmaker_id=atol(optarg);
+      else if(ch=='w'||ch=='s'){
+        long v=board_parse_window(optarg);
+        if(v<0){ fprintf(stderr,"--%s: N[m|h|d] (seconds without a unit)\n", ch=='w'?"window":"since"); return 2; }
+        if(ch=='w') vo.window_s=v; else vo.since_s=v;
+      }
+      else if(ch=='n') vo.max_bets=atol(optarg);
+      else if(ch=='k') vo.max_stake_cents=atoll(optarg);
+      else if(ch=='N') vo.runner_max_bets=atol(optarg);
+      else if(ch=='K') vo.runner_max_stake_cents=atoll(optarg);
+      else if(ch=='f') vo.follow_s=atol(optarg);
+      else if(ch=='m') vo.follow_min=atol(optarg);
+      else if(ch=='F') fmt=rf_format_from_str(optarg);
+      else if(ch=='O') out=optarg;
+      else return 2;
+    }
+    if(!vo.bookmaker_id){ fprintf(stderr,"required: --bookmaker-id\n"); return 2; }
+    if(vo.max_bets<0||vo.max_stake_cents<0||vo.runner_max_bets<0||vo.runner_max_stake_cents<0||vo.follow_s<0||vo.follow_min<1){
+      fprintf(stderr,"thresholds must be >= 0 (0 = off), --follow-min >= 1\n"); return 2;
+    }
+    return velocity_run(c,&vo,fmt,out);
+  }
   if (argc<2 || strcmp(argv[1],"list")!=0){
-    fprintf(stderr,"risk list --event-id X\n"); return 2;
+    fprintf(stderr,"risk list --event-id X | risk parlays [--bookmaker-id N] | risk mtm --event-id X|--all | risk velocity --bookmaker-id N\n"); return 2;
   }
-  long event=0; static struct option o[]={{"event-id",1,0,'e'},{0,0,0,0}}; int ch,ix=0; optind=1;
-  while((ch=getopt_long(argc-1,argv+1,"e:",o,&ix))!=-1){
-    if(ch=='e') event=atol(optarg); else return 2;
+  long event=0, chunk=GIGAM_SCAN_CHUNK;
+  static struct option o[]={{"event-id",1,0,'e'},{"chunk-rows",1,0,'c'},{0,0,0,0}}; int ch,ix=0; optind=1;
+  while((ch=getopt_long(argc-1,argv+1,"e:c:",o,&ix))!=-1){
+    if(ch=='e') event=atol(optarg);
+    else if(ch=='c') chunk=atol(optarg);
+    else return 2;
   }
   if(!event){
     fprintf(stderr,"required: --event-id\n");
     return 2;
   }
-
-  const char* qf =
-    "SELECT market_type,pick_side,COALESCE(line,0),is_asian,COALESCE(line_b,0),price_decimal,COALESCE(price_decimal_b,0),stake_cents "
-    "FROM bets WHERE event_id=%ld AND status='open'";
-  char qb[256]; snprintf(qb,sizeof(qb), qf, event);
-  if (db_exec(c,qb)!=0) { return 5; }
-  MYSQL_RES* r = mysql_store_result(c); if(!r){
-    printf("Scenario\tExposure_USD\n");
-    return 0;
-  }
-
-  long long ex_HOME=0, ex_AWAY=0, ex_DRAW=0, ex_OVER=0, ex_UNDER=0;
-  MYSQL_ROW row;
-  while((row=mysql_fetch_row(r))){
-    const char* market=row[0]; const char* side=row[1];
-    double line=atof(row[2]); int is_asian=atoi(row[3]); double line_b=atof(row[4]);
-    double price=atof(row[5]); double price_b=atof(row[6]); long long stake=atoll(row[7]);
-    (void)line_b; /* not used for exposure computation */
-
-    if (!strcmp(market,"moneyline")||!strcmp(market,"threeway")) {
-      int cmp_home = (!strcmp(side,"HOME"))? 1 : (!strcmp(side,"AWAY")? -1 : 0);
-      int cmp_away = (!strcmp(side,"AWAY"))? 1 : (!strcmp(side,"HOME")? -1 : 0);
-      int cmp_draw = (!strcmp(market,"threeway") && !strcmp(side,"DRAW")) ? 1 : -1;
-      ex_HOME += risk_delta(stake, price, cmp_home);
-      ex_AWAY += risk_delta(stake, price, cmp_away);
-      if (!strcmp(market,"threeway")) ex_DRAW += risk_delta(stake, price, cmp_draw);
-    } else if (!strcmp(market,"spread")) {
-      if (!strcmp(side,"HOME")) {
-        if (is_asian && (line-(int)line!=0.0)) {
-          ex_HOME += risk_delta(stake/2, price,  1) + risk_delta(stake/2, (price_b>1.0?price_b:price),  1);
-          ex_AWAY += risk_delta(stake/2, price, -1) + risk_delta(stake/2, (price_b>1.0?price_b:price), -1);
-        } else {
-          ex_HOME += risk_delta(stake, price,  1);
-          ex_AWAY += risk_delta(stake, price, -1);
-        }
-      } else {
-        if (is_asian && (line-(int)line!=0.0)) {
-          ex_AWAY += risk_delta(stake/2, price,  1) + risk_delta(stake/2, (price_b>1.0?price_b:price),  1);
-          ex_HOME += risk_delta(stake/2, price, -1) + risk_delta(stake/2, (price_b>1.0?price_b:price), -1);
-        } else {
-          ex_AWAY += risk_delta(stake, price,  1);
-          ex_HOME += risk_delta(stake, price, -1);
-        }
-      }
-    } else if (!strcmp(market,"total")) {
-      if (is_asian && (line-(int)line!=0.0)) {
-        int cmp_over  = (!strcmp(side,"OVER"))  ? 1 : -1;
-        int cmp_under = (!strcmp(side,"UNDER")) ? 1 : -1;
-        ex_OVER  += risk_delta(stake/2, price, cmp_over) + risk_delta(stake/2, (price_b>1.0?price_b:price), cmp_over);
-        ex_UNDER += risk_delta(stake/2, price, cmp_under) + risk_delta(stake/2, (price_b>1.0?price_b:price), cmp_under);
-      } else {
-        int cmp_over  = (!strcmp(side,"OVER"))  ? 1 : -1;
-        int cmp_under = (!strcmp(side,"UNDER")) ? 1 : -1;
-        ex_OVER  += risk_delta(stake, price, cmp_over);
-        ex_UNDER += risk_delta(stake, price, cmp_under);
-      }
+  if(chunk<1){ fprintf(stderr,"--chunk-rows >= 1\n"); return 2; }
+
+  risk_fan_t* f = (risk_fan_t*)calloc(1,sizeof(risk_fan_t));
+  if (!f) return 5;
+  f->event=event; f->chunk=chunk;
+  int rc = each_shard(c, risk_event_task, f, f->rc);
+  gigam_exposure_t ex = f->ex[0];
+  if (!rc && g_shards.n>1) {
+    for (int i=1;i<g_shards.n;i++) {
+      for (int h=0;h<GIGAM_RISK_GOALS;h++) for (int a=0;a<GIGAM_RISK_GOALS;a++) ex.grid[h][a] += f->ex[i].grid[h][a];
     }
+    gigam_exposure_scenarios(&ex);
   }
-  mysql_free_result(r);
+  free(f);
+  if (rc) return rc;
 
   printf("Scenario\tExposure_USD\n");
-  printf("HOME_wins\t%.2f\n",  ex_HOME/100.0);
-  printf("AWAY_wins\t%.2f\n",  ex_AWAY/100.0);
-  printf("DRAW\t%.2f\n",       ex_DRAW/100.0);
-  printf("OVER\t%.2f\n",       ex_OVER/100.0);
-  printf("UNDER\t%.2f\n",      ex_UNDER/100.0);
+  printf("HOME_wins\t%.2f\n",  ex.home/100.0);
+  printf("AWAY_wins\t%.2f\n",  ex.away/100.0);
+  printf("DRAW\t%.2f\n",       ex.draw/100.0);
+  printf("OVER\t%.2f\n",       ex.over/100.0);
+  printf("UNDER\t%.2f\n",      ex.under/100.0);
+  printf("WORST_%d-%d\t%.2f\n", ex.worst_home, ex.worst_away, ex.worst/100.0);
   return 0;
 }
 
+/* ---------- REPLAY ---------- */
+
+static int cmd_replay(int argc, char** argv) {
+  replay_opts_t ro = { NULL, 1.0, 8 };
+  rf_format_t fmt=RF_TABLE; const char* out=NULL;
+  static struct option o[]={{"file",1,0,'f'},{"speed",1,0,'s'},{"concurrency",1,0,'c'},{"format",1,0,'F'},{"out",1,0,'O'},{0,0,0,0}};
+  int ch,ix=0; optind=1;
+  while((ch=getopt_long(argc,argv,"f:s:c:F:O:",o,&ix))!=-1){
+    if(ch=='f') ro.file=optarg;
+    else if(ch=='s'){
+      char* end; ro.speed = strcmp(optarg,"max") ? strtod(optarg,&end) : 0;
+      if(strcmp(optarg,"max") && (end==optarg || (*end && strcmp(end,"x")) || ro.speed<=0)){
+        fprintf(stderr,"--speed: Nx (2x = twice as fast as recorded) or max\n"); return 2;
+      }
+    }
+    else if(ch=='c') ro.concurrency=atoi(optarg);
+    else if(ch=='F') fmt=rf_format_from_str(optarg);
+    else if(ch=='O') out=optarg;
+    else return 2;
+  }
+  if(!ro.file && optind<argc) ro.file=argv[optind];
+  if(!ro.file||ro.concurrency<1){
+    fprintf(stderr,"replay <capture file> [--speed 1x|Nx|max] [--concurrency K]\n");
+    return 2;
+  }
+  return replay_run(&ro,fmt,out);
+}
+
 /* ---------- DISPATCH ---------- */
 
-int cli_dispatch(int argc, char** argv) {
+static int cli_run(int argc, char** argv) {
   if (argc < 2) { usage_root(); return 1; }
 
-  db_config_t cfg; db_load_env(&cfg);
-  MYSQL* conn = db_connect(&cfg);
-  if (!conn) { fprintf(stderr,"DB connect failed\n"); return 5; }
+  const char* cmd = argv[1];
+  /* report --snapshot reads a local file and never needs the database;
+   * replay runs its commands as child processes */
+  bool offline = !strcmp(cmd,"cache") || !strcmp(cmd,"replay") || (!strcmp(cmd,"journal") && argc>2 && !strcmp(argv[2],"status"));
+  if (!strcmp(cmd,"report")) {
+    for (int i=2;i<argc;i++) if (!strncmp(argv[i],"--snapshot",10)) offline = true;
+  }
 
-  int rc=2; const char* cmd = argv[1];
+  MYSQL* conn = NULL;
+  if (!offline) {
+    if (shard_map_load(&g_shards)!=0) return 2;
+    if ((g_cur = route_shard(argc, argv)) < 0) return 2;
+    db_config_t cfg = g_shards.s[g_cur].cfg;
+    if (g_shards.n>1) {
+      db_route(&cfg);
+      const char* rh = getenv("DB_REPLICA_HOST");
+      if (rh && *rh && read_only(argc, argv))
+        fprintf(stderr,"DB_REPLICA_HOST ignored with a shard map, reading from the shards\n");
+    } else if (read_only(argc, argv) && (conn = db_connect_replica())) db_load_env(&g_shards.s[g_cur].cfg);
+    if (!conn) conn = db_connect(&cfg);
+    if (!conn) { fprintf(stderr,"DB connect failed\n"); return 5; }
+  }
+
+  int rc=2;
   if      (!strcmp(cmd,"sport"))     { rc = cmd_sport(argc-1, argv+1, conn); }
   else if (!strcmp(cmd,"league"))    { rc = cmd_league(argc-1, argv+1, conn); }
   else if (!strcmp(cmd,"team"))      { rc = cmd_team(argc-1, argv+1, conn); }
@@ -1221,10 +1886,24 @@ int cli_dispatch(int argc, char** argv) {
   else if (!strcmp(cmd,"bet"))       { rc = cmd_bet(argc-1, argv+1, conn); }
   else if (!strcmp(cmd,"settle"))    { rc = cmd_settle(argc-1, argv+1, conn); }
   else if (!strcmp(cmd,"report"))    { rc = cmd_report(argc-1, argv+1, conn); }
+  else if (!strcmp(cmd,"snapshot"))  { rc = cmd_snapshot(argc-1, argv+1, conn); }
+  else if (!strcmp(cmd,"cache"))     { rc = cmd_cache(argc-1, argv+1); }
+  else if (!strcmp(cmd,"journal"))   { rc = cmd_journal(argc-1, argv+1, conn); }
   else if (!strcmp(cmd,"risk"))      { rc = cmd_risk(argc-1, argv+1, conn); }
+  else if (!strcmp(cmd,"ledger"))    { rc = cmd_ledger(argc-1, argv+1, conn); }
+  else if (!strcmp(cmd,"replay"))    { rc = cmd_replay(argc-1, argv+1); }
   else { usage_root(); rc=1; }
 
   db_disconnect(conn);
+  db_disconnect(g_extra);
+  return rc;
+}
+
+int cli_dispatch(int argc, char** argv) {
+  capture_t cap;
+  capture_begin(&cap);
+  int rc = cli_run(argc, argv);
+  capture_end(&cap, argc, argv, rc);
   return rc;
 }
 
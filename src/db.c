@@ -2,13 +2,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 static const char* env_or(const char* k, const char* d) {
   const char* v = getenv(k);
   return v && *v ? v : d;
 }
 
+static db_config_t db_routed;
+static int db_is_routed;
+
+void db_route(const db_config_t* cfg) {
+  if (cfg) db_routed = *cfg;
+  db_is_routed = cfg != NULL;
+}
+
 void db_load_env(db_config_t* cfg) {
+  if (db_is_routed) { *cfg = db_routed; return; }
   snprintf(cfg->host, sizeof(cfg->host), "%s", env_or("DB_HOST","127.0.0.1"));
   cfg->port = atoi(env_or("DB_PORT","3306"));
   snprintf(cfg->dbname, sizeof(cfg->dbname), "%s", env_or("DB_NAME","gigam_db"));
@@ -27,6 +38,62 @@ MYSQL* db_connect(const db_config_t* cfg) {
   return c;
 }
 
+/* seconds the replica is behind its primary (the most behind channel);
+ * -1 if it is not replicating or its status cannot be read */
+static long replica_lag(MYSQL* c) {
+  /* MySQL 8.4 only knows the first, older servers only the second */
+  MYSQL_RES* r = NULL;
+  if (mysql_query(c, "SHOW REPLICA STATUS") == 0 || mysql_query(c, "SHOW SLAVE STATUS") == 0) r = mysql_store_result(c);
+  if (!r) return -1;
+  MYSQL_FIELD* f = mysql_fetch_fields(r);
+  unsigned nf = mysql_num_fields(r), col = nf;
+  for (unsigned i=0;i<nf;i++) {
+    if (!strcmp(f[i].name, "Seconds_Behind_Source") || !strcmp(f[i].name, "Seconds_Behind_Master")) col = i;
+  }
+  long lag = -1;
+  MYSQL_ROW row;
+  while (col < nf && (row = mysql_fetch_row(r))) {
+    if (!row[col]) { lag = -1; break; }   /* NULL: replication stopped */
+    long v = atol(row[col]);
+    if (v > lag) lag = v;
+  }
+  mysql_free_result(r);
+  return lag;
+}
+
+MYSQL* db_connect_replica(void) {
+  const char* host = getenv("DB_REPLICA_HOST");
+  if (!host || !*host) return NULL;
+  db_config_t cfg; db_load_env(&cfg);
+  snprintf(cfg.host, sizeof(cfg.host), "%s", host);
+  cfg.port = atoi(env_or("DB_REPLICA_PORT", env_or("DB_PORT","3306")));
+  const char* v;
+  if ((v = getenv("DB_REPLICA_NAME")) && *v) snprintf(cfg.dbname, sizeof(cfg.dbname), "%s", v);
+  if ((v = getenv("DB_REPLICA_USER")) && *v) snprintf(cfg.user, sizeof(cfg.user), "%s", v);
+  if ((v = getenv("DB_REPLICA_PASS")) && *v) snprintf(cfg.pass, sizeof(cfg.pass), "%s", v);
+  long max_lag = atol(env_or("DB_REPLICA_MAX_LAG","30"));
+  unsigned timeout = (unsigned)atoi(env_or("DB_REPLICA_CONNECT_TIMEOUT","2"));
+
+  /* a replica that is down must not stall the command: short timeout */
+  MYSQL* c = mysql_init(NULL);
+  if (!c) return NULL;
+  mysql_options(c, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+  if (!mysql_real_connect(c, cfg.host, cfg.user, cfg.pass, cfg.dbname, cfg.port, NULL, 0)) {
+    fprintf(stderr, "replica %s:%d unavailable (%s), reading from the primary\n", cfg.host, cfg.port, mysql_error(c));
+    mysql_close(c);
+    return NULL;
+  }
+  long lag = replica_lag(c);
+  if (lag < 0 || lag > max_lag) {
+    if (lag < 0) fprintf(stderr, "replica %s:%d not replicating, reading from the primary\n", cfg.host, cfg.port);
+    else fprintf(stderr, "replica %s:%d is %lds behind (max %ld), reading from the primary\n", cfg.host, cfg.port, lag, max_lag);
+    mysql_close(c);
+    return NULL;
+  }
+  db_route(&cfg);
+  return c;
+}
+
 void db_disconnect(MYSQL* conn) {
   if (conn) mysql_close(conn);
 }
@@ -39,6 +106,18 @@ int db_exec(MYSQL* conn, const char* sql) {
   return 0;
 }
 
+void db_escape(MYSQL* c, const char* in, char* out, size_t outsz) {
+  if (!in) { out[0]='\0'; return; }
+  size_t n = strlen(in);
+  char* tmp = (char*)malloc(n*2+1);
+  if(!tmp){ out[0]='\0'; return; }
+  unsigned long m = mysql_real_escape_string(c, tmp, in, n);
+  if ((size_t)m >= outsz) m = (unsigned long)(outsz - 1);
+  memcpy(out, tmp, (size_t)m);
+  out[m]='\0';
+  free(tmp);
+}
+
 void db_print_result(MYSQL_RES* res) {
   if (!res) return;
   unsigned int n = mysql_num_fields(res);
@@ -56,3 +135,104 @@ void db_print_result(MYSQL_RES* res) {
     }
   }
 }
+
+int db_exec_all(MYSQL* const* conns, int n, const char* sql) {
+  int sent = 0, rc = 0;
+  for (; sent<n; sent++) {
+    if (mysql_send_query(conns[sent], sql, (unsigned long)strlen(sql)) != 0) {
+      fprintf(stderr, "SQL error: %s\n", mysql_error(conns[sent]));
+      rc = -1; break;
+    }
+  }
+  /* collect every query sent, so no connection is left mid-result */
+  for (int i=0;i<sent;i++) {
+    if (mysql_read_query_result(conns[i]) != 0) {
+      fprintf(stderr, "SQL error: %s\n", mysql_error(conns[i]));
+      rc = -1;
+    }
+  }
+  return rc;
+}
+
+/* ---------- Parallel execution over a small connection pool ---------- */
+
+typedef struct {
+  const db_config_t* cfg;
+  const size_t* tasks;   /* this pool's task numbers; NULL = 0..ntasks-1 */
+  size_t ntasks;
+  atomic_size_t next;
+  atomic_int failed;
+  atomic_int connected;
+  db_task_fn fn;
+  void* ud;
+} db_par_t;
+
+static void* db_par_worker(void* arg) {
+  db_par_t* p = (db_par_t*)arg;
+  mysql_thread_init();
+  MYSQL* c = db_connect(p->cfg);
+  if (c) {
+    atomic_fetch_add(&p->connected, 1);
+    for (;;) {
+      size_t t = atomic_fetch_add(&p->next, 1);
+      if (t >= p->ntasks) break;
+      if (p->fn(c, p->tasks ? p->tasks[t] : t, p->ud) != 0) atomic_fetch_add(&p->failed, 1);
+    }
+    db_disconnect(c);
+  }
+  mysql_thread_end();
+  return NULL;
+}
+
+int db_parallel(const db_config_t* cfg, size_t ntasks, int nconn, db_task_fn fn, void* ud) {
+  return db_parallel_sharded(cfg, 1, NULL, ntasks, nconn, fn, ud);
+}
+
+int db_parallel_sharded(const db_config_t* cfgs, int ncfg, const int* task_cfg, size_t ntasks, int nconn,
+                        db_task_fn fn, void* ud) {
+  if (!ntasks) return 0;
+  if (ncfg < 1) return -1;
+  if (nconn < 1) nconn = 1;
+  /* the client library must be initialised before threads use it */
+  if (mysql_library_init(0, NULL, NULL) != 0) return -1;
+
+  db_par_t* p = (db_par_t*)calloc((size_t)ncfg, sizeof(db_par_t));
+  size_t* order = task_cfg ? (size_t*)malloc(ntasks*sizeof(size_t)) : NULL;
+  pthread_t* th = (pthread_t*)calloc((size_t)ncfg * (size_t)nconn, sizeof(pthread_t));
+  if (!p || !th || (task_cfg && !order)) { free(p); free(order); free(th); return -1; }
+
+  /* one pool per config over its own tasks, kept in task order */
+  size_t used = 0;
+  for (int s=0;s<ncfg;s++) {
+    p[s].cfg = &cfgs[s]; p[s].fn = fn; p[s].ud = ud;
+    if (task_cfg) {
+      p[s].tasks = order + used;
+      for (size_t t=0;t<ntasks;t++) if (task_cfg[t] == s) order[used++] = t;
+      p[s].ntasks = (size_t)(order + used - p[s].tasks);
+    } else {
+      p[s].ntasks = s == 0 ? ntasks : 0;
+    }
+    atomic_init(&p[s].next, 0); atomic_init(&p[s].failed, 0); atomic_init(&p[s].connected, 0);
+  }
+
+  int started = 0;
+  for (int s=0;s<ncfg;s++) {
+    int k = (size_t)nconn > p[s].ntasks ? (int)p[s].ntasks : nconn;
+    for (int i=0;i<k;i++) {
+      if (pthread_create(&th[started], NULL, db_par_worker, &p[s]) == 0) started++;
+    }
+  }
+  for (int i=0;i<started;i++) pthread_join(th[i], NULL);
+  free(th);
+
+  int failed = 0, unreachable = 0;
+  for (int s=0;s<ncfg;s++) {
+    if (!p[s].ntasks) continue;
+    if (!atomic_load(&p[s].connected)) unreachable++;
+    /* tasks nobody picked up (every worker lost its connection) count as failed */
+    size_t done = atomic_load(&p[s].next);
+    failed += atomic_load(&p[s].failed) + (done < p[s].ntasks ? (int)(p[s].ntasks - done) : 0);
+  }
+  free(p); free(order);
+  return unreachable ? -1 : failed;
+}
@@ -0,0 +1,544 @@
+#define _POSIX_C_SOURCE 200809L
+#include "fixtures.h"
+#include "hmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#define FX_NAME_MAX 128   /* VARCHAR(128) in leagues and teams */
+#define FX_ERR_SHOWN 20
+
+/* ---------- CSV ---------- */
+
+/* One row of p split in place into NUL-terminated fields ("" is a quote
+ * inside a quoted field); *line counts the newlines consumed. Returns the
+ * start of the next row, NULL at the end of the buffer. */
+static char* csv_row(char* p, char** f, int max, int* nf, long* line) {
+  *nf = 0;
+  if (!*p) return NULL;
+  for (;;) {
+    char* start = p; char* out = p;
+    if (*p == '"') {
+      for (p++; *p; ) {
+        if (*p == '"') { if (p[1] != '"') { p++; break; } p++; }
+        if (*p == '\n') (*line)++;
+        *out++ = *p++;
+      }
+      while (*p && *p != ',' && *p != '\n' && *p != '\r') p++;
+    } else {
+      while (*p && *p != ',' && *p != '\n' && *p != '\r') *out++ = *p++;
+    }
+    char sep = *p;
+    *out = '\0';
+    if (*nf < max) f[*nf] = start;
+    (*nf)++;
+    if (sep == ',') { p++; continue; }
+    if (sep == '\r') { p++; if (*p == '\n') p++; (*line)++; }
+    else if (sep == '\n') { p++; (*line)++; }
+    return p;
+  }
+}
+
+static char* trim(char* s) {
+  while (*s == ' ' || *s == '\t') s++;
+  size_t n = strlen(s);
+  while (n && (s[n-1] == ' ' || s[n-1] == '\t')) s[--n] = '\0';
+  return s;
+}
+
+static char* slurp(const char* path) {
+  FILE* fp = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+  if (!fp) return NULL;
+  char* buf = NULL; size_t cap = 0, n = 0;
+  for (;;) {
+    if (n + 65536 + 1 > cap) {
+      cap = cap ? cap*2 : 1 << 20;
+      char* nb = realloc(buf, cap);
+      if (!nb) { free(buf); buf = NULL; break; }
+      buf = nb;
+    }
+    size_t k = fread(buf + n, 1, cap - n - 1, fp);
+    n += k;
+    if (k == 0) { if (ferror(fp)) { free(buf); buf = NULL; } break; }
+  }
+  if (fp != stdin) fclose(fp);
+  if (buf) buf[n] = '\0';
+  return buf;
+}
+
+/* YYYY-MM-DD HH:MM[:SS] ('T' also separates) as YYYYMMDDHHMMSS */
+static int parse_kickoff(const char* s, long long* ko) {
+  static const int mdays[] = { 31,29,31,30,31,30,31,31,30,31,30,31 };
+  int y, mo, d, h, mi, se = 0; char sep, tail;
+  int k = sscanf(s, "%4d-%2d-%2d%c%2d:%2d:%2d%c", &y, &mo, &d, &sep, &h, &mi, &se, &tail);
+  if ((k != 6 && k != 7) || (sep != ' ' && sep != 'T')) return -1;
+  if (y < 1970 || mo < 1 || mo > 12 || d < 1 || d > mdays[mo-1] || h > 23 || mi > 59 || se > 59 || h < 0 || mi < 0 || se < 0) return -1;
+  if (mo == 2 && d == 29 && (y % 4 || (y % 100 == 0 && y % 400))) return -1;
+  *ko = (((((long long)y*100 + mo)*100 + d)*100 + h)*100 + mi)*100 + se;
+  return 0;
+}
+
+static void fmt_kickoff(long long ko, char* out, size_t n) {
+  snprintf(out, n, "%04lld-%02lld-%02lld %02lld:%02lld:%02lld", ko/10000000000LL, ko/100000000%100, ko/1000000%100,
+           ko/10000%100, ko/100%100, ko%100);
+}
+
+/* ---------- Name dictionaries ---------- */
+
+/* names are kept in one pool, by offset, so the pool can grow */
+typedef struct { char* s; size_t len, cap; } spool_t;
+
+static long spool_add(spool_t* p, const char* s, size_t n) {
+  if (p->len + n + 1 > p->cap) {
+    size_t cap = p->cap ? p->cap : 4096;
+    while (cap < p->len + n + 1) cap *= 2;
+    char* ns = realloc(p->s, cap);
+    if (!ns) return -1;
+    p->s = ns; p->cap = cap;
+  }
+  memcpy(p->s + p->len, s, n);
+  p->s[p->len + n] = '\0';
+  long off = (long)p->len;
+  p->len += n + 1;
+  return off;
+}
+
+typedef struct {
+  long scope;          /* the team's league; 0 for leagues */
+  long off;            /* name in the pool */
+  long id;             /* 0: not in the database (yet) */
+  int count;           /* rows with the name: a league name is per sport */
+  bool used;           /* a fixture of the file names it */
+} fx_name_t;
+
+typedef struct { hmap_t m; spool_t pool; } fx_dict_t;
+
+static int lower(int ch) { return ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch; }
+
+/* case-insensitive (ASCII), as the schema's collation compares names */
+static bool name_eq(const char* pooled, const char* s, size_t n) {
+  for (size_t i=0;i<n;i++) if (lower((unsigned char)pooled[i]) != lower((unsigned char)s[i])) return false;
+  return pooled[n] == '\0';
+}
+
+/* keyed by the hash of (scope, name) and probed on collision, as mtm.c
+ * keys its picks; *created (if given) tells a new entry */
+static fx_name_t* dict_find(fx_dict_t* d, long scope, const char* s, bool create, bool* created) {
+  size_t n = strlen(s);
+  unsigned long long h = 1469598103934665603ULL ^ (unsigned long long)scope;
+  for (size_t i=0;i<n;i++) { h ^= (unsigned long long)lower((unsigned char)s[i]); h *= 1099511628211ULL; }
+  for (unsigned long long i=0;;i++) {
+    long long key = (long long)(h + i*0x9E3779B97F4A7C15ULL);
+    bool fresh = false;
+    fx_name_t* e = (fx_name_t*)(create ? hmap_put(&d->m, key, &fresh) : hmap_get(&d->m, key));
+    if (!e) return NULL;
+    if (fresh) {
+      long off = spool_add(&d->pool, s, n);
+      if (off < 0) return NULL;
+      e->scope = scope; e->off = off;
+      if (created) *created = true;
+      return e;
+    }
+    if (e->scope == scope && name_eq(d->pool.s + e->off, s, n)) {
+      if (created) *created = false;
+      return e;
+    }
+  }
+}
+
+static void dict_free(fx_dict_t* d) { hmap_free(&d->m); free(d->pool.s); }
+
+/* ---------- Events already stored ---------- */
+
+typedef struct {
+  long league, home, away;
+  long long ko;
+  long id;             /* 0 until stored */
+  bool in_file;
+} fx_event_t;
+
+static fx_event_t* event_find(hmap_t* m, const fx_event_t* k, bool create, bool* created) {
+  unsigned long long h = 1469598103934665603ULL;
+  long long f[4] = { k->league, k->ko, k->home, k->away };
+  for (int i=0;i<4;i++) { h ^= (unsigned long long)f[i]; h *= 1099511628211ULL; h ^= h >> 29; }
+  for (unsigned long long i=0;;i++) {
+    long long key = (long long)(h + i*0x9E3779B97F4A7C15ULL);
+    bool fresh = false;
+    fx_event_t* e = (fx_event_t*)(create ? hmap_put(m, key, &fresh) : hmap_get(m, key));
+    if (!e) return NULL;
+    if (fresh) { *e = *k; e->id = 0; e->in_file = false; *created = true; return e; }
+    if (e->league == k->league && e->ko == k->ko && e->home == k->home && e->away == k->away) { *created = false; return e; }
+  }
+}
+
+/* ---------- Multi-row INSERTs ---------- */
+
+typedef struct {
+  MYSQL* c;
+  const char* head;    /* "INSERT ... VALUES" */
+  long batch, rows;
+  char* sql; size_t len;
+  FILE* f;
+  unsigned long long affected;
+} fx_ins_t;
+
+/* the stream to print the next row's "(...)" to */
+static FILE* ins_row(fx_ins_t* b) {
+  if (!b->f) {
+    if (!(b->f = open_memstream(&b->sql, &b->len))) return NULL;
+    fputs(b->head, b->f);
+  } else {
+    fputc(',', b->f);
+  }
+  return b->f;
+}
+
+static int ins_flush(fx_ins_t* b) {
+  if (!b->f) return 0;
+  fclose(b->f); b->f = NULL;
+  int rc = db_exec(b->c, b->sql);
+  if (rc == 0) b->affected += mysql_affected_rows(b->c);
+  free(b->sql); b->sql = NULL; b->rows = 0;
+  return rc;
+}
+
+static int ins_next(fx_ins_t* b) {
+  return ++b->rows >= b->batch ? ins_flush(b) : 0;
+}
+
+static void ins_drop(fx_ins_t* b) {
+  if (b->f) { fclose(b->f); free(b->sql); b->f = NULL; b->sql = NULL; }
+}
+
+/* ---------- Import ---------- */
+
+typedef struct {
+  long line;
+  char* f[4];          /* league, kickoff, home, away (in the file buffer) */
+  long long ko;
+  long league, home, away;
+} fx_row_t;
+
+typedef struct {
+  MYSQL* c;
+  char* buf;
+  fx_row_t* rows; long nrows;
+  fx_dict_t leagues, teams;
+  hmap_t league_ids;   /* every league id -> nothing */
+  hmap_t file_leagues; /* the file's league ids */
+  hmap_t events;
+  long errors;
+  const char* path;
+} fx_t;
+
+static void row_error(fx_t* x, long line, const char* fmt, ...) {
+  if (x->errors++ >= FX_ERR_SHOWN) return;
+  va_list ap;
+  va_start(ap, fmt);
+  fprintf(stderr, "%s:%ld: ", x->path, line);
+  vfprintf(stderr, fmt, ap);
+  fputc('\n', stderr);
+  va_end(ap);
+}
+
+static MYSQL_RES* fx_query(MYSQL* c, const char* q) {
+  if (db_exec(c, q) != 0) return NULL;
+  MYSQL_RES* r = mysql_use_result(c);
+  if (!r) fprintf(stderr, "SQL error: %s\n", mysql_error(c));
+  return r;
+}
+
+static int fx_done(MYSQL* c, MYSQL_RES* r) {
+  mysql_free_result(r);
+  if (mysql_errno(c)) { fprintf(stderr, "SQL error: %s\n", mysql_error(c)); return 5; }
+  return 0;
+}
+
+/* " IN(...)" over the file's leagues */
+static char* league_list(fx_t* x) {
+  char* s = NULL; size_t n = 0;
+  FILE* f = open_memstream(&s, &n);
+  if (!f) return NULL;
+  size_t pos = 0; long long id; void* v; int k = 0;
+  fputs(" IN(", f);
+  while (hmap_next(&x->file_leagues, &pos, &id, &v)) fprintf(f, "%s%lld", k++ ? "," : "", id);
+  fputc(')', f);
+  fclose(f);
+  return s;
+}
+
+static int parse_file(fx_t* x) {
+  long cap = 0, line = 1;
+  char* p = x->buf;
+  for (bool first = true; p; ) {
+    char* f[5]; int nf; long at = line;
+    p = csv_row(p, f, 5, &nf, &line);
+    if (!p) break;
+    if (nf == 1 && !*trim(f[0])) continue;
+    if (*trim(f[0]) == '#') continue;
+    fx_row_t r = { .line = at };
+    for (int i=0;i<4 && i<nf;i++) r.f[i] = trim(f[i]);
+    bool header = first;
+    first = false;
+    if (nf != 4) { row_error(x, at, "%d fields, expected 4 (league,kickoff,home,away)", nf); continue; }
+    if (parse_kickoff(r.f[1], &r.ko) != 0) {
+      if (!header) row_error(x, at, "kickoff '%s': YYYY-MM-DD HH:MM[:SS]", r.f[1]);
+      continue;
+    }
+    bool bad = false;
+    for (int i=0;i<4;i++) {
+      if (i == 1) continue;
+      if (!*r.f[i]) { row_error(x, at, "empty %s", i == 0 ? "league" : i == 2 ? "home team" : "away team"); bad = true; }
+      else if (strlen(r.f[i]) > FX_NAME_MAX) { row_error(x, at, "name longer than 128: '%.40s...'", r.f[i]); bad = true; }
+    }
+    if (bad) continue;
+    if (!strcasecmp(r.f[2], r.f[3])) { row_error(x, at, "'%s' plays itself", r.f[2]); continue; }
+    if (x->nrows == cap) {
+      cap = cap ? cap*2 : 1024;
+      fx_row_t* nr = realloc(x->rows, (size_t)cap*sizeof(fx_row_t));
+      if (!nr) { fprintf(stderr, "out of memory\n"); return 1; }
+      x->rows = nr;
+    }
+    x->rows[x->nrows++] = r;
+  }
+  return 0;
+}
+
+static int load_leagues(fx_t* x) {
+  MYSQL_RES* r = fx_query(x->c, "SELECT id,name FROM leagues");
+  if (!r) return 5;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r))) {
+    long id = atol(row[0]);
+    bool created;
+    fx_name_t* e = dict_find(&x->leagues, 0, row[1] ? row[1] : "", true, &created);
+    if (!e || !hmap_put(&x->league_ids, id, &created)) { mysql_free_result(r); fprintf(stderr, "out of memory\n"); return 5; }
+    e->count++; e->id = id;
+  }
+  return fx_done(x->c, r);
+}
+
+static int resolve_leagues(fx_t* x) {
+  for (long i=0;i<x->nrows;i++) {
+    fx_row_t* r = &x->rows[i];
+    const char* s = r->f[0];
+    if (strspn(s, "0123456789") == strlen(s)) {
+      r->league = atol(s);
+      if (!hmap_get(&x->league_ids, r->league)) { row_error(x, r->line, "no league with id %s", s); continue; }
+    } else {
+      fx_name_t* e = dict_find(&x->leagues, 0, s, false, NULL);
+      if (!e) { row_error(x, r->line, "no league named '%s'", s); continue; }
+      if (e->count > 1) { row_error(x, r->line, "league name '%s' is ambiguous (one per sport); use its id", s); continue; }
+      r->league = e->id;
+    }
+    bool created;
+    if (!hmap_put(&x->file_leagues, r->league, &created)) { fprintf(stderr, "out of memory\n"); return 5; }
+  }
+  return 0;
+}
+
+/* teams of the file's leagues; a name already in the dictionary takes the id */
+static int load_teams(fx_t* x) {
+  char* in = league_list(x);
+  if (!in) return 5;
+  char* q = NULL; size_t n = 0;
+  FILE* f = open_memstream(&q, &n);
+  if (!f) { free(in); return 5; }
+  fprintf(f, "SELECT id,league_id,name FROM teams WHERE league_id%s", in);
+  fclose(f); free(in);
+  MYSQL_RES* r = fx_query(x->c, q);
+  free(q);
+  if (!r) return 5;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r))) {
+    fx_name_t* e = dict_find(&x->teams, atol(row[1]), row[2] ? row[2] : "", true, NULL);
+    if (!e) { mysql_free_result(r); fprintf(stderr, "out of memory\n"); return 5; }
+    e->id = atol(row[0]);
+  }
+  return fx_done(x->c, r);
+}
+
+/* a name the collation matches and the ASCII compare does not (accents,
+ * say): ask the database which team it is */
+static int team_lookup(fx_t* x, fx_name_t* e) {
+  char esc[2*FX_NAME_MAX+1], q[2*FX_NAME_MAX+128];
+  db_escape(x->c, x->teams.pool.s + e->off, esc, sizeof(esc));
+  snprintf(q, sizeof(q), "SELECT id FROM teams WHERE league_id=%ld AND name='%s'", e->scope, esc);
+  MYSQL_RES* r = fx_query(x->c, q);
+  if (!r) return 5;
+  MYSQL_ROW row = mysql_fetch_row(r);
+  if (row) e->id = atol(row[0]);
+  int rc = fx_done(x->c, r);
+  if (!rc && !e->id) { fprintf(stderr, "team '%s' (league %ld) not found after insert\n", x->teams.pool.s + e->off, e->scope); rc = 5; }
+  return rc;
+}
+
+/* the teams no row of the dictionary has: INSERTed in batches, read back */
+static int create_teams(fx_t* x, long batch, long* created) {
+  fx_ins_t b = { .c = x->c, .head = "INSERT IGNORE INTO teams(league_id,name) VALUES", .batch = batch };
+  bool any = false;
+  for (long i=0;i<x->nrows;i++) {
+    fx_row_t* r = &x->rows[i];
+    for (int side=2; side<=3; side++) {
+      bool fresh;
+      fx_name_t* e = dict_find(&x->teams, r->league, r->f[side], true, &fresh);
+      if (!e) { ins_drop(&b); fprintf(stderr, "out of memory\n"); return 5; }
+      e->used = true;
+      if (!fresh) continue;
+      char esc[2*FX_NAME_MAX+1];
+      db_escape(x->c, r->f[side], esc, sizeof(esc));
+      FILE* f = ins_row(&b);
+      if (!f) return 5;
+      fprintf(f, "(%ld,'%s')", r->league, esc);
+      if (ins_next(&b) != 0) return 5;
+      any = true;
+    }
+  }
+  if (ins_flush(&b) != 0) return 5;
+  *created = (long)b.affected;
+  if (!any) return 0;
+  int rc = load_teams(x);
+  size_t pos = 0; long long key; void* v;
+  while (!rc && hmap_next(&x->teams.m, &pos, &key, &v)) {
+    fx_name_t* e = (fx_name_t*)v;
+    if (!e->id && e->used) rc = team_lookup(x, e);
+  }
+  return rc;
+}
+
+/* events of the file's leagues within its kickoffs, with their ids */
+static int load_events(fx_t* x, bool in_file_only) {
+  long long lo = x->rows[0].ko, hi = lo;
+  for (long i=1;i<x->nrows;i++) { if (x->rows[i].ko < lo) lo = x->rows[i].ko; if (x->rows[i].ko > hi) hi = x->rows[i].ko; }
+  char* in = league_list(x);
+  if (!in) return 5;
+  char* q = NULL; size_t n = 0;
+  FILE* f = open_memstream(&q, &n);
+  if (!f) { free(in); return 5; }
+  fprintf(f, "SELECT id,league_id,DATE_FORMAT(starts_at,'%%Y%%m%%d%%H%%i%%s'),home_team_id,away_team_id FROM events "
+             "WHERE starts_at BETWEEN STR_TO_DATE('%lld','%%Y%%m%%d%%H%%i%%s') AND STR_TO_DATE('%lld','%%Y%%m%%d%%H%%i%%s') "
+             "AND league_id%s", lo, hi, in);
+  fclose(f); free(in);
+  MYSQL_RES* r = fx_query(x->c, q);
+  free(q);
+  if (!r) return 5;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r))) {
+    fx_event_t k = { .league = atol(row[1]), .ko = atoll(row[2] ? row[2] : "0"), .home = atol(row[3]), .away = atol(row[4]) };
+    bool fresh;
+    fx_event_t* e = event_find(&x->events, &k, !in_file_only, &fresh);
+    if (!e) {
+      if (in_file_only) continue;
+      mysql_free_result(r); fprintf(stderr, "out of memory\n"); return 5;
+    }
+    if (!e->id) e->id = atol(row[0]);
+  }
+  return fx_done(x->c, r);
+}
+
+static int insert_events(fx_t* x, long batch, fixtures_stats_t* st) {
+  fx_ins_t b = { .c = x->c, .head = "INSERT INTO events(league_id,starts_at,home_team_id,away_team_id) VALUES", .batch = batch };
+  for (long i=0;i<x->nrows;i++) {
+    fx_row_t* r = &x->rows[i];
+    r->home = dict_find(&x->teams, r->league, r->f[2], false, NULL)->id;
+    r->away = dict_find(&x->teams, r->league, r->f[3], false, NULL)->id;
+    fx_event_t k = { .league = r->league, .ko = r->ko, .home = r->home, .away = r->away };
+    bool fresh;
+    fx_event_t* e = event_find(&x->events, &k, true, &fresh);
+    if (!e) { ins_drop(&b); fprintf(stderr, "out of memory\n"); return 5; }
+    e->in_file = true;
+    if (!fresh) { st->skipped++; continue; }
+    char ts[32]; fmt_kickoff(r->ko, ts, sizeof(ts));
+    FILE* f = ins_row(&b);
+    if (!f) return 5;
+    fprintf(f, "(%ld,'%s',%ld,%ld)", r->league, ts, r->home, r->away);
+    if (ins_next(&b) != 0) return 5;
+  }
+  if (ins_flush(&b) != 0) return 5;
+  st->created = (long)b.affected;
+  return 0;
+}
+
+/* the file's teams and events on another shard, under the ids they have
+ * here; INSERT IGNORE, so a shard that missed an import catches up */
+static int copy_to(fx_t* x, MYSQL* o, long batch) {
+  if (db_exec(o, "START TRANSACTION") != 0) return 5;
+  fx_ins_t b = { .c = o, .head = "INSERT IGNORE INTO teams(id,league_id,name) VALUES", .batch = batch };
+  size_t pos = 0; long long key; void* v;
+  while (hmap_next(&x->teams.m, &pos, &key, &v)) {
+    fx_name_t* e = (fx_name_t*)v;
+    if (!e->used) continue;
+    char esc[2*FX_NAME_MAX+1];
+    db_escape(o, x->teams.pool.s + e->off, esc, sizeof(esc));
+    FILE* f = ins_row(&b);
+    if (!f) goto fail;
+    fprintf(f, "(%ld,%ld,'%s')", e->id, e->scope, esc);
+    if (ins_next(&b) != 0) goto fail;
+  }
+  if (ins_flush(&b) != 0) goto fail;
+  fx_ins_t eb = { .c = o, .head = "INSERT IGNORE INTO events(id,league_id,starts_at,home_team_id,away_team_id) VALUES", .batch = batch };
+  pos = 0;
+  while (hmap_next(&x->events, &pos, &key, &v)) {
+    fx_event_t* e = (fx_event_t*)v;
+    if (!e->in_file) continue;
+    if (!e->id) { ins_drop(&eb); fprintf(stderr, "imported event not read back\n"); goto fail; }
+    char ts[32]; fmt_kickoff(e->ko, ts, sizeof(ts));
+    FILE* f = ins_row(&eb);
+    if (!f) goto fail;
+    fprintf(f, "(%ld,%ld,'%s',%ld,%ld)", e->id, e->league, ts, e->home, e->away);
+    if (ins_next(&eb) != 0) goto fail;
+  }
+  if (ins_flush(&eb) != 0 || db_exec(o, "COMMIT") != 0) goto fail;
+  return 0;
+fail:
+  ins_drop(&b);
+  db_exec(o, "ROLLBACK");
+  return 5;
+}
+
+int fixtures_import(MYSQL* const* conns, int n, const char* path, long batch, fixtures_stats_t* st) {
+  memset(st, 0, sizeof(*st));
+  if (batch < 1) batch = 1;
+  fx_t x;
+  memset(&x, 0, sizeof(x));
+  x.c = conns[0]; x.path = path;
+  if (!(x.buf = slurp(path))) { fprintf(stderr, "cannot read %s: %s\n", path, strerror(errno)); return 1; }
+  hmap_init(&x.leagues.m, sizeof(fx_name_t));
+  hmap_init(&x.teams.m, sizeof(fx_name_t));
+  hmap_init(&x.league_ids, 1);
+  hmap_init(&x.file_leagues, 1);
+  hmap_init(&x.events, sizeof(fx_event_t));
+
+  int rc = parse_file(&x);
+  st->rows = x.nrows + x.errors;
+  if (rc || x.nrows == 0) goto out;
+  /* everything is read and resolved before the first write */
+  if (db_exec(x.c, "START TRANSACTION") != 0) { rc = 5; goto out; }
+  if ((rc = load_leagues(&x)) || (rc = resolve_leagues(&x))) goto rollback;
+  if (x.errors) goto rollback;
+  if ((rc = load_teams(&x)) || (rc = create_teams(&x, batch, &st->teams)) ||
+      (rc = load_events(&x, false)) || (rc = insert_events(&x, batch, st))) goto rollback;
+  if (db_exec(x.c, "COMMIT") != 0) { rc = 5; goto rollback; }
+
+  if (n > 1 && (rc = load_events(&x, true)) == 0) {
+    for (int i=1;i<n;i++) {
+      if (copy_to(&x, conns[i], batch) != 0) { fprintf(stderr, "shard #%d: not updated\n", i); rc = 5; }
+    }
+  }
+  goto out;
+
+rollback:
+  db_exec(x.c, "ROLLBACK");
+  st->created = st->teams = 0;
+out:
+  if (x.errors > FX_ERR_SHOWN) fprintf(stderr, "%s: %ld more bad rows\n", path, x.errors - FX_ERR_SHOWN);
+  if (!rc && x.errors) rc = 2;
+  dict_free(&x.leagues); dict_free(&x.teams);
+  hmap_free(&x.league_ids); hmap_free(&x.file_leagues); hmap_free(&x.events);
+  free(x.rows); free(x.buf);
+  return rc;
+}
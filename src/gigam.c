@@ -0,0 +1,1215 @@
+#define _POSIX_C_SOURCE 200809L
+#include "gigam.h"
+#include "market.h"
+#include "ledger.h"
+#include "hmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+
+struct gigam_ctx {
+  MYSQL* c;
+  int owns;           /* close c in gigam_close */
+  ledger_batch_t* lb; /* ledger postings of the settlement in progress */
+  long chunk;         /* rows per keyset chunk of the settle/risk scans */
+  char err[512];
+};
+
+/* ---------- Context ---------- */
+
+gigam_ctx_t* gigam_open(const db_config_t* cfg) {
+  MYSQL* c = db_connect(cfg);
+  if (!c) return NULL;
+  gigam_ctx_t* g = gigam_wrap(c);
+  if (!g) { db_disconnect(c); return NULL; }
+  g->owns = 1;
+  return g;
+}
+
+gigam_ctx_t* gigam_wrap(MYSQL* conn) {
+  gigam_ctx_t* g = (gigam_ctx_t*)calloc(1, sizeof(*g));
+  if (!g) return NULL;
+  g->c = conn;
+  g->chunk = GIGAM_SCAN_CHUNK;
+  return g;
+}
+
+void gigam_close(gigam_ctx_t* g) {
+  if (!g) return;
+  if (g->owns) db_disconnect(g->c);
+  free(g);
+}
+
+void gigam_set_scan_chunk(gigam_ctx_t* g, long rows) { g->chunk = rows > 0 ? rows : GIGAM_SCAN_CHUNK; }
+
+MYSQL* gigam_conn(gigam_ctx_t* g) { return g->c; }
+const char* gigam_errmsg(const gigam_ctx_t* g) { return g->err; }
+
+static int fail(gigam_ctx_t* g, int rc, const char* fmt, ...) {
+  va_list ap; va_start(ap, fmt);
+  vsnprintf(g->err, sizeof(g->err), fmt, ap);
+  va_end(ap);
+  return rc;
+}
+
+/* like db_exec, but the error is kept in the context instead of printed */
+static int gexec(gigam_ctx_t* g, const char* sql) {
+  if (mysql_query(g->c, sql) != 0) {
+    fail(g, GIGAM_EDB, "SQL error: %s", mysql_error(g->c));
+    return -1;
+  }
+  return 0;
+}
+
+/* market/side names -> ENUM codes, checked against the rule table */
+static const char* check_pick(const char* market, const char* side, int line_q, int line_b_q, int asian,
+                              mkt_market_t* m, mkt_side_t* sd) {
+  *m = mkt_market_code(market);
+  *sd = mkt_side_code(side);
+  if (*m == MKT_NONE || *sd == SIDE_NONE) return NULL;
+  return mkt_check(*m, *sd, line_q, line_b_q, asian);
+}
+
+/* ---------- Settlement helpers ---------- */
+
+/* *state: 0 not final, 1 final, 2 void */
+static int get_event_scores(gigam_ctx_t* g, long event_id, int* home, int* away, int* state) {
+  char q[256]; snprintf(q,sizeof(q),"SELECT home_score,away_score,(status='final')+2*(status='void') FROM events WHERE id=%ld", event_id);
+  if (gexec(g,q)!=0) return -1;
+  MYSQL_RES* r = mysql_store_result(g->c); if(!r) return -1;
+  MYSQL_ROW row = mysql_fetch_row(r);
+  if (!row) { mysql_free_result(r); return -1; }
+  *home = row[0]?atoi(row[0]):0;
+  *away = row[1]?atoi(row[1]):0;
+  *state = row[2]?atoi(row[2]):0;
+  mysql_free_result(r);
+  return 0;
+}
+
+/* ---------- Quotes & bets ---------- */
+
+/* SQL literals for line_q / line_b_q / price_b_e4 (NULL where the market has none) */
+static void line_literals(mkt_market_t m, int asian, int line_q, int line_b_q, long price_b_e4,
+                          char* line_sql, char* lineb_sql, char* priceb_sql, size_t n) {
+  unsigned fl = mkt_rules[m].flags;
+  snprintf(line_sql,n,"NULL"); snprintf(lineb_sql,n,"NULL"); snprintf(priceb_sql,n,"NULL");
+  if (fl & MKT_F_SCORE) { snprintf(line_sql,n,"%d", line_q); snprintf(lineb_sql,n,"%d", line_b_q); return; }
+  if (fl & MKT_F_LINE) snprintf(line_sql,n,"%d", line_q);
+  if (asian) { snprintf(lineb_sql,n,"%d", line_b_q); snprintf(priceb_sql,n,"%ld", price_b_e4); }
+}
+
+/* latest matching quote of the bookmaker, resolved inside the INSERT */
+static void quote_subquery(mkt_market_t m, long event_id, long bm, const char* market, const char* side,
+                           int line_q, int line_b_q, char* buf, size_t n) {
+  char match[64] = "";
+  if (mkt_rules[m].flags & MKT_F_SCORE) snprintf(match,sizeof(match)," AND line_q=%d AND line_b_q=%d",line_q,line_b_q);
+  else if (mkt_rules[m].flags & MKT_F_LINE) snprintf(match,sizeof(match)," AND COALESCE(line_q,0)=%d",line_q);
+  snprintf(buf,n,
+    "(SELECT id FROM quotes WHERE event_id=%ld AND bookmaker_id=%ld AND market_type='%s' AND side='%s'%s ORDER BY id DESC LIMIT 1)",
+    event_id,bm,market,side,match);
+}
+
+int gigam_quote_add(gigam_ctx_t* g, const gigam_quote_t* q, long long* quote_id) {
+  g->err[0] = '\0';
+  mkt_market_t m; mkt_side_t sd;
+  const char* why = check_pick(q->market, q->side, q->line_q, q->line_b_q, q->asian, &m, &sd);
+  if (!q->event_id || !q->bookmaker_id || m == MKT_NONE || sd == SIDE_NONE || q->price_e4 <= MKT_PRICE_ONE)
+    return fail(g, GIGAM_EINVAL, "quote: event_id, bookmaker_id, market, side and price > 1 required");
+  if (why) return fail(g, GIGAM_EINVAL, "quote: %s", why);
+  if (q->asian && q->price_b_e4 <= MKT_PRICE_ONE)
+    return fail(g, GIGAM_EINVAL, "asian requires: --price-b (and usually --line-b)");
+
+  char line_sql[32], lineb_sql[32], priceb_sql[32];
+  line_literals(m, q->asian, q->line_q, q->line_b_q, q->price_b_e4, line_sql, lineb_sql, priceb_sql, sizeof(line_sql));
+  char sql[1024];
+  snprintf(sql,sizeof(sql),
+    "INSERT INTO quotes(event_id,bookmaker_id,market_type,side,line_q,is_asian,line_b_q,price_e4,price_b_e4) "
+    "VALUES(%ld,%ld,'%s','%s',%s,%d,%s,%ld,%s)",
+    q->event_id,q->bookmaker_id,q->market,q->side,line_sql,q->asian ? 1 : 0,lineb_sql,q->price_e4,priceb_sql);
+  if (gexec(g,sql)!=0) return GIGAM_EDB;
+  if (quote_id) *quote_id = (long long)mysql_insert_id(g->c);
+  return GIGAM_OK;
+}
+
+static int is_bet_key(const char* k) {
+  size_t n = 0;
+  for (; k[n]; n++) {
+    char ch = k[n];
+    if (!((ch>='a'&&ch<='z') || (ch>='A'&&ch<='Z') || (ch>='0'&&ch<='9') || ch=='_' || ch=='-')) return 0;
+  }
+  return n >= 1 && n <= 64;
+}
+
+const char* gigam_bet_invalid(const gigam_bet_t* b) {
+  mkt_market_t m; mkt_side_t sd;
+  const char* why = check_pick(b->market, b->side, b->line_q, b->line_b_q, b->asian, &m, &sd);
+  if (!b->bookmaker_id || !b->event_id || !b->runner_id || !b->bettor_id ||
+      m == MKT_NONE || sd == SIDE_NONE || b->price_e4 <= MKT_PRICE_ONE || b->stake_cents <= 0)
+    return "bet: bookmaker_id, event_id, runner_id, bettor_id, market, side, price > 1 and stake required";
+  if (why) {
+    static _Thread_local char msg[96];
+    snprintf(msg, sizeof(msg), "bet: %s", why);
+    return msg;
+  }
+  if (b->bet_key && !is_bet_key(b->bet_key))
+    return "bet: bet_key must be 1-64 characters [A-Za-z0-9_-]";
+  return NULL;
+}
+
+int gigam_bet_values(const gigam_bet_t* b, char* buf, size_t n) {
+  char line_sql[32], lineb_sql[32], priceb_sql[32], key_sql[80];
+  mkt_market_t m = mkt_market_code(b->market);
+  if (m == MKT_NONE) return -1;
+  line_literals(m, b->asian, b->line_q, b->line_b_q, b->price_b_e4, line_sql, lineb_sql, priceb_sql, sizeof(line_sql));
+  if (b->bet_key) snprintf(key_sql, sizeof(key_sql), "'%s'", b->bet_key);
+  else snprintf(key_sql, sizeof(key_sql), "NULL");
+
+  char qid[512];
+  quote_subquery(m, b->event_id, b->bookmaker_id, b->market, b->side, b->line_q, b->line_b_q, qid, sizeof(qid));
+  int len = snprintf(buf, n, "(%ld,%ld,%s,%ld,'%s','%s',%s,%d,%ld,%s,%s,%ld,%ld,'open',%s)",
+    b->bookmaker_id,b->event_id,qid,b->stake_cents,b->market,b->side,line_sql,b->asian ? 1 : 0,b->price_e4,priceb_sql,lineb_sql,
+    b->runner_id,b->bettor_id,key_sql);
+  return len < 0 || (size_t)len >= n ? -1 : 0;
+}
+
+int gigam_bet_place(gigam_ctx_t* g, const gigam_bet_t* b, long long* bet_id) {
+  g->err[0] = '\0';
+  const char* why = gigam_bet_invalid(b);
+  if (why) return fail(g, GIGAM_EINVAL, "%s", why);
+
+  char row[1024], ins[1280];
+  if (gigam_bet_values(b, row, sizeof(row)) != 0) return fail(g, GIGAM_EINVAL, "bet: values too long");
+  /* a repeated bet_key returns the stored bet instead of failing */
+  snprintf(ins,sizeof(ins), "INSERT INTO bets(" GIGAM_BET_COLUMNS ") VALUES%s ON DUPLICATE KEY UPDATE id=LAST_INSERT_ID(id)", row);
+  if (gexec(g,ins)!=0) return GIGAM_EDB;
+  if (bet_id) *bet_id = (long long)mysql_insert_id(g->c);
+  return GIGAM_OK;
+}
+
+/* ---------- Settlement ---------- */
+
+/* queue a ledger posting; written by the settlement's ledger_batch_post */
+static int post(gigam_ctx_t* g, ledger_src_t src, long long source_id, long bet_id, long bm,
+                ledger_kind_t kind, long owner, long long amount) {
+  if (ledger_batch_add(g->lb, src, source_id, bet_id, bm, kind, owner, amount) != 0) {
+    fail(g, GIGAM_EDB, "out of memory");
+    return -1;
+  }
+  return 0;
+}
+
+/* rate in basis points (DECIMAL(5,2) percent * 100); rounded half up */
+static long long commission_for(const char* scheme, long rate_bp, long long stake, long long profit) {
+  if (!strcmp(scheme,"handle")) return (stake*rate_bp+5000)/10000;
+  long long net_for_book = -profit;
+  long long base = net_for_book>0?net_for_book:0;
+  return (base*rate_bp+5000)/10000;
+}
+
+/* runner commission on a settled bet (singles and parlays alike). Adds to
+ * an existing settlement row: a parlay reopened by settle correct keeps its
+ * first commission next to the adjustment row that reversed it. */
+static int book_commission(gigam_ctx_t* g, long bet_id, long bm, long runner_id, long long stake, long long profit) {
+  char qrc[512];
+  snprintf(qrc,sizeof(qrc),"SELECT commission_scheme,ROUND(commission_rate*100) FROM runners WHERE id=%ld", runner_id);
+  if (gexec(g,qrc)!=0) return -1;
+  MYSQL_RES* rr = mysql_store_result(g->c);
+  if (!rr) return 0;
+  MYSQL_ROW rw = mysql_fetch_row(rr);
+  int rc = 0;
+  if (rw){
+    const char* scheme=rw[0]?rw[0]:"net"; long rate=rw[1]?atol(rw[1]):1000;
+    long long comm=commission_for(scheme,rate,stake,profit);
+    char insc[512];
+    snprintf(insc,sizeof(insc),
+      "INSERT INTO runner_commissions(bet_id,runner_id,commission_cents,scheme,rate) VALUES(%ld,%ld,%lld,'%s',%ld.%02ld) "
+      "ON DUPLICATE KEY UPDATE commission_cents=commission_cents+VALUES(commission_cents), id=LAST_INSERT_ID(id)",
+      bet_id, runner_id, (long long)comm, scheme, rate/100, rate%100);
+    rc = gexec(g,insc);
+    if (rc==0) rc = post(g, LEDGER_COMMISSION, (long long)mysql_insert_id(g->c), bet_id, bm, LEDGER_RUNNER, runner_id, comm);
+  }
+  mysql_free_result(rr);
+  return rc;
+}
+
+static int settle_legs(gigam_ctx_t* g, long event_id, int hs, int as, int is_void, long* last, long* n, long long* settled);
+
+/* One keyset chunk of the event's open singles: ids after *last, at most
+ * g->chunk of them; *n is how many were read. */
+static int settle_singles(gigam_ctx_t* g, long event_id, int hs, int as, int is_void, long* last, long* n, long long* settled) {
+  /* market_type+0 / pick_side+0: ENUM codes, indexes into mkt_rules */
+  char qb[384];
+  snprintf(qb,sizeof(qb),
+    "SELECT id,market_type+0,pick_side+0,COALESCE(line_q,0),is_asian,COALESCE(line_b_q,0),price_e4,COALESCE(price_b_e4,0),stake_cents,runner_id,bookmaker_id,bettor_id "
+    "FROM bets WHERE event_id=%ld AND status='open' AND bet_type='single' AND id>%ld ORDER BY id LIMIT %ld", event_id, *last, g->chunk);
+  if (gexec(g,qb)!=0) return -1;
+  MYSQL_RES* r = mysql_store_result(g->c);
+
+  MYSQL_ROW row;
+  while(r && (row=mysql_fetch_row(r))){
+    long bet_id=atol(row[0]);
+    *last = bet_id; (*n)++;
+    mkt_bet_t b = { (mkt_market_t)atoi(row[1]), (mkt_side_t)atoi(row[2]), atoi(row[3]), atoi(row[5]),
+                    atol(row[6]), atol(row[7]), atoi(row[4]), atoll(row[8]) };
+    long long stake=b.stake_cents; long runner_id=atol(row[9]), bm=atol(row[10]), bettor_id=atol(row[11]);
+    char up[512];
+    if (is_void) {
+      /* called off: stake back, no commission */
+      snprintf(up,sizeof(up),
+        "UPDATE bets SET status='void', result='push', payout_cents=%lld, profit_cents=0, settled_at=NOW() WHERE id=%ld AND status='open'",
+        stake, bet_id);
+      if (gexec(g,up)!=0){ mysql_free_result(r); return -1; }
+      if (mysql_affected_rows(g->c)==1) (*settled)++;
+      continue;
+    }
+    long long payout=0, profit=0;
+    mkt_settle(&b,hs,as,&payout,&profit);
+    const char* result = profit>0 ? "win" : (profit<0 ? "lose" : "push");
+
+    /* status guard: a concurrent settler of the same event books nothing twice */
+    snprintf(up,sizeof(up),
+      "UPDATE bets SET status='settled', result='%s', payout_cents=%lld, profit_cents=%lld, settled_at=NOW() WHERE id=%ld AND status='open'",
+      result, (long long)payout, (long long)profit, bet_id);
+    if (gexec(g,up)!=0){ mysql_free_result(r); return -1; }
+    if (mysql_affected_rows(g->c)!=1) continue;
+    if (post(g,LEDGER_SETTLEMENT,bet_id,bet_id,bm,LEDGER_BETTOR,bettor_id,-profit)!=0 ||
+        book_commission(g,bet_id,bm,runner_id,stake,profit)!=0){ mysql_free_result(r); return -1; }
+    (*settled)++;
+  }
+  if (r) mysql_free_result(r);
+  return 0;
+}
+
+/* Singles first, then the open parlay legs, each read in keyset chunks of
+ * g->chunk rows. A chunk is one transaction: its bets, their commissions
+ * and the ledger postings, which go last so account rows are locked only
+ * briefly and in a fixed order. Memory and the undo a transaction holds
+ * are bounded by the chunk, not the event. */
+int gigam_settle_event(gigam_ctx_t* g, long event_id, long long* settled) {
+  g->err[0] = '\0';
+  if (settled) *settled = 0;
+  if (!event_id) return fail(g, GIGAM_EINVAL, "required: event_id");
+  int hs=0,as=0,state=0;
+  if(get_event_scores(g,event_id,&hs,&as,&state)!=0){
+    if (!g->err[0]) fail(g, GIGAM_EDB, "event not found");
+    return GIGAM_EDB;
+  }
+  if(!state) return fail(g, GIGAM_EINVAL, "event not final; use event set-score --final");
+  int is_void = state == 2;
+
+  ledger_batch_t* lb = ledger_batch_new();
+  if (!lb) return fail(g, GIGAM_EDB, "out of memory");
+  int rc = GIGAM_OK;
+  long last = 0;
+  for (int legs = 0; legs < 2 && rc == GIGAM_OK; ) {
+    long n = 0; long long done = 0;
+    if (gexec(g,"START TRANSACTION")!=0) { rc = GIGAM_EDB; break; }
+    g->lb = lb;
+    int r = legs ? settle_legs(g,event_id,hs,as,is_void,&last,&n,&done)
+                 : settle_singles(g,event_id,hs,as,is_void,&last,&n,&done);
+    if (r != 0) rc = GIGAM_EDB;
+    else if (ledger_batch_post(g->c, lb)!=0) rc = fail(g, GIGAM_EDB, "ledger: %s", mysql_error(g->c));
+    else if (gexec(g,"COMMIT")!=0) rc = GIGAM_EDB;
+    g->lb = NULL;
+    if (rc != GIGAM_OK) break;
+    if (settled) *settled += done;
+    if (n < g->chunk) { legs++; last = 0; }
+  }
+  ledger_batch_free(lb);
+  if (rc == GIGAM_OK) return GIGAM_OK;
+  if (mysql_query(g->c,"ROLLBACK")!=0) { /* keep the first error */ }
+  return rc;
+}
+
+/* ---------- Risk ---------- */
+
+int gigam_risk_event(gigam_ctx_t* g, long event_id, gigam_exposure_t* ex) {
+  g->err[0] = '\0';
+  memset(ex, 0, sizeof(*ex));
+  if (!event_id) return fail(g, GIGAM_EINVAL, "required: event_id");
+
+  /* book P&L per final score, from the same rules settlement uses; read in
+   * keyset chunks so memory stays flat however large the event */
+  enum { N = GIGAM_RISK_GOALS };
+  for (long last = 0, n = g->chunk; n == g->chunk; ) {
+    char qb[384];
+    /* singles only: a parlay's row carries leg 1 at the combined price (gigam_risk_parlays) */
+    snprintf(qb,sizeof(qb),
+      "SELECT id,market_type+0,pick_side+0,COALESCE(line_q,0),is_asian,COALESCE(line_b_q,0),price_e4,COALESCE(price_b_e4,0),stake_cents "
+      "FROM bets WHERE event_id=%ld AND status='open' AND bet_type='single' AND id>%ld ORDER BY id LIMIT %ld", event_id, last, g->chunk);
+    if (gexec(g,qb)!=0) return GIGAM_EDB;
+    MYSQL_RES* r = mysql_store_result(g->c); if(!r) break;
+    n = 0;
+    MYSQL_ROW row;
+    while((row=mysql_fetch_row(r))){
+      last = atol(row[0]); n++;
+      mkt_bet_t b = { (mkt_market_t)atoi(row[1]), (mkt_side_t)atoi(row[2]), atoi(row[3]), atoi(row[5]),
+                      atol(row[6]), atol(row[7]), atoi(row[4]), atoll(row[8]) };
+      for (int h=0;h<N;h++) for (int a=0;a<N;a++) {
+        long long payout, profit;
+        mkt_settle(&b,h,a,&payout,&profit);
+        ex->grid[h][a] -= profit;
+      }
+    }
+    mysql_free_result(r);
+  }
+  gigam_exposure_scenarios(ex);
+  return GIGAM_OK;
+}
+
+void gigam_exposure_scenarios(gigam_exposure_t* ex) {
+  /* scenario = worst score inside it; over/under split at 2.5 goals */
+  enum { N = GIGAM_RISK_GOALS };
+  int first[5] = {1,1,1,1,1};
+  long long* bucket[5] = { &ex->home, &ex->away, &ex->draw, &ex->over, &ex->under };
+  ex->worst = ex->grid[0][0]; ex->worst_home = ex->worst_away = 0;
+  for (int h=0;h<N;h++) for (int a=0;a<N;a++) {
+    long long v = ex->grid[h][a];
+    int in[5] = { h>a, a>h, h==a, h+a>2, h+a<=2 };
+    for (int k=0;k<5;k++) if (in[k] && (first[k] || v < *bucket[k])) { *bucket[k] = v; first[k] = 0; }
+    if (v < ex->worst) { ex->worst = v; ex->worst_home = h; ex->worst_away = a; }
+  }
+}
+
+/* ---------- Parlays ---------- */
+
+static int cmp_long(const void* a, const void* b) {
+  long x = *(const long*)a, y = *(const long*)b;
+  return (x > y) - (x < y);
+}
+
+/* Settle an open parlay once it is decided: a lost leg decides it at once,
+ * otherwise it waits for the last leg. Void/push legs count as 1.0, so the
+ * parlay pays at the product of the remaining legs. The legs are a locking
+ * read, so a leg another settlement just committed is seen. */
+static int settle_parlay(gigam_ctx_t* g, long bet_id, long long* settled) {
+  char q[320];
+  snprintf(q,sizeof(q),
+    "SELECT b.stake_cents,b.runner_id,l.status,COALESCE(l.factor_e6,%lld),b.bookmaker_id,b.bettor_id FROM bets b JOIN bet_legs l ON l.bet_id=b.id "
+    "WHERE b.id=%ld AND b.status='open' ORDER BY l.leg_no FOR UPDATE", MKT_FACTOR_ONE, bet_id);
+  if (gexec(g,q)!=0) return -1;
+  MYSQL_RES* r = mysql_store_result(g->c);
+  if (!r) return 0;
+  long long stake=0, payout=0; long runner_id=0, bm=0, bettor_id=0; int legs=0, open=0, voided=0, dead=0;
+  MYSQL_ROW row;
+  while((row=mysql_fetch_row(r))){
+    if (!legs) payout=stake=atoll(row[0]);
+    runner_id=atol(row[1]); bm=atol(row[4]); bettor_id=atol(row[5]); legs++;
+    if (!strcmp(row[2],"open")) { open++; continue; }
+    if (!strcmp(row[2],"void")) voided++;
+    long long f=atoll(row[3]);
+    if (f<=0) dead=1;
+    payout=mkt_apply_factor(payout,f);
+  }
+  mysql_free_result(r);
+  if (!legs || (open && !dead)) return 0;
+
+  if (dead) payout = 0;
+  long long profit = payout - stake;
+  int all_void = voided==legs;
+  const char* result = profit>0 ? "win" : (profit<0 ? "lose" : "push");
+  char up[512];
+  snprintf(up,sizeof(up),
+    "UPDATE bets SET status='%s', result='%s', payout_cents=%lld, profit_cents=%lld, settled_at=NOW() WHERE id=%ld AND status='open'",
+    all_void ? "void" : "settled", result, payout, profit, bet_id);
+  if (gexec(g,up)!=0) return -1;
+  if (mysql_affected_rows(g->c)!=1) return 0;
+  if (post(g,LEDGER_SETTLEMENT,bet_id,bet_id,bm,LEDGER_BETTOR,bettor_id,-profit)!=0) return -1;
+  if (!all_void && book_commission(g,bet_id,bm,runner_id,stake,profit)!=0) return -1;
+  if (settled) (*settled)++;
+  return 0;
+}
+
+/* Lock the parlay rows (sorted, unique ids) in ascending id order. Two
+ * events settling legs of the same parlay then queue on its bets row, and
+ * the later one sees the earlier one's leg as settled. */
+static int lock_parlays(gigam_ctx_t* g, const long* bets, size_t nb) {
+  if (!nb) return 0;
+  char* sql = NULL; size_t len = 0;
+  FILE* f = open_memstream(&sql, &len);
+  if (!f) { fail(g, GIGAM_EDB, "out of memory"); return -1; }
+  fputs("SELECT id FROM bets WHERE id IN (", f);
+  for (size_t i=0;i<nb;i++) fprintf(f, "%s%ld", i ? "," : "", bets[i]);
+  fputs(") ORDER BY id FOR UPDATE", f);
+  fclose(f);
+  int rc = gexec(g,sql);
+  free(sql);
+  if (rc!=0) return -1;
+  MYSQL_RES* r = mysql_store_result(g->c);
+  if (r) mysql_free_result(r);
+  return 0;
+}
+
+/* One keyset chunk of the event's open parlay legs, then the parlays they
+ * belong to (a parlay has at most one leg per event). The parlays are
+ * locked before any of their legs is written. */
+static int settle_legs(gigam_ctx_t* g, long event_id, int hs, int as, int is_void, long* last, long* n, long long* settled) {
+  char q[384];
+  snprintf(q,sizeof(q),
+    "SELECT id,bet_id,market_type+0,pick_side+0,COALESCE(line_q,0),is_asian,COALESCE(line_b_q,0),price_e4,COALESCE(price_b_e4,0) "
+    "FROM bet_legs WHERE event_id=%ld AND status='open' AND id>%ld ORDER BY id LIMIT %ld", event_id, *last, g->chunk);
+  if (gexec(g,q)!=0) return -1;
+  MYSQL_RES* r = mysql_store_result(g->c);
+  if (!r) return 0;
+  size_t rows = (size_t)mysql_num_rows(r);
+  long* bets = (long*)malloc((rows ? rows : 1) * sizeof(long));
+  if (!bets) { mysql_free_result(r); fail(g, GIGAM_EDB, "out of memory"); return -1; }
+  size_t nb = 0;
+  MYSQL_ROW row;
+  while((row=mysql_fetch_row(r))) bets[nb++] = atol(row[1]);
+  qsort(bets, nb, sizeof(long), cmp_long);
+  size_t nu = 0;
+  for (size_t i=0;i<nb;i++) if (!nu || bets[i]!=bets[nu-1]) bets[nu++] = bets[i];
+  if (lock_parlays(g,bets,nu)!=0) { free(bets); mysql_free_result(r); return -1; }
+
+  mysql_data_seek(r,0);
+  while((row=mysql_fetch_row(r))){
+    mkt_bet_t leg = { (mkt_market_t)atoi(row[2]), (mkt_side_t)atoi(row[3]), atoi(row[4]), atoi(row[6]),
+                      atol(row[7]), atol(row[8]), atoi(row[5]), 0 };
+    long long f = is_void ? MKT_FACTOR_ONE : mkt_leg_factor(&leg,hs,as);
+    const char* result = f>MKT_FACTOR_ONE ? "win" : (f<MKT_FACTOR_ONE ? "lose" : "push");
+    char up[256];
+    snprintf(up,sizeof(up),"UPDATE bet_legs SET status='%s', result='%s', factor_e6=%lld WHERE id=%ld",
+      is_void ? "void" : "settled", result, f, atol(row[0]));
+    if (gexec(g,up)!=0) { free(bets); mysql_free_result(r); return -1; }
+    *last = atol(row[0]); (*n)++;
+  }
+  mysql_free_result(r);
+
+  int rc = 0;
+  for (size_t i=0;i<nu && rc==0;i++) rc = settle_parlay(g,bets[i],settled);
+  free(bets);
+  return rc;
+}
+
+int gigam_parlay_place(gigam_ctx_t* g, const gigam_parlay_t* p, long long* bet_id) {
+  g->err[0] = '\0';
+  if (!p->bookmaker_id || !p->runner_id || !p->bettor_id || p->stake_cents <= 0 || !p->legs)
+    return fail(g, GIGAM_EINVAL, "parlay: bookmaker_id, runner_id, bettor_id and stake required");
+  if (p->nlegs < 2 || p->nlegs > GIGAM_PARLAY_MAX_LEGS)
+    return fail(g, GIGAM_EINVAL, "parlay: 2 to %d legs", GIGAM_PARLAY_MAX_LEGS);
+  if (p->bet_key && !is_bet_key(p->bet_key))
+    return fail(g, GIGAM_EINVAL, "parlay: bet_key must be 1-64 characters [A-Za-z0-9_-]");
+  long price = MKT_PRICE_ONE;
+  mkt_market_t codes[GIGAM_PARLAY_MAX_LEGS];
+  for (int i=0;i<p->nlegs;i++) {
+    const gigam_leg_t* l = &p->legs[i];
+    mkt_side_t sd;
+    const char* why = check_pick(l->market, l->side, l->line_q, l->line_b_q, l->asian, &codes[i], &sd);
+    if (!l->event_id || codes[i] == MKT_NONE || sd == SIDE_NONE || l->price_e4 <= MKT_PRICE_ONE)
+      return fail(g, GIGAM_EINVAL, "parlay: leg %d needs event_id, market, side and price > 1", i+1);
+    if (why) return fail(g, GIGAM_EINVAL, "parlay: leg %d: %s", i+1, why);
+    /* legs on one event are correlated; the price would be wrong */
+    for (int k=0;k<i;k++) if (p->legs[k].event_id == l->event_id)
+      return fail(g, GIGAM_EINVAL, "parlay: legs %d and %d are on the same event", k+1, i+1);
+    /* offered price only (settlement uses the leg factors), rounded half up per leg */
+    long lp = l->asian && l->price_b_e4 > MKT_PRICE_ONE ? (l->price_e4 + l->price_b_e4 + 1) / 2 : l->price_e4;
+    /* price <= the cap and lp <= 10000.0 before each step: the product fits */
+    price = (long)(((long long)price * lp + MKT_PRICE_ONE / 2) / MKT_PRICE_ONE);
+    if (price > GIGAM_PARLAY_MAX_PRICE_E4)
+      return fail(g, GIGAM_EINVAL, "parlay: combined price above %ld", GIGAM_PARLAY_MAX_PRICE_E4 / MKT_PRICE_ONE);
+  }
+  if ((long long)p->stake_cents > GIGAM_PARLAY_MAX_PAYOUT * MKT_PRICE_ONE / price)
+    return fail(g, GIGAM_EINVAL, "parlay: potential payout above %lld.00", GIGAM_PARLAY_MAX_PAYOUT / 100);
+
+  char ls[32], lbs[32], pbs[32], key_sql[80], sql[1024];
+  const gigam_leg_t* l0 = &p->legs[0];
+  line_literals(codes[0], l0->asian, l0->line_q, l0->line_b_q, l0->price_b_e4, ls, lbs, pbs, sizeof(ls));
+  if (p->bet_key) snprintf(key_sql, sizeof(key_sql), "'%s'", p->bet_key);
+  else snprintf(key_sql, sizeof(key_sql), "NULL");
+
+  if (gexec(g,"START TRANSACTION")!=0) return GIGAM_EDB;
+  /* event/market/side of the bets row repeat leg 1; the legs are in bet_legs */
+  snprintf(sql,sizeof(sql),
+    "INSERT INTO bets(bookmaker_id,event_id,stake_cents,market_type,pick_side,line_q,is_asian,price_e4,price_b_e4,line_b_q,"
+    "runner_id,bettor_id,status,bet_key,bet_type) VALUES(%ld,%ld,%ld,'%s','%s',%s,%d,%ld,NULL,%s,%ld,%ld,'open',%s,'parlay') "
+    "ON DUPLICATE KEY UPDATE id=LAST_INSERT_ID(id)",
+    p->bookmaker_id, l0->event_id, p->stake_cents, l0->market, l0->side, ls, l0->asian ? 1 : 0, price, lbs,
+    p->runner_id, p->bettor_id, key_sql);
+  if (gexec(g,sql)!=0) goto rollback;
+  long long id = (long long)mysql_insert_id(g->c);
+  if (mysql_affected_rows(g->c) == 1) {
+    char* ins = NULL; size_t len = 0;
+    FILE* f = open_memstream(&ins, &len);
+    if (!f) { fail(g, GIGAM_EDB, "out of memory"); goto rollback; }
+    fputs("INSERT INTO bet_legs(bet_id,leg_no,event_id,quote_id,market_type,pick_side,line_q,is_asian,line_b_q,price_e4,price_b_e4) VALUES", f);
+    for (int i=0;i<p->nlegs;i++) {
+      const gigam_leg_t* l = &p->legs[i];
+      char qid[512];
+      line_literals(codes[i], l->asian, l->line_q, l->line_b_q, l->price_b_e4, ls, lbs, pbs, sizeof(ls));
+      quote_subquery(codes[i], l->event_id, p->bookmaker_id, l->market, l->side, l->line_q, l->line_b_q, qid, sizeof(qid));
+      fprintf(f, "%s(%lld,%d,%ld,%s,'%s','%s',%s,%d,%s,%ld,%s)", i ? "," : "",
+        id, i+1, l->event_id, qid, l->market, l->side, ls, l->asian ? 1 : 0, lbs, l->price_e4, pbs);
+    }
+    fclose(f);
+    int bad = mysql_real_query(g->c, ins, (unsigned long)len) != 0;
+    free(ins);
+    if (bad) { fail(g, GIGAM_EDB, "SQL error: %s", mysql_error(g->c)); goto rollback; }
+  }
+  if (gexec(g,"COMMIT")!=0) goto rollback;
+  if (bet_id) *bet_id = id;
+  return GIGAM_OK;
+
+rollback:
+  if (mysql_query(g->c,"ROLLBACK")!=0) { /* keep the first error */ }
+  return GIGAM_EDB;
+}
+
+/* ---------- Parlay risk ---------- */
+
+/* Each event's 10x10 score grid collapses into outcome classes: scores on
+ * which every open leg of that event pays the same. A leg is then a few
+ * bitmasks over its event's classes (one per non-zero return), and a joint
+ * scenario is one class per event.
+ *
+ * Events that share no parlay are independent: the events split into
+ * components (union-find over each parlay's legs) and the worst case is
+ * the sum of each component's. Within a component a depth-first branch
+ * and bound picks one class per event. Every parlay carries an upper
+ * bound, its payout so far through its remaining legs at their best
+ * return, and a branch whose bounds cannot beat the worst payout found so
+ * far is cut. Past the node budget a component stops at its first
+ * complete scenario, and what it left unexplored is reported as a bound. */
+
+#define RISK_CELLS (GIGAM_RISK_GOALS * GIGAM_RISK_GOALS)
+#define RISK_NODES_MAX (1LL << 22)
+
+typedef struct { uint64_t mask[2]; long long f; } leg_out_t;   /* f: mkt_leg_factor */
+
+typedef struct {
+  int parlay, event;
+  mkt_bet_t b;
+  leg_out_t out[4];        /* win / half win / push / half lose */
+  int nout;
+  long long fmax;          /* best return over the event's classes */
+  int next, prev;          /* the parlay's next / previous open leg in search order; -1 */
+} risk_leg_t;
+
+typedef struct {
+  long id;
+  int nclass;
+  int rep[RISK_CELLS];     /* a representative score cell per class */
+  int* legs; int nlegs;    /* indexes into the leg array */
+  int off;                 /* this event's slice of saved / saved_ub */
+  int comp;                /* root event of its component */
+  int depth;               /* its place in its component's search order */
+} risk_event_t;
+
+typedef struct {
+  long long stake;
+  long long fixed;         /* payout after the already settled legs */
+  int lo, n;               /* its open legs: legs[lo..lo+n) */
+  int rlo, rn;             /* all its legs in leg_no order: rf[rlo..rlo+rn) */
+  int first;               /* first open leg in search order; -1: none */
+} risk_parlay_t;
+
+typedef struct {
+  risk_event_t* ev; int nev;
+  risk_leg_t* legs;
+  risk_parlay_t* par; int npar;
+  long long* mult;         /* per parlay: payout after the legs on the path */
+  long long* ub;           /* per parlay: mult through its remaining legs at fmax */
+  long long* saved;        /* mult and ub before the current event, per leg */
+  long long* saved_ub;
+  const int* order; int nord;   /* the component being searched */
+  int* cls;                /* per depth: classes in the order tried */
+  long long* cls_ub;       /* per depth and class: the bound after choosing it */
+  int* pick;               /* class per event on the current path */
+  int* best_pick;
+  long long best; int have_best;
+  long long open_ub;       /* the best bound left unexplored when the budget ran out */
+  long long nodes;
+} risk_walk_t;
+
+static long long leg_out_factor(const risk_leg_t* l, int cls) {
+  for (int k=0;k<l->nout;k++) if (l->out[k].mask[cls >> 6] & (1ULL << (cls & 63))) return l->out[k].f;
+  return 0;
+}
+
+/* v through the legs after l, each at its best; mkt_apply_factor is
+ * monotone, so no path through those legs pays more */
+static long long leg_bound(const risk_walk_t* w, int l, long long v) {
+  for (int k=w->legs[l].next; k>=0; k=w->legs[k].next) v = mkt_apply_factor(v, w->legs[k].fmax);
+  return v;
+}
+
+/* A tighter bound than the sum of ub: each parlay still open is charged
+ * to its next leg's event, and every event below depth takes its best
+ * class for the parlays charged to it alone. Parlays charged to different
+ * events may want different classes of one event, but never two parlays
+ * at the same event. */
+static long long risk_bound(const risk_walk_t* w, int depth, long long paid) {
+  long long b = paid, acc[RISK_CELLS];
+  for (int d=depth;d<w->nord;d++) {
+    const risk_event_t* ev = &w->ev[w->order[d]];
+    int any = 0;
+    for (int i=0;i<ev->nlegs;i++) {
+      const risk_leg_t* l = &w->legs[ev->legs[i]];
+      if (l->prev >= 0 && w->ev[w->legs[l->prev].event].depth >= depth) continue;
+      long long m = w->mult[l->parlay];
+      b -= m;
+      if (!m) continue;
+      if (!any) { memset(acc, 0, (size_t)ev->nclass * sizeof(long long)); any = 1; }
+      for (int c=0;c<ev->nclass;c++) acc[c] += leg_bound(w, ev->legs[i], mkt_apply_factor(m, leg_out_factor(l, c)));
+    }
+    if (!any) continue;
+    long long mx = 0;
+    for (int c=0;c<ev->nclass;c++) if (acc[c] > mx) mx = acc[c];
+    b += mx;
+  }
+  return b;
+}
+
+/* paid = sum of mult, bound = sum of ub; a node only touches its event's
+ * legs (one per parlay). Open legs round in search order rather than
+ * leg_no order, a cent or so per parlay; the scenario found is repriced
+ * in leg_no order at the end. -1 once the node budget is spent, with open_ub raised to the
+ * bound of every branch given up. */
+static int risk_walk(risk_walk_t* w, int depth, long long paid, long long bound) {
+  if (w->have_best && bound <= w->best) return 0;
+  if (++w->nodes > RISK_NODES_MAX && w->have_best) {
+    if (bound > w->open_ub) w->open_ub = bound;
+    return -1;
+  }
+  if (w->have_best && depth < w->nord && risk_bound(w, depth, paid) <= w->best) return 0;
+  if (depth == w->nord) {
+    w->best = paid; w->have_best = 1;
+    for (int i=0;i<w->nord;i++) w->best_pick[w->order[i]] = w->pick[w->order[i]];
+    return 0;
+  }
+  int e = w->order[depth];
+  const risk_event_t* ev = &w->ev[e];
+  long long* saved = w->saved + ev->off;
+  long long* saved_ub = w->saved_ub + ev->off;
+  int* cls = w->cls + (size_t)depth * RISK_CELLS;
+  long long* cub = w->cls_ub + (size_t)depth * RISK_CELLS;
+  for (int i=0;i<ev->nlegs;i++) {
+    int p = w->legs[ev->legs[i]].parlay;
+    saved[i] = w->mult[p]; saved_ub[i] = w->ub[p];
+  }
+  /* the most promising class first, so a bad case for the book turns up early */
+  for (int c=0;c<ev->nclass;c++) {
+    long long b = bound;
+    for (int i=0;i<ev->nlegs;i++) {
+      int l = ev->legs[i];
+      b += leg_bound(w, l, mkt_apply_factor(saved[i], leg_out_factor(&w->legs[l], c))) - saved_ub[i];
+    }
+    int k = c;
+    while (k && cub[k-1] < b) { cub[k] = cub[k-1]; cls[k] = cls[k-1]; k--; }
+    cub[k] = b; cls[k] = c;
+  }
+  int rc = 0;
+  for (int k=0;k<ev->nclass && rc==0;k++) {
+    if (w->have_best && cub[k] <= w->best) break;
+    int c = cls[k];
+    long long pd = paid;
+    for (int i=0;i<ev->nlegs;i++) {
+      int l = ev->legs[i], p = w->legs[l].parlay;
+      long long v = mkt_apply_factor(saved[i], leg_out_factor(&w->legs[l], c));
+      pd += v - saved[i];
+      w->mult[p] = v; w->ub[p] = leg_bound(w, l, v);
+    }
+    w->pick[e] = c;
+    rc = risk_walk(w, depth + 1, pd, cub[k]);
+    if (rc && cub[k] > w->open_ub) w->open_ub = cub[k];   /* the classes after k bound no higher */
+  }
+  for (int i=0;i<ev->nlegs;i++) {
+    int p = w->legs[ev->legs[i]].parlay;
+    w->mult[p] = saved[i]; w->ub[p] = saved_ub[i];
+  }
+  return rc;
+}
+
+static int uf_root(int* uf, int x) {
+  while (uf[x] != x) { uf[x] = uf[uf[x]]; x = uf[x]; }
+  return x;
+}
+
+/* search order: by component, and within one the events with most legs first */
+typedef struct { int comp, nlegs, ev; } risk_ord_t;
+
+static int cmp_risk_ord(const void* a, const void* b) {
+  const risk_ord_t* x = a; const risk_ord_t* y = b;
+  if (x->comp != y->comp) return x->comp < y->comp ? -1 : 1;
+  if (x->nlegs != y->nlegs) return x->nlegs > y->nlegs ? -1 : 1;
+  return x->ev < y->ev ? -1 : x->ev > y->ev;
+}
+
+int gigam_risk_parlays(gigam_ctx_t* g, long bookmaker_id, gigam_parlay_risk_t* out) {
+  g->err[0] = '\0';
+  memset(out, 0, sizeof(*out));
+  char bm[64] = "";
+  if (bookmaker_id) snprintf(bm, sizeof(bm), " AND b.bookmaker_id=%ld", bookmaker_id);
+  char q[768];
+  snprintf(q,sizeof(q),
+    "SELECT l.bet_id,b.stake_cents,l.event_id,l.status,COALESCE(l.factor_e6,%lld),l.market_type+0,l.pick_side+0,COALESCE(l.line_q,0),"
+    "l.is_asian,COALESCE(l.line_b_q,0),l.price_e4,COALESCE(l.price_b_e4,0) "
+    "FROM bet_legs l JOIN bets b ON b.id=l.bet_id WHERE b.bet_type='parlay' AND b.status='open'%s ORDER BY l.bet_id,l.leg_no", MKT_FACTOR_ONE, bm);
+  if (gexec(g,q)!=0) return GIGAM_EDB;
+  MYSQL_RES* r = mysql_store_result(g->c);
+  if (!r) return GIGAM_OK;
+  size_t nrows = (size_t)mysql_num_rows(r);
+  if (!nrows) { mysql_free_result(r); return GIGAM_OK; }
+
+  risk_walk_t w; memset(&w, 0, sizeof(w));
+  hmap_t evix; hmap_init(&evix, sizeof(int));   /* event id -> index in w.ev */
+  int* uf = NULL; risk_ord_t* ord = NULL; int* order = NULL;
+  long long* rf = (long long*)malloc(nrows * sizeof(long long));   /* settled leg factors; -1: open */
+  long long* comp_paid = NULL; long long* comp_ub = NULL;
+  w.legs = (risk_leg_t*)calloc(nrows, sizeof(risk_leg_t));
+  w.par = (risk_parlay_t*)calloc(nrows, sizeof(risk_parlay_t));
+  w.ev = (risk_event_t*)calloc(nrows, sizeof(risk_event_t));
+  int rc = GIGAM_OK, nlegs = 0;
+  int nrf = 0;
+  if (!w.legs || !w.par || !w.ev || !rf) { rc = fail(g, GIGAM_EDB, "out of memory"); goto done; }
+
+  long last_bet = 0;
+  MYSQL_ROW row;
+  while((row=mysql_fetch_row(r))){
+    long bid = atol(row[0]);
+    if (bid != last_bet) {
+      risk_parlay_t* np = &w.par[w.npar++];
+      np->stake = np->fixed = atoll(row[1]);
+      np->lo = nlegs; np->rlo = nrf; np->first = -1;
+      last_bet = bid;
+      out->stake_cents += atoll(row[1]);
+    }
+    risk_parlay_t* p = &w.par[w.npar - 1];
+    p->rn++;
+    if (strcmp(row[3],"open")) { rf[nrf++] = atoll(row[4]); p->fixed = mkt_apply_factor(p->fixed, rf[nrf-1]); continue; }
+    rf[nrf++] = -1;
+    bool created = false;
+    int* ix = (int*)hmap_put(&evix, atoll(row[2]), &created);
+    if (!ix) { rc = fail(g, GIGAM_EDB, "out of memory"); goto done; }
+    if (created) { *ix = w.nev; w.ev[w.nev].id = atol(row[2]); w.nev++; }
+    risk_leg_t* l = &w.legs[nlegs++];
+    l->parlay = w.npar - 1; l->event = *ix; l->next = -1;
+    l->b = (mkt_bet_t){ (mkt_market_t)atoi(row[5]), (mkt_side_t)atoi(row[6]), atoi(row[7]), atoi(row[9]),
+                        atol(row[10]), atol(row[11]), atoi(row[8]), 0 };
+    w.ev[*ix].nlegs++;
+    p->n++;
+  }
+  out->parlays = w.npar; out->legs = nlegs; out->events = w.nev;
+
+  /* each event's legs, in one pass */
+  for (int e=0;e<w.nev;e++) w.ev[e].off = e ? w.ev[e-1].off + w.ev[e-1].nlegs : 0;
+  for (int e=0;e<w.nev;e++) {
+    if (!(w.ev[e].legs = (int*)malloc((size_t)w.ev[e].nlegs * sizeof(int)))) { rc = fail(g, GIGAM_EDB, "out of memory"); goto done; }
+    w.ev[e].nlegs = 0;
+  }
+  for (int i=0;i<nlegs;i++) { risk_event_t* ev = &w.ev[w.legs[i].event]; ev->legs[ev->nlegs++] = i; }
+
+  /* classes per event, and each leg's returns as bitmasks over them */
+  for (int e=0;e<w.nev;e++) {
+    risk_event_t* ev = &w.ev[e];
+    long long* f = (long long*)malloc((size_t)ev->nlegs * RISK_CELLS * sizeof(long long));
+    if (!f) { rc = fail(g, GIGAM_EDB, "out of memory"); goto done; }
+    for (int c=0;c<RISK_CELLS;c++)
+      for (int i=0;i<ev->nlegs;i++) f[(size_t)i*RISK_CELLS + c] = mkt_leg_factor(&w.legs[ev->legs[i]].b, c / GIGAM_RISK_GOALS, c % GIGAM_RISK_GOALS);
+    for (int c=0;c<RISK_CELLS;c++) {
+      int cls = 0;
+      for (; cls<ev->nclass; cls++) {
+        int same = 1;
+        for (int i=0;i<ev->nlegs && same;i++) same = f[(size_t)i*RISK_CELLS + c] == f[(size_t)i*RISK_CELLS + ev->rep[cls]];
+        if (same) break;
+      }
+      if (cls == ev->nclass) ev->rep[ev->nclass++] = c;
+      for (int i=0;i<ev->nlegs;i++) {
+        risk_leg_t* l = &w.legs[ev->legs[i]];
+        long long v = f[(size_t)i*RISK_CELLS + c];
+        if (v > l->fmax) l->fmax = v;
+        if (v <= 0) continue;
+        int o = 0;
+        while (o < l->nout && l->out[o].f != v) o++;
+        if (o == l->nout) { if (l->nout == 4) continue; l->out[l->nout++].f = v; }
+        l->out[o].mask[cls >> 6] |= 1ULL << (cls & 63);
+      }
+    }
+    free(f);
+  }
+
+  /* components: events joined by a parlay's legs */
+  uf = (int*)malloc((size_t)w.nev * sizeof(int));
+  ord = (risk_ord_t*)malloc((size_t)w.nev * sizeof(risk_ord_t));
+  order = (int*)malloc((size_t)w.nev * sizeof(int));
+  comp_paid = (long long*)calloc((size_t)w.nev, sizeof(long long));
+  comp_ub = (long long*)calloc((size_t)w.nev, sizeof(long long));
+  if (!uf || !ord || !order || !comp_paid || !comp_ub) { rc = fail(g, GIGAM_EDB, "out of memory"); goto done; }
+  for (int e=0;e<w.nev;e++) uf[e] = e;
+  for (int p=0;p<w.npar;p++)
+    for (int i=1;i<w.par[p].n;i++) {
+      int a = uf_root(uf, w.legs[w.par[p].lo].event), b = uf_root(uf, w.legs[w.par[p].lo + i].event);
+      if (a != b) uf[a < b ? b : a] = a < b ? a : b;
+    }
+  for (int e=0;e<w.nev;e++) { w.ev[e].comp = uf_root(uf, e); ord[e] = (risk_ord_t){ w.ev[e].comp, w.ev[e].nlegs, e }; }
+  qsort(ord, (size_t)w.nev, sizeof(risk_ord_t), cmp_risk_ord);
+  for (int k=0,start=0;k<w.nev;k++) {
+    if (ord[k].comp != ord[start].comp) start = k;
+    order[k] = ord[k].ev; uf[ord[k].ev] = k;   /* uf: now the place in the order */
+    w.ev[ord[k].ev].depth = k - start;
+  }
+
+  /* each parlay's open legs chained in search order, and its bound */
+  long long const_paid = 0;
+  w.mult = (long long*)malloc((size_t)w.npar * sizeof(long long));
+  w.ub = (long long*)malloc((size_t)w.npar * sizeof(long long));
+  if (!w.mult || !w.ub) { rc = fail(g, GIGAM_EDB, "out of memory"); goto done; }
+  for (int p=0;p<w.npar;p++) {
+    risk_parlay_t* pp = &w.par[p];
+    int chain[GIGAM_PARLAY_MAX_LEGS], n = 0;
+    for (int i=0;i<pp->n && n<GIGAM_PARLAY_MAX_LEGS;i++) {
+      int l = pp->lo + i, k = n++;
+      while (k && uf[w.legs[chain[k-1]].event] > uf[w.legs[l].event]) { chain[k] = chain[k-1]; k--; }
+      chain[k] = l;
+    }
+    for (int i=0;i<n;i++) { w.legs[chain[i]].next = i+1 < n ? chain[i+1] : -1; w.legs[chain[i]].prev = i ? chain[i-1] : -1; }
+    pp->first = n ? chain[0] : -1;
+    w.mult[p] = w.ub[p] = pp->fixed;
+    if (!n) { const_paid += pp->fixed; continue; }
+    w.ub[p] = leg_bound(&w, chain[0], mkt_apply_factor(pp->fixed, w.legs[chain[0]].fmax));
+    int comp = w.ev[w.legs[chain[0]].event].comp;
+    comp_paid[comp] += w.mult[p]; comp_ub[comp] += w.ub[p];
+  }
+
+  int maxcomp = 0;
+  for (int k=0,start=0;k<=w.nev;k++)
+    if (k == w.nev || ord[k].comp != ord[start].comp) { if (k - start > maxcomp) maxcomp = k - start; start = k; }
+  w.saved = (long long*)malloc(((size_t)nlegs + 1) * sizeof(long long));
+  w.saved_ub = (long long*)malloc(((size_t)nlegs + 1) * sizeof(long long));
+  w.cls = (int*)malloc((size_t)maxcomp * RISK_CELLS * sizeof(int));
+  w.cls_ub = (long long*)malloc((size_t)maxcomp * RISK_CELLS * sizeof(long long));
+  w.pick = (int*)calloc((size_t)w.nev, sizeof(int));
+  w.best_pick = (int*)calloc((size_t)w.nev, sizeof(int));
+  if (!w.saved || !w.saved_ub || !w.cls || !w.cls_ub || !w.pick || !w.best_pick) { rc = fail(g, GIGAM_EDB, "out of memory"); goto done; }
+
+  /* the components one at a time; their worst cases add up */
+  long long paid = const_paid, paid_ub = const_paid;
+  out->scenarios = 0;
+  for (int k=0,start=0;k<=w.nev;k++) {
+    if (k < w.nev && ord[k].comp == ord[start].comp) continue;
+    double joint = 1.0;
+    for (int i=start;i<k;i++) joint *= w.ev[order[i]].nclass;
+    out->scenarios += joint;
+    out->components++;
+    w.order = order + start; w.nord = k - start; w.have_best = 0; w.open_ub = 0;
+    int comp = ord[start].comp;
+    if (risk_walk(&w, 0, comp_paid[comp], comp_ub[comp]) != 0) out->cut++;
+    paid += w.best;
+    paid_ub += w.open_ub > w.best ? w.open_ub : w.best;
+    start = k;
+  }
+  out->nodes = w.nodes;
+
+  /* the worst scenario paid as settlement would: legs in leg_no order */
+  long long exact = const_paid;
+  for (int p=0;p<w.npar;p++) {
+    if (w.par[p].first < 0) continue;
+    long long v = w.par[p].stake;
+    for (int i=0,k=w.par[p].lo;i<w.par[p].rn;i++) {
+      long long f = rf[w.par[p].rlo + i];
+      if (f < 0) { const risk_leg_t* l = &w.legs[k++]; f = leg_out_factor(l, w.best_pick[l->event]); }
+      v = mkt_apply_factor(v, f);
+    }
+    exact += v;
+  }
+  out->worst = out->stake_cents - exact;
+  out->worst_bound = out->cut ? out->stake_cents - paid_ub : out->worst;
+  if (out->worst_bound > out->worst) out->worst_bound = out->worst;
+
+  size_t used = 0;
+  for (int e=0;e<w.nev && used < sizeof(out->worst_desc);e++) {
+    int cell = w.ev[e].rep[w.best_pick[e]];
+    int n = snprintf(out->worst_desc + used, sizeof(out->worst_desc) - used, "%sevent %ld %d-%d",
+      e ? ", " : "", w.ev[e].id, cell / GIGAM_RISK_GOALS, cell % GIGAM_RISK_GOALS);
+    if (n < 0) break;
+    used += (size_t)n;
+  }
+
+done:
+  mysql_free_result(r);
+  hmap_free(&evix);
+  for (int e=0;e<w.nev && w.ev;e++) free(w.ev[e].legs);
+  free(w.ev); free(w.legs); free(w.par); free(w.mult); free(w.ub); free(w.saved); free(w.saved_ub);
+  free(w.cls); free(w.cls_ub); free(w.pick); free(w.best_pick);
+  free(uf); free(ord); free(order); free(comp_paid); free(comp_ub); free(rf);
+  return rc;
+}
+
+/* ---------- Score corrections ---------- */
+
+/* One distinct pick (market, side, lines) of an event. Its raw column text
+ * goes back into the WHERE that fetches its bets, so the lookup is an
+ * equality on the pick index. */
+typedef struct {
+  char market[24], side[16], line[40], line_b[40];
+  int asian;
+} pick_t;
+
+static void pick_where(const pick_t* p, char* buf, size_t n) {
+  snprintf(buf, n, "market_type='%s' AND pick_side='%s' AND line_q<=>%s AND line_b_q<=>%s AND is_asian=%d",
+           p->market, p->side, p->line, p->line_b, p->asian);
+}
+
+/* Distinct picks of `table` rows matching `where` whose outcome differs
+ * between the two scores. Reads one row per pick, not per bet. */
+static int changed_picks(gigam_ctx_t* g, const char* table, const char* where,
+                         int oh, int oa, int nh, int na, pick_t** out, size_t* n) {
+  *out = NULL; *n = 0;
+  char q[512];
+  snprintf(q,sizeof(q),
+    "SELECT market_type,pick_side,line_q,line_b_q,is_asian FROM %s WHERE %s "
+    "GROUP BY market_type,pick_side,line_q,line_b_q,is_asian", table, where);
+  if (gexec(g,q)!=0) return -1;
+  MYSQL_RES* r = mysql_store_result(g->c);
+  if (!r) return 0;
+  size_t rows = (size_t)mysql_num_rows(r);
+  pick_t* p = (pick_t*)calloc(rows ? rows : 1, sizeof(pick_t));
+  if (!p) { mysql_free_result(r); fail(g, GIGAM_EDB, "out of memory"); return -1; }
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r))) {
+    mkt_bet_t b = { mkt_market_code(row[0]), mkt_side_code(row[1]), row[2] ? atoi(row[2]) : 0, row[3] ? atoi(row[3]) : 0,
+                    2 * MKT_PRICE_ONE, 0, atoi(row[4]), 2 };
+    if (mkt_outcome_key(&b, oh, oa) == mkt_outcome_key(&b, nh, na)) continue;
+    pick_t* k = &p[(*n)++];
+    snprintf(k->market, sizeof(k->market), "%s", row[0]);
+    snprintf(k->side, sizeof(k->side), "%s", row[1]);
+    snprintf(k->line, sizeof(k->line), "%s", row[2] ? row[2] : "NULL");
+    snprintf(k->line_b, sizeof(k->line_b), "%s", row[3] ? row[3] : "NULL");
+    k->asian = atoi(row[4]);
+  }
+  mysql_free_result(r);
+  *out = p;
+  return 0;
+}
+
+/* A settled bet as booked: money so far and how its commission is charged
+ * (the settlement row's scheme/rate, else the runner's current ones). */
+typedef struct {
+  long id, event_id, bookmaker_id, runner_id, bettor_id;
+  long long stake, payout, profit, comm;
+  char status[12], result[8], scheme[8];
+  long rate_bp;
+} booked_t;
+
+#define BOOKED_COLS \
+  "b.id,b.event_id,b.bookmaker_id,b.runner_id,b.bettor_id,b.stake_cents,COALESCE(b.payout_cents,0),COALESCE(b.profit_cents,0)," \
+  "(SELECT COALESCE(SUM(x.commission_cents),0) FROM runner_commissions x WHERE x.bet_id=b.id),b.status,COALESCE(b.result,'')," \
+  "COALESCE(rc0.scheme,r.commission_scheme),ROUND(COALESCE(rc0.rate,r.commission_rate)*100)"
+#define BOOKED_FROM \
+  "FROM bets b JOIN runners r ON r.id=b.runner_id " \
+  "LEFT JOIN runner_commissions rc0 ON rc0.bet_id=b.id AND rc0.runner_id=b.runner_id AND rc0.adjustment_id=0 "
+#define BOOKED_NCOLS 13
+
+static void booked_row(MYSQL_ROW row, booked_t* k) {
+  k->id = atol(row[0]); k->event_id = atol(row[1]); k->bookmaker_id = atol(row[2]);
+  k->runner_id = atol(row[3]); k->bettor_id = atol(row[4]);
+  k->stake = atoll(row[5]); k->payout = atoll(row[6]); k->profit = atoll(row[7]); k->comm = atoll(row[8]);
+  snprintf(k->status, sizeof(k->status), "%s", row[9]);
+  snprintf(k->result, sizeof(k->result), "%s", row[10]);
+  snprintf(k->scheme, sizeof(k->scheme), "%s", row[11] ? row[11] : "net");
+  k->rate_bp = row[12] ? atol(row[12]) : 1000;
+}
+
+typedef struct {
+  long event_id;
+  int oh, oa, nh, na;
+  gigam_correction_t* out;
+} correction_t;
+
+/* Move a booked bet to its corrected payout (reopen: back to open with its
+ * money reversed). The deltas become a settlement_adjustments row and, for
+ * commission, a compensating runner_commissions row. */
+static int adjust_bet(gigam_ctx_t* g, const correction_t* cx, const booked_t* k, int reopen,
+                      long long payout, long long profit) {
+  long long comm = reopen ? 0 : commission_for(k->scheme, k->rate_bp, k->stake, profit);
+  long long dp = payout - k->payout, dpr = profit - k->profit, dc = comm - k->comm;
+  const char* result = reopen ? NULL : (profit>0 ? "win" : (profit<0 ? "lose" : "push"));
+  if (!reopen && !dp && !dpr && !dc && !strcmp(result, k->result)) return 0;
+
+  char q[768], oldr[16], newr[16];
+  snprintf(oldr, sizeof(oldr), k->result[0] ? "'%s'" : "NULL", k->result);
+  snprintf(newr, sizeof(newr), result ? "'%s'" : "NULL", result ? result : "");
+  snprintf(q,sizeof(q),
+    "INSERT INTO settlement_adjustments(bet_id,event_id,bookmaker_id,runner_id,bettor_id,old_home,old_away,new_home,new_away,"
+    "old_result,new_result,payout_delta_cents,profit_delta_cents,commission_delta_cents) "
+    "VALUES(%ld,%ld,%ld,%ld,%ld,%d,%d,%d,%d,%s,%s,%lld,%lld,%lld)",
+    k->id, cx->event_id, k->bookmaker_id, k->runner_id, k->bettor_id, cx->oh, cx->oa, cx->nh, cx->na,
+    oldr, newr, dp, dpr, dc);
+  if (gexec(g,q)!=0) return -1;
+  long long adj = (long long)mysql_insert_id(g->c);
+
+  if (reopen)
+    snprintf(q,sizeof(q),
+      "UPDATE bets SET status='open', result=NULL, payout_cents=NULL, profit_cents=NULL, settled_at=NULL WHERE id=%ld", k->id);
+  else
+    snprintf(q,sizeof(q),
+      "UPDATE bets SET result='%s', payout_cents=%lld, profit_cents=%lld WHERE id=%ld", result, payout, profit, k->id);
+  if (gexec(g,q)!=0) return -1;
+
+  if (dc) {
+    snprintf(q,sizeof(q),
+      "INSERT INTO runner_commissions(bet_id,runner_id,commission_cents,scheme,rate,adjustment_id) VALUES(%ld,%ld,%lld,'%s',%ld.%02ld,%lld)",
+      k->id, k->runner_id, dc, k->scheme, k->rate_bp/100, k->rate_bp%100, adj);
+    if (gexec(g,q)!=0) return -1;
+  }
+  if (post(g,LEDGER_ADJUSTMENT,adj,k->id,k->bookmaker_id,LEDGER_BETTOR,k->bettor_id,-dpr)!=0 ||
+      post(g,LEDGER_ADJUSTMENT,adj,k->id,k->bookmaker_id,LEDGER_RUNNER,k->runner_id,dc)!=0) return -1;
+  gigam_correction_t* o = cx->out;
+  o->bets++;
+  if (reopen) o->reopened++;
+  o->payout_delta += dp; o->profit_delta += dpr; o->commission_delta += dc;
+  return 0;
+}
+
+static int correct_singles(gigam_ctx_t* g, const correction_t* cx) {
+  char where[128];
+  snprintf(where,sizeof(where),"event_id=%ld AND status='settled' AND bet_type='single'", cx->event_id);
+  pick_t* picks; size_t np;
+  if (changed_picks(g,"bets",where,cx->oh,cx->oa,cx->nh,cx->na,&picks,&np)!=0) return -1;
+  int rc = 0;
+  for (size_t i=0;i<np && rc==0;i++) {
+    char pw[256], q[1536];
+    pick_where(&picks[i], pw, sizeof(pw));
+    snprintf(q,sizeof(q),
+      "SELECT " BOOKED_COLS ",b.market_type+0,b.pick_side+0,COALESCE(b.line_q,0),b.is_asian,COALESCE(b.line_b_q,0),b.price_e4,COALESCE(b.price_b_e4,0) "
+      BOOKED_FROM "WHERE b.event_id=%ld AND b.status='settled' AND b.bet_type='single' AND b.%s FOR UPDATE",
+      cx->event_id, pw);
+    if (gexec(g,q)!=0) { rc = -1; break; }
+    MYSQL_RES* r = mysql_store_result(g->c);
+    MYSQL_ROW row;
+    while (rc==0 && r && (row = mysql_fetch_row(r))) {
+      booked_t k; booked_row(row, &k);
+      MYSQL_ROW m = row + BOOKED_NCOLS;
+      mkt_bet_t b = { (mkt_market_t)atoi(m[0]), (mkt_side_t)atoi(m[1]), atoi(m[2]), atoi(m[4]),
+                      atol(m[5]), atol(m[6]), atoi(m[3]), k.stake };
+      long long payout, profit;
+      mkt_settle(&b, cx->nh, cx->na, &payout, &profit);
+      rc = adjust_bet(g, cx, &k, 0, payout, profit);
+    }
+    if (r) mysql_free_result(r);
+    cx->out->picks_changed++;
+  }
+  free(picks);
+  return rc;
+}
+
+/* Re-price a parlay after one of its legs changed: adjusted if it is still
+ * decided, reopened if the corrected leg was what decided it early. */
+static int correct_parlay(gigam_ctx_t* g, const correction_t* cx, long bet_id) {
+  char q[1024];
+  snprintf(q,sizeof(q),
+    "SELECT " BOOKED_COLS ",l.status,COALESCE(l.factor_e6,%lld) " BOOKED_FROM
+    "JOIN bet_legs l ON l.bet_id=b.id WHERE b.id=%ld ORDER BY l.leg_no FOR UPDATE", MKT_FACTOR_ONE, bet_id);
+  if (gexec(g,q)!=0) return -1;
+  MYSQL_RES* r = mysql_store_result(g->c);
+  if (!r) return 0;
+  booked_t k; int legs=0, open=0, dead=0; long long payout=0;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r))) {
+    booked_row(row, &k);
+    if (!legs++) payout = k.stake;
+    MYSQL_ROW m = row + BOOKED_NCOLS;
+    if (!strcmp(m[0],"open")) { open++; continue; }
+    long long f = atoll(m[1]);
+    if (f<=0) dead=1;
+    payout = mkt_apply_factor(payout, f);
+  }
+  mysql_free_result(r);
+  if (!legs) return 0;
+  if (!strcmp(k.status,"open")) return settle_parlay(g, bet_id, NULL);   /* may be decided now */
+  if (strcmp(k.status,"settled")) return 0;                             /* void: no leg of a final event */
+  if (open && !dead) return adjust_bet(g, cx, &k, 1, 0, 0);
+  if (dead) payout = 0;
+  return adjust_bet(g, cx, &k, 0, payout, payout - k.stake);
+}
+
+static int correct_legs(gigam_ctx_t* g, const correction_t* cx) {
+  char where[128];
+  snprintf(where,sizeof(where),"event_id=%ld AND status='settled'", cx->event_id);
+  pick_t* picks; size_t np;
+  if (changed_picks(g,"bet_legs",where,cx->oh,cx->oa,cx->nh,cx->na,&picks,&np)!=0) return -1;
+  long* bets = NULL; size_t nb = 0, cap = 0;
+  int rc = 0;
+  for (size_t i=0;i<np && rc==0;i++) {
+    char pw[256], q[768];
+    pick_where(&picks[i], pw, sizeof(pw));
+    snprintf(q,sizeof(q),
+      "SELECT id,bet_id,market_type+0,pick_side+0,COALESCE(line_q,0),is_asian,COALESCE(line_b_q,0),price_e4,COALESCE(price_b_e4,0) "
+      "FROM bet_legs WHERE event_id=%ld AND status='settled' AND %s", cx->event_id, pw);
+    if (gexec(g,q)!=0) { rc = -1; break; }
+    MYSQL_RES* r = mysql_store_result(g->c);
+    MYSQL_ROW row;
+    while (rc==0 && r && (row = mysql_fetch_row(r))) {
+      mkt_bet_t leg = { (mkt_market_t)atoi(row[2]), (mkt_side_t)atoi(row[3]), atoi(row[4]), atoi(row[6]),
+                        atol(row[7]), atol(row[8]), atoi(row[5]), 0 };
+      long long f = mkt_leg_factor(&leg, cx->nh, cx->na);
+      const char* result = f>MKT_FACTOR_ONE ? "win" : (f<MKT_FACTOR_ONE ? "lose" : "push");
+      char up[256];
+      snprintf(up,sizeof(up),"UPDATE bet_legs SET result='%s', factor_e6=%lld WHERE id=%ld", result, f, atol(row[0]));
+      if (gexec(g,up)!=0) { rc = -1; break; }
+      if (nb == cap) {
+        size_t nc = cap ? cap*2 : 64;
+        long* p = (long*)realloc(bets, nc*sizeof(long));
+        if (!p) { fail(g, GIGAM_EDB, "out of memory"); rc = -1; break; }
+        bets = p; cap = nc;
+      }
+      bets[nb++] = atol(row[1]);
+    }
+    if (r) mysql_free_result(r);
+    cx->out->picks_changed++;
+  }
+  free(picks);
+  if (rc==0 && nb) {
+    qsort(bets, nb, sizeof(long), cmp_long);
+    for (size_t i=0;i<nb && rc==0;i++) {
+      if (i && bets[i]==bets[i-1]) continue;
+      rc = correct_parlay(g, cx, bets[i]);
+    }
+  }
+  free(bets);
+  return rc;
+}
+
+int gigam_settle_correct(gigam_ctx_t* g, long event_id, int home, int away, gigam_correction_t* out) {
+  g->err[0] = '\0';
+  memset(out, 0, sizeof(*out));
+  if (!event_id) return fail(g, GIGAM_EINVAL, "required: event_id");
+  if (home < 0 || away < 0) return fail(g, GIGAM_EINVAL, "scores must be >= 0");
+
+  ledger_batch_t* lb = ledger_batch_new();
+  if (!lb) return fail(g, GIGAM_EDB, "out of memory");
+  if (gexec(g,"START TRANSACTION")!=0) { ledger_batch_free(lb); return GIGAM_EDB; }
+  g->lb = lb;
+  char q[256];
+  snprintf(q,sizeof(q),"SELECT home_score,away_score,status FROM events WHERE id=%ld FOR UPDATE", event_id);
+  int rc = GIGAM_EDB;
+  correction_t cx = { event_id, 0, 0, home, away, out };
+  if (gexec(g,q)==0) {
+    MYSQL_RES* r = mysql_store_result(g->c);
+    MYSQL_ROW row = r ? mysql_fetch_row(r) : NULL;
+    if (!row) fail(g, GIGAM_EDB, "event not found");
+    else if (strcmp(row[2],"final")) rc = fail(g, GIGAM_EINVAL, "event is %s; only final events can be corrected", row[2]);
+    else {
+      cx.oh = row[0] ? atoi(row[0]) : 0;
+      cx.oa = row[1] ? atoi(row[1]) : 0;
+      rc = GIGAM_OK;
+    }
+    if (r) mysql_free_result(r);
+  }
+  if (rc == GIGAM_OK && (cx.oh != home || cx.oa != away)) {
+    snprintf(q,sizeof(q),"UPDATE events SET home_score=%d, away_score=%d WHERE id=%ld", home, away, event_id);
+    if (gexec(g,q)!=0 || correct_singles(g,&cx)!=0 || correct_legs(g,&cx)!=0) rc = GIGAM_EDB;
+  }
+  if (rc == GIGAM_OK && ledger_batch_post(g->c, lb)!=0) rc = fail(g, GIGAM_EDB, "ledger: %s", mysql_error(g->c));
+  g->lb = NULL;
+  ledger_batch_free(lb);
+  if (rc == GIGAM_OK && gexec(g,"COMMIT")==0) {
+    out->old_home = cx.oh; out->old_away = cx.oa;
+    return GIGAM_OK;
+  }
+  if (mysql_query(g->c,"ROLLBACK")!=0) { /* keep the first error */ }
+  memset(out, 0, sizeof(*out));
+  return rc == GIGAM_OK ? GIGAM_EDB : rc;
+}
@@ -0,0 +1,872 @@
+#define _POSIX_C_SOURCE 200809L
+/* gigamd: JSON-over-HTTP front end to libgigam.
+ *
+ * One thread runs an epoll loop that accepts, reads and parses requests and
+ * writes responses; a fixed pool of workers, each with its own libgigam
+ * context (one MySQL connection), executes them. Bets waiting in the queue
+ * are taken in groups and written in a single transaction (one commit per
+ * group, a savepoint per bet). With --journal, accepted bets are appended
+ * to a local journal instead and a flusher thread drains it into MySQL in
+ * multi-row transactions. Workers hand results back through an eventfd.
+ * Per-route latency histograms are served on GET /metrics. */
+
+#include "db.h"
+#include "gigam.h"
+#include "journal.h"
+#include "json.h"
+#include "market.h"
+#include "report.h"
+#include "reportfmt.h"
+#include "rptagg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define MAX_REQUEST   (1u << 20)
+#define MAX_EVENTS    256
+
+/* ---------- Metrics ---------- */
+
+enum { R_BET, R_QUOTES, R_RISK, R_REPORT, R_METRICS, R_OTHER, R_COUNT };
+static const char* const route_names[R_COUNT] = { "bet", "quotes", "risk", "report", "metrics", "other" };
+
+/* upper bounds in microseconds; one extra bucket for +Inf */
+static const unsigned long long bucket_us[] = {
+  50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000
+};
+#define NBUCKETS (sizeof(bucket_us)/sizeof(bucket_us[0]))
+
+typedef struct {
+  atomic_ullong bucket[NBUCKETS + 1];
+  atomic_ullong count, sum_us;
+  atomic_ullong status_5xx, status_4xx;
+} histo_t;
+
+static histo_t hist[R_COUNT];
+static atomic_ullong group_commits, grouped_bets, max_group;
+static gigam_journal_t* journal;   /* NULL unless --journal */
+
+static void histo_add(int route, unsigned long long us, int status) {
+  histo_t* h = &hist[route];
+  size_t i = 0;
+  while (i < NBUCKETS && us > bucket_us[i]) i++;
+  atomic_fetch_add(&h->bucket[i], 1);
+  atomic_fetch_add(&h->count, 1);
+  atomic_fetch_add(&h->sum_us, us);
+  if (status >= 500) atomic_fetch_add(&h->status_5xx, 1);
+  else if (status >= 400) atomic_fetch_add(&h->status_4xx, 1);
+}
+
+/* Prometheus text format */
+static void metrics_render(FILE* f) {
+  fprintf(f, "# TYPE gigamd_request_seconds histogram\n");
+  for (int r=0;r<R_COUNT;r++) {
+    unsigned long long cum = 0;
+    for (size_t i=0;i<=NBUCKETS;i++) {
+      cum += atomic_load(&hist[r].bucket[i]);
+      if (i < NBUCKETS)
+        fprintf(f, "gigamd_request_seconds_bucket{route=\"%s\",le=\"%g\"} %llu\n", route_names[r], (double)bucket_us[i] / 1e6, cum);
+      else
+        fprintf(f, "gigamd_request_seconds_bucket{route=\"%s\",le=\"+Inf\"} %llu\n", route_names[r], cum);
+    }
+    fprintf(f, "gigamd_request_seconds_sum{route=\"%s\"} %.6f\n", route_names[r], (double)atomic_load(&hist[r].sum_us) / 1e6);
+    fprintf(f, "gigamd_request_seconds_count{route=\"%s\"} %llu\n", route_names[r], atomic_load(&hist[r].count));
+  }
+  fprintf(f, "# TYPE gigamd_errors_total counter\n");
+  for (int r=0;r<R_COUNT;r++) {
+    fprintf(f, "gigamd_errors_total{route=\"%s\",class=\"4xx\"} %llu\n", route_names[r], atomic_load(&hist[r].status_4xx));
+    fprintf(f, "gigamd_errors_total{route=\"%s\",class=\"5xx\"} %llu\n", route_names[r], atomic_load(&hist[r].status_5xx));
+  }
+  fprintf(f, "# TYPE gigamd_bet_group_commits_total counter\ngigamd_bet_group_commits_total %llu\n", atomic_load(&group_commits));
+  fprintf(f, "# TYPE gigamd_bet_grouped_total counter\ngigamd_bet_grouped_total %llu\n", atomic_load(&grouped_bets));
+  fprintf(f, "# TYPE gigamd_bet_group_max gauge\ngigamd_bet_group_max %llu\n", atomic_load(&max_group));
+  if (journal) {
+    gigam_journal_stats_t st; gigam_journal_stats(journal, &st);
+    fprintf(f, "# TYPE gigamd_journal_appended_total counter\ngigamd_journal_appended_total %llu\n", st.appended);
+    fprintf(f, "# TYPE gigamd_journal_applied_total counter\ngigamd_journal_applied_total %llu\n", st.applied);
+    fprintf(f, "# TYPE gigamd_journal_rejected_total counter\ngigamd_journal_rejected_total %llu\n", st.rejected);
+    fprintf(f, "# TYPE gigamd_journal_fsyncs_total counter\ngigamd_journal_fsyncs_total %llu\n", st.syncs);
+    fprintf(f, "# TYPE gigamd_journal_flushes_total counter\ngigamd_journal_flushes_total %llu\n", st.flushes);
+    fprintf(f, "# TYPE gigamd_journal_pending gauge\ngigamd_journal_pending %lld\n", st.pending);
+  }
+}
+
+static unsigned long long elapsed_us(const struct timespec* t0) {
+  struct timespec t1; clock_gettime(CLOCK_MONOTONIC, &t1);
+  long long us = (long long)(t1.tv_sec - t0->tv_sec) * 1000000LL + (t1.tv_nsec - t0->tv_nsec) / 1000;
+  return us > 0 ? (unsigned long long)us : 0;
+}
+
+/* ---------- Jobs & queues ---------- */
+
+typedef struct job {
+  struct job* next;
+  int fd;
+  unsigned gen;           /* connection generation when queued */
+  int route;
+  char* path;             /* path + query, NUL-terminated */
+  char* body;             /* NUL-terminated */
+  struct timespec t0;
+  int status;
+  char* resp; size_t resp_len;
+} job_t;
+
+typedef struct { job_t* head; job_t* tail; size_t len; } job_list_t;
+
+static void list_push(job_list_t* l, job_t* j) {
+  j->next = NULL;
+  if (l->tail) l->tail->next = j; else l->head = j;
+  l->tail = j; l->len++;
+}
+
+static job_t* list_pop(job_list_t* l) {
+  job_t* j = l->head;
+  if (!j) return NULL;
+  l->head = j->next;
+  if (!l->head) l->tail = NULL;
+  l->len--;
+  return j;
+}
+
+static void job_free(job_t* j) {
+  free(j->path); free(j->body); free(j->resp); free(j);
+}
+
+static struct {
+  pthread_mutex_t mu;
+  pthread_cond_t cv;
+  job_list_t bets, other;
+  bool stop;
+} work = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, {0}, {0}, false };
+
+static struct {
+  pthread_mutex_t mu;
+  job_list_t list;
+  int efd;
+} done = { PTHREAD_MUTEX_INITIALIZER, {0}, -1 };
+
+static int group_max = 64;
+
+static void finish(job_t* j) {
+  pthread_mutex_lock(&done.mu);
+  list_push(&done.list, j);
+  pthread_mutex_unlock(&done.mu);
+  uint64_t one = 1;
+  if (write(done.efd, &one, sizeof(one)) < 0) { /* counter saturated: loop still wakes */ }
+}
+
+/* ---------- Responses ---------- */
+
+static void respond_mem(job_t* j, int status, char* buf, size_t len) {
+  free(j->resp);
+  j->status = status; j->resp = buf; j->resp_len = len;
+}
+
+static void respond_error(job_t* j, int status, const char* msg) {
+  char* buf = NULL; size_t len = 0;
+  FILE* f = open_memstream(&buf, &len);
+  if (!f) { respond_mem(j, status, NULL, 0); return; }
+  fputs("{\"error\":", f); rf_json_escape(f, msg ? msg : ""); fputs("}\n", f);
+  fclose(f);
+  respond_mem(j, status, buf, len);
+}
+
+static void respond_rc(job_t* j, gigam_ctx_t* g, int rc) {
+  respond_error(j, rc == GIGAM_EINVAL ? 400 : 500, gigam_errmsg(g));
+}
+
+/* ---------- Handlers (worker side) ---------- */
+
+/* price/line fields as exact decimal text; missing or malformed stays 0 and
+ * fails validation */
+static long json_price(const json_obj_t* o, const char* key) {
+  long e4 = 0;
+  const char* v = json_get(o, key);
+  if (v && mkt_parse_price(v, &e4) != 0) e4 = 0;
+  return e4;
+}
+
+static int json_line(const json_obj_t* o, const char* key) {
+  int q = 0;
+  const char* v = json_get(o, key);
+  if (v && mkt_parse_line(v, &q) != 0) q = 0;
+  return q;
+}
+
+static void bet_from_json(const json_obj_t* o, gigam_bet_t* b) {
+  memset(b, 0, sizeof(*b));
+  b->bookmaker_id = json_get_long(o, "bookmaker_id", 0);
+  b->event_id     = json_get_long(o, "event_id", 0);
+  b->runner_id    = json_get_long(o, "runner_id", 0);
+  b->bettor_id    = json_get_long(o, "bettor_id", 0);
+  b->market       = json_get(o, "market");
+  b->side         = json_get(o, "side");
+  b->line_q       = json_line(o, "line");
+  b->price_e4     = json_price(o, "price");
+  b->stake_cents  = json_get_long(o, "stake_cents", 0);
+  b->asian        = json_get_bool(o, "asian", 0);
+  b->line_b_q     = json_line(o, "line_b");
+  b->price_b_e4   = json_price(o, "price_b");
+  b->bet_key      = json_get(o, "bet_key");
+}
+
+static void quote_from_json(const json_obj_t* o, gigam_quote_t* q) {
+  memset(q, 0, sizeof(*q));
+  q->event_id     = json_get_long(o, "event_id", 0);
+  q->bookmaker_id = json_get_long(o, "bookmaker_id", 0);
+  q->market       = json_get(o, "market");
+  q->side         = json_get(o, "side");
+  q->line_q       = json_line(o, "line");
+  q->price_e4     = json_price(o, "price");
+  q->asian        = json_get_bool(o, "asian", 0);
+  q->line_b_q     = json_line(o, "line_b");
+  q->price_b_e4   = json_price(o, "price_b");
+}
+
+/* POST /bet with --journal: validate, append the whole group with one
+ * write and one fsync, answer 202 with each bet's key. */
+static void journal_bets(job_t** jobs, int n) {
+  gigam_bet_t bets[256];
+  json_obj_t* objs = (json_obj_t*)malloc((size_t)n * sizeof(json_obj_t));
+  int idx[256], k = 0;
+  char (*keys)[65] = (char (*)[65])malloc((size_t)n * 65);
+  for (int i=0;i<n && objs && keys;i++) {
+    const char* p = jobs[i]->body;
+    if (json_parse_object(&p, &objs[i]) != 0) { respond_error(jobs[i], 400, "body must be a flat JSON object"); continue; }
+    bet_from_json(&objs[i], &bets[k]);
+    const char* why = gigam_bet_invalid(&bets[k]);
+    if (why) { respond_error(jobs[i], 400, why); continue; }
+    idx[k++] = i;
+  }
+  if (!objs || !keys) {
+    for (int i=0;i<n;i++) respond_error(jobs[i], 500, "out of memory");
+  } else if (k) {
+    int rc = gigam_journal_append(journal, bets, k, keys);
+    for (int i=0;i<k;i++) {
+      job_t* j = jobs[idx[i]];
+      if (rc != GIGAM_OK) { respond_error(j, rc == GIGAM_EINVAL ? 400 : 500, rc == GIGAM_EINVAL ? "bet: field too long" : gigam_journal_errmsg(journal)); continue; }
+      char* buf = (char*)malloc(96);
+      int len = buf ? snprintf(buf, 96, "{\"bet_key\":\"%s\"}\n", keys[i]) : 0;
+      respond_mem(j, 202, buf, (size_t)len);
+    }
+    atomic_fetch_add(&group_commits, 1);
+    atomic_fetch_add(&grouped_bets, (unsigned long long)k);
+  }
+  for (int i=0;i<n;i++) finish(jobs[i]);
+  free(objs); free(keys);
+}
+
+/* POST /bet, grouped: one transaction, a savepoint per bet so a rejected
+ * bet does not undo the others, one COMMIT for the whole group. A deadlock
+ * (or a savepoint that cannot be rolled back to) means InnoDB rolled back
+ * the whole transaction: the bets placed so far in it get a 500 and the
+ * rest of the group goes on in a new one. */
+static void handle_bets(gigam_ctx_t* g, job_t** jobs, int n) {
+  MYSQL* c = gigam_conn(g);
+  bool txn = n > 1 && mysql_query(c, "START TRANSACTION") == 0;
+  long long ids[256];
+  bool ok[256];
+  for (int i=0;i<n;i++) {
+    job_t* j = jobs[i];
+    ok[i] = false;
+    json_obj_t o; const char* p = j->body;
+    gigam_bet_t b;
+    if (json_parse_object(&p, &o) != 0) { respond_error(j, 400, "body must be a flat JSON object"); continue; }
+    bet_from_json(&o, &b);
+    if (txn && mysql_query(c, "SAVEPOINT bet") != 0) { respond_error(j, 500, mysql_error(c)); continue; }
+    int rc = gigam_bet_place(g, &b, &ids[i]);
+    if (rc != GIGAM_OK) {
+      respond_rc(j, g, rc);
+      if (!txn) continue;
+      char msg[512]; snprintf(msg, sizeof(msg), "group rolled back: %s", mysql_error(c));
+      if (mysql_errno(c) != 1213 && mysql_query(c, "ROLLBACK TO SAVEPOINT bet") == 0) continue;
+      if (mysql_query(c, "ROLLBACK") != 0) { /* the transaction is gone either way */ }
+      for (int k=0;k<i;k++) if (ok[k]) { ok[k] = false; respond_error(jobs[k], 500, msg); }
+      txn = mysql_query(c, "START TRANSACTION") == 0;
+      continue;
+    }
+    ok[i] = true;
+  }
+  if (txn) {
+    if (mysql_query(c, "COMMIT") != 0) {
+      char msg[512]; snprintf(msg, sizeof(msg), "commit failed: %s", mysql_error(c));
+      if (mysql_query(c, "ROLLBACK") != 0) { /* connection is gone either way */ }
+      for (int i=0;i<n;i++) if (ok[i]) { ok[i] = false; respond_error(jobs[i], 500, msg); }
+    }
+    atomic_fetch_add(&group_commits, 1);
+    atomic_fetch_add(&grouped_bets, (unsigned long long)n);
+    unsigned long long m = atomic_load(&max_group);
+    while ((unsigned long long)n > m && !atomic_compare_exchange_weak(&max_group, &m, (unsigned long long)n)) {}
+  }
+  for (int i=0;i<n;i++) {
+    if (ok[i]) {
+      char* buf = (char*)malloc(48);
+      int len = buf ? snprintf(buf, 48, "{\"bet_id\":%lld}\n", ids[i]) : 0;
+      respond_mem(jobs[i], 201, buf, (size_t)len);
+    }
+    finish(jobs[i]);
+  }
+}
+
+/* POST /quotes: JSON array of quotes, all-or-nothing */
+static void handle_quotes(gigam_ctx_t* g, job_t* j) {
+  MYSQL* c = gigam_conn(g);
+  char* buf = NULL; size_t len = 0;
+  FILE* f = open_memstream(&buf, &len);
+  if (!f) { respond_error(j, 500, "out of memory"); return; }
+  if (mysql_query(c, "START TRANSACTION") != 0) { fclose(f); free(buf); respond_error(j, 500, mysql_error(c)); return; }
+
+  const char* p = j->body; int first = 1, k, n = 0;
+  json_obj_t o;
+  fputs("{\"quote_ids\":[", f);
+  while ((k = json_array_next(&p, &first, &o)) == 1) {
+    gigam_quote_t q; quote_from_json(&o, &q);
+    long long id = 0;
+    int rc = gigam_quote_add(g, &q, &id);
+    if (rc != GIGAM_OK) {
+      char msg[600]; snprintf(msg, sizeof(msg), "quote %d: %s", n, gigam_errmsg(g));
+      if (mysql_query(c, "ROLLBACK") != 0) { /* reported by the next request */ }
+      fclose(f); free(buf);
+      respond_error(j, rc == GIGAM_EINVAL ? 400 : 500, msg);
+      return;
+    }
+    fprintf(f, "%s%lld", n ? "," : "", id);
+    n++;
+  }
+  if (k < 0) {
+    if (mysql_query(c, "ROLLBACK") != 0) { /* see above */ }
+    fclose(f); free(buf);
+    respond_error(j, 400, "body must be a JSON array of flat objects");
+    return;
+  }
+  fputs("]}\n", f);
+  fclose(f);
+  if (mysql_query(c, "COMMIT") != 0) { free(buf); respond_error(j, 500, mysql_error(c)); return; }
+  respond_mem(j, 201, buf, len);
+}
+
+static void handle_risk(gigam_ctx_t* g, job_t* j, long event_id) {
+  gigam_exposure_t ex;
+  int rc = gigam_risk_event(g, event_id, &ex);
+  if (rc != GIGAM_OK) { respond_rc(j, g, rc); return; }
+  char* buf = (char*)malloc(320);
+  int len = buf ? snprintf(buf, 320,
+    "{\"event_id\":%ld,\"exposure_cents\":{\"HOME_wins\":%lld,\"AWAY_wins\":%lld,\"DRAW\":%lld,\"OVER\":%lld,\"UNDER\":%lld},"
+    "\"worst\":{\"score\":\"%d-%d\",\"cents\":%lld}}\n",
+    event_id, ex.home, ex.away, ex.draw, ex.over, ex.under, ex.worst_home, ex.worst_away, ex.worst) : 0;
+  respond_mem(j, 200, buf, (size_t)len);
+}
+
+/* ?a=1&b=x -> value of name, %XX/+ decoded; 0 if found */
+static int query_param(const char* path, const char* name, char* out, size_t n) {
+  const char* q = strchr(path, '?');
+  if (!q) return -1;
+  size_t nl = strlen(name);
+  for (const char* p = q + 1; *p; ) {
+    const char* end = strchr(p, '&'); if (!end) end = p + strlen(p);
+    if ((size_t)(end - p) > nl && !strncmp(p, name, nl) && p[nl] == '=') {
+      size_t o = 0;
+      for (const char* v = p + nl + 1; v < end && o + 1 < n; v++) {
+        if (*v == '+') out[o++] = ' ';
+        else if (*v == '%' && v + 2 < end && isxdigit((unsigned char)v[1]) && isxdigit((unsigned char)v[2])) {
+          char hx[3] = { v[1], v[2], 0 }; out[o++] = (char)strtol(hx, NULL, 16); v += 2;
+        } else out[o++] = *v;
+      }
+      out[o] = '\0';
+      return 0;
+    }
+    p = *end ? end + 1 : end;
+  }
+  return -1;
+}
+
+/* GET /report?kind=pnl&by=runner&bookmaker_id=1&from=YYYY-MM-DD&to=YYYY-MM-DD */
+static void handle_report(gigam_ctx_t* g, job_t* j) {
+  char kind_s[32] = "", by[16] = "", bm_s[24] = "", from[16] = "", to[16] = "";
+  query_param(j->path, "kind", kind_s, sizeof(kind_s));
+  query_param(j->path, "by", by, sizeof(by));
+  query_param(j->path, "bookmaker_id", bm_s, sizeof(bm_s));
+  query_param(j->path, "from", from, sizeof(from));
+  query_param(j->path, "to", to, sizeof(to));
+  int kind = rpt_kind_from(kind_s, by[0] ? by : NULL);
+  long bm = atol(bm_s);
+  int d0, d1;
+  if (kind < 0 || bm <= 0 || rpt_parse_day(from, &d0) || rpt_parse_day(to, &d1)) {
+    respond_error(j, 400, "required: kind, bookmaker_id, from, to (YYYY-MM-DD); optional: by");
+    return;
+  }
+  MYSQL* c = gigam_conn(g);
+  char q[4096];
+  report_sql((rpt_kind_t)kind, bm, from, to, q, sizeof(q));
+  if (mysql_query(c, q) != 0) { respond_error(j, 500, mysql_error(c)); return; }
+  MYSQL_RES* r = mysql_store_result(c);
+  if (!r) { respond_error(j, 500, mysql_error(c)); return; }
+  char* buf; size_t len;
+  int rc = report_render(r, RF_JSON, &buf, &len);
+  mysql_free_result(r);
+  if (rc) { respond_error(j, 500, "report rendering failed"); return; }
+  respond_mem(j, 200, buf, len);
+}
+
+static void handle_one(gigam_ctx_t* g, job_t* j) {
+  if (j->route == R_QUOTES) handle_quotes(g, j);
+  else if (j->route == R_RISK) handle_risk(g, j, atol(j->path + strlen("/risk/event/")));
+  else if (j->route == R_REPORT) handle_report(g, j);
+  else respond_error(j, 404, "not found");
+  finish(j);
+}
+
+static void* worker_main(void* arg) {
+  gigam_ctx_t* g = (gigam_ctx_t*)arg;
+  mysql_thread_init();
+  job_t* batch[256];
+  for (;;) {
+    pthread_mutex_lock(&work.mu);
+    while (!work.stop && !work.bets.head && !work.other.head) pthread_cond_wait(&work.cv, &work.mu);
+    if (work.stop && !work.bets.head && !work.other.head) { pthread_mutex_unlock(&work.mu); break; }
+    int n = 0; job_t* one = NULL;
+    if (work.bets.head) {
+      while (n < group_max && work.bets.head) batch[n++] = list_pop(&work.bets);
+    } else {
+      one = list_pop(&work.other);
+    }
+    pthread_mutex_unlock(&work.mu);
+    if (n && journal) journal_bets(batch, n);
+    else if (n) handle_bets(g, batch, n);
+    else handle_one(g, one);
+  }
+  mysql_thread_end();
+  return NULL;
+}
+
+/* ---------- Journal flusher ---------- */
+
+#define FLUSH_ROWS 1000
+
+static struct {
+  db_config_t cfg;
+  int every_ms;
+  atomic_bool stop;
+} flusher;
+
+/* Drain the journal every --flush-ms (back to back while there is a full
+ * batch), with its own connection; reconnects after a database error. On
+ * stop it keeps going until the journal is empty or MySQL is unreachable. */
+static void* flusher_main(void* arg) {
+  (void)arg;
+  mysql_thread_init();
+  gigam_ctx_t* g = NULL;
+  for (;;) {
+    bool stop = atomic_load(&flusher.stop);
+    if (gigam_journal_policy(journal) == GIGAM_FSYNC_INTERVAL && gigam_journal_sync(journal) != GIGAM_OK)
+      fprintf(stderr, "gigamd: journal fsync failed\n");
+    long n = 0;
+    int rc = GIGAM_OK;
+    if (!g) g = gigam_open(&flusher.cfg);
+    if (g) {
+      rc = gigam_journal_flush(g, journal, FLUSH_ROWS, &n);
+      if (rc != GIGAM_OK) fprintf(stderr, "gigamd: %s\n", gigam_journal_errmsg(journal));
+      if (rc == GIGAM_EDB) { gigam_close(g); g = NULL; }
+    }
+    gigam_journal_stats_t st; gigam_journal_stats(journal, &st);
+    if (stop && (st.pending == 0 || !g || rc != GIGAM_OK)) break;
+    if (n == FLUSH_ROWS) continue;
+    struct timespec ts = { flusher.every_ms / 1000, (long)(flusher.every_ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+  }
+  gigam_close(g);
+  mysql_thread_end();
+  return NULL;
+}
+
+static void submit(job_t* j) {
+  pthread_mutex_lock(&work.mu);
+  list_push(j->route == R_BET ? &work.bets : &work.other, j);
+  pthread_cond_signal(&work.cv);
+  pthread_mutex_unlock(&work.mu);
+}
+
+/* ---------- Connections (event loop side) ---------- */
+
+typedef struct {
+  bool open;
+  unsigned gen;
+  char* in; size_t in_len, in_cap;
+  char* out; size_t out_len, out_off;
+  bool busy;          /* a request is with the workers */
+  bool close_after;   /* Connection: close / HTTP/1.0 */
+  bool want_close;    /* close once out is flushed */
+} conn_t;
+
+static conn_t* conns;
+static size_t nconns;
+static int epfd;
+static volatile sig_atomic_t stopping;
+
+static conn_t* conn_get(int fd) {
+  if ((size_t)fd >= nconns) {
+    size_t n = nconns ? nconns : 1024;
+    while (n <= (size_t)fd) n *= 2;
+    conn_t* nc = (conn_t*)realloc(conns, n * sizeof(conn_t));
+    if (!nc) return NULL;
+    memset(nc + nconns, 0, (n - nconns) * sizeof(conn_t));
+    conns = nc; nconns = n;
+  }
+  return &conns[fd];
+}
+
+static void conn_close(int fd) {
+  conn_t* c = &conns[fd];
+  epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+  close(fd);
+  free(c->in); free(c->out);
+  unsigned gen = c->gen + 1;
+  memset(c, 0, sizeof(*c));
+  c->gen = gen;     /* late worker results for the old connection are dropped */
+}
+
+static const char* status_text(int s) {
+  switch (s) {
+    case 200: return "OK";
+    case 201: return "Created";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    default:  return "Internal Server Error";
+  }
+}
+
+static int out_append(conn_t* c, const char* p, size_t n) {
+  char* no = (char*)realloc(c->out, c->out_len + n);
+  if (!no) return -1;
+  c->out = no;
+  memcpy(c->out + c->out_len, p, n);
+  c->out_len += n;
+  return 0;
+}
+
+static void conn_flush(int fd);
+
+static void queue_response(int fd, int status, const char* ctype, const char* body, size_t len) {
+  conn_t* c = &conns[fd];
+  char hdr[256];
+  int hl = snprintf(hdr, sizeof(hdr),
+    "HTTP/1.1 %d %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: %s\r\n\r\n",
+    status, status_text(status), ctype, len, c->close_after ? "close" : "keep-alive");
+  if (out_append(c, hdr, (size_t)hl) != 0 || (len && out_append(c, body, len) != 0)) { conn_close(fd); return; }
+  if (c->close_after) c->want_close = true;
+  c->busy = false;
+  conn_flush(fd);
+}
+
+static void queue_json(int fd, int status, const char* body) {
+  queue_response(fd, status, "application/json", body, strlen(body));
+}
+
+static void process_input(int fd);
+
+static void conn_flush(int fd) {
+  conn_t* c = &conns[fd];
+  while (c->out_off < c->out_len) {
+    ssize_t w = write(fd, c->out + c->out_off, c->out_len - c->out_off);
+    if (w > 0) { c->out_off += (size_t)w; continue; }
+    if (w < 0 && errno == EINTR) continue;
+    if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.fd = fd };
+      epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+      return;
+    }
+    conn_close(fd);
+    return;
+  }
+  c->out_len = c->out_off = 0;
+  struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+  epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+  if (c->want_close) { conn_close(fd); return; }
+  if (!c->busy && c->in_len) process_input(fd);   /* pipelined request */
+}
+
+static int route_of(const char* method, const char* path) {
+  size_t pl = strcspn(path, "?");
+  if (!strcmp(method, "POST") && pl == 4 && !strncmp(path, "/bet", 4)) return R_BET;
+  if (!strcmp(method, "POST") && pl == 7 && !strncmp(path, "/quotes", 7)) return R_QUOTES;
+  if (!strcmp(method, "GET") && !strncmp(path, "/risk/event/", 12) && atol(path + 12) > 0) return R_RISK;
+  if (!strcmp(method, "GET") && pl == 7 && !strncmp(path, "/report", 7)) return R_REPORT;
+  if (!strcmp(method, "GET") && pl == 8 && !strncmp(path, "/metrics", 8)) return R_METRICS;
+  return R_OTHER;
+}
+
+static size_t header_value(const char* hdrs, const char* end, const char* name, char* out, size_t n) {
+  size_t nl = strlen(name);
+  for (const char* p = hdrs; p < end; ) {
+    const char* eol = strstr(p, "\r\n");
+    if (!eol || eol > end) eol = end;
+    if ((size_t)(eol - p) > nl && !strncasecmp(p, name, nl) && p[nl] == ':') {
+      const char* v = p + nl + 1;
+      while (v < eol && (*v == ' ' || *v == '\t')) v++;
+      size_t len = (size_t)(eol - v);
+      if (len >= n) len = n - 1;
+      memcpy(out, v, len); out[len] = '\0';
+      return len + 1;
+    }
+    p = eol + 2;
+  }
+  return 0;
+}
+
+/* Parse one complete request from the input buffer, if there is one. */
+static void process_input(int fd) {
+  conn_t* c = &conns[fd];
+  if (c->busy || !c->in_len) return;
+  c->in[c->in_len] = '\0';
+  char* hend = strstr(c->in, "\r\n\r\n");
+  if (!hend) {
+    if (c->in_len >= MAX_REQUEST) { c->close_after = true; queue_json(fd, 413, "{\"error\":\"request too large\"}\n"); }
+    return;
+  }
+  char method[8], path[1024], version[16];
+  if (sscanf(c->in, "%7s %1023s %15s", method, path, version) != 3 || strncmp(version, "HTTP/1.", 7)) {
+    c->close_after = true;
+    queue_json(fd, 400, "{\"error\":\"bad request\"}\n");
+    return;
+  }
+  const char* hdrs = strstr(c->in, "\r\n") + 2;
+  char val[64];
+  size_t clen = 0;
+  if (header_value(hdrs, hend, "Content-Length", val, sizeof(val))) clen = (size_t)strtoul(val, NULL, 10);
+  bool keep = strcmp(version, "HTTP/1.0") != 0;
+  if (header_value(hdrs, hend, "Connection", val, sizeof(val))) {
+    if (!strncasecmp(val, "close", 5)) keep = false;
+    else if (!strncasecmp(val, "keep-alive", 10)) keep = true;
+  }
+  size_t hlen = (size_t)(hend - c->in) + 4;
+  if (clen > MAX_REQUEST) {
+    c->close_after = true;
+    queue_json(fd, 413, "{\"error\":\"request too large\"}\n");
+    return;
+  }
+  if (c->in_len < hlen + clen) return;       /* body still arriving */
+
+  c->close_after = !keep;
+  int route = route_of(method, path);
+  job_t* j = NULL;
+  if (route != R_METRICS && route != R_OTHER) {
+    j = (job_t*)calloc(1, sizeof(job_t));
+    if (j) { j->path = strdup(path); j->body = (char*)malloc(clen + 1); }
+    if (!j || !j->path || !j->body) { if (j) job_free(j); conn_close(fd); return; }
+    memcpy(j->body, c->in + hlen, clen); j->body[clen] = '\0';
+    j->fd = fd; j->gen = c->gen; j->route = route;
+    clock_gettime(CLOCK_MONOTONIC, &j->t0);
+  }
+  /* consume the request */
+  memmove(c->in, c->in + hlen + clen, c->in_len - hlen - clen);
+  c->in_len -= hlen + clen;
+  c->busy = true;
+
+  if (j) { submit(j); return; }
+  struct timespec t0; clock_gettime(CLOCK_MONOTONIC, &t0);
+  if (route == R_METRICS) {
+    char* buf = NULL; size_t len = 0;
+    FILE* f = open_memstream(&buf, &len);
+    if (f) { metrics_render(f); fclose(f); }
+    histo_add(R_METRICS, elapsed_us(&t0), 200);
+    queue_response(fd, 200, "text/plain; version=0.0.4", buf ? buf : "", buf ? len : 0);
+    free(buf);
+  } else {
+    histo_add(R_OTHER, elapsed_us(&t0), 404);
+    queue_json(fd, 404, "{\"error\":\"not found\"}\n");
+  }
+}
+
+static void conn_read(int fd) {
+  conn_t* c = &conns[fd];
+  for (;;) {
+    if (c->in_cap - c->in_len < 4096 + 1) {
+      size_t nc = c->in_cap ? c->in_cap * 2 : 8192;
+      if (nc > MAX_REQUEST * 2) { conn_close(fd); return; }
+      char* ni = (char*)realloc(c->in, nc);
+      if (!ni) { conn_close(fd); return; }
+      c->in = ni; c->in_cap = nc;
+    }
+    ssize_t r = read(fd, c->in + c->in_len, c->in_cap - c->in_len - 1);
+    if (r > 0) { c->in_len += (size_t)r; continue; }
+    if (r == 0) { conn_close(fd); return; }
+    if (errno == EINTR) continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+    conn_close(fd);
+    return;
+  }
+  process_input(fd);
+}
+
+static void drain_done(void) {
+  uint64_t n;
+  if (read(done.efd, &n, sizeof(n)) < 0) { /* spurious wakeup */ }
+  pthread_mutex_lock(&done.mu);
+  job_t* j = done.list.head;
+  done.list.head = done.list.tail = NULL; done.list.len = 0;
+  pthread_mutex_unlock(&done.mu);
+  while (j) {
+    job_t* next = j->next;
+    histo_add(j->route, elapsed_us(&j->t0), j->status);
+    if ((size_t)j->fd < nconns && conns[j->fd].open && conns[j->fd].gen == j->gen)
+      queue_response(j->fd, j->status ? j->status : 500, "application/json", j->resp ? j->resp : "", j->resp_len);
+    job_free(j);
+    j = next;
+  }
+}
+
+static int set_nonblock(int fd) {
+  int fl = fcntl(fd, F_GETFL, 0);
+  return fl < 0 ? -1 : fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+}
+
+static void on_signal(int sig) { (void)sig; stopping = 1; }
+
+static void usage(void) {
+  fprintf(stderr, "gigamd [--bind 127.0.0.1] [--port 8080] [--workers 8] [--group-max 64]\n"
+                  "       [--journal DIR [--fsync always|interval|none] [--flush-ms 5]]\n");
+}
+
+int main(int argc, char** argv) {
+  const char* bind_addr = "127.0.0.1"; int port = 8080, nworkers = 8;
+  const char* journal_dir = NULL; gigam_fsync_t fsync_policy = GIGAM_FSYNC_ALWAYS;
+  flusher.every_ms = 5;
+  static struct option o[] = {
+    {"bind",1,0,'b'}, {"port",1,0,'p'}, {"workers",1,0,'w'}, {"group-max",1,0,'g'},
+    {"journal",1,0,'j'}, {"fsync",1,0,'f'}, {"flush-ms",1,0,'F'}, {"help",0,0,'h'}, {0,0,0,0}
+  };
+  int ch, ix = 0;
+  while ((ch = getopt_long(argc, argv, "b:p:w:g:j:f:F:h", o, &ix)) != -1) {
+    if (ch == 'b') bind_addr = optarg;
+    else if (ch == 'p') port = atoi(optarg);
+    else if (ch == 'w') nworkers = atoi(optarg);
+    else if (ch == 'g') group_max = atoi(optarg);
+    else if (ch == 'j') journal_dir = optarg;
+    else if (ch == 'f') {
+      if (!strcmp(optarg, "always")) fsync_policy = GIGAM_FSYNC_ALWAYS;
+      else if (!strcmp(optarg, "interval")) fsync_policy = GIGAM_FSYNC_INTERVAL;
+      else if (!strcmp(optarg, "none")) fsync_policy = GIGAM_FSYNC_NONE;
+      else { usage(); return 2; }
+    }
+    else if (ch == 'F') flusher.every_ms = atoi(optarg);
+    else { usage(); return 2; }
+  }
+  if (port <= 0 || port > 65535 || nworkers < 1 || group_max < 1 || flusher.every_ms < 1) { usage(); return 2; }
+  if (group_max > 256) group_max = 256;
+
+  /* connection pool: one libgigam context per worker, opened up front */
+  mysql_library_init(0, NULL, NULL);
+  db_config_t cfg; db_load_env(&cfg);
+  gigam_ctx_t** ctx = (gigam_ctx_t**)calloc((size_t)nworkers, sizeof(*ctx));
+  if (!ctx) return 5;
+  for (int i=0;i<nworkers;i++) {
+    if (!(ctx[i] = gigam_open(&cfg))) { fprintf(stderr, "DB connect failed\n"); return 5; }
+  }
+  pthread_t flush_th;
+  if (journal_dir) {
+    char err[512];
+    if (!(journal = gigam_journal_open(journal_dir, fsync_policy, err, sizeof(err)))) { fprintf(stderr, "%s\n", err); return 1; }
+    gigam_journal_stats_t st; gigam_journal_stats(journal, &st);
+    if (st.torn) fprintf(stderr, "gigamd: journal: dropped %lld bytes of an incomplete record\n", st.torn);
+    if (st.pending) fprintf(stderr, "gigamd: journal: replaying %lld pending bets\n", st.pending);
+    flusher.cfg = cfg;
+    pthread_create(&flush_th, NULL, flusher_main, NULL);
+  }
+
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+  int one = 1;
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  struct sockaddr_in sa; memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET; sa.sin_port = htons((uint16_t)port);
+  if (inet_pton(AF_INET, bind_addr, &sa.sin_addr) != 1) { fprintf(stderr, "invalid --bind address\n"); return 2; }
+  if (lfd < 0 || bind(lfd, (struct sockaddr*)&sa, sizeof(sa)) != 0 || listen(lfd, 1024) != 0 || set_nonblock(lfd) != 0) {
+    perror("gigamd: listen");
+    return 1;
+  }
+
+  epfd = epoll_create1(0);
+  done.efd = eventfd(0, EFD_NONBLOCK);
+  if (epfd < 0 || done.efd < 0) { perror("gigamd"); return 1; }
+  struct epoll_event ev = { .events = EPOLLIN, .data.fd = lfd };
+  epoll_ctl(epfd, EPOLL_CTL_ADD, lfd, &ev);
+  ev.data.fd = done.efd;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, done.efd, &ev);
+
+  struct sigaction sa_sig; memset(&sa_sig, 0, sizeof(sa_sig));
+  sa_sig.sa_handler = on_signal;
+  sigaction(SIGINT, &sa_sig, NULL);
+  sigaction(SIGTERM, &sa_sig, NULL);
+  signal(SIGPIPE, SIG_IGN);
+
+  pthread_t* th = (pthread_t*)calloc((size_t)nworkers, sizeof(pthread_t));
+  if (!th) return 5;
+  for (int i=0;i<nworkers;i++) pthread_create(&th[i], NULL, worker_main, ctx[i]);
+  fprintf(stderr, "gigamd listening on %s:%d (%d workers, group-max %d)\n", bind_addr, port, nworkers, group_max);
+
+  struct epoll_event evs[MAX_EVENTS];
+  while (!stopping) {
+    int n = epoll_wait(epfd, evs, MAX_EVENTS, -1);
+    if (n < 0) { if (errno == EINTR) continue; perror("epoll_wait"); break; }
+    for (int i=0;i<n;i++) {
+      int fd = evs[i].data.fd;
+      if (fd == lfd) {
+        for (;;) {
+          int cfd = accept(lfd, NULL, NULL);
+          if (cfd < 0) break;
+          conn_t* c = conn_get(cfd);
+          if (!c || set_nonblock(cfd) != 0) { close(cfd); continue; }
+          setsockopt(cfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+          unsigned gen = c->gen;
+          memset(c, 0, sizeof(*c));
+          c->gen = gen; c->open = true;
+          struct epoll_event cev = { .events = EPOLLIN, .data.fd = cfd };
+          epoll_ctl(epfd, EPOLL_CTL_ADD, cfd, &cev);
+        }
+      } else if (fd == done.efd) {
+        drain_done();
+      } else if ((size_t)fd < nconns && conns[fd].open) {
+        if (evs[i].events & (EPOLLERR | EPOLLHUP)) { conn_close(fd); continue; }
+        if (evs[i].events & EPOLLOUT) conn_flush(fd);
+        if ((size_t)fd < nconns && conns[fd].open && (evs[i].events & EPOLLIN)) conn_read(fd);
+      }
+    }
+  }
+
+  pthread_mutex_lock(&work.mu);
+  work.stop = true;
+  pthread_cond_broadcast(&work.cv);
+  pthread_mutex_unlock(&work.mu);
+  for (int i=0;i<nworkers;i++) pthread_join(th[i], NULL);
+  for (int i=0;i<nworkers;i++) gigam_close(ctx[i]);
+  if (journal) {
+    atomic_store(&flusher.stop, true);
+    pthread_join(flush_th, NULL);
+    gigam_journal_stats_t st; gigam_journal_stats(journal, &st);
+    if (st.pending) fprintf(stderr, "gigamd: journal: %lld bets left for the next start\n", st.pending);
+    gigam_journal_close(journal);
+  }
+  free(th); free(ctx);
+  mysql_library_end();
+  return 0;
+}
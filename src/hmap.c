@@ -0,0 +1,105 @@
+#include "hmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+static size_t hmap_hash(long long key) {
+  /* splitmix64 finaliser: ids are dense, so spread them before masking */
+  unsigned long long x = (unsigned long long)key;
+  x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return (size_t)x;
+}
+
+void hmap_init(hmap_t* m, size_t val_size) {
+  memset(m, 0, sizeof(*m));
+  m->val_size = val_size;
+}
+
+void hmap_free(hmap_t* m) {
+  free(m->keys); free(m->used); free(m->vals);
+  m->keys=NULL; m->used=NULL; m->vals=NULL; m->cap=0; m->len=0;
+}
+
+static size_t hmap_slot(const hmap_t* m, long long key, bool* found) {
+  size_t mask = m->cap - 1;
+  size_t i = hmap_hash(key) & mask;
+  while (m->used[i]) {
+    if (m->keys[i] == key) { *found = true; return i; }
+    i = (i + 1) & mask;
+  }
+  *found = false;
+  return i;
+}
+
+static int hmap_grow(hmap_t* m) {
+  size_t ncap = m->cap ? m->cap * 2 : 64;
+  hmap_t n; hmap_init(&n, m->val_size);
+  n.keys = (long long*)malloc(ncap * sizeof(long long));
+  n.used = (unsigned char*)calloc(ncap, 1);
+  n.vals = (unsigned char*)calloc(ncap, m->val_size ? m->val_size : 1);
+  if (!n.keys || !n.used || !n.vals) { hmap_free(&n); return -1; }
+  n.cap = ncap;
+  for (size_t i=0;i<m->cap;i++) {
+    if (!m->used[i]) continue;
+    bool found; size_t j = hmap_slot(&n, m->keys[i], &found);
+    n.used[j] = 1; n.keys[j] = m->keys[i];
+    memcpy(n.vals + j*m->val_size, m->vals + i*m->val_size, m->val_size);
+  }
+  n.len = m->len;
+  hmap_free(m);
+  *m = n;
+  return 0;
+}
+
+void* hmap_get(const hmap_t* m, long long key) {
+  if (!m->cap) return NULL;
+  bool found; size_t i = hmap_slot(m, key, &found);
+  return found ? m->vals + i*m->val_size : NULL;
+}
+
+void* hmap_put(hmap_t* m, long long key, bool* created) {
+  if (created) *created = false;
+  if (m->cap) {
+    bool found; size_t i = hmap_slot(m, key, &found);
+    if (found) return m->vals + i*m->val_size;
+  }
+  /* keep load factor under 0.7 so probe chains stay short */
+  if ((m->len + 1) * 10 > m->cap * 7 && hmap_grow(m) != 0) return NULL;
+  bool found; size_t i = hmap_slot(m, key, &found);
+  m->used[i] = 1; m->keys[i] = key; m->len++;
+  if (created) *created = true;
+  return m->vals + i*m->val_size;
+}
+
+bool hmap_del(hmap_t* m, long long key) {
+  if (!m->cap) return false;
+  bool found; size_t i = hmap_slot(m, key, &found);
+  if (!found) return false;
+  /* backward-shift: pull later entries of the probe chain into the hole
+   * unless their home slot lies cyclically in (i, j], so no tombstones */
+  size_t mask = m->cap - 1;
+  for (size_t j = (i + 1) & mask; m->used[j]; j = (j + 1) & mask) {
+    size_t h = hmap_hash(m->keys[j]) & mask;
+    bool stays = i <= j ? (h > i && h <= j) : (h > i || h <= j);
+    if (stays) continue;
+    m->keys[i] = m->keys[j];
+    memcpy(m->vals + i*m->val_size, m->vals + j*m->val_size, m->val_size);
+    i = j;
+  }
+  m->used[i] = 0;
+  memset(m->vals + i*m->val_size, 0, m->val_size);
+  m->len--;
+  return true;
+}
+
+bool hmap_next(const hmap_t* m, size_t* pos, long long* key, void** val) {
+  while (*pos < m->cap) {
+    size_t i = (*pos)++;
+    if (!m->used[i]) continue;
+    if (key) *key = m->keys[i];
+    if (val) *val = m->vals + i*m->val_size;
+    return true;
+  }
+  return false;
+}
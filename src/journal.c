@@ -0,0 +1,464 @@
+#define _POSIX_C_SOURCE 200809L
+#include "journal.h"
+#include "market.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define JOURNAL_FILE   "bets.journal"
+#define APPLIED_FILE   "applied"
+#define REJECTED_FILE  "rejected.log"
+#define RECORD_MAX     512
+#define ROTATE_BYTES   (16LL << 20)   /* truncate a fully applied journal past this */
+
+struct gigam_journal {
+  char dir[512];
+  int fd, rnd;
+  gigam_fsync_t policy;
+  pthread_mutex_t mu;        /* written, applied, counters, err */
+  pthread_mutex_t sync_mu;   /* synced; when both are held, taken before mu */
+  long long written, synced, applied, pending, torn;
+  unsigned long long appended, napplied, rejected, syncs, flushes;
+  char err[512];
+};
+
+typedef struct {
+  gigam_bet_t b;
+  char key[65], market[16], side[16];
+  long long end;             /* journal offset just past this line */
+  const char* line;          /* payload, for rejected.log */
+} rec_t;
+
+static int jfail(gigam_journal_t* j, const char* fmt, ...) {
+  va_list ap; va_start(ap, fmt);
+  vsnprintf(j->err, sizeof(j->err), fmt, ap);
+  va_end(ap);
+  return GIGAM_EIO;
+}
+
+static uint32_t crc32(const char* p, size_t n) {
+  uint32_t c = 0xFFFFFFFFu;
+  for (size_t i=0;i<n;i++) {
+    c ^= (unsigned char)p[i];
+    for (int k=0;k<8;k++) c = (c >> 1) ^ (0xEDB88320u & (0u - (c & 1u)));
+  }
+  return ~c;
+}
+
+/* ---------- Records ---------- */
+
+/* "<crc32> key\tbm\tevent\trunner\tbettor\tmarket\tside\tline\tprice\tstake\tasian\tline_b\tprice_b\n"
+ * (lines and prices as decimal text: "-0.75", "1.9500") */
+static int format_record(const gigam_bet_t* b, const char* key, char* buf, size_t n) {
+  char payload[RECORD_MAX], line[16], line_b[16], price[24], price_b[24];
+  mkt_fmt_line(b->line_q, line, sizeof(line));       mkt_fmt_price(b->price_e4, price, sizeof(price));
+  mkt_fmt_line(b->line_b_q, line_b, sizeof(line_b)); mkt_fmt_price(b->price_b_e4, price_b, sizeof(price_b));
+  int len = snprintf(payload, sizeof(payload), "%s\t%ld\t%ld\t%ld\t%ld\t%s\t%s\t%s\t%s\t%ld\t%d\t%s\t%s",
+    key, b->bookmaker_id, b->event_id, b->runner_id, b->bettor_id, b->market, b->side,
+    line, price, b->stake_cents, b->asian ? 1 : 0, line_b, price_b);
+  if (len < 0 || (size_t)len >= sizeof(payload)) return -1;
+  int out = snprintf(buf, n, "%08x %s\n", (unsigned)crc32(payload, (size_t)len), payload);
+  return out < 0 || (size_t)out >= n ? -1 : out;
+}
+
+/* Journals written before fixed point hold "%.17g" doubles
+ * ("1.8999999999999999"); those round to the nearest unit. */
+static long text_e4(const char* s) {
+  long e4;
+  if (mkt_parse_price(s, &e4) == 0) return e4;
+  double d = strtod(s, NULL) * MKT_PRICE_ONE;
+  return (long)(d + (d < 0 ? -0.5 : 0.5));
+}
+
+static int text_q(const char* s) {
+  int q;
+  if (mkt_parse_line(s, &q) == 0) return q;
+  double d = strtod(s, NULL) * 4;
+  return (int)(d + (d < 0 ? -0.5 : 0.5));
+}
+
+/* One line without its '\n'; 0 if the checksum and all 13 fields are good. */
+static int parse_record(const char* line, size_t len, rec_t* r) {
+  if (len < 10 || len >= RECORD_MAX + 9 || line[8] != ' ') return -1;
+  char hex[9]; memcpy(hex, line, 8); hex[8] = '\0';
+  char* end;
+  unsigned long want = strtoul(hex, &end, 16);
+  if (*end || (uint32_t)want != crc32(line + 9, len - 9)) return -1;
+  if (!r) return 0;
+
+  char tmp[RECORD_MAX + 1];
+  memcpy(tmp, line + 9, len - 9); tmp[len - 9] = '\0';
+  char* f[13]; int nf = 0;
+  for (char* p = tmp; nf < 13; ) {
+    f[nf++] = p;
+    char* tab = strchr(p, '\t');
+    if (!tab) break;
+    *tab = '\0'; p = tab + 1;
+  }
+  if (nf != 13 || strlen(f[0]) > 64 || strlen(f[5]) >= sizeof(r->market) || strlen(f[6]) >= sizeof(r->side)) return -1;
+  memset(r, 0, sizeof(*r));
+  strcpy(r->key, f[0]); strcpy(r->market, f[5]); strcpy(r->side, f[6]);
+  r->b.bookmaker_id = atol(f[1]); r->b.event_id = atol(f[2]);
+  r->b.runner_id = atol(f[3]);    r->b.bettor_id = atol(f[4]);
+  r->b.market = r->market;        r->b.side = r->side;
+  r->b.line_q = text_q(f[7]);     r->b.price_e4 = text_e4(f[8]);
+  r->b.stake_cents = atol(f[9]);  r->b.asian = atoi(f[10]);
+  r->b.line_b_q = text_q(f[11]);  r->b.price_b_e4 = text_e4(f[12]);
+  r->b.bet_key = r->key;
+  return 0;
+}
+
+/* Walk complete, valid lines in [from, to), up to max of them, parsing
+ * into out[] when given. Returns the offset after the last good line. */
+static long long scan(int fd, long long from, long long to, long max, rec_t* out, char* payloads, long* count) {
+  static const size_t chunk = 1 << 16;
+  long long pos = from, end = from;
+  *count = 0;
+  char* buf = (char*)malloc(chunk);
+  if (!buf) return from;
+  while (pos < to && *count < max) {
+    size_t want = (size_t)(to - pos) < chunk ? (size_t)(to - pos) : chunk;
+    ssize_t r = pread(fd, buf, want, (off_t)pos);
+    if (r <= 0) break;
+    size_t start = 0;
+    for (size_t i=0;i<(size_t)r && *count < max;i++) {
+      if (buf[i] != '\n') continue;
+      rec_t* rec = out ? &out[*count] : NULL;
+      if (parse_record(buf + start, i - start, rec) != 0) goto done;
+      end = pos + (long long)i + 1;
+      if (rec) {
+        char* keep = payloads + (size_t)*count * (RECORD_MAX + 16);
+        memcpy(keep, buf + start + 9, i - start - 9); keep[i - start - 9] = '\0';
+        rec->line = keep;
+        rec->end = end;
+      }
+      (*count)++;
+      start = i + 1;
+    }
+    if (start == 0) break;   /* no complete line in a whole chunk: torn */
+    pos += (long long)start;
+  }
+done:
+  free(buf);
+  return end;
+}
+
+/* ---------- Offsets ---------- */
+
+static long long read_applied(const char* dir) {
+  char path[640];
+  snprintf(path, sizeof(path), "%s/" APPLIED_FILE, dir);
+  FILE* f = fopen(path, "r");
+  if (!f) return 0;
+  long long v = 0;
+  if (fscanf(f, "%lld", &v) != 1 || v < 0) v = 0;
+  fclose(f);
+  return v;
+}
+
+static int write_applied(const char* dir, long long off) {
+  char path[640], tmp[700];
+  snprintf(path, sizeof(path), "%s/" APPLIED_FILE, dir);
+  snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+  FILE* f = fopen(tmp, "w");
+  if (!f) return -1;
+  fprintf(f, "%lld\n", off);
+  if (fclose(f) != 0 || rename(tmp, path) != 0) { remove(tmp); return -1; }
+  return 0;
+}
+
+static unsigned long long count_lines(const char* path) {
+  FILE* f = fopen(path, "r");
+  if (!f) return 0;
+  unsigned long long n = 0; int ch;
+  while ((ch = fgetc(f)) != EOF) if (ch == '\n') n++;
+  fclose(f);
+  return n;
+}
+
+/* ---------- Open / close ---------- */
+
+gigam_journal_t* gigam_journal_open(const char* dir, gigam_fsync_t policy, char* err, size_t errsz) {
+  gigam_journal_t* j = (gigam_journal_t*)calloc(1, sizeof(*j));
+  if (!j) { snprintf(err, errsz, "journal: out of memory"); return NULL; }
+  snprintf(j->dir, sizeof(j->dir), "%s", dir);
+  j->policy = policy;
+  j->fd = j->rnd = -1;
+  pthread_mutex_init(&j->mu, NULL);
+  pthread_mutex_init(&j->sync_mu, NULL);
+
+  char path[640];
+  snprintf(path, sizeof(path), "%s/" JOURNAL_FILE, dir);
+  if (mkdir(dir, 0700) != 0 && errno != EEXIST) { snprintf(err, errsz, "journal: cannot create %s: %s", dir, strerror(errno)); goto fail; }
+  if ((j->fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600)) < 0) {
+    snprintf(err, errsz, "journal: cannot open %s: %s", path, strerror(errno)); goto fail;
+  }
+  struct flock fl; memset(&fl, 0, sizeof(fl));
+  fl.l_type = F_WRLCK; fl.l_whence = SEEK_SET;
+  if (fcntl(j->fd, F_SETLK, &fl) != 0) { snprintf(err, errsz, "journal: %s is in use by another process", dir); goto fail; }
+  if ((j->rnd = open("/dev/urandom", O_RDONLY | O_CLOEXEC)) < 0) { snprintf(err, errsz, "journal: /dev/urandom: %s", strerror(errno)); goto fail; }
+
+  struct stat st;
+  if (fstat(j->fd, &st) != 0) { snprintf(err, errsz, "journal: %s", strerror(errno)); goto fail; }
+  long long size = (long long)st.st_size;
+  j->applied = read_applied(dir);
+  /* applied beyond the end: the journal was truncated after a full flush */
+  if (j->applied > size) { j->applied = 0; write_applied(dir, 0); }
+
+  long n = 0;
+  long long good = scan(j->fd, j->applied, size, 0x7fffffffL, NULL, NULL, &n);
+  if (good < size) {
+    /* torn tail from a crash mid-append: never acknowledged, drop it */
+    if (ftruncate(j->fd, (off_t)good) != 0) { snprintf(err, errsz, "journal: truncate: %s", strerror(errno)); goto fail; }
+    j->torn = size - good;
+  }
+  j->written = j->synced = good;
+  j->pending = n;
+  return j;
+
+fail:
+  gigam_journal_close(j);
+  return NULL;
+}
+
+void gigam_journal_close(gigam_journal_t* j) {
+  if (!j) return;
+  if (j->fd >= 0) { if (j->policy != GIGAM_FSYNC_NONE) fdatasync(j->fd); close(j->fd); }
+  if (j->rnd >= 0) close(j->rnd);
+  pthread_mutex_destroy(&j->mu);
+  pthread_mutex_destroy(&j->sync_mu);
+  free(j);
+}
+
+const char* gigam_journal_errmsg(const gigam_journal_t* j) { return j->err; }
+gigam_fsync_t gigam_journal_policy(const gigam_journal_t* j) { return j->policy; }
+
+/* ---------- Append / sync ---------- */
+
+static int new_key(gigam_journal_t* j, char* out) {
+  unsigned char r[16];
+  if (read(j->rnd, r, sizeof(r)) != (ssize_t)sizeof(r)) return -1;
+  for (int i=0;i<16;i++) snprintf(out + 2*i, 3, "%02x", r[i]);
+  return 0;
+}
+
+/* Group commit: whoever syncs first covers every append written so far;
+ * later waiters whose bytes are already covered return without an fsync. */
+static int sync_to(gigam_journal_t* j, long long upto) {
+  int rc = GIGAM_OK;
+  pthread_mutex_lock(&j->sync_mu);
+  if (j->synced < upto) {
+    pthread_mutex_lock(&j->mu);
+    long long target = j->written;
+    pthread_mutex_unlock(&j->mu);
+    if (fdatasync(j->fd) != 0) rc = GIGAM_EIO;
+    else { j->synced = target; j->syncs++; }
+  }
+  pthread_mutex_unlock(&j->sync_mu);
+  return rc;
+}
+
+int gigam_journal_append(gigam_journal_t* j, const gigam_bet_t* bets, int n, char (*keys)[65]) {
+  if (n <= 0) return GIGAM_OK;
+  size_t cap = (size_t)n * (RECORD_MAX + 16), len = 0;
+  char* buf = (char*)malloc(cap);
+  if (!buf) return GIGAM_EIO;
+  for (int i=0;i<n;i++) {
+    if (bets[i].bet_key) snprintf(keys[i], 65, "%s", bets[i].bet_key);
+    else if (new_key(j, keys[i]) != 0) { free(buf); return GIGAM_EIO; }
+    int w = format_record(&bets[i], keys[i], buf + len, cap - len);
+    if (w < 0) { free(buf); return GIGAM_EINVAL; }
+    len += (size_t)w;
+  }
+
+  pthread_mutex_lock(&j->mu);
+  size_t off = 0;
+  while (off < len) {
+    ssize_t w = write(j->fd, buf + off, len - off);
+    if (w < 0 && errno == EINTR) continue;
+    if (w <= 0) break;
+    off += (size_t)w;
+  }
+  if (off < len) {
+    /* keep the file a sequence of whole records */
+    if (ftruncate(j->fd, (off_t)j->written) != 0) { /* open() will cut the torn tail */ }
+    jfail(j, "journal: write: %s", strerror(errno ? errno : EIO));
+    pthread_mutex_unlock(&j->mu);
+    free(buf);
+    return GIGAM_EIO;
+  }
+  j->written += (long long)len;
+  j->appended += (unsigned long long)n;
+  j->pending += n;
+  long long mine = j->written;
+  pthread_mutex_unlock(&j->mu);
+  free(buf);
+
+  if (j->policy != GIGAM_FSYNC_ALWAYS) return GIGAM_OK;
+  int rc = sync_to(j, mine);
+  if (rc != GIGAM_OK) {
+    pthread_mutex_lock(&j->mu); jfail(j, "journal: fdatasync: %s", strerror(errno)); pthread_mutex_unlock(&j->mu);
+  }
+  return rc;
+}
+
+int gigam_journal_sync(gigam_journal_t* j) {
+  pthread_mutex_lock(&j->mu);
+  long long upto = j->written;
+  pthread_mutex_unlock(&j->mu);
+  return sync_to(j, upto);
+}
+
+/* ---------- Flush ---------- */
+
+static void reject(gigam_journal_t* j, const rec_t* r, const char* why) {
+  char path[640];
+  snprintf(path, sizeof(path), "%s/" REJECTED_FILE, j->dir);
+  FILE* f = fopen(path, "a");
+  if (f) { fprintf(f, "%s\t%s\t%s\n", r->key, why, r->line); fclose(f); }
+  j->rejected++;
+}
+
+/* client-side errors (CR_*, 2000+) mean the connection, not the row */
+static int conn_error(MYSQL* c) { return mysql_errno(c) >= 2000; }
+
+static int insert_rows(MYSQL* c, const rec_t* recs, long n, char* row, size_t rowsz) {
+  char* sql = NULL; size_t len = 0;
+  FILE* f = open_memstream(&sql, &len);
+  if (!f) return -1;
+  fputs("INSERT INTO bets(" GIGAM_BET_COLUMNS ") VALUES", f);
+  long k = 0;
+  for (long i=0;i<n;i++) {
+    if (gigam_bet_invalid(&recs[i].b) || gigam_bet_values(&recs[i].b, row, rowsz) != 0) continue;
+    fprintf(f, "%s%s", k++ ? "," : "", row);
+  }
+  /* a key already in bets was applied before a crash: skip it */
+  fputs(" ON DUPLICATE KEY UPDATE bet_key=bet_key", f);
+  fclose(f);
+  int rc = k ? mysql_real_query(c, sql, (unsigned long)len) : 0;
+  free(sql);
+  return rc;
+}
+
+int gigam_journal_flush(gigam_ctx_t* g, gigam_journal_t* j, int max_rows, long* applied) {
+  if (applied) *applied = 0;
+  if (max_rows < 1) max_rows = 1;
+  pthread_mutex_lock(&j->mu);
+  long long from = j->applied, to = j->written;
+  pthread_mutex_unlock(&j->mu);
+  if (from >= to) return GIGAM_OK;
+
+  rec_t* recs = (rec_t*)malloc((size_t)max_rows * sizeof(rec_t));
+  char* payloads = (char*)malloc((size_t)max_rows * (RECORD_MAX + 16));
+  if (!recs || !payloads) { free(recs); free(payloads); return GIGAM_EIO; }
+  long n = 0;
+  scan(j->fd, from, to, max_rows, recs, payloads, &n);
+  if (n == 0) {
+    free(recs); free(payloads);
+    pthread_mutex_lock(&j->mu); jfail(j, "journal: unreadable record at offset %lld", from); pthread_mutex_unlock(&j->mu);
+    return GIGAM_EIO;
+  }
+
+  MYSQL* c = gigam_conn(g);
+  char row[1024];
+  int rc = GIGAM_OK;
+  long long upto = recs[n - 1].end;
+  long done_rows = n;
+  unsigned long long rejected = 0;
+
+  if (mysql_query(c, "START TRANSACTION") != 0 || insert_rows(c, recs, n, row, sizeof(row)) != 0 ||
+      mysql_query(c, "COMMIT") != 0) {
+    char why[512]; snprintf(why, sizeof(why), "%s", mysql_error(c));
+    if (mysql_query(c, "ROLLBACK") != 0) { /* nothing to undo on a dead connection */ }
+    if (conn_error(c)) {
+      upto = from; done_rows = 0; rc = GIGAM_EDB;
+      pthread_mutex_lock(&j->mu); jfail(j, "journal: flush: %s", why); pthread_mutex_unlock(&j->mu);
+    } else {
+      /* one bad row fails the batch: retry row by row and set the bad ones aside */
+      upto = from; done_rows = 0;
+      for (long i=0;i<n;i++) {
+        const char* invalid = gigam_bet_invalid(&recs[i].b);
+        if (!invalid && insert_rows(c, &recs[i], 1, row, sizeof(row)) != 0) {
+          if (conn_error(c)) {
+            rc = GIGAM_EDB;
+            pthread_mutex_lock(&j->mu); jfail(j, "journal: flush: %s", mysql_error(c)); pthread_mutex_unlock(&j->mu);
+            break;
+          }
+          pthread_mutex_lock(&j->mu); reject(j, &recs[i], mysql_error(c)); pthread_mutex_unlock(&j->mu);
+          rejected++;
+        } else if (invalid) {
+          pthread_mutex_lock(&j->mu); reject(j, &recs[i], invalid); pthread_mutex_unlock(&j->mu);
+          rejected++;
+        }
+        upto = recs[i].end; done_rows++;
+      }
+    }
+  }
+  free(recs); free(payloads);
+  if (done_rows == 0) return rc;
+
+  /* MySQL has the rows; losing this update only means replaying no-ops */
+  if (write_applied(j->dir, upto) != 0 && rc == GIGAM_OK) {
+    pthread_mutex_lock(&j->mu); rc = jfail(j, "journal: cannot update %s/" APPLIED_FILE, j->dir); pthread_mutex_unlock(&j->mu);
+  }
+  pthread_mutex_lock(&j->mu);
+  j->applied = upto;
+  j->pending -= done_rows;
+  j->napplied += (unsigned long long)(done_rows - (long)rejected);
+  j->flushes++;
+  bool rotate = j->applied == j->written && j->written >= ROTATE_BYTES;
+  pthread_mutex_unlock(&j->mu);
+  if (rotate) {
+    /* sync_mu first, as sync_to takes them; an append in between keeps it */
+    pthread_mutex_lock(&j->sync_mu);
+    pthread_mutex_lock(&j->mu);
+    if (j->applied == j->written && ftruncate(j->fd, 0) == 0) {
+      j->written = j->synced = j->applied = 0;
+      write_applied(j->dir, 0);
+    }
+    pthread_mutex_unlock(&j->mu);
+    pthread_mutex_unlock(&j->sync_mu);
+  }
+  if (applied) *applied = done_rows;
+  return rc;
+}
+
+/* ---------- Stats ---------- */
+
+void gigam_journal_stats(gigam_journal_t* j, gigam_journal_stats_t* st) {
+  memset(st, 0, sizeof(*st));
+  pthread_mutex_lock(&j->mu);
+  st->appended = j->appended; st->applied = j->napplied; st->rejected = j->rejected;
+  st->syncs = j->syncs; st->flushes = j->flushes;
+  st->size = j->written; st->applied_offset = j->applied;
+  st->pending = j->pending; st->torn = j->torn;
+  pthread_mutex_unlock(&j->mu);
+}
+
+int gigam_journal_peek(const char* dir, gigam_journal_stats_t* st) {
+  memset(st, 0, sizeof(*st));
+  char path[640];
+  snprintf(path, sizeof(path), "%s/" JOURNAL_FILE, dir);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return GIGAM_EIO;
+  struct stat s;
+  if (fstat(fd, &s) != 0) { close(fd); return GIGAM_EIO; }
+  st->size = (long long)s.st_size;
+  st->applied_offset = read_applied(dir);
+  if (st->applied_offset > st->size) st->applied_offset = 0;
+  long n = 0;
+  scan(fd, st->applied_offset, st->size, 0x7fffffffL, NULL, NULL, &n);
+  st->pending = n;
+  close(fd);
+  snprintf(path, sizeof(path), "%s/" REJECTED_FILE, dir);
+  st->rejected = count_lines(path);
+  return GIGAM_OK;
+}
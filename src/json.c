@@ -0,0 +1,147 @@
+#include "json.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char* skip_ws(const char* p) {
+  while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') p++;
+  return p;
+}
+
+static int put_char(json_obj_t* o, char ch) {
+  if (o->used >= sizeof(o->buf)) return -1;
+  o->buf[o->used++] = ch;
+  return 0;
+}
+
+static int hexval(char ch) {
+  if (ch >= '0' && ch <= '9') return ch - '0';
+  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+  return -1;
+}
+
+/* "..." at *p into o->buf; returns the stored string or NULL */
+static const char* parse_string(const char** pp, json_obj_t* o) {
+  const char* p = *pp;
+  if (*p != '"') return NULL;
+  p++;
+  const char* start = o->buf + o->used;
+  while (*p != '"') {
+    unsigned char ch = (unsigned char)*p;
+    if (!ch || ch < 0x20) return NULL;
+    if (ch != '\\') { if (put_char(o, (char)ch)) return NULL; p++; continue; }
+    p++;
+    switch (*p) {
+      case '"': case '\\': case '/': ch = (unsigned char)*p; break;
+      case 'b': ch = '\b'; break;
+      case 'f': ch = '\f'; break;
+      case 'n': ch = '\n'; break;
+      case 'r': ch = '\r'; break;
+      case 't': ch = '\t'; break;
+      case 'u': {
+        unsigned cp = 0;
+        for (int i=1;i<=4;i++) { int h = hexval(p[i]); if (h < 0) return NULL; cp = cp*16u + (unsigned)h; }
+        p += 4;
+        /* UTF-8, BMP only (surrogates are passed through as-is) */
+        if (cp < 0x80) { if (put_char(o, (char)cp)) return NULL; }
+        else if (cp < 0x800) {
+          if (put_char(o, (char)(0xC0 | (cp >> 6))) || put_char(o, (char)(0x80 | (cp & 0x3F)))) return NULL;
+        } else {
+          if (put_char(o, (char)(0xE0 | (cp >> 12))) || put_char(o, (char)(0x80 | ((cp >> 6) & 0x3F))) ||
+              put_char(o, (char)(0x80 | (cp & 0x3F)))) return NULL;
+        }
+        p++;
+        continue;
+      }
+      default: return NULL;
+    }
+    if (put_char(o, (char)ch)) return NULL;
+    p++;
+  }
+  if (put_char(o, '\0')) return NULL;
+  *pp = p + 1;
+  return start;
+}
+
+/* number / true / false / null copied verbatim ("null" -> NULL value) */
+static int parse_scalar(const char** pp, json_obj_t* o, const char** out) {
+  const char* p = *pp;
+  if (!strncmp(p, "null", 4)) { *out = NULL; *pp = p + 4; return 0; }
+  const char* s = p;
+  if (!strncmp(p, "true", 4)) p += 4;
+  else if (!strncmp(p, "false", 5)) p += 5;
+  else {
+    char* end;
+    strtod(s, &end);
+    if (end == s) return -1;
+    p = end;
+  }
+  const char* start = o->buf + o->used;
+  for (const char* q = s; q < p; q++) if (put_char(o, *q)) return -1;
+  if (put_char(o, '\0')) return -1;
+  *out = start;
+  *pp = p;
+  return 0;
+}
+
+int json_parse_object(const char** pp, json_obj_t* o) {
+  o->n = 0; o->used = 0;
+  const char* p = skip_ws(*pp);
+  if (*p++ != '{') return -1;
+  p = skip_ws(p);
+  if (*p == '}') { *pp = p + 1; return 0; }
+  for (;;) {
+    if (o->n >= JSON_MAX_FIELDS) return -1;
+    const char* key = parse_string(&p, o);
+    if (!key) return -1;
+    p = skip_ws(p);
+    if (*p++ != ':') return -1;
+    p = skip_ws(p);
+    const char* val;
+    if (*p == '"') { if (!(val = parse_string(&p, o))) return -1; }
+    else if (*p == '{' || *p == '[') return -1;
+    else if (parse_scalar(&p, o, &val) != 0) return -1;
+    o->key[o->n] = key; o->val[o->n] = val; o->n++;
+    p = skip_ws(p);
+    if (*p == ',') { p = skip_ws(p + 1); continue; }
+    if (*p == '}') { *pp = p + 1; return 0; }
+    return -1;
+  }
+}
+
+int json_array_next(const char** pp, int* first, json_obj_t* o) {
+  const char* p = skip_ws(*pp);
+  if (*first) {
+    if (*p++ != '[') return -1;
+    p = skip_ws(p);
+    *first = 0;
+    if (*p == ']') { *pp = p + 1; return 0; }
+  } else {
+    if (*p == ']') { *pp = p + 1; return 0; }
+    if (*p++ != ',') return -1;
+  }
+  if (json_parse_object(&p, o) != 0) return -1;
+  *pp = p;
+  return 1;
+}
+
+const char* json_get(const json_obj_t* o, const char* key) {
+  for (int i=0;i<o->n;i++) if (!strcmp(o->key[i], key)) return o->val[i];
+  return NULL;
+}
+
+long json_get_long(const json_obj_t* o, const char* key, long def) {
+  const char* v = json_get(o, key);
+  return v ? atol(v) : def;
+}
+
+double json_get_double(const json_obj_t* o, const char* key, double def) {
+  const char* v = json_get(o, key);
+  return v ? atof(v) : def;
+}
+
+int json_get_bool(const json_obj_t* o, const char* key, int def) {
+  const char* v = json_get(o, key);
+  if (!v) return def;
+  return !strcmp(v, "true") || (strcmp(v, "false") && atoi(v) != 0);
+}
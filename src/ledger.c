@@ -0,0 +1,296 @@
+#define _POSIX_C_SOURCE 200809L
+#include "ledger.h"
+#include "hmap.h"
+#include "report.h"
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdbool.h>
+
+static const char* const kind_names[] = { "bettor", "runner" };
+static const char* const src_names[]  = { "settlement", "commission", "payout", "adjustment" };
+
+/* ---------- Posting ---------- */
+
+typedef struct {
+  int kind; long owner, bookmaker_id, bet_id;
+  int src; long long source_id, amount;
+  size_t seq;   /* insertion order, kept within an account */
+} post_t;
+
+struct ledger_batch {
+  post_t* p; size_t n, cap;
+};
+
+ledger_batch_t* ledger_batch_new(void) {
+  return (ledger_batch_t*)calloc(1, sizeof(ledger_batch_t));
+}
+
+void ledger_batch_free(ledger_batch_t* b) {
+  if (!b) return;
+  free(b->p);
+  free(b);
+}
+
+int ledger_batch_add(ledger_batch_t* b, ledger_src_t src, long long source_id, long bet_id, long bookmaker_id,
+                     ledger_kind_t kind, long owner_id, long long amount_cents) {
+  if (!amount_cents) return 0;
+  if (b->n == b->cap) {
+    size_t nc = b->cap ? b->cap * 2 : 64;
+    post_t* p = (post_t*)realloc(b->p, nc * sizeof(post_t));
+    if (!p) return -1;
+    b->p = p; b->cap = nc;
+  }
+  b->p[b->n] = (post_t){ (int)kind, owner_id, bookmaker_id, bet_id, (int)src, source_id, amount_cents, b->n };
+  b->n++;
+  return 0;
+}
+
+static int cmp_post(const void* x, const void* y) {
+  const post_t* a = (const post_t*)x; const post_t* b = (const post_t*)y;
+  if (a->kind != b->kind) return a->kind - b->kind;
+  if (a->owner != b->owner) return (a->owner > b->owner) - (a->owner < b->owner);
+  return (a->seq > b->seq) - (a->seq < b->seq);
+}
+
+/* One account's run of postings: one balance upsert (its row lock is held
+ * until the caller commits), then its entries and their book contras in one
+ * INSERT, each with the running balance after it. */
+static int post_account(MYSQL* c, const post_t* p, size_t n) {
+  const char* k = kind_names[p->kind];
+  long long total = 0;
+  for (size_t i=0;i<n;i++) total += p[i].amount;
+
+  char q[512];
+  snprintf(q, sizeof(q),
+    "INSERT INTO ledger_balances(kind,owner_id,bookmaker_id,balance_cents,entries) VALUES('%s',%ld,%ld,%lld,%zu) "
+    "ON DUPLICATE KEY UPDATE balance_cents=balance_cents+VALUES(balance_cents), entries=entries+VALUES(entries)",
+    k, p->owner, p->bookmaker_id, total, n);
+  if (mysql_query(c, q) != 0) return -1;
+  snprintf(q, sizeof(q), "SELECT balance_cents FROM ledger_balances WHERE kind='%s' AND owner_id=%ld", k, p->owner);
+  if (mysql_query(c, q) != 0) return -1;
+  MYSQL_RES* r = mysql_store_result(c);
+  if (!r) return -1;
+  MYSQL_ROW row = mysql_fetch_row(r);
+  long long bal = row && row[0] ? atoll(row[0]) - total : 0;
+  mysql_free_result(r);
+
+  char* sql = NULL; size_t len = 0;
+  FILE* f = open_memstream(&sql, &len);
+  if (!f) return -1;
+  fputs("INSERT INTO ledger_entries(kind,owner_id,bookmaker_id,amount_cents,balance_after_cents,source,source_id,bet_id) VALUES", f);
+  for (size_t i=0;i<n;i++) {
+    char bet[32];
+    if (p[i].bet_id) snprintf(bet, sizeof(bet), "%ld", p[i].bet_id); else snprintf(bet, sizeof(bet), "NULL");
+    bal += p[i].amount;
+    fprintf(f, "%s('%s',%ld,%ld,%lld,%lld,'%s',%lld,%s),('book',%ld,%ld,%lld,NULL,'%s',%lld,%s)", i ? "," : "",
+            k, p[i].owner, p[i].bookmaker_id, p[i].amount, bal, src_names[p[i].src], p[i].source_id, bet,
+            p[i].bookmaker_id, p[i].bookmaker_id, -p[i].amount, src_names[p[i].src], p[i].source_id, bet);
+  }
+  fclose(f);
+  int rc = mysql_query(c, sql) != 0 ? -1 : 0;
+  free(sql);
+  return rc;
+}
+
+int ledger_batch_post(MYSQL* c, ledger_batch_t* b) {
+  /* accounts in (kind, owner) order: concurrent settlers touching the same
+   * bettors and runners lock them in the same order, so never deadlock */
+  qsort(b->p, b->n, sizeof(post_t), cmp_post);
+  int rc = 0;
+  for (size_t i=0;i<b->n && rc==0;) {
+    size_t j = i + 1;
+    while (j < b->n && b->p[j].kind == b->p[i].kind && b->p[j].owner == b->p[i].owner) j++;
+    rc = post_account(c, b->p + i, j - i);
+    i = j;
+  }
+  b->n = 0;
+  return rc;
+}
+
+int ledger_post(MYSQL* c, ledger_src_t src, long long source_id, long bet_id, long bookmaker_id,
+                ledger_kind_t kind, long owner_id, long long amount_cents) {
+  if (!amount_cents) return 0;
+  post_t p = { (int)kind, owner_id, bookmaker_id, bet_id, (int)src, source_id, amount_cents, 0 };
+  return post_account(c, &p, 1);
+}
+
+int ledger_balance(MYSQL* c, ledger_kind_t kind, long owner_id, long long* balance_cents, long long* entries) {
+  *balance_cents = 0; *entries = 0;
+  char q[256];
+  snprintf(q, sizeof(q), "SELECT balance_cents,entries FROM ledger_balances WHERE kind='%s' AND owner_id=%ld",
+           kind_names[kind], owner_id);
+  if (mysql_query(c, q) != 0) return -1;
+  MYSQL_RES* r = mysql_store_result(c);
+  if (!r) return -1;
+  MYSQL_ROW row = mysql_fetch_row(r);
+  if (row) { *balance_cents = atoll(row[0]); *entries = atoll(row[1]); }
+  mysql_free_result(r);
+  return 0;
+}
+
+void ledger_period_sql(ledger_kind_t kind, long bookmaker_id, const char* from, const char* to, char* q, size_t n) {
+  bool bettor = kind == LEDGER_BETTOR;
+  /* payouts post negative */
+  snprintf(q, n,
+    "SELECT o.id AS %s, o.%s, COUNT(*) AS entries, "
+    "ROUND(SUM(IF(le.source<>'payout',le.amount_cents,0))/100,2) AS %s, "
+    "ROUND(-SUM(IF(le.source='payout',le.amount_cents,0))/100,2) AS paid_usd, "
+    "ROUND(SUM(le.amount_cents)/100,2) AS balance_usd "
+    "FROM ledger_entries le JOIN %s o ON o.id=le.owner_id "
+    "WHERE le.bookmaker_id=%ld AND le.kind='%s' AND " RANGE_SQL("le.created_at") " "
+    "GROUP BY o.id,o.%s ORDER BY balance_usd DESC",
+    bettor ? "bettor_id" : "runner_id", bettor ? "code" : "name", bettor ? "owed_gross_usd" : "commissions_usd",
+    bettor ? "bettors" : "runners", bookmaker_id, kind_names[kind], from, to, bettor ? "code" : "name");
+}
+
+/* ---------- Verify ---------- */
+
+/* per kind: the source rows an account balance is made of, as
+ * (owner, signed cents) sums over an owner-id range */
+static const char* const source_sql[2][2] = {
+  { "SELECT bettor_id,-SUM(COALESCE(profit_cents,0)) FROM bets WHERE status='settled' AND bettor_id BETWEEN %ld AND %ld GROUP BY bettor_id",
+    "SELECT bettor_id,-SUM(amount_cents) FROM payouts_bettor WHERE bettor_id BETWEEN %ld AND %ld GROUP BY bettor_id" },
+  { "SELECT runner_id,SUM(commission_cents) FROM runner_commissions WHERE runner_id BETWEEN %ld AND %ld GROUP BY runner_id",
+    "SELECT runner_id,-SUM(amount_cents) FROM payouts_runner WHERE runner_id BETWEEN %ld AND %ld GROUP BY runner_id" },
+};
+
+typedef struct { long long source, entries, balance; } acct_t;
+
+typedef struct {
+  int kind; long owner;
+  acct_t a;
+} drift_t;
+
+typedef struct {
+  long max_id[2];
+  int ranges;               /* per kind; one more task checks the books */
+  pthread_mutex_t mu;
+  drift_t* drift; size_t ndrift, cap;
+  long accounts, unbalanced;
+  FILE* out;
+} verify_t;
+
+static int sum_into(MYSQL* c, const char* q, hmap_t* m, size_t field) {
+  if (mysql_query(c, q) != 0) return -1;
+  MYSQL_RES* r = mysql_use_result(c);
+  if (!r) return -1;
+  MYSQL_ROW row;
+  int rc = 0;
+  while ((row = mysql_fetch_row(r))) {
+    bool created;
+    acct_t* a = (acct_t*)hmap_put(m, atoll(row[0]), &created);
+    if (!a) { rc = -1; break; }
+    *(long long*)((char*)a + field) += row[1] ? atoll(row[1]) : 0;
+  }
+  if (mysql_errno(c)) rc = -1;
+  mysql_free_result(r);
+  return rc;
+}
+
+static int verify_books(MYSQL* c, verify_t* v) {
+  if (mysql_query(c, "SELECT bookmaker_id,SUM(amount_cents) FROM ledger_entries GROUP BY bookmaker_id HAVING SUM(amount_cents)<>0") != 0)
+    return -1;
+  MYSQL_RES* r = mysql_store_result(c);
+  if (!r) return -1;
+  MYSQL_ROW row;
+  pthread_mutex_lock(&v->mu);
+  while ((row = mysql_fetch_row(r))) {
+    v->unbalanced++;
+    fprintf(v->out, "book\t%s\t0.00\t%.2f\t-\n", row[0], atoll(row[1]) / 100.0);
+  }
+  pthread_mutex_unlock(&v->mu);
+  mysql_free_result(r);
+  return 0;
+}
+
+static int verify_task(MYSQL* c, size_t task, void* ud) {
+  verify_t* v = (verify_t*)ud;
+  if ((int)task == 2 * v->ranges) return verify_books(c, v);
+  int kind = (int)task / v->ranges, part = (int)task % v->ranges;
+  long span = v->max_id[kind] / v->ranges + 1;
+  long lo = part * span + 1, hi = lo + span - 1;
+
+  hmap_t m; hmap_init(&m, sizeof(acct_t));
+  char q[512];
+  int rc = 0;
+  for (int s=0;s<2 && rc==0;s++) {
+    snprintf(q, sizeof(q), source_sql[kind][s], lo, hi);
+    rc = sum_into(c, q, &m, offsetof(acct_t, source));
+  }
+  if (rc == 0) {
+    snprintf(q, sizeof(q), "SELECT owner_id,SUM(amount_cents) FROM ledger_entries WHERE kind='%s' AND owner_id BETWEEN %ld AND %ld GROUP BY owner_id",
+             kind_names[kind], lo, hi);
+    rc = sum_into(c, q, &m, offsetof(acct_t, entries));
+  }
+  if (rc == 0) {
+    snprintf(q, sizeof(q), "SELECT owner_id,balance_cents FROM ledger_balances WHERE kind='%s' AND owner_id BETWEEN %ld AND %ld",
+             kind_names[kind], lo, hi);
+    rc = sum_into(c, q, &m, offsetof(acct_t, balance));
+  }
+  if (rc == 0) {
+    size_t pos = 0; long long key; void* val;
+    pthread_mutex_lock(&v->mu);
+    v->accounts += (long)m.len;
+    while (hmap_next(&m, &pos, &key, &val)) {
+      acct_t* a = (acct_t*)val;
+      if (a->source == a->entries && a->entries == a->balance) continue;
+      if (v->ndrift == v->cap) {
+        size_t nc = v->cap ? v->cap * 2 : 64;
+        drift_t* p = (drift_t*)realloc(v->drift, nc * sizeof(drift_t));
+        if (!p) { rc = -1; break; }
+        v->drift = p; v->cap = nc;
+      }
+      v->drift[v->ndrift++] = (drift_t){ kind, (long)key, *a };
+    }
+    pthread_mutex_unlock(&v->mu);
+  }
+  hmap_free(&m);
+  return rc;
+}
+
+static int cmp_drift(const void* x, const void* y) {
+  const drift_t* a = (const drift_t*)x; const drift_t* b = (const drift_t*)y;
+  if (a->kind != b->kind) return a->kind - b->kind;
+  return (a->owner > b->owner) - (a->owner < b->owner);
+}
+
+int ledger_verify(const db_config_t* cfg, int parallel, FILE* out, ledger_verify_t* res) {
+  memset(res, 0, sizeof(*res));
+  verify_t v;
+  memset(&v, 0, sizeof(v));
+  v.out = out;
+  v.ranges = parallel < 1 ? 1 : parallel;
+  pthread_mutex_init(&v.mu, NULL);
+
+  MYSQL* c = db_connect(cfg);
+  if (!c) return -1;
+  int rc = 0;
+  const char* qmax[2] = { "SELECT COALESCE(MAX(id),0) FROM bettors", "SELECT COALESCE(MAX(id),0) FROM runners" };
+  for (int k=0;k<2 && rc==0;k++) {
+    MYSQL_RES* r = NULL;
+    if (mysql_query(c, qmax[k]) != 0 || !(r = mysql_store_result(c))) { rc = -1; break; }
+    MYSQL_ROW row = mysql_fetch_row(r);
+    v.max_id[k] = row && row[0] ? atol(row[0]) : 0;
+    mysql_free_result(r);
+  }
+  if (rc != 0) fprintf(stderr, "SQL error: %s\n", mysql_error(c));
+  db_disconnect(c);
+  if (rc != 0) { pthread_mutex_destroy(&v.mu); return -1; }
+
+  fprintf(out, "kind\towner_id\tsource_usd\tentries_usd\tbalance_usd\n");
+  if (db_parallel(cfg, (size_t)(2 * v.ranges + 1), v.ranges, verify_task, &v) != 0) rc = -1;
+  qsort(v.drift, v.ndrift, sizeof(drift_t), cmp_drift);
+  for (size_t i=0;i<v.ndrift;i++) {
+    const drift_t* d = &v.drift[i];
+    fprintf(out, "%s\t%ld\t%.2f\t%.2f\t%.2f\n", kind_names[d->kind], d->owner,
+            d->a.source / 100.0, d->a.entries / 100.0, d->a.balance / 100.0);
+  }
+  res->accounts = v.accounts;
+  res->drift = (long)v.ndrift;
+  res->unbalanced = v.unbalanced;
+  free(v.drift);
+  pthread_mutex_destroy(&v.mu);
+  return rc;
+}
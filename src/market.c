@@ -0,0 +1,230 @@
+#include "market.h"
+#include <stdio.h>
+#include <string.h>
+
+static int cmp(int x, int y) { return x > y ? 1 : (x < y ? -1 : 0); }
+static int yes(int c) { return c ? 1 : -1; }
+
+/* ---------- Outcomes ---------- */
+
+/* scores are compared in quarter goals against line_q */
+
+static int o_moneyline(mkt_side_t s, int line_q, int line_b_q, int h, int a) {
+  (void)line_q; (void)line_b_q;
+  if (s == SIDE_DRAW) return yes(h == a);
+  return s == SIDE_HOME ? cmp(h, a) : cmp(a, h);   /* draw pushes */
+}
+
+static int o_threeway(mkt_side_t s, int line_q, int line_b_q, int h, int a) {
+  (void)line_q; (void)line_b_q;
+  if (s == SIDE_HOME) return yes(h > a);
+  if (s == SIDE_AWAY) return yes(a > h);
+  return yes(h == a);
+}
+
+static int o_spread(mkt_side_t s, int line_q, int line_b_q, int h, int a) {
+  (void)line_b_q;
+  return s == SIDE_HOME ? cmp(4*h + line_q, 4*a) : cmp(4*a + line_q, 4*h);
+}
+
+static int o_goals(mkt_side_t s, int line_q, int goals) {
+  return s == SIDE_OVER ? cmp(4*goals, line_q) : cmp(line_q, 4*goals);
+}
+
+static int o_total(mkt_side_t s, int line_q, int line_b_q, int h, int a) { (void)line_b_q; return o_goals(s, line_q, h + a); }
+static int o_team_home(mkt_side_t s, int line_q, int line_b_q, int h, int a) { (void)line_b_q; (void)a; return o_goals(s, line_q, h); }
+static int o_team_away(mkt_side_t s, int line_q, int line_b_q, int h, int a) { (void)line_b_q; (void)h; return o_goals(s, line_q, a); }
+
+static int o_btts(mkt_side_t s, int line_q, int line_b_q, int h, int a) {
+  (void)line_q; (void)line_b_q;
+  int both = h > 0 && a > 0;
+  return yes(s == SIDE_YES ? both : !both);
+}
+
+static int o_correct_score(mkt_side_t s, int line_q, int line_b_q, int h, int a) {
+  (void)s;
+  return yes(4*h == line_q && 4*a == line_b_q);
+}
+
+static int o_double_chance(mkt_side_t s, int line_q, int line_b_q, int h, int a) {
+  (void)line_q; (void)line_b_q;
+  if (s == SIDE_HOME_DRAW) return yes(h >= a);
+  if (s == SIDE_HOME_AWAY) return yes(h != a);
+  return yes(a >= h);
+}
+
+static int o_dnb(mkt_side_t s, int line_q, int line_b_q, int h, int a) {
+  (void)line_q; (void)line_b_q;
+  return s == SIDE_HOME ? cmp(h, a) : cmp(a, h);
+}
+
+/* ---------- Table ---------- */
+
+#define S(x) (1u << SIDE_##x)
+
+const mkt_rule_t mkt_rules[MKT_COUNT] = {
+  [MKT_NONE]            = { NULL, 0, 0, NULL, 0, 0 },
+  /* a moneyline draw refunds HOME/AWAY, so those two are its book */
+  [MKT_MONEYLINE]       = { "moneyline",       S(HOME)|S(AWAY)|S(DRAW), 0,                          o_moneyline,     S(HOME)|S(AWAY), 1 },
+  [MKT_THREEWAY]        = { "threeway",        S(HOME)|S(AWAY)|S(DRAW), 0,                          o_threeway,      S(HOME)|S(AWAY)|S(DRAW), 1 },
+  [MKT_SPREAD]          = { "spread",          S(HOME)|S(AWAY),         MKT_F_LINE|MKT_F_QUARTER|MKT_F_HANDICAP, o_spread, S(HOME)|S(AWAY), 1 },
+  [MKT_TOTAL]           = { "total",           S(OVER)|S(UNDER),        MKT_F_LINE|MKT_F_QUARTER,   o_total,         S(OVER)|S(UNDER), 1 },
+  [MKT_BTTS]            = { "btts",            S(YES)|S(NO),            0,                          o_btts,          S(YES)|S(NO), 1 },
+  [MKT_CORRECT_SCORE]   = { "correct_score",   S(SCORE),                MKT_F_SCORE,                o_correct_score, 0, 0 },
+  [MKT_DOUBLE_CHANCE]   = { "double_chance",   S(HOME_DRAW)|S(HOME_AWAY)|S(DRAW_AWAY), 0,           o_double_chance, S(HOME_DRAW)|S(HOME_AWAY)|S(DRAW_AWAY), 2 },
+  [MKT_DNB]             = { "dnb",             S(HOME)|S(AWAY),         0,                          o_dnb,           S(HOME)|S(AWAY), 1 },
+  [MKT_TEAM_TOTAL_HOME] = { "team_total_home", S(OVER)|S(UNDER),        MKT_F_LINE|MKT_F_QUARTER,   o_team_home,     S(OVER)|S(UNDER), 1 },
+  [MKT_TEAM_TOTAL_AWAY] = { "team_total_away", S(OVER)|S(UNDER),        MKT_F_LINE|MKT_F_QUARTER,   o_team_away,     S(OVER)|S(UNDER), 1 },
+};
+
+#undef S
+
+const char* const mkt_side_names[SIDE_COUNT] = {
+  NULL, "HOME", "AWAY", "DRAW", "OVER", "UNDER",
+  "YES", "NO", "HOME_DRAW", "HOME_AWAY", "DRAW_AWAY", "SCORE"
+};
+
+mkt_market_t mkt_market_code(const char* name) {
+  if (!name) return MKT_NONE;
+  for (int m=1;m<MKT_COUNT;m++) if (!strcmp(name, mkt_rules[m].name)) return (mkt_market_t)m;
+  return MKT_NONE;
+}
+
+mkt_side_t mkt_side_code(const char* name) {
+  if (!name) return SIDE_NONE;
+  for (int s=1;s<SIDE_COUNT;s++) if (!strcmp(name, mkt_side_names[s])) return (mkt_side_t)s;
+  return SIDE_NONE;
+}
+
+const char* mkt_check(mkt_market_t m, mkt_side_t s, int line_q, int line_b_q, int asian) {
+  if (m <= MKT_NONE || m >= MKT_COUNT) return "unknown market";
+  if (s <= SIDE_NONE || s >= SIDE_COUNT || !(mkt_rules[m].sides & (1u << s))) return "side not valid for this market";
+  unsigned fl = mkt_rules[m].flags;
+  if (fl & MKT_F_SCORE) {
+    if (asian || line_q < 0 || line_b_q < 0 || line_q % 4 || line_b_q % 4)
+      return "correct_score takes the home/away score as line/line_b";
+  } else if (!(fl & MKT_F_LINE) && asian) {
+    return "asian lines only apply to spread/total markets";
+  }
+  return NULL;
+}
+
+/* ---------- Fixed point ---------- */
+
+/* [+-]digits[.digits] scaled by 10^places; extra decimals must be zeros */
+static int parse_fixed(const char* s, int places, long long max, long long* out) {
+  if (!s) return -1;
+  const char* p = s;
+  int neg = 0, digits = 0, frac = 0;
+  if (*p == '+' || *p == '-') neg = *p++ == '-';
+  long long v = 0;
+  for (; *p >= '0' && *p <= '9'; p++, digits++) {
+    v = v * 10 + (*p - '0');
+    if (v > max) return -1;
+  }
+  if (*p == '.') {
+    for (p++; *p >= '0' && *p <= '9'; p++, digits++) {
+      if (frac == places) { if (*p != '0') return -1; continue; }
+      v = v * 10 + (*p - '0'); frac++;
+    }
+  }
+  if (!digits || *p) return -1;
+  for (; frac < places; frac++) v *= 10;
+  if (v > max) return -1;
+  *out = neg ? -v : v;
+  return 0;
+}
+
+int mkt_parse_price(const char* s, long* price_e4) {
+  long long v;
+  /* up to 10000.0000: a single's stake * price_e4 stays far inside int64;
+   * parlay products are capped in gigam_parlay_place */
+  if (parse_fixed(s, 4, 100000000LL, &v) != 0 || v < 0) return -1;
+  *price_e4 = (long)v;
+  return 0;
+}
+
+int mkt_parse_line(const char* s, int* line_q) {
+  long long v;
+  if (parse_fixed(s, 2, 100000LL, &v) != 0 || v % 25) return -1;
+  *line_q = (int)(v / 25);
+  return 0;
+}
+
+void mkt_fmt_price(long price_e4, char* buf, size_t n) {
+  snprintf(buf, n, "%ld.%04ld", price_e4 / MKT_PRICE_ONE, price_e4 % MKT_PRICE_ONE);
+}
+
+void mkt_fmt_line(int line_q, char* buf, size_t n) {
+  static const char* const frac[4] = { "", ".25", ".5", ".75" };
+  int v = line_q < 0 ? -line_q : line_q;
+  snprintf(buf, n, "%s%d%s", line_q < 0 ? "-" : "", v / 4, frac[v % 4]);
+}
+
+/* ---------- Settlement ---------- */
+
+/* A bet settles as one stake, or as two half stakes on an asian split /
+ * quarter line; every part carries its own line and price. */
+typedef struct { int line_q; long price_e4; long long stake; } mkt_part_t;
+
+static int bet_parts(const mkt_rule_t* r, const mkt_bet_t* b, mkt_part_t p[2]) {
+  long long half = b->stake_cents / 2, rest = b->stake_cents - half;
+  if ((r->flags & MKT_F_LINE) && b->asian && b->line_b_q != b->line_q) {
+    /* split given explicitly: line @ price, line_b @ price_b */
+    p[0] = (mkt_part_t){ b->line_q, b->price_e4, half };
+    p[1] = (mkt_part_t){ b->line_b_q, b->price_b_e4 > MKT_PRICE_ONE ? b->price_b_e4 : b->price_e4, rest };
+    return 2;
+  }
+  if ((r->flags & MKT_F_QUARTER) && b->line_q % 2) {
+    /* -0.75 = half on -0.5, half on -1.0 */
+    p[0] = (mkt_part_t){ b->line_q - 1, b->price_e4, half };
+    p[1] = (mkt_part_t){ b->line_q + 1, b->price_e4, rest };
+    return 2;
+  }
+  p[0] = (mkt_part_t){ b->line_q, b->price_e4, b->stake_cents };
+  return 1;
+}
+
+void mkt_settle(const mkt_bet_t* b, int home, int away, long long* payout, long long* profit) {
+  *payout = 0; *profit = 0;
+  if (b->market <= MKT_NONE || b->market >= MKT_COUNT) return;
+  const mkt_rule_t* r = &mkt_rules[b->market];
+  mkt_part_t p[2];
+  int n = bet_parts(r, b, p);
+  for (int i=0;i<n;i++) {
+    int c = r->outcome(b->side, p[i].line_q, b->line_b_q, home, away);
+    if (c > 0) {
+      long long w = (p[i].stake * p[i].price_e4 + MKT_PRICE_ONE / 2) / MKT_PRICE_ONE;
+      *payout += w;
+      *profit += w - p[i].stake;
+    } else if (c == 0) {
+      *payout += p[i].stake;   /* push */
+    } else {
+      *profit -= p[i].stake;
+    }
+  }
+}
+
+int mkt_outcome_key(const mkt_bet_t* b, int home, int away) {
+  if (b->market <= MKT_NONE || b->market >= MKT_COUNT) return -1;
+  const mkt_rule_t* r = &mkt_rules[b->market];
+  mkt_part_t p[2];
+  int n = bet_parts(r, b, p), key = 0;
+  for (int i=0;i<n;i++) key = key * 3 + r->outcome(b->side, p[i].line_q, b->line_b_q, home, away) + 1;
+  return key;
+}
+
+long long mkt_leg_factor(const mkt_bet_t* leg, int home, int away) {
+  mkt_bet_t unit = *leg;
+  unit.stake_cents = MKT_FACTOR_ONE;
+  long long payout, profit;
+  mkt_settle(&unit, home, away, &payout, &profit);
+  return payout;
+}
+
+long long mkt_apply_factor(long long payout, long long factor_e6) {
+  /* payout * factor_e6 can pass int64: split the factor into its whole
+   * part and millionths, (p*q*ONE + p*r + ONE/2) / ONE = p*q + (p*r + ONE/2) / ONE */
+  long long q = factor_e6 / MKT_FACTOR_ONE, r = factor_e6 % MKT_FACTOR_ONE;
+  return payout * q + (payout * r + MKT_FACTOR_ONE / 2) / MKT_FACTOR_ONE;
+}
@@ -0,0 +1,238 @@
+#include "mtm.h"
+#include "market.h"
+#include "hmap.h"
+#include "rptagg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* ---------- Latest price per pick ---------- */
+
+typedef struct {
+  long bm, event;
+  int market, side, line_q, line_b_q;
+} mtm_pick_t;
+
+typedef struct {
+  mtm_pick_t k;
+  long long quote_id;
+  long price;
+} mtm_px_t;
+
+/* Lines only take part where the market has them (as in quote matching):
+ * line_q for line markets, both scores for correct_score. */
+static void pick_norm(mtm_pick_t* k) {
+  unsigned fl = mkt_rules[k->market].flags;
+  if (!(fl & (MKT_F_LINE|MKT_F_SCORE))) k->line_q = 0;
+  if (!(fl & MKT_F_SCORE)) k->line_b_q = 0;
+}
+
+static unsigned long long pick_hash(const mtm_pick_t* k) {
+  unsigned long long h = 1469598103934665603ULL;
+  long long f[6] = { k->bm, k->event, k->market, k->side, k->line_q, k->line_b_q };
+  for (int i=0;i<6;i++) { h ^= (unsigned long long)f[i]; h *= 1099511628211ULL; h ^= h >> 29; }
+  return h;
+}
+
+static bool pick_eq(const mtm_pick_t* a, const mtm_pick_t* b) {
+  return a->bm == b->bm && a->event == b->event && a->market == b->market && a->side == b->side &&
+         a->line_q == b->line_q && a->line_b_q == b->line_b_q;
+}
+
+/* hmap is keyed by 64-bit ids: the pick's hash is the id and the pick is
+ * kept in the value, so a collision probes the next id of the sequence. */
+static mtm_px_t* px_find(hmap_t* m, const mtm_pick_t* k, bool create) {
+  unsigned long long h = pick_hash(k);
+  for (unsigned long long i=0;;i++) {
+    long long id = (long long)(h + i*0x9E3779B97F4A7C15ULL);
+    bool created = false;
+    mtm_px_t* v = (mtm_px_t*)(create ? hmap_put(m, id, &created) : hmap_get(m, id));
+    if (!v) return NULL;
+    if (created) { v->k = *k; return v; }
+    if (pick_eq(&v->k, k)) return v;
+  }
+}
+
+/* latest quote per pick: the highest quote id wins, so no ORDER BY */
+static int load_prices(MYSQL* c, const char* qfilter, const char* bfilter, hmap_t* px) {
+  char q[1024];
+  snprintf(q,sizeof(q),
+    "SELECT q.bookmaker_id,q.event_id,q.market_type+0,q.side+0,COALESCE(q.line_q,0),COALESCE(q.line_b_q,0),q.price_e4,q.id "
+    "FROM quotes q WHERE q.is_asian=0%s AND q.event_id IN (SELECT b.event_id FROM bets b WHERE b.status='open' AND b.bet_type='single'%s)",
+    qfilter, bfilter);
+  if (db_exec(c,q)!=0) return -1;
+  MYSQL_RES* r = mysql_use_result(c);
+  if (!r) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); return -1; }
+  MYSQL_ROW row; int rc = 0;
+  while ((row = mysql_fetch_row(r))) {
+    mtm_pick_t k = { atol(row[0]), atol(row[1]), atoi(row[2]), atoi(row[3]), atoi(row[4]), atoi(row[5]) };
+    if (k.market <= MKT_NONE || k.market >= MKT_COUNT) continue;
+    pick_norm(&k);
+    long long id = atoll(row[7]);
+    mtm_px_t* v = px_find(px, &k, true);
+    if (!v) { rc = -1; fprintf(stderr,"risk mtm: out of memory\n"); break; }
+    if (id > v->quote_id) { v->quote_id = id; v->price = atol(row[6]); }
+  }
+  if (!rc && mysql_errno(c)) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); rc = -1; }
+  mysql_free_result(r);
+  return rc;
+}
+
+/* ---------- Open bets ---------- */
+
+typedef struct {
+  long long bets, priced;
+  long long stake_cents, cashout_cents;   /* cash-out of unpriced bets = stake */
+} mtm_acc_t;
+
+typedef struct { long long id; const mtm_acc_t* acc; } mtm_row_t;
+
+static int mtm_cmp(const void* pa, const void* pb) {
+  const mtm_row_t* a = (const mtm_row_t*)pa; const mtm_row_t* b = (const mtm_row_t*)pb;
+  long long ma = a->acc->stake_cents - a->acc->cashout_cents, mb = b->acc->stake_cents - b->acc->cashout_cents;
+  if (ma != mb) return ma < mb ? -1 : 1;
+  return (a->id > b->id) - (a->id < b->id);
+}
+
+static int mtm_emit(const hmap_t* m, mtm_by_t by, rf_format_t fmt, const char* out_path) {
+  static const char* ids[] = { "event_id", "runner_id", "bettor_id" };
+  const char* hdr[6] = { ids[by], "bets", "priced", "stake_usd", "cashout_usd", "mtm_usd" };
+  mtm_row_t* rows = (mtm_row_t*)malloc((m->len ? m->len : 1)*sizeof(mtm_row_t));
+  if (!rows) return 5;
+  size_t n=0, pos=0; long long id; void* v;
+  while (hmap_next(m,&pos,&id,&v)) { rows[n].id = id; rows[n].acc = (const mtm_acc_t*)v; n++; }
+  qsort(rows, n, sizeof(mtm_row_t), mtm_cmp);
+  rf_ctx_t* rf = rf_begin(fmt, stdout, out_path, hdr, 6);
+  if (!rf) {
+    free(rows);
+    fprintf(stderr,"risk mtm: unable to open output file: %s\n", out_path ? out_path : "");
+    return 1;
+  }
+  for (size_t i=0;i<n;i++) {
+    const mtm_acc_t* a = rows[i].acc;
+    char c0[24], c1[24], c2[24], c3[32], c4[32], c5[32];
+    snprintf(c0,sizeof(c0),"%lld",rows[i].id);
+    snprintf(c1,sizeof(c1),"%lld",a->bets);
+    snprintf(c2,sizeof(c2),"%lld",a->priced);
+    rpt_fmt_cents(a->stake_cents,c3,sizeof(c3));
+    rpt_fmt_cents(a->cashout_cents,c4,sizeof(c4));
+    rpt_fmt_cents(a->stake_cents - a->cashout_cents,c5,sizeof(c5));
+    const char* row[6] = { c0, c1, c2, c3, c4, c5 };
+    rf_row(rf,row);
+  }
+  free(rows);
+  return rf_end(rf) ? 0 : 1;
+}
+
+/* open bets of one database into agg (mtm_acc_t by o->by); 0 or 5 */
+static int mtm_collect(MYSQL* c, const mtm_opts_t* o, hmap_t* agg) {
+  char qf[48] = "", bf[96] = "";
+  if (o->bookmaker_id) {
+    snprintf(qf,sizeof(qf)," AND q.bookmaker_id=%ld", o->bookmaker_id);
+    snprintf(bf,sizeof(bf)," AND b.bookmaker_id=%ld", o->bookmaker_id);
+  }
+  if (o->event_id) {
+    size_t len = strlen(bf);
+    snprintf(bf+len,sizeof(bf)-len," AND b.event_id=%ld", o->event_id);
+  }
+
+  hmap_t px; hmap_init(&px, sizeof(mtm_px_t));
+  if (load_prices(c, qf, bf, &px) != 0) { hmap_free(&px); return 5; }
+
+  char q[1024];
+  snprintf(q,sizeof(q),
+    "SELECT b.event_id,b.runner_id,b.bettor_id,b.bookmaker_id,b.market_type+0,b.pick_side+0,COALESCE(b.line_q,0),COALESCE(b.line_b_q,0),b.price_e4,b.stake_cents,"
+    "b.is_asian,COALESCE(b.price_b_e4,0) FROM bets b WHERE b.status='open' AND b.bet_type='single'%s", bf);
+  if (db_exec(c,q)!=0) { hmap_free(&px); return 5; }
+  MYSQL_RES* r = mysql_use_result(c);
+  if (!r) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); hmap_free(&px); return 5; }
+
+  int rc = 0;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r))) {
+    mtm_pick_t k = { atol(row[3]), atol(row[0]), atoi(row[4]), atoi(row[5]), atoi(row[6]), atoi(row[7]) };
+    long long stake = atoll(row[9]), value = stake;
+    /* an explicit asian split is two half stakes, line @ price and
+     * line_b @ price_b (as settlement splits it), each valued at the quote
+     * of its own line; unpriced unless both halves are */
+    struct { mtm_pick_t k; long price; long long stake; } part[2];
+    int nparts = 1;
+    part[0].k = k; part[0].price = atol(row[8]); part[0].stake = stake;
+    bool known = k.market > MKT_NONE && k.market < MKT_COUNT;
+    if (known && (mkt_rules[k.market].flags & MKT_F_LINE) && atoi(row[10]) && k.line_b_q != k.line_q) {
+      long price_b = atol(row[11]);
+      part[0].stake = stake / 2;
+      part[1].k = k; part[1].k.line_q = k.line_b_q;
+      part[1].price = price_b > MKT_PRICE_ONE ? price_b : part[0].price;
+      part[1].stake = stake - part[0].stake;
+      nparts = 2;
+    }
+    bool priced = known;
+    long long split = 0;
+    for (int i=0;i<nparts && priced;i++) {
+      pick_norm(&part[i].k);
+      const mtm_px_t* now = px_find(&px, &part[i].k, false);
+      priced = now && now->price > MKT_PRICE_ONE;
+      if (priced) split += (part[i].stake*part[i].price + now->price/2) / now->price;
+    }
+    if (priced) value = split;
+    long long key = atoll(row[o->by == MTM_BY_EVENT ? 0 : o->by == MTM_BY_RUNNER ? 1 : 2]);
+    bool created;
+    mtm_acc_t* a = (mtm_acc_t*)hmap_put(agg, key, &created);
+    if (!a) { fprintf(stderr,"risk mtm: out of memory\n"); rc = 5; break; }
+    a->bets++; a->priced += priced;
+    a->stake_cents += stake; a->cashout_cents += value;
+  }
+  if (!rc && mysql_errno(c)) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); rc = 5; }
+  mysql_free_result(r);
+  hmap_free(&px);
+  return rc;
+}
+
+int mtm_run(MYSQL* c, const mtm_opts_t* o, rf_format_t fmt, const char* out_path) {
+  hmap_t agg; hmap_init(&agg, sizeof(mtm_acc_t));
+  int rc = mtm_collect(c, o, &agg);
+  if (!rc) rc = mtm_emit(&agg, o->by, fmt, out_path);
+  hmap_free(&agg);
+  return rc;
+}
+
+/* ---------- Several databases ---------- */
+
+typedef struct {
+  const mtm_opts_t* o;
+  hmap_t* agg;         /* one per database */
+} mtm_shards_t;
+
+static int mtm_shard_task(MYSQL* c, size_t t, void* ud) {
+  mtm_shards_t* ms = (mtm_shards_t*)ud;
+  return mtm_collect(c, ms->o, &ms->agg[t]);
+}
+
+int mtm_run_sharded(const db_config_t* cfgs, int n, const mtm_opts_t* o, rf_format_t fmt, const char* out_path) {
+  hmap_t* agg = (hmap_t*)malloc((size_t)n*sizeof(hmap_t));
+  int* task_cfg = (int*)malloc((size_t)n*sizeof(int));
+  if (!agg || !task_cfg) { free(agg); free(task_cfg); return 5; }
+  for (int i=0;i<n;i++) { hmap_init(&agg[i], sizeof(mtm_acc_t)); task_cfg[i] = i; }
+  mtm_shards_t ms = { o, agg };
+  int failed = db_parallel_sharded(cfgs, n, task_cfg, (size_t)n, 1, mtm_shard_task, &ms);
+  int rc = failed ? 5 : 0;
+  if (failed < 0) fprintf(stderr,"DB connect failed\n");
+
+  /* each database holds its own bookmakers' bets: the sums just add up */
+  for (int i=1;i<n && !rc;i++) {
+    size_t pos=0; long long id; void* v;
+    while (hmap_next(&agg[i],&pos,&id,&v)) {
+      const mtm_acc_t* x = (const mtm_acc_t*)v;
+      mtm_acc_t* a = (mtm_acc_t*)hmap_put(&agg[0], id, NULL);
+      if (!a) { fprintf(stderr,"risk mtm: out of memory\n"); rc = 5; break; }
+      a->bets += x->bets; a->priced += x->priced;
+      a->stake_cents += x->stake_cents; a->cashout_cents += x->cashout_cents;
+    }
+  }
+  if (!rc) rc = mtm_emit(&agg[0], o->by, fmt, out_path);
+  for (int i=0;i<n;i++) hmap_free(&agg[i]);
+  free(agg); free(task_cfg);
+  return rc;
+}
@@ -0,0 +1,228 @@
+#define _POSIX_C_SOURCE 200809L
+#include "rcache.h"
+#include "report.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define RCACHE_MAGIC "GIGRC1"
+
+static const char* const rcache_counters[] = { "hit", "miss", "stale", "bypass" };
+#define RCACHE_NCOUNTERS (sizeof(rcache_counters)/sizeof(rcache_counters[0]))
+
+/* ---------- Paths ---------- */
+
+static int cache_dir(char* buf, size_t n) {
+  const char* d = getenv("GIGAM_CACHE_DIR");
+  if (d && *d) snprintf(buf, n, "%s", d);
+  else {
+    const char* home = getenv("HOME");
+    snprintf(buf, n, "%s/.cache/gigamctl", home && *home ? home : "/tmp");
+  }
+  /* mkdir -p */
+  for (char* p = buf + 1; ; p++) {
+    char ch = *p;
+    if (ch != '/' && ch != '\0') continue;
+    *p = '\0';
+    int rc = mkdir(buf, 0700);
+    *p = ch;
+    if (rc != 0 && errno != EEXIST) return -1;
+    if (!ch) break;
+  }
+  return 0;
+}
+
+static unsigned long long fnv1a(const char* s) {
+  unsigned long long h = 0xcbf29ce484222325ULL;
+  for (; *s; s++) { h ^= (unsigned char)*s; h *= 0x100000001b3ULL; }
+  return h;
+}
+
+static int entry_path(const char* key, char* buf, size_t n) {
+  char dir[768];
+  if (cache_dir(dir, sizeof(dir)) != 0) return -1;
+  snprintf(buf, n, "%s/%016llx.rc", dir, fnv1a(key));
+  return 0;
+}
+
+/* ---------- Watermark ---------- */
+
+int rcache_mark(MYSQL* c, long bm, const char* from, const char* to, rcache_mark_t* m) {
+  char q[2048];
+  /* payouts belong to the bookmaker through runner (and bettor -> runner);
+   * the bets part reads idx_bets_book_settled only (schema/010) */
+  snprintf(q, sizeof(q),
+    "SELECT COALESCE(MAX(b.settled_at),''), COUNT(*), COALESCE(SUM(b.profit_cents),0), COALESCE(MAX(b.id),0), "
+    "GREATEST("
+    "COALESCE((SELECT MAX(p.id) FROM payouts_bettor p JOIN bettors bt ON bt.id=p.bettor_id JOIN runners r ON r.id=bt.runner_id "
+    "WHERE r.bookmaker_id=%ld AND " RANGE_SQL("p.created_at") "),0), "
+    "COALESCE((SELECT MAX(p.id) FROM payouts_runner p JOIN runners r ON r.id=p.runner_id "
+    "WHERE r.bookmaker_id=%ld AND " RANGE_SQL("p.created_at") "),0)), "
+    "COALESCE((SELECT MAX(a.id) FROM settlement_adjustments a WHERE a.bookmaker_id=%ld),0) "
+    "FROM bets b WHERE b.bookmaker_id=%ld AND " RANGE_SQL("b.settled_at"),
+    bm, from, to, bm, from, to, bm, bm, from, to);
+  if (db_exec(c, q) != 0) return -1;
+  MYSQL_RES* r = mysql_store_result(c);
+  if (!r) return -1;
+  MYSQL_ROW row = mysql_fetch_row(r);
+  int rc = row ? 0 : -1;
+  if (row) {
+    snprintf(m->settled_max, sizeof(m->settled_max), "%s", row[0] ? row[0] : "");
+    m->settled_n = row[1] ? atoll(row[1]) : 0;
+    m->profit_sum = row[2] ? atoll(row[2]) : 0;
+    m->last_bet_id = row[3] ? atoll(row[3]) : 0;
+    m->last_payout_id = row[4] ? atoll(row[4]) : 0;
+    m->last_adjust_id = row[5] ? atoll(row[5]) : 0;
+  }
+  mysql_free_result(r);
+  return rc;
+}
+
+/* ---------- Entries ---------- */
+
+/* file: "GIGRC1\n<key>\n<settled_max>\t<n>\t<profit>\t<last_bet>\t<last_payout>\t<last_adjust>\n<len>\n<bytes>" */
+
+rcache_result_t rcache_get(const char* key, const rcache_mark_t* m, char** data, size_t* len) {
+  *data = NULL; *len = 0;
+  char path[1024];
+  if (entry_path(key, path, sizeof(path)) != 0) return RCACHE_MISS;
+  FILE* f = fopen(path, "rb");
+  if (!f) return RCACHE_MISS;
+
+  rcache_result_t res = RCACHE_MISS;
+  char line[1024], mark[256];
+  char want[256];
+  snprintf(want, sizeof(want), "%s\t%lld\t%lld\t%lld\t%lld\t%lld\n", m->settled_max, m->settled_n, m->profit_sum,
+           m->last_bet_id, m->last_payout_id, m->last_adjust_id);
+  unsigned long long n = 0;
+  if (!fgets(line, sizeof(line), f) || strcmp(line, RCACHE_MAGIC "\n")) goto done;
+  /* a different key hashing to the same file is just a miss */
+  if (!fgets(line, sizeof(line), f) || strncmp(line, key, strlen(key)) || line[strlen(key)] != '\n') goto done;
+  if (!fgets(mark, sizeof(mark), f)) goto done;
+  if (strcmp(mark, want)) { res = RCACHE_STALE; goto done; }
+  if (!fgets(line, sizeof(line), f) || sscanf(line, "%llu", &n) != 1) goto done;
+  char* buf = (char*)malloc(n ? n : 1);
+  if (!buf) goto done;
+  if (fread(buf, 1, n, f) != n) { free(buf); goto done; }
+  *data = buf; *len = n;
+  res = RCACHE_HIT;
+done:
+  fclose(f);
+  return res;
+}
+
+int rcache_put(const char* key, const rcache_mark_t* m, const char* data, size_t len) {
+  char path[1024], tmp[1100];
+  if (entry_path(key, path, sizeof(path)) != 0) return -1;
+  snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+  FILE* f = fopen(tmp, "wb");
+  if (!f) return -1;
+  fprintf(f, RCACHE_MAGIC "\n%s\n%s\t%lld\t%lld\t%lld\t%lld\t%lld\n%zu\n", key, m->settled_max, m->settled_n, m->profit_sum,
+          m->last_bet_id, m->last_payout_id, m->last_adjust_id, len);
+  int ok = fwrite(data, 1, len, f) == len;
+  if (fclose(f) != 0) ok = 0;
+  /* readers see the old entry or the new one, never half of it */
+  if (!ok || rename(tmp, path) != 0) { remove(tmp); return -1; }
+  return 0;
+}
+
+/* ---------- Stats ---------- */
+
+static void read_counters(const char* path, unsigned long long* v) {
+  memset(v, 0, RCACHE_NCOUNTERS * sizeof(*v));
+  FILE* f = fopen(path, "r");
+  if (!f) return;
+  char name[32]; unsigned long long x;
+  while (fscanf(f, "%31s %llu", name, &x) == 2) {
+    for (size_t i=0;i<RCACHE_NCOUNTERS;i++) if (!strcmp(name, rcache_counters[i])) v[i] = x;
+  }
+  fclose(f);
+}
+
+/* The read-increment-rename runs under an fcntl lock on stats.lock, so
+ * reports finishing together in other processes keep each other's counts;
+ * the mutex does the same for the report threads of this one (fcntl locks
+ * belong to the process). */
+static pthread_mutex_t stats_mu = PTHREAD_MUTEX_INITIALIZER;
+
+void rcache_count(const char* what) {
+  char dir[768], path[1024], tmp[1100];
+  if (cache_dir(dir, sizeof(dir)) != 0) return;
+  snprintf(path, sizeof(path), "%s/stats.lock", dir);
+  pthread_mutex_lock(&stats_mu);
+  int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+  struct flock fl; memset(&fl, 0, sizeof(fl));
+  fl.l_type = F_WRLCK; fl.l_whence = SEEK_SET;
+  if (fd < 0 || fcntl(fd, F_SETLKW, &fl) != 0) {
+    if (fd >= 0) close(fd);
+    pthread_mutex_unlock(&stats_mu);
+    return;
+  }
+  snprintf(path, sizeof(path), "%s/stats", dir);
+  snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid());
+  unsigned long long v[RCACHE_NCOUNTERS];
+  read_counters(path, v);
+  for (size_t i=0;i<RCACHE_NCOUNTERS;i++) if (!strcmp(what, rcache_counters[i])) v[i]++;
+  FILE* f = fopen(tmp, "w");
+  if (f) {
+    for (size_t i=0;i<RCACHE_NCOUNTERS;i++) fprintf(f, "%s %llu\n", rcache_counters[i], v[i]);
+    if (fclose(f) != 0 || rename(tmp, path) != 0) remove(tmp);
+  }
+  close(fd);   /* releases the lock */
+  pthread_mutex_unlock(&stats_mu);
+}
+
+int rcache_stats(FILE* out) {
+  char dir[768], path[1024];
+  if (cache_dir(dir, sizeof(dir)) != 0) { fprintf(stderr, "cache: cannot create %s\n", dir); return 1; }
+  snprintf(path, sizeof(path), "%s/stats", dir);
+  unsigned long long v[RCACHE_NCOUNTERS];
+  read_counters(path, v);
+
+  unsigned long long entries = 0, bytes = 0;
+  DIR* d = opendir(dir);
+  if (d) {
+    struct dirent* e;
+    while ((e = readdir(d))) {
+      size_t n = strlen(e->d_name);
+      if (n < 4 || strcmp(e->d_name + n - 3, ".rc")) continue;
+      snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+      struct stat st;
+      if (stat(path, &st) == 0) { entries++; bytes += (unsigned long long)st.st_size; }
+    }
+    closedir(d);
+  }
+  unsigned long long lookups = v[0] + v[1] + v[2];
+  fprintf(out, "dir\t%s\n", dir);
+  fprintf(out, "entries\t%llu\n", entries);
+  fprintf(out, "bytes\t%llu\n", bytes);
+  for (size_t i=0;i<RCACHE_NCOUNTERS;i++) fprintf(out, "%s\t%llu\n", rcache_counters[i], v[i]);
+  fprintf(out, "hit_rate\t%.1f%%\n", lookups ? 100.0 * (double)v[0] / (double)lookups : 0.0);
+  return 0;
+}
+
+int rcache_clear(void) {
+  char dir[768], path[1024];
+  if (cache_dir(dir, sizeof(dir)) != 0) { fprintf(stderr, "cache: cannot create %s\n", dir); return 1; }
+  DIR* d = opendir(dir);
+  if (!d) return 1;
+  unsigned long long n = 0;
+  struct dirent* e;
+  while ((e = readdir(d))) {
+    size_t len = strlen(e->d_name);
+    bool entry = len >= 4 && !strcmp(e->d_name + len - 3, ".rc");
+    if (!entry && strcmp(e->d_name, "stats")) continue;
+    snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+    if (remove(path) == 0 && entry) n++;
+  }
+  closedir(d);
+  printf("OK cleared %llu entries\n", n);
+  return 0;
+}
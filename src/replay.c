@@ -0,0 +1,262 @@
+#define _POSIX_C_SOURCE 200809L
+#include "replay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+static double ms_between(const struct timespec* a, const struct timespec* b) {
+  return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+/* ---------- Capture ---------- */
+
+void capture_begin(capture_t* cap) {
+  const char* p = getenv("GIGAM_CAPTURE");
+  cap->path = p && *p ? p : NULL;
+  if (!cap->path) return;
+  struct timespec now; clock_gettime(CLOCK_REALTIME, &now);
+  cap->start_ms = (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+  clock_gettime(CLOCK_MONOTONIC, &cap->t0);
+}
+
+static void put_escaped(FILE* f, const char* s) {
+  for (; *s; s++) {
+    if (*s == '\t') fputs("\\t", f);
+    else if (*s == '\n') fputs("\\n", f);
+    else if (*s == '\\') fputs("\\\\", f);
+    else fputc(*s, f);
+  }
+}
+
+void capture_end(const capture_t* cap, int argc, char** argv, int rc) {
+  if (!cap->path || argc < 2 || !strcmp(argv[1], "replay")) return;
+  struct timespec t1; clock_gettime(CLOCK_MONOTONIC, &t1);
+  char* line = NULL; size_t len = 0;
+  FILE* f = open_memstream(&line, &len);
+  if (!f) return;
+  fprintf(f, "%lld\t%lld\t%d", cap->start_ms, (long long)(ms_between(&cap->t0, &t1) * 1e3), rc);
+  for (int i=1;i<argc;i++) { fputc('\t', f); put_escaped(f, argv[i]); }
+  fputc('\n', f);
+  fclose(f);
+  int fd = open(cap->path, O_WRONLY|O_APPEND|O_CREAT, 0644);
+  if (fd < 0 || write(fd, line, len) != (ssize_t)len) fprintf(stderr, "capture: cannot write %s: %s\n", cap->path, strerror(errno));
+  if (fd >= 0) close(fd);
+  free(line);
+}
+
+/* ---------- Replay ---------- */
+
+typedef struct {
+  long long start_ms;
+  double rec_ms;       /* recorded duration */
+  char** argv;         /* argv[0] is the binary; NULL-terminated */
+  char type[64];       /* "bet place" */
+  double lat_ms, late_ms;
+  int rc;
+} rp_cmd_t;
+
+typedef struct {
+  rp_cmd_t* cmd; size_t n;
+  double speed;
+  struct timespec t0;
+  posix_spawn_file_actions_t fa;
+  atomic_size_t next;
+} rp_t;
+
+static void unescape(char* s) {
+  char* o = s;
+  for (; *s; s++) {
+    if (*s == '\\' && s[1]) {
+      s++;
+      *o++ = *s == 't' ? '\t' : *s == 'n' ? '\n' : *s;
+    } else {
+      *o++ = *s;
+    }
+  }
+  *o = '\0';
+}
+
+/* one capture line into c; -1 if malformed */
+static int parse_line(char* line, const char* exe, rp_cmd_t* c) {
+  memset(c, 0, sizeof(*c));
+  size_t n = strlen(line);
+  if (n && line[n-1] == '\n') line[--n] = '\0';
+  int nf = 1;
+  for (char* p=line; *p; p++) if (*p == '\t') nf++;
+  if (nf < 4) return -1;
+  char** f = calloc((size_t)nf + 1, sizeof(char*));
+  if (!f) return -1;
+  int k = 0;
+  for (char* p=line; ; ) {
+    f[k++] = p;
+    char* t = strchr(p, '\t');
+    if (!t) break;
+    *t = '\0'; p = t + 1;
+  }
+  char* end;
+  c->start_ms = strtoll(f[0], &end, 10);
+  if (*end || !*f[0]) { free(f); return -1; }
+  c->rec_ms = atof(f[1]) / 1e3;
+  int nargs = nf - 3;
+  if (!(c->argv = calloc((size_t)nargs + 2, sizeof(char*)))) { free(f); return -1; }
+  c->argv[0] = (char*)exe;
+  for (int i=0;i<nargs;i++) { unescape(f[3+i]); c->argv[1+i] = strdup(f[3+i]); }
+  snprintf(c->type, sizeof(c->type), "%s%s%s", c->argv[1],
+           nargs > 1 && c->argv[2][0] != '-' ? " " : "", nargs > 1 && c->argv[2][0] != '-' ? c->argv[2] : "");
+  free(f);
+  return !strcmp(c->argv[1], "replay") ? -1 : 0;
+}
+
+static void* rp_worker(void* arg) {
+  rp_t* r = (rp_t*)arg;
+  for (;;) {
+    size_t i = atomic_fetch_add(&r->next, 1);
+    if (i >= r->n) break;
+    rp_cmd_t* c = &r->cmd[i];
+    /* due at the recorded offset, compressed by --speed */
+    struct timespec due = r->t0, now;
+    if (r->speed > 0) {
+      double off_ms = (double)(c->start_ms - r->cmd[0].start_ms) / r->speed;
+      long long ns = (long long)(off_ms * 1e6) + due.tv_nsec;
+      due.tv_sec += (time_t)(ns / 1000000000LL); due.tv_nsec = (long)(ns % 1000000000LL);
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL) == EINTR) {}
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    c->late_ms = r->speed > 0 ? ms_between(&due, &now) : 0;
+    pid_t pid;
+    int st = 0;
+    if (posix_spawn(&pid, c->argv[0], &r->fa, NULL, c->argv, environ) != 0 || waitpid(pid, &st, 0) < 0) {
+      c->rc = -1;
+    } else {
+      c->rc = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + (WIFSIGNALED(st) ? WTERMSIG(st) : 0);
+    }
+    struct timespec t1; clock_gettime(CLOCK_MONOTONIC, &t1);
+    c->lat_ms = ms_between(&now, &t1);
+  }
+  return NULL;
+}
+
+static int cmp_start(const void* a, const void* b) {
+  const rp_cmd_t* x = a; const rp_cmd_t* y = b;
+  return x->start_ms < y->start_ms ? -1 : x->start_ms > y->start_ms;
+}
+
+static int cmp_dbl(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return x < y ? -1 : x > y;
+}
+
+static int cmp_type(const void* a, const void* b) {
+  return strcmp((*(rp_cmd_t* const*)a)->type, (*(rp_cmd_t* const*)b)->type);
+}
+
+static double pct(const double* v, size_t n, double p) { return v[(size_t)((n - 1) * p)]; }
+
+/* the row of one command type: cmds[0..n) */
+static bool emit(rf_ctx_t* rf, const char* type, rp_cmd_t* const* cmds, size_t n, double* lat, double* rec) {
+  long errors = 0;
+  for (size_t i=0;i<n;i++) { lat[i] = cmds[i]->lat_ms; rec[i] = cmds[i]->rec_ms; errors += cmds[i]->rc != 0; }
+  qsort(lat, n, sizeof(double), cmp_dbl);
+  qsort(rec, n, sizeof(double), cmp_dbl);
+  char cnt[24], err[24], p50[32], p90[32], p99[32], mx[32], r50[32];
+  snprintf(cnt, sizeof(cnt), "%zu", n);
+  snprintf(err, sizeof(err), "%ld", errors);
+  snprintf(p50, sizeof(p50), "%.2f", pct(lat, n, 0.50));
+  snprintf(p90, sizeof(p90), "%.2f", pct(lat, n, 0.90));
+  snprintf(p99, sizeof(p99), "%.2f", pct(lat, n, 0.99));
+  snprintf(mx, sizeof(mx), "%.2f", lat[n-1]);
+  snprintf(r50, sizeof(r50), "%.2f", pct(rec, n, 0.50));
+  const char* row[8] = { type, cnt, err, p50, p90, p99, mx, r50 };
+  return rf_row(rf, row);
+}
+
+int replay_run(const replay_opts_t* o, rf_format_t fmt, const char* out_path) {
+  char exe[4096];
+  ssize_t el = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  if (el <= 0) { fprintf(stderr, "replay: cannot find the gigamctl binary: %s\n", strerror(errno)); return 1; }
+  exe[el] = '\0';
+
+  FILE* in = strcmp(o->file, "-") ? fopen(o->file, "r") : stdin;
+  if (!in) { fprintf(stderr, "cannot open %s: %s\n", o->file, strerror(errno)); return 1; }
+  rp_t r;
+  memset(&r, 0, sizeof(r));
+  size_t cap = 0; long bad = 0;
+  char* line = NULL; size_t lcap = 0;
+  while (getline(&line, &lcap, in) > 0) {
+    if (line[0] == '\n') continue;
+    if (r.n == cap) {
+      cap = cap ? cap*2 : 1024;
+      rp_cmd_t* nc = realloc(r.cmd, cap*sizeof(rp_cmd_t));
+      if (!nc) break;
+      r.cmd = nc;
+    }
+    if (parse_line(line, exe, &r.cmd[r.n]) == 0) r.n++;
+    else { bad++; if (r.cmd[r.n].argv) { for (char** a=r.cmd[r.n].argv+1; *a; a++) free(*a); free(r.cmd[r.n].argv); } }
+  }
+  free(line);
+  if (in != stdin) fclose(in);
+  if (bad) fprintf(stderr, "replay: %ld lines skipped (malformed or replay)\n", bad);
+  if (!r.n) { fprintf(stderr, "replay: no commands in %s\n", o->file); free(r.cmd); return 2; }
+  qsort(r.cmd, r.n, sizeof(rp_cmd_t), cmp_start);
+
+  /* the replayed commands must not capture themselves into the file */
+  unsetenv("GIGAM_CAPTURE");
+  posix_spawn_file_actions_init(&r.fa);
+  posix_spawn_file_actions_addopen(&r.fa, 0, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&r.fa, 1, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&r.fa, 2, "/dev/null", O_WRONLY, 0);
+  r.speed = o->speed;
+  atomic_init(&r.next, 0);
+  int k = o->concurrency < 1 ? 1 : o->concurrency;
+  if ((size_t)k > r.n) k = (int)r.n;
+  pthread_t* th = calloc((size_t)k, sizeof(pthread_t));
+  int started = 0;
+  clock_gettime(CLOCK_MONOTONIC, &r.t0);
+  for (int i=0; th && i<k; i++) if (pthread_create(&th[started], NULL, rp_worker, &r) == 0) started++;
+  if (!started) rp_worker(&r);
+  for (int i=0;i<started;i++) pthread_join(th[i], NULL);
+  struct timespec t1; clock_gettime(CLOCK_MONOTONIC, &t1);
+  free(th);
+  posix_spawn_file_actions_destroy(&r.fa);
+
+  /* per type, then all */
+  rp_cmd_t** by = malloc(r.n*sizeof(rp_cmd_t*));
+  double* lat = malloc(r.n*sizeof(double));
+  double* rec = malloc(r.n*sizeof(double));
+  int rc = 1;
+  if (by && lat && rec) {
+    for (size_t i=0;i<r.n;i++) { by[i] = &r.cmd[i]; lat[i] = r.cmd[i].late_ms; }
+    qsort(lat, r.n, sizeof(double), cmp_dbl);
+    char pace[32] = "back to back";
+    if (r.speed > 0) snprintf(pace, sizeof(pace), "at %gx", r.speed);
+    fprintf(stderr, "replayed %zu commands in %.1fs (%s, %d at once); behind schedule p99_ms=%.1f max_ms=%.1f\n",
+            r.n, ms_between(&r.t0, &t1) / 1e3, pace, k, pct(lat, r.n, 0.99), lat[r.n-1]);
+    qsort(by, r.n, sizeof(rp_cmd_t*), cmp_type);
+    static const char* const hdr[8] = { "command","count","errors","p50_ms","p90_ms","p99_ms","max_ms","recorded_p50_ms" };
+    rf_ctx_t* rf = rf_begin(fmt, stdout, out_path, hdr, 8);
+    if (rf) {
+      bool ok = true;
+      for (size_t i=0;i<r.n; ) {
+        size_t j = i;
+        while (j < r.n && !strcmp(by[j]->type, by[i]->type)) j++;
+        ok = emit(rf, by[i]->type, by + i, j - i, lat, rec) && ok;
+        i = j;
+      }
+      ok = emit(rf, "all", by, r.n, lat, rec) && ok;
+      rc = rf_end(rf) && ok ? 0 : 1;
+    }
+  }
+  free(by); free(lat); free(rec);
+  for (size_t i=0;i<r.n;i++) { for (char** a=r.cmd[i].argv+1; *a; a++) free(*a); free(r.cmd[i].argv); }
+  free(r.cmd);
+  return rc;
+}
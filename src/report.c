@@ -0,0 +1,553 @@
+#define _POSIX_C_SOURCE 200809L
+#include "report.h"
+#include "rcache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/* ---------- SQL per report ---------- */
+
+int report_sql(rpt_kind_t kind, long bm, const char* from, const char* to, char* q, size_t n) {
+  switch (kind) {
+    case RPT_PNL_RUNNER:
+      snprintf(q,n,
+        "SELECT r.id AS runner_id, r.name, COUNT(b.id) AS bets, ROUND(SUM(b.stake_cents)/100,2) AS handle_usd, ROUND(SUM(COALESCE(b.profit_cents,0))/100,2) AS profit_usd "
+        "FROM bets b JOIN runners r ON r.id=b.runner_id "
+        "WHERE b.bookmaker_id=%ld AND b.status='settled' AND " RANGE_SQL("b.settled_at") " "
+        "GROUP BY r.id,r.name ORDER BY profit_usd DESC", bm, from, to);
+      return 0;
+    case RPT_PNL_BETTOR:
+      snprintf(q,n,
+        "SELECT bt.id AS bettor_id, bt.code, COUNT(b.id) AS bets, ROUND(SUM(b.stake_cents)/100,2) AS handle_usd, ROUND(SUM(COALESCE(b.profit_cents,0))/100,2) AS profit_usd "
+        "FROM bets b JOIN bettors bt ON bt.id=b.bettor_id "
+        "WHERE b.bookmaker_id=%ld AND b.status='settled' AND " RANGE_SQL("b.settled_at") " "
+        "GROUP BY bt.id,bt.code ORDER BY profit_usd ASC", bm, from, to);
+      return 0;
+    case RPT_PNL:
+      snprintf(q,n,
+        "SELECT COUNT(id) AS bets, ROUND(SUM(stake_cents)/100,2) AS handle_usd, ROUND(SUM(COALESCE(profit_cents,0))/100,2) AS profit_usd "
+        "FROM bets WHERE bookmaker_id=%ld AND status='settled' AND " RANGE_SQL("settled_at"),
+        bm, from, to);
+      return 0;
+    case RPT_RUNNER_COMMISSIONS:
+      snprintf(q,n,
+        "SELECT r.id AS runner_id, r.name, ROUND(SUM(rc.commission_cents)/100,2) AS commissions_usd, COUNT(rc.id) AS items "
+        "FROM runner_commissions rc JOIN bets b ON b.id=rc.bet_id JOIN runners r ON r.id=rc.runner_id "
+        "WHERE b.bookmaker_id=%ld AND " RANGE_SQL("b.settled_at") " "
+        "GROUP BY r.id,r.name ORDER BY commissions_usd DESC", bm, from, to);
+      return 0;
+    case RPT_BETTOR_BALANCES:
+      snprintf(q,n,
+        "SELECT bt.id AS bettor_id, bt.code, ROUND(-SUM(COALESCE(b.profit_cents,0))/100,2) AS owed_gross_usd, "
+        "ROUND(COALESCE((SELECT SUM(pr.amount_cents) FROM payouts_bettor pr WHERE pr.bettor_id=bt.id AND " RANGE_SQL("pr.created_at") "),0)/100,2) AS paid_usd, "
+        "ROUND((-SUM(COALESCE(b.profit_cents,0)) - COALESCE((SELECT SUM(pr.amount_cents) FROM payouts_bettor pr WHERE pr.bettor_id=bt.id AND " RANGE_SQL("pr.created_at") "),0))/100,2) AS balance_usd "
+        "FROM bets b JOIN bettors bt ON bt.id=b.bettor_id "
+        "WHERE b.bookmaker_id=%ld AND b.status='settled' AND " RANGE_SQL("b.settled_at") " "
+        "GROUP BY bt.id,bt.code ORDER BY balance_usd DESC", from,to, from,to, bm, from,to);
+      return 0;
+    case RPT_RUNNER_BALANCES:
+      snprintf(q,n,
+        "SELECT r.id AS runner_id, r.name, "
+        "ROUND(COALESCE(SUM(rc.commission_cents),0)/100,2) AS commissions_usd, "
+        "ROUND(COALESCE((SELECT SUM(pr.amount_cents) FROM payouts_runner pr WHERE pr.runner_id=r.id AND " RANGE_SQL("pr.created_at") "),0)/100,2) AS paid_usd, "
+        "ROUND((COALESCE(SUM(rc.commission_cents),0) - COALESCE((SELECT SUM(pr.amount_cents) FROM payouts_runner pr WHERE pr.runner_id=r.id AND " RANGE_SQL("pr.created_at") "),0))/100,2) AS balance_usd "
+        "FROM runners r LEFT JOIN runner_commissions rc ON rc.runner_id=r.id LEFT JOIN bets b ON b.id=rc.bet_id "
+        "WHERE b.bookmaker_id=%ld AND " RANGE_SQL("b.settled_at") " "
+        "GROUP BY r.id,r.name ORDER BY balance_usd DESC", from,to, from,to, bm, from,to);
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+int report_print(MYSQL_RES* r, rf_format_t fmt, FILE* out, const char* out_path) {
+  if (!r) return 0;
+  unsigned int nf = mysql_num_fields(r);
+  MYSQL_FIELD* flds = mysql_fetch_fields(r);
+  const char** hdr = (const char**)calloc(nf ? nf : 1, sizeof(char*));
+  if (!hdr) return 5;
+  for (unsigned int i=0;i<nf;i++) hdr[i] = flds[i].name ? flds[i].name : "";
+  /* table siempre va a 'out'; rf ignora out_path */
+  rf_ctx_t* rf = rf_begin(fmt, out, out_path, hdr, nf);
+  free(hdr);
+  if (!rf) {
+    fprintf(stderr, "report: unable to open output file: %s\n", out_path ? out_path : "");
+    return 1;
+  }
+  MYSQL_ROW row;
+  while ((row=mysql_fetch_row(r))) rf_row(rf, (const char* const*)row);
+  return rf_end(rf) ? 0 : 1;
+}
+
+int report_render(MYSQL_RES* r, rf_format_t fmt, char** buf, size_t* len) {
+  *buf = NULL; *len = 0;
+  FILE* mem = open_memstream(buf, len);
+  if (!mem) return 5;
+  int rc = report_print(r, fmt, mem, NULL);
+  if (fclose(mem) != 0 && rc == 0) rc = 5;
+  if (rc) { free(*buf); *buf = NULL; *len = 0; }
+  return rc;
+}
+
+/* same destination rules as report_print: json/csv honour --out */
+static int write_rendered(const char* buf, size_t len, rf_format_t fmt, const char* out_path) {
+  if (fmt == RF_TABLE || !out_path) {
+    fwrite(buf, 1, len, stdout);
+    return fflush(stdout) == 0 ? 0 : 1;
+  }
+  FILE* f = fopen(out_path, "wb");
+  if (!f) { fprintf(stderr, "report: unable to open output file: %s\n", out_path); return 1; }
+  int ok = fwrite(buf, 1, len, f) == len;
+  if (fclose(f) != 0) ok = 0;
+  return ok ? 0 : 1;
+}
+
+int report_run_cached(MYSQL* c, const db_config_t* cfg, rpt_kind_t kind, long bm,
+                      const char* from, const char* to, rf_format_t fmt, const char* out_path) {
+  /* normalized parameters; the database is part of the key */
+  char key[768];
+  snprintf(key, sizeof(key), "v2|%s:%d/%s|%s|bm=%ld|%s|%s|%s", cfg->host, cfg->port, cfg->dbname,
+           rpt_kind_name(kind), bm, from, to, fmt == RF_JSON ? "json" : (fmt == RF_CSV ? "csv" : "table"));
+
+  rcache_mark_t mk;
+  if (rcache_mark(c, bm, from, to, &mk) != 0) return 5;
+  char* buf = NULL; size_t len = 0;
+  rcache_result_t cr = rcache_get(key, &mk, &buf, &len);
+  rcache_count(cr == RCACHE_HIT ? "hit" : (cr == RCACHE_STALE ? "stale" : "miss"));
+  if (cr != RCACHE_HIT) {
+    char q[4096];
+    report_sql(kind, bm, from, to, q, sizeof(q));
+    if (db_exec(c, q) != 0) return 5;
+    MYSQL_RES* r = mysql_store_result(c);
+    if (!r) return 5;
+    int rc = report_render(r, fmt, &buf, &len);
+    mysql_free_result(r);
+    if (rc) return rc;
+    if (rcache_put(key, &mk, buf, len) != 0) fprintf(stderr, "report: cache write failed\n");
+  }
+  int rc = write_rendered(buf, len, fmt, out_path);
+  free(buf);
+  return rc;
+}
+
+/* ---------- Concurrent jobs ---------- */
+
+typedef struct {
+  const report_job_t* jobs;
+  const char* from;
+  const char* to;
+  rf_format_t fmt;
+  const char* out_dir;
+  pthread_mutex_t out_mu;   /* serialises whole results on stdout */
+} report_jobs_t;
+
+static int report_job_task(MYSQL* c, size_t t, void* ud) {
+  report_jobs_t* rj = (report_jobs_t*)ud;
+  const report_job_t* j = &rj->jobs[t];
+  char q[4096];
+  if (report_sql(j->kind, j->bm, rj->from, rj->to, q, sizeof(q)) != 0) return -1;
+  if (db_exec(c, q) != 0) return -1;
+  MYSQL_RES* r = mysql_store_result(c);
+  if (!r) { fprintf(stderr, "SQL error: %s\n", mysql_error(c)); return -1; }
+
+  int rc;
+  if (rj->out_dir) {
+    const char* ext = rj->fmt == RF_JSON ? "json" : (rj->fmt == RF_CSV ? "csv" : "txt");
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s_bm%ld.%s", rj->out_dir, rpt_kind_name(j->kind), j->bm, ext);
+    FILE* f = fopen(path, "wb");
+    if (!f) { fprintf(stderr, "report: unable to open output file: %s\n", path); mysql_free_result(r); return -1; }
+    rc = report_print(r, rj->fmt, f, NULL);
+    if (fclose(f) != 0) rc = 1;
+  } else {
+    /* render off-lock, then emit the whole result at once */
+    char* buf = NULL; size_t len = 0;
+    rc = report_render(r, rj->fmt, &buf, &len);
+    if (rc) { mysql_free_result(r); return -1; }
+    pthread_mutex_lock(&rj->out_mu);
+    printf("# report=%s bookmaker_id=%ld\n", rpt_kind_name(j->kind), j->bm);
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+    pthread_mutex_unlock(&rj->out_mu);
+    free(buf);
+  }
+  mysql_free_result(r);
+  return rc == 0 ? 0 : -1;
+}
+
+int report_run_jobs(const db_config_t* cfgs, int ncfg, const report_job_t* jobs, size_t njobs, int parallel,
+                    const char* from, const char* to, rf_format_t fmt, const char* out_dir) {
+  int* shard = (int*)malloc((njobs ? njobs : 1)*sizeof(int));
+  if (!shard) return 5;
+  for (size_t t=0;t<njobs;t++) shard[t] = jobs[t].shard;
+  report_jobs_t rj;
+  rj.jobs = jobs; rj.from = from; rj.to = to; rj.fmt = fmt; rj.out_dir = out_dir;
+  pthread_mutex_init(&rj.out_mu, NULL);
+  int failed = db_parallel_sharded(cfgs, ncfg, shard, njobs, parallel, report_job_task, &rj);
+  pthread_mutex_destroy(&rj.out_mu);
+  free(shard);
+  if (failed < 0) { fprintf(stderr, "DB connect failed\n"); return 5; }
+  if (failed > 0) { fprintf(stderr, "report: %d of %zu queries failed\n", failed, njobs); return 5; }
+  return 0;
+}
+
+int report_scan_all(MYSQL* c, long bm, const char* from, const char* to, rpt_agg_t* out) {
+  char q[1024];
+  /* One pass over the settled bets of the range, then the commissions
+   * summed per runner as chunk_scan does; the commission reports (like
+   * their SQL) take any bet in range, settled or not. */
+  snprintf(q,sizeof(q),
+    "SELECT runner_id,bettor_id,stake_cents,COALESCE(profit_cents,0) FROM bets "
+    "WHERE bookmaker_id=%ld AND status='settled' AND " RANGE_SQL("settled_at"), bm, from, to);
+  if (db_exec(c,q)!=0) return -1;
+  MYSQL_RES* r = mysql_use_result(c);
+  if (!r) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); return -1; }
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r)))
+    rpt_add_bet(out, atoll(row[0]), atoll(row[1]), atoll(row[2]), atoll(row[3]));
+  int rc = mysql_errno(c) ? -1 : 0;
+  if (rc) fprintf(stderr,"SQL error: %s\n", mysql_error(c));
+  mysql_free_result(r);
+  if (rc) return rc;
+
+  snprintf(q,sizeof(q),
+    "SELECT rc.runner_id, SUM(rc.commission_cents), COUNT(rc.id) "
+    "FROM runner_commissions rc JOIN bets b ON b.id=rc.bet_id "
+    "WHERE b.bookmaker_id=%ld AND " RANGE_SQL("b.settled_at") " GROUP BY rc.runner_id", bm, from, to);
+  if (db_exec(c,q)!=0) return -1;
+  r = mysql_store_result(c);
+  if (!r) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); return -1; }
+  while ((row = mysql_fetch_row(r))) {
+    rpt_acc_t* ra = rpt_runner(out, atoll(row[0]));
+    if (ra) { ra->comm_cents += atoll(row[1]); ra->comm_items += atoll(row[2]); }
+  }
+  mysql_free_result(r);
+
+  /* only this bookmaker's payouts: an owner of another one would
+   * otherwise turn up in the balances with its payouts alone */
+  static const struct { const char* from; const char* owner; int is_bettor; } pay[] = {
+    { PAY_BETTOR_FROM, "bettor_id", 1 }, { PAY_RUNNER_FROM, "runner_id", 0 },
+  };
+  for (size_t i=0;i<sizeof(pay)/sizeof(pay[0]);i++) {
+    snprintf(q,sizeof(q),
+      "SELECT p.%s, SUM(p.amount_cents) %sWHERE r.bookmaker_id=%ld AND " RANGE_SQL("p.created_at") " GROUP BY p.%s",
+      pay[i].owner, pay[i].from, bm, from, to, pay[i].owner);
+    if (db_exec(c,q)!=0) return -1;
+    MYSQL_RES* pr = mysql_store_result(c);
+    if (!pr) return -1;
+    while ((row = mysql_fetch_row(pr))) {
+      if (!row[0] || !row[1]) continue;
+      if (pay[i].is_bettor) rpt_add_bettor_payout(out, atoll(row[0]), atoll(row[1]));
+      else                  rpt_add_runner_payout(out, atoll(row[0]), atoll(row[1]));
+    }
+    mysql_free_result(pr);
+  }
+  return report_load_names(c, out);
+}
+
+/* ---------- Date-range chunks ---------- */
+
+typedef struct {
+  long bm;
+  int from_day, to_day, chunk_days;
+  size_t nchunks, done;
+  rpt_agg_t* out;
+  pthread_mutex_t mu;       /* guards out and done */
+  int merge_failed;
+} report_chunks_t;
+
+/* Partial aggregates for one chunk: counts and sums grouped by owner, so
+ * adding them up over the chunks gives exactly the whole-range totals. */
+static int chunk_scan(MYSQL* c, long bm, const char* from, const char* to, rpt_agg_t* a) {
+  char q[1024];
+  snprintf(q,sizeof(q),
+    "SELECT runner_id, bettor_id, COUNT(*), SUM(stake_cents), SUM(COALESCE(profit_cents,0)) "
+    "FROM bets WHERE bookmaker_id=%ld AND status='settled' AND " RANGE_SQL("settled_at") " "
+    "GROUP BY runner_id, bettor_id", bm, from, to);
+  if (db_exec(c,q)!=0) return -1;
+  MYSQL_RES* r = mysql_store_result(c);
+  if (!r) return -1;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r))) {
+    long long n = atoll(row[2]), stake = atoll(row[3]), profit = atoll(row[4]);
+    a->bets += n; a->handle_cents += stake; a->profit_cents += profit;
+    rpt_acc_t* ra = rpt_runner(a, atoll(row[0]));
+    if (ra) { ra->bets += n; ra->handle_cents += stake; ra->profit_cents += profit; }
+    rpt_acc_t* ba = rpt_bettor(a, atoll(row[1]));
+    if (ba) { ba->bets += n; ba->handle_cents += stake; ba->profit_cents += profit; }
+  }
+  mysql_free_result(r);
+
+  snprintf(q,sizeof(q),
+    "SELECT rc.runner_id, SUM(rc.commission_cents), COUNT(rc.id) "
+    "FROM runner_commissions rc JOIN bets b ON b.id=rc.bet_id "
+    "WHERE b.bookmaker_id=%ld AND " RANGE_SQL("b.settled_at") " GROUP BY rc.runner_id", bm, from, to);
+  if (db_exec(c,q)!=0) return -1;
+  r = mysql_store_result(c);
+  if (!r) return -1;
+  while ((row = mysql_fetch_row(r))) {
+    rpt_acc_t* ra = rpt_runner(a, atoll(row[0]));
+    if (ra) { ra->comm_cents += atoll(row[1]); ra->comm_items += atoll(row[2]); }
+  }
+  mysql_free_result(r);
+
+  /* payouts of this bookmaker's bettors and runners only */
+  snprintf(q,sizeof(q),
+    "SELECT p.bettor_id, SUM(p.amount_cents) " PAY_BETTOR_FROM "WHERE r.bookmaker_id=%ld AND " RANGE_SQL("p.created_at") " GROUP BY p.bettor_id",
+    bm, from, to);
+  if (db_exec(c,q)!=0) return -1;
+  r = mysql_store_result(c);
+  if (!r) return -1;
+  while ((row = mysql_fetch_row(r))) if (row[1]) rpt_add_bettor_payout(a, atoll(row[0]), atoll(row[1]));
+  mysql_free_result(r);
+
+  snprintf(q,sizeof(q),
+    "SELECT p.runner_id, SUM(p.amount_cents) " PAY_RUNNER_FROM "WHERE r.bookmaker_id=%ld AND " RANGE_SQL("p.created_at") " GROUP BY p.runner_id",
+    bm, from, to);
+  if (db_exec(c,q)!=0) return -1;
+  r = mysql_store_result(c);
+  if (!r) return -1;
+  while ((row = mysql_fetch_row(r))) if (row[1]) rpt_add_runner_payout(a, atoll(row[0]), atoll(row[1]));
+  mysql_free_result(r);
+  return 0;
+}
+
+static int chunk_task(MYSQL* c, size_t t, void* ud) {
+  report_chunks_t* rc = (report_chunks_t*)ud;
+  int d0 = rc->from_day + (int)t * rc->chunk_days;
+  int d1 = d0 + rc->chunk_days - 1;
+  if (d1 > rc->to_day) d1 = rc->to_day;
+  char from[16], to[16];
+  rpt_fmt_day(d0, from, sizeof(from)); rpt_fmt_day(d1, to, sizeof(to));
+
+  rpt_agg_t part; rpt_agg_init(&part);
+  int ok = chunk_scan(c, rc->bm, from, to, &part) == 0;
+  pthread_mutex_lock(&rc->mu);
+  if (ok && rpt_agg_merge(rc->out, &part) != 0) rc->merge_failed = 1;
+  rc->done++;
+  fprintf(stderr, "report: chunk %zu/%zu %s..%s %s\n", rc->done, rc->nchunks, from, to, ok ? "done" : "FAILED");
+  pthread_mutex_unlock(&rc->mu);
+  rpt_agg_free(&part);
+  return ok ? 0 : -1;
+}
+
+int report_scan_chunked(const db_config_t* cfg, long bm, int from_day, int to_day, int chunk_days,
+                        int parallel, rpt_agg_t* out) {
+  if (chunk_days < 1 || to_day < from_day) return 0;
+  report_chunks_t rc;
+  memset(&rc, 0, sizeof(rc));
+  rc.bm = bm; rc.from_day = from_day; rc.to_day = to_day; rc.chunk_days = chunk_days;
+  rc.nchunks = (size_t)((to_day - from_day) / chunk_days + 1);
+  rc.out = out;
+  pthread_mutex_init(&rc.mu, NULL);
+  if ((size_t)parallel > rc.nchunks) parallel = (int)rc.nchunks;
+  int failed = db_parallel(cfg, rc.nchunks, parallel, chunk_task, &rc);
+  pthread_mutex_destroy(&rc.mu);
+  if (failed < 0) { fprintf(stderr, "DB connect failed\n"); return -1; }
+  if (failed > 0) { fprintf(stderr, "report: %d of %zu chunks failed\n", failed, rc.nchunks); return -1; }
+  return rc.merge_failed ? -1 : 0;
+}
+
+/* names for the ids that will actually be printed, in IN() batches */
+static int load_names_for(MYSQL* c, rpt_agg_t* a, hmap_t* m, const char* sql_prefix) {
+  enum { BATCH = 1000 };
+  size_t cap = strlen(sql_prefix) + BATCH * 21 + 8;
+  char* q = (char*)malloc(cap);
+  if (!q) return -1;
+  size_t pos = 0; long long id; void* v; int rc = 0;
+  bool more = true;
+  while (more && rc == 0) {
+    size_t n = strlen(sql_prefix), k = 0;
+    memcpy(q, sql_prefix, n);
+    while (k < BATCH && (more = hmap_next(m, &pos, &id, &v))) {
+      const rpt_acc_t* acc = (const rpt_acc_t*)v;
+      if (acc->name || (!acc->bets && !acc->comm_items)) continue;
+      n += (size_t)snprintf(q + n, cap - n, "%s%lld", k ? "," : "", id);
+      k++;
+    }
+    if (!k) break;
+    snprintf(q + n, cap - n, ")");
+    if (db_exec(c,q)!=0) { rc = -1; break; }
+    MYSQL_RES* r = mysql_store_result(c);
+    if (!r) { rc = -1; break; }
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(r))) {
+      rpt_acc_t* acc = (rpt_acc_t*)hmap_get(m, atoll(row[0]));
+      if (acc && row[1]) rpt_set_name(a, acc, row[1]);
+    }
+    mysql_free_result(r);
+  }
+  free(q);
+  return rc;
+}
+
+int report_load_names(MYSQL* c, rpt_agg_t* a) {
+  if (load_names_for(c, a, &a->runners, "SELECT id,name FROM runners WHERE id IN (") != 0) return -1;
+  return load_names_for(c, a, &a->bettors, "SELECT id,code FROM bettors WHERE id IN (");
+}
+
+int report_write_all(const rpt_agg_t* a, const char* dir, rf_format_t fmt) {
+  const char* ext = fmt == RF_JSON ? "json" : (fmt == RF_CSV ? "csv" : "txt");
+  for (int k=0;k<RPT_KIND_COUNT;k++) {
+    char path[1024];
+    snprintf(path,sizeof(path),"%s/%s.%s", dir, rpt_kind_name((rpt_kind_t)k), ext);
+    FILE* f = fopen(path,"wb");
+    if (!f) { fprintf(stderr,"report: unable to open output file: %s\n", path); return 1; }
+    int rc = rpt_emit(a, (rpt_kind_t)k, fmt, f, NULL);
+    if (fclose(f)!=0 && rc==0) rc = 1;
+    if (rc) return rc;
+  }
+  return 0;
+}
+
+/* ---------- Closing-line value ---------- */
+
+/* Pick key shared by both streams: event, market, side, line, and the away
+ * score of correct_score picks (the fields quote_subquery matches on). */
+#define CLV_KEY_SQL(t, side) t ".event_id," t ".market_type+0," t "." side "+0,COALESCE(" t ".line_q,0)," \
+  "IF(" t ".market_type='correct_score',COALESCE(" t ".line_b_q,0),0)"
+#define CLV_KEYS 5
+
+typedef struct {
+  long long bets, closed, beat;       /* bets; with a closing quote; priced above it */
+  long long handle_cents;             /* stake of the closed bets */
+  long long clv_wsum;                 /* sum of stake_cents * clv_bp over closed bets */
+  char name[64];
+} clv_acc_t;
+
+typedef struct { long long id; const clv_acc_t* acc; long long bp; } clv_row_t;
+
+static int clv_keycmp(const long long* a, const long long* b) {
+  for (int i=0;i<CLV_KEYS;i++) if (a[i]!=b[i]) return a[i]<b[i] ? -1 : 1;
+  return 0;
+}
+
+static void clv_key(MYSQL_ROW row, long long* k) {
+  for (int i=0;i<CLV_KEYS;i++) k[i] = row[i] ? atoll(row[i]) : 0;
+}
+
+/* stake-weighted clv in basis points, rounded half away from zero */
+static long long clv_bp(const clv_acc_t* a) {
+  long long h = a->handle_cents;
+  return a->clv_wsum >= 0 ? (a->clv_wsum + h/2) / h : -((-a->clv_wsum + h/2) / h);
+}
+
+static int clv_cmp(const void* pa, const void* pb) {
+  const clv_row_t* a = (const clv_row_t*)pa; const clv_row_t* b = (const clv_row_t*)pb;
+  int ca = a->acc->closed>0, cb = b->acc->closed>0;
+  if (ca != cb) return cb - ca;
+  if (a->bp != b->bp) return a->bp > b->bp ? -1 : 1;
+  return (a->id > b->id) - (a->id < b->id);
+}
+
+static int clv_emit(const hmap_t* m, bool by_runner, rf_format_t fmt, const char* out_path) {
+  static const char* hb[] = { "bettor_id","code","bets","closed","beat_close","handle_usd","clv_pct" };
+  static const char* hr[] = { "runner_id","name","bets","closed","beat_close","handle_usd","clv_pct" };
+  clv_row_t* rows = (clv_row_t*)malloc((m->len ? m->len : 1)*sizeof(clv_row_t));
+  if (!rows) return 5;
+  size_t n=0, pos=0; long long id; void* v;
+  while (hmap_next(m,&pos,&id,&v)) {
+    const clv_acc_t* a = (const clv_acc_t*)v;
+    rows[n].id = id; rows[n].acc = a; rows[n].bp = a->closed ? clv_bp(a) : 0; n++;
+  }
+  qsort(rows, n, sizeof(clv_row_t), clv_cmp);
+  rf_ctx_t* rf = rf_begin(fmt, stdout, out_path, by_runner ? hr : hb, 7);
+  if (!rf) {
+    free(rows);
+    fprintf(stderr, "report: unable to open output file: %s\n", out_path ? out_path : "");
+    return 1;
+  }
+  for (size_t i=0;i<n;i++) {
+    const clv_acc_t* a = rows[i].acc;
+    char c0[24], c2[24], c3[24], c4[24], c5[32], c6[32];
+    snprintf(c0,sizeof(c0),"%lld",rows[i].id);
+    snprintf(c2,sizeof(c2),"%lld",a->bets);
+    snprintf(c3,sizeof(c3),"%lld",a->closed);
+    snprintf(c4,sizeof(c4),"%lld",a->beat);
+    rpt_fmt_cents(a->handle_cents,c5,sizeof(c5));
+    rpt_fmt_cents(rows[i].bp,c6,sizeof(c6));      /* basis points -> percent, 2 decimals */
+    const char* row[7] = { c0, a->name, c2, c3, c4, c5, a->closed ? c6 : NULL };
+    rf_row(rf,row);
+  }
+  free(rows);
+  return rf_end(rf) ? 0 : 1;
+}
+
+int report_clv(MYSQL* c, const db_config_t* cfg, long bm, const char* from, const char* to,
+               const char* by, rf_format_t fmt, const char* out_path) {
+  bool by_runner = by && !strcmp(by,"runner");
+  MYSQL* qc = db_connect(cfg);
+  if (!qc) { fprintf(stderr,"DB connect failed\n"); return 5; }
+
+  /* quotes of the events bet on in range, by pick then capture time */
+  char q[2048];
+  snprintf(q,sizeof(q),
+    "SELECT " CLV_KEY_SQL("q","side") ",UNIX_TIMESTAMP(q.captured_at),q.price_e4 FROM quotes q "
+    "WHERE q.bookmaker_id=%ld AND q.event_id IN (SELECT b.event_id FROM bets b "
+    "WHERE b.bookmaker_id=%ld AND b.bet_type='single' AND " RANGE_SQL("b.placed_at") ") "
+    "ORDER BY 1,2,3,4,5,6,q.id", bm, bm, from, to);
+  if (db_exec(qc,q)!=0) { db_disconnect(qc); return 5; }
+  MYSQL_RES* qr = mysql_use_result(qc);
+  if (!qr) { fprintf(stderr,"SQL error: %s\n", mysql_error(qc)); db_disconnect(qc); return 5; }
+
+  snprintf(q,sizeof(q),
+    "SELECT " CLV_KEY_SQL("b","pick_side") ",UNIX_TIMESTAMP(e.starts_at),b.price_e4,b.stake_cents,%s "
+    "FROM bets b JOIN events e ON e.id=b.event_id %s "
+    "WHERE b.bookmaker_id=%ld AND b.bet_type='single' AND b.status<>'void' AND " RANGE_SQL("b.placed_at") " "
+    "ORDER BY 1,2,3,4,5",
+    by_runner ? "r.id,r.name" : "bt.id,bt.code",
+    by_runner ? "JOIN runners r ON r.id=b.runner_id" : "JOIN bettors bt ON bt.id=b.bettor_id",
+    bm, from, to);
+  if (db_exec(c,q)!=0) { mysql_free_result(qr); db_disconnect(qc); return 5; }
+  MYSQL_RES* br = mysql_use_result(c);
+  if (!br) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); mysql_free_result(qr); db_disconnect(qc); return 5; }
+
+  /* As-of merge: both streams are sorted by pick, so the quote cursor only
+   * moves forward. For each new pick it skips smaller picks, then keeps the
+   * last quote of the pick captured before the event started; the bets of
+   * the pick share that closing price. */
+  hmap_t m; hmap_init(&m, sizeof(clv_acc_t));
+  long long qk[CLV_KEYS], pk[CLV_KEYS], qt=0; long qprice=0, close=0;
+  bool have_q=false, have_pk=false, oom=false;
+  MYSQL_ROW row = mysql_fetch_row(qr);
+  if (row) { clv_key(row,qk); qt=atoll(row[5]); qprice=atol(row[6]); have_q=true; }
+  while ((row = mysql_fetch_row(br))) {
+    long long bk[CLV_KEYS]; clv_key(row,bk);
+    if (!have_pk || clv_keycmp(bk,pk)!=0) {
+      long long starts = atoll(row[5]);
+      close = 0;
+      while (have_q) {
+        int d = clv_keycmp(qk,bk);
+        if (d>0 || (d==0 && qt>=starts)) break;
+        if (d==0) close = qprice;
+        MYSQL_ROW nq = mysql_fetch_row(qr);
+        if (!nq) { have_q=false; break; }
+        clv_key(nq,qk); qt=atoll(nq[5]); qprice=atol(nq[6]);
+      }
+      memcpy(pk,bk,sizeof(pk)); have_pk=true;
+    }
+    bool created;
+    clv_acc_t* a = (clv_acc_t*)hmap_put(&m, atoll(row[8]), &created);
+    if (!a) { oom=true; break; }
+    if (created) snprintf(a->name,sizeof(a->name),"%s", row[9] ? row[9] : "");
+    a->bets++;
+    long price = atol(row[6]);
+    if (close>0 && price>0) {
+      long long stake = atoll(row[7]);
+      long long bp = ((long long)price*10000 + close/2) / close - 10000;
+      a->closed++; a->handle_cents += stake; a->clv_wsum += stake*bp;
+      if (bp>0) a->beat++;
+    }
+  }
+  int rc = 0;
+  if (mysql_errno(c)) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); rc = 5; }
+  else if (mysql_errno(qc)) { fprintf(stderr,"SQL error: %s\n", mysql_error(qc)); rc = 5; }
+  else if (oom) { fprintf(stderr,"report clv: out of memory\n"); rc = 5; }
+  mysql_free_result(br);
+  mysql_free_result(qr);
+  db_disconnect(qc);
+  if (!rc) rc = clv_emit(&m, by_runner, fmt, out_path);
+  hmap_free(&m);
+  return rc;
+}
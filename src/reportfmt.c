@@ -4,25 +4,15 @@
 #include <string.h>
 #include <ctype.h>
 
-typedef struct {
-    char **cells;
-} rf_row_t;
-
 struct rf_ctx {
     rf_format_t fmt;
     FILE* out;            // destino activo
     FILE* out_provided;   // puntero original (no cerrar)
-    char* out_path_dup;   // si se abrió archivo, recordar path
     size_t ncols;
 
     // headers
     char **headers;
 
-    // buffer de filas (para TABLE hacemos width pass al final)
-    rf_row_t *rows;
-    size_t nrows;
-    size_t cap;
-
     // flags estado (para JSON, saber si ya imprimimos una fila)
     bool first_row_emitted;
 };
@@ -36,24 +26,7 @@ static char* rf_strdup(const char* s) {
     return p;
 }
 
-static void rf_free_row(rf_row_t* r, size_t ncols) {
-    if (!r || !r->cells) return;
-    for (size_t i=0;i<ncols;i++) free(r->cells[i]);
-    free(r->cells);
-}
-
-static bool rf_reserve_rows(struct rf_ctx* c, size_t need) {
-    if (c->cap >= need) return true;
-    size_t newcap = c->cap ? c->cap * 2u : 16u;
-    if (newcap < need) newcap = need;
-    rf_row_t* nr = (rf_row_t*)realloc(c->rows, newcap * sizeof(rf_row_t));
-    if (!nr) return false;
-    c->rows = nr;
-    c->cap  = newcap;
-    return true;
-}
-
-static void rf_json_escape(FILE* f, const char* s) {
+void rf_json_escape(FILE* f, const char* s) {
     fputc('"', f);
     for (const unsigned char* p = (const unsigned char*)s; *p; ++p) {
         unsigned char ch = *p;
@@ -113,42 +86,37 @@ const char* rf_format_name(rf_format_t f) {
     }
 }
 
-rf_ctx* rf_begin(rf_format_t fmt,
-                 FILE* out,
-                 const char* out_path,
-                 const char* const * headers,
-                 size_t ncols)
+rf_ctx_t* rf_begin(rf_format_t fmt,
+                   FILE* out,
+                   const char* out_path,
+                   const char* const * headers,
+                   size_t ncols)
 {
     if (!out) out = stdout;
 
+    // open file if JSON/CSV and out_path provided; failing to open is an error
+    FILE* opened = NULL;
+    if (out_path && *out_path && (fmt == RF_JSON || fmt == RF_CSV)) {
+        opened = fopen(out_path, "wb");
+        if (!opened) return NULL;
+    }
+
     struct rf_ctx* c = (struct rf_ctx*)calloc(1, sizeof(*c));
-    if (!c) return NULL;
+    if (!c) { if (opened) fclose(opened); return NULL; }
     c->fmt = fmt;
-    c->out = out;
+    c->out = opened ? opened : out;
     c->out_provided = out;
     c->ncols = ncols;
     c->first_row_emitted = false;
 
     // duplicate headers
-    c->headers = (char**)calloc(ncols, sizeof(char*));
-    if (!c->headers) { free(c); return NULL; }
+    c->headers = (char**)calloc(ncols ? ncols : 1u, sizeof(char*));
+    if (!c->headers) { if (opened) fclose(opened); free(c); return NULL; }
     for (size_t i=0;i<ncols;i++) {
         c->headers[i] = rf_strdup(headers && headers[i] ? headers[i] : "");
         if (!c->headers[i]) { // free partial
             for (size_t j=0;j<i;j++) free(c->headers[j]);
-            free(c->headers); free(c); return NULL;
-        }
-    }
-
-    // open file if JSON/CSV and out_path provided
-    if (out_path && *out_path && (fmt == RF_JSON || fmt == RF_CSV)) {
-        FILE* f = fopen(out_path, "wb");
-        if (!f) {
-            // fallback to provided 'out' but keep going
-            c->out = out;
-        } else {
-            c->out = f;
-            c->out_path_dup = rf_strdup(out_path);
+            free(c->headers); if (opened) fclose(opened); free(c); return NULL;
         }
     }
 
@@ -162,13 +130,17 @@ rf_ctx* rf_begin(rf_format_t fmt,
             rf_csv_escape(c->out, c->headers[i]);
         }
         fputc('\n', c->out);
+    } else {
+        // TABLE: mismo formato que db_print_result (tabs, sin padding)
+        for (size_t i=0;i<ncols;i++) {
+            fprintf(c->out, "%s%s", c->headers[i], (i+1<ncols) ? "\t" : "\n");
+        }
     }
-    // TABLE: nada (se calcula widths al final)
 
     return c;
 }
 
-bool rf_row(rf_ctx* c, const char* const * cells)
+bool rf_row(rf_ctx_t* c, const char* const * cells)
 {
     if (!c || !cells) return false;
 
@@ -192,90 +164,35 @@ bool rf_row(rf_ctx* c, const char* const * cells)
         fputc('\n', c->out);
         return true;
     } else {
-        // TABLE: almacenamos para width pass
-        if (!rf_reserve_rows(c, c->nrows + 1u)) return false;
-        rf_row_t *r = &c->rows[c->nrows++];
-        r->cells = (char**)calloc(c->ncols, sizeof(char*));
-        if (!r->cells) return false;
+        // TABLE: celdas NULL se imprimen como "NULL" (igual que db_print_result)
         for (size_t i=0;i<c->ncols;i++) {
-            r->cells[i] = rf_strdup(cells[i] ? cells[i] : "");
-            if (!r->cells[i]) return false;
+            fputs(cells[i] ? cells[i] : "NULL", c->out);
+            fputs((i+1<c->ncols) ? "\t" : "\n", c->out);
         }
         return true;
     }
 }
 
-static void rf_table_flush(struct rf_ctx* c) {
-    // calcular ancho por columna
-    size_t *w = (size_t*)calloc(c->ncols, sizeof(size_t));
-    if (!w) return;
-
-    for (size_t i=0;i<c->ncols;i++) {
-        w[i] = strlen(c->headers[i]);
-    }
-    for (size_t r=0;r<c->nrows;r++) {
-        for (size_t i=0;i<c->ncols;i++) {
-            size_t len = c->rows[r].cells[i] ? strlen(c->rows[r].cells[i]) : 0u;
-            if (len > w[i]) w[i] = len;
-        }
-    }
-
-    // separador
-    #define SEP_CHAR '-'
-    #define PAD "  "
-
-    // header
-    for (size_t i=0;i<c->ncols;i++) {
-        if (i) fputs("  ", c->out);
-        fprintf(c->out, "%-*s", (int)w[i], c->headers[i]);
-    }
-    fputc('\n', c->out);
-    // underline
-    for (size_t i=0;i<c->ncols;i++) {
-        if (i) fputs("  ", c->out);
-        for (size_t k=0;k<w[i];k++) fputc(SEP_CHAR, c->out);
-    }
-    fputc('\n', c->out);
-
-    // rows
-    for (size_t r=0;r<c->nrows;r++) {
-        for (size_t i=0;i<c->ncols;i++) {
-            if (i) fputs("  ", c->out);
-            const char* cell = c->rows[r].cells[i] ? c->rows[r].cells[i] : "";
-            fprintf(c->out, "%-*s", (int)w[i], cell);
-        }
-        fputc('\n', c->out);
-    }
-    free(w);
-}
-
-bool rf_end(rf_ctx* c)
+bool rf_end(rf_ctx_t* c)
 {
     if (!c) return false;
     bool ok = true;
 
     if (c->fmt == RF_JSON) {
         fputs("\n]\n", c->out);
-    } else if (c->fmt == RF_CSV) {
-        // nada extra
-    } else {
-        rf_table_flush(c);
     }
+    // CSV / TABLE: nada extra
 
     // liberar
     for (size_t i=0;i<c->ncols;i++) free(c->headers[i]);
     free(c->headers);
-    if (c->rows) {
-        for (size_t r=0;r<c->nrows;r++) rf_free_row(&c->rows[r], c->ncols);
-        free(c->rows);
-    }
 
     // cerrar archivo si lo abrimos nosotros
     if (c->out != c->out_provided && c->out) {
         if (fclose(c->out) != 0) ok = false;
+    } else if (fflush(c->out) != 0) {
+        ok = false;
     }
-    free(c->out_path_dup);
     free(c);
     return ok;
 }
-
@@ -0,0 +1,279 @@
+#include "rptagg.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* ---------- Name arena ---------- */
+
+struct rpt_arena {
+  struct rpt_arena* next;
+  size_t used, cap;
+  char data[];
+};
+
+static const char* arena_dup(rpt_arena_t** head, const char* s) {
+  size_t n = strlen(s) + 1;
+  rpt_arena_t* a = *head;
+  if (!a || a->cap - a->used < n) {
+    size_t cap = n > 16384 ? n : 16384;
+    rpt_arena_t* na = (rpt_arena_t*)malloc(sizeof(*na) + cap);
+    if (!na) return NULL;
+    na->next = a; na->used = 0; na->cap = cap;
+    *head = a = na;
+  }
+  char* p = a->data + a->used;
+  memcpy(p, s, n);
+  a->used += n;
+  return p;
+}
+
+/* ---------- Aggregate ---------- */
+
+void rpt_agg_init(rpt_agg_t* a) {
+  memset(a, 0, sizeof(*a));
+  hmap_init(&a->runners, sizeof(rpt_acc_t));
+  hmap_init(&a->bettors, sizeof(rpt_acc_t));
+}
+
+void rpt_agg_free(rpt_agg_t* a) {
+  hmap_free(&a->runners);
+  hmap_free(&a->bettors);
+  while (a->names) { rpt_arena_t* n = a->names->next; free(a->names); a->names = n; }
+}
+
+rpt_acc_t* rpt_runner(rpt_agg_t* a, long long runner_id) {
+  return (rpt_acc_t*)hmap_put(&a->runners, runner_id, NULL);
+}
+
+rpt_acc_t* rpt_bettor(rpt_agg_t* a, long long bettor_id) {
+  return (rpt_acc_t*)hmap_put(&a->bettors, bettor_id, NULL);
+}
+
+void rpt_set_name(rpt_agg_t* a, rpt_acc_t* acc, const char* name) {
+  if (!acc || acc->name || !name) return;
+  acc->name = arena_dup(&a->names, name);
+}
+
+void rpt_add_bet(rpt_agg_t* a, long long runner_id, long long bettor_id,
+                 long long stake_cents, long long profit_cents) {
+  a->bets++; a->handle_cents += stake_cents; a->profit_cents += profit_cents;
+  rpt_acc_t* r = rpt_runner(a, runner_id);
+  if (r) { r->bets++; r->handle_cents += stake_cents; r->profit_cents += profit_cents; }
+  rpt_acc_t* b = rpt_bettor(a, bettor_id);
+  if (b) { b->bets++; b->handle_cents += stake_cents; b->profit_cents += profit_cents; }
+}
+
+void rpt_add_commission(rpt_agg_t* a, long long runner_id, long long commission_cents) {
+  rpt_acc_t* r = rpt_runner(a, runner_id);
+  if (r) { r->comm_cents += commission_cents; r->comm_items++; }
+}
+
+void rpt_add_bettor_payout(rpt_agg_t* a, long long bettor_id, long long amount_cents) {
+  rpt_acc_t* b = rpt_bettor(a, bettor_id);
+  if (b) b->paid_cents += amount_cents;
+}
+
+void rpt_add_runner_payout(rpt_agg_t* a, long long runner_id, long long amount_cents) {
+  rpt_acc_t* r = rpt_runner(a, runner_id);
+  if (r) r->paid_cents += amount_cents;
+}
+
+static int merge_map(rpt_agg_t* dst, hmap_t* dm, const hmap_t* sm) {
+  size_t pos = 0; long long k; void* v;
+  while (hmap_next(sm, &pos, &k, &v)) {
+    const rpt_acc_t* s = (const rpt_acc_t*)v;
+    rpt_acc_t* d = (rpt_acc_t*)hmap_put(dm, k, NULL);
+    if (!d) return -1;
+    d->bets += s->bets; d->handle_cents += s->handle_cents; d->profit_cents += s->profit_cents;
+    d->comm_cents += s->comm_cents; d->comm_items += s->comm_items;
+    d->paid_cents += s->paid_cents;
+    if (!d->name && s->name) rpt_set_name(dst, d, s->name);
+  }
+  return 0;
+}
+
+int rpt_agg_merge(rpt_agg_t* dst, const rpt_agg_t* src) {
+  dst->bets += src->bets;
+  dst->handle_cents += src->handle_cents;
+  dst->profit_cents += src->profit_cents;
+  if (merge_map(dst, &dst->runners, &src->runners) != 0) return -1;
+  if (merge_map(dst, &dst->bettors, &src->bettors) != 0) return -1;
+  return 0;
+}
+
+/* ---------- Kinds ---------- */
+
+int rpt_kind_from(const char* sub, const char* by) {
+  if (!sub) return -1;
+  if (!strcmp(sub,"pnl")) {
+    if (by && !strcmp(by,"runner")) return RPT_PNL_RUNNER;
+    if (by && !strcmp(by,"bettor")) return RPT_PNL_BETTOR;
+    return RPT_PNL;
+  }
+  if (!strcmp(sub,"runner-commissions")) return RPT_RUNNER_COMMISSIONS;
+  if (!strcmp(sub,"bettor-balances"))    return RPT_BETTOR_BALANCES;
+  if (!strcmp(sub,"runner-balances"))    return RPT_RUNNER_BALANCES;
+  return -1;
+}
+
+const char* rpt_kind_name(rpt_kind_t k) {
+  switch (k) {
+    case RPT_PNL:                return "pnl";
+    case RPT_PNL_RUNNER:         return "pnl_by_runner";
+    case RPT_PNL_BETTOR:         return "pnl_by_bettor";
+    case RPT_RUNNER_COMMISSIONS: return "runner_commissions";
+    case RPT_BETTOR_BALANCES:    return "bettor_balances";
+    case RPT_RUNNER_BALANCES:    return "runner_balances";
+    default:                     return "unknown";
+  }
+}
+
+/* ---------- Formatting helpers ---------- */
+
+int rpt_parse_day(const char* ymd, int* day) {
+  int y=0, m=0, d=0, n=0;
+  if (!ymd || sscanf(ymd, "%d-%d-%d%n", &y, &m, &d, &n) != 3 || ymd[n] != '\0') return -1;
+  if (m < 1 || m > 12 || d < 1 || d > 31) return -1;
+  /* days_from_civil (proleptic Gregorian), 1970-01-01 == 0 */
+  y -= m <= 2;
+  long era = (y >= 0 ? y : y - 399) / 400;
+  unsigned yoe = (unsigned)(y - era * 400);
+  unsigned doy = (153u * (unsigned)(m > 2 ? m - 3 : m + 9) + 2u) / 5u + (unsigned)d - 1u;
+  unsigned doe = yoe * 365u + yoe / 4u - yoe / 100u + doy;
+  *day = (int)(era * 146097 + (long)doe - 719468);
+  return 0;
+}
+
+void rpt_fmt_day(int day, char* buf, size_t n) {
+  /* civil_from_days, inverse of the above */
+  long z = (long)day + 719468;
+  long era = (z >= 0 ? z : z - 146096) / 146097;
+  unsigned doe = (unsigned)(z - era * 146097);
+  unsigned yoe = (doe - doe / 1460u + doe / 36524u - doe / 146096u) / 365u;
+  long y = (long)yoe + era * 400;
+  unsigned doy = doe - (365u * yoe + yoe / 4u - yoe / 100u);
+  unsigned mp = (5u * doy + 2u) / 153u;
+  unsigned d = doy - (153u * mp + 2u) / 5u + 1u;
+  unsigned m = mp < 10u ? mp + 3u : mp - 9u;
+  if (m <= 2u) y++;
+  snprintf(buf, n, "%04ld-%02u-%02u", y, m, d);
+}
+
+void rpt_fmt_cents(long long cents, char* buf, size_t n) {
+  unsigned long long a = cents < 0 ? (unsigned long long)(-(cents + 1)) + 1u : (unsigned long long)cents;
+  snprintf(buf, n, "%s%llu.%02llu", cents < 0 ? "-" : "", a / 100u, a % 100u);
+}
+
+/* ---------- Emission ---------- */
+
+typedef struct { long long id; const rpt_acc_t* acc; long long key; } rpt_sorted_t;
+
+static int cmp_key_desc(const void* pa, const void* pb) {
+  const rpt_sorted_t* a = (const rpt_sorted_t*)pa; const rpt_sorted_t* b = (const rpt_sorted_t*)pb;
+  if (a->key != b->key) return a->key > b->key ? -1 : 1;
+  return (a->id > b->id) - (a->id < b->id);
+}
+
+static int cmp_key_asc(const void* pa, const void* pb) {
+  const rpt_sorted_t* a = (const rpt_sorted_t*)pa; const rpt_sorted_t* b = (const rpt_sorted_t*)pb;
+  if (a->key != b->key) return a->key < b->key ? -1 : 1;
+  return (a->id > b->id) - (a->id < b->id);
+}
+
+/* Collect the rows the SQL GROUP BY would produce, sorted like its ORDER BY. */
+static rpt_sorted_t* collect(const rpt_agg_t* a, rpt_kind_t kind, size_t* n) {
+  const hmap_t* m = (kind == RPT_PNL_BETTOR || kind == RPT_BETTOR_BALANCES) ? &a->bettors : &a->runners;
+  rpt_sorted_t* rows = (rpt_sorted_t*)malloc((m->len ? m->len : 1) * sizeof(*rows));
+  if (!rows) return NULL;
+  size_t pos = 0, k = 0; long long id; void* v;
+  while (hmap_next(m, &pos, &id, &v)) {
+    const rpt_acc_t* acc = (const rpt_acc_t*)v;
+    long long key = 0;
+    switch (kind) {
+      case RPT_PNL_RUNNER:
+      case RPT_PNL_BETTOR:         if (!acc->bets) continue; key = acc->profit_cents; break;
+      case RPT_RUNNER_COMMISSIONS: if (!acc->comm_items) continue; key = acc->comm_cents; break;
+      case RPT_BETTOR_BALANCES:    if (!acc->bets) continue; key = -acc->profit_cents - acc->paid_cents; break;
+      case RPT_RUNNER_BALANCES:    if (!acc->comm_items) continue; key = acc->comm_cents - acc->paid_cents; break;
+      default: continue;
+    }
+    rows[k].id = id; rows[k].acc = acc; rows[k].key = key; k++;
+  }
+  qsort(rows, k, sizeof(*rows), kind == RPT_PNL_BETTOR ? cmp_key_asc : cmp_key_desc);
+  *n = k;
+  return rows;
+}
+
+int rpt_emit(const rpt_agg_t* a, rpt_kind_t kind, rf_format_t fmt, FILE* out, const char* out_path) {
+  static const char* h_pnl[]    = {"bets","handle_usd","profit_usd"};
+  static const char* h_pnl_r[]  = {"runner_id","name","bets","handle_usd","profit_usd"};
+  static const char* h_pnl_b[]  = {"bettor_id","code","bets","handle_usd","profit_usd"};
+  static const char* h_comm[]   = {"runner_id","name","commissions_usd","items"};
+  static const char* h_bbal[]   = {"bettor_id","code","owed_gross_usd","paid_usd","balance_usd"};
+  static const char* h_rbal[]   = {"runner_id","name","commissions_usd","paid_usd","balance_usd"};
+  const char* const* hdr; size_t nc;
+  switch (kind) {
+    case RPT_PNL:                hdr = h_pnl;   nc = 3; break;
+    case RPT_PNL_RUNNER:         hdr = h_pnl_r; nc = 5; break;
+    case RPT_PNL_BETTOR:         hdr = h_pnl_b; nc = 5; break;
+    case RPT_RUNNER_COMMISSIONS: hdr = h_comm;  nc = 4; break;
+    case RPT_BETTOR_BALANCES:    hdr = h_bbal;  nc = 5; break;
+    case RPT_RUNNER_BALANCES:    hdr = h_rbal;  nc = 5; break;
+    default: return 2;
+  }
+
+  rf_ctx_t* rf = rf_begin(fmt, out, out_path, hdr, nc);
+  if (!rf) {
+    fprintf(stderr, "report: unable to open output file: %s\n", out_path ? out_path : "");
+    return 1;
+  }
+
+  char c0[32], c1[32], c2[32], c3[32], c4[32];
+  if (kind == RPT_PNL) {
+    /* aggregate without GROUP BY: always one row; SUM() of nothing is NULL */
+    snprintf(c0, sizeof(c0), "%lld", a->bets);
+    rpt_fmt_cents(a->handle_cents, c1, sizeof(c1));
+    rpt_fmt_cents(a->profit_cents, c2, sizeof(c2));
+    const char* row[3] = { c0, a->bets ? c1 : NULL, a->bets ? c2 : NULL };
+    rf_row(rf, row);
+    return rf_end(rf) ? 0 : 1;
+  }
+
+  size_t n = 0;
+  rpt_sorted_t* rows = collect(a, kind, &n);
+  if (!rows) { rf_end(rf); return 5; }
+  for (size_t i=0;i<n;i++) {
+    const rpt_acc_t* acc = rows[i].acc;
+    snprintf(c0, sizeof(c0), "%lld", rows[i].id);
+    const char* row[5] = { c0, acc->name, NULL, NULL, NULL };
+    switch (kind) {
+      case RPT_PNL_RUNNER:
+      case RPT_PNL_BETTOR:
+        snprintf(c2, sizeof(c2), "%lld", acc->bets);
+        rpt_fmt_cents(acc->handle_cents, c3, sizeof(c3));
+        rpt_fmt_cents(acc->profit_cents, c4, sizeof(c4));
+        row[2]=c2; row[3]=c3; row[4]=c4;
+        break;
+      case RPT_RUNNER_COMMISSIONS:
+        rpt_fmt_cents(acc->comm_cents, c2, sizeof(c2));
+        snprintf(c3, sizeof(c3), "%lld", acc->comm_items);
+        row[2]=c2; row[3]=c3;
+        break;
+      case RPT_BETTOR_BALANCES:
+        rpt_fmt_cents(-acc->profit_cents, c2, sizeof(c2));
+        rpt_fmt_cents(acc->paid_cents, c3, sizeof(c3));
+        rpt_fmt_cents(rows[i].key, c4, sizeof(c4));
+        row[2]=c2; row[3]=c3; row[4]=c4;
+        break;
+      case RPT_RUNNER_BALANCES:
+        rpt_fmt_cents(acc->comm_cents, c2, sizeof(c2));
+        rpt_fmt_cents(acc->paid_cents, c3, sizeof(c3));
+        rpt_fmt_cents(rows[i].key, c4, sizeof(c4));
+        row[2]=c2; row[3]=c3; row[4]=c4;
+        break;
+      default: break;
+    }
+    rf_row(rf, row);
+  }
+  free(rows);
+  return rf_end(rf) ? 0 : 1;
+}
@@ -0,0 +1,298 @@
+#define _POSIX_C_SOURCE 200809L
+#include "settlefeed.h"
+#include "gigam.h"
+#include "hmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+enum { UPD_LIVE = 0, UPD_FINAL, UPD_VOID };
+
+typedef struct {
+  long event;
+  int home, away, status;
+  struct timespec seen;   /* when the line was read */
+} upd_t;
+
+/* ---------- Settlement queue ---------- */
+
+typedef struct {
+  long event;
+  struct timespec whistle;
+} sjob_t;
+
+typedef struct {
+  pthread_mutex_t mu;
+  pthread_cond_t not_empty, not_full;
+  sjob_t* ring; int cap, head, len;
+  int closed;
+
+  const shard_map_t* shards;
+  long chunk_rows;
+  long events, failed;
+  long long bets;
+  double* lat_ms; size_t nlat, caplat;
+} squeue_t;
+
+static double ms_since(const struct timespec* t0) {
+  struct timespec t1; clock_gettime(CLOCK_MONOTONIC, &t1);
+  return (t1.tv_sec - t0->tv_sec) * 1e3 + (t1.tv_nsec - t0->tv_nsec) / 1e6;
+}
+
+static void sq_push(squeue_t* q, const sjob_t* j) {
+  pthread_mutex_lock(&q->mu);
+  while (q->len == q->cap) pthread_cond_wait(&q->not_full, &q->mu);
+  q->ring[(q->head + q->len) % q->cap] = *j;
+  q->len++;
+  pthread_cond_signal(&q->not_empty);
+  pthread_mutex_unlock(&q->mu);
+}
+
+/* 0 once the queue is closed and drained */
+static int sq_pop(squeue_t* q, sjob_t* j) {
+  pthread_mutex_lock(&q->mu);
+  while (!q->len && !q->closed) pthread_cond_wait(&q->not_empty, &q->mu);
+  int got = q->len > 0;
+  if (got) {
+    *j = q->ring[q->head];
+    q->head = (q->head + 1) % q->cap;
+    q->len--;
+    pthread_cond_signal(&q->not_full);
+  }
+  pthread_mutex_unlock(&q->mu);
+  return got;
+}
+
+static void sq_done(squeue_t* q, long event, long long bets, double ms, const char* err) {
+  pthread_mutex_lock(&q->mu);
+  if (err) {
+    q->failed++;
+    fprintf(stderr, "event %ld: %s\n", event, err);
+  } else {
+    q->events++; q->bets += bets;
+    if (q->nlat == q->caplat) {
+      size_t nc = q->caplat ? q->caplat * 2 : 256;
+      double* p = (double*)realloc(q->lat_ms, nc * sizeof(double));
+      if (p) { q->lat_ms = p; q->caplat = nc; }
+    }
+    if (q->nlat < q->caplat) q->lat_ms[q->nlat++] = ms;
+    printf("%ld\t%lld\t%.1f\n", event, bets, ms);
+    fflush(stdout);
+  }
+  pthread_mutex_unlock(&q->mu);
+}
+
+static void* settle_worker(void* arg) {
+  squeue_t* q = (squeue_t*)arg;
+  const shard_map_t* m = q->shards;
+  mysql_thread_init();
+  gigam_ctx_t* g[SHARD_MAX];
+  int up = 0;
+  for (int s=0;s<m->n;s++) {
+    if ((g[s] = gigam_open(&m->s[s].cfg))) { gigam_set_scan_chunk(g[s], q->chunk_rows); up++; }
+  }
+  sjob_t j;
+  while (sq_pop(q, &j)) {
+    if (up < m->n) { sq_done(q, j.event, 0, 0, "no database connection"); continue; }
+    /* every shard, so a failed one does not leave the others unsettled */
+    long long total = 0;
+    char err[600] = "";
+    for (int s=0;s<m->n;s++) {
+      long long n = 0;
+      if (gigam_settle_event(g[s], j.event, &n) == GIGAM_OK) total += n;
+      else if (!err[0] && m->n > 1) snprintf(err, sizeof(err), "shard %s: %s", m->s[s].name, gigam_errmsg(g[s]));
+      else if (!err[0]) snprintf(err, sizeof(err), "%s", gigam_errmsg(g[s]));
+    }
+    if (err[0]) sq_done(q, j.event, 0, 0, err);
+    else sq_done(q, j.event, total, ms_since(&j.whistle), NULL);
+  }
+  for (int s=0;s<m->n;s++) gigam_close(g[s]);
+  mysql_thread_end();
+  return NULL;
+}
+
+/* ---------- Feed ---------- */
+
+/* 1 parsed, 0 blank/comment, -1 malformed */
+static int parse_line(char* s, upd_t* u) {
+  char* hash = strchr(s, '#'); if (hash) *hash = 0;
+  char st[16] = ""; int h = 0, a = 0; char tail;
+  if (sscanf(s, " %ld %15s %c", &u->event, st, &tail) == 2 && !strcmp(st, "void")) {
+    u->status = UPD_VOID; u->home = u->away = 0;
+    return u->event > 0 ? 1 : -1;
+  }
+  int n = sscanf(s, " %ld %d-%d %15s %c", &u->event, &h, &a, st, &tail);
+  if (n == 4 && u->event > 0 && h >= 0 && a >= 0) {
+    if (!strcmp(st, "final")) u->status = UPD_FINAL;
+    else if (!strcmp(st, "live")) u->status = UPD_LIVE;
+    else return -1;
+    u->home = h; u->away = a;
+    return 1;
+  }
+  for (char* p = s; *p; p++) if (*p != ' ' && *p != '\t' && *p != '\r') return -1;
+  return 0;
+}
+
+typedef struct {
+  char buf[65536]; size_t have;
+  upd_t* batch; int nb, max;
+  hmap_t slot;       /* event -> index+1 in batch (last line wins) */
+  hmap_t finished;   /* events already queued for settlement */
+  struct timespec first;
+  long lines, skipped;
+} feed_t;
+
+/* Move complete lines from buf into the batch until it is full. */
+static int feed_parse(feed_t* fe) {
+  char* line = fe->buf; char* nl;
+  while (fe->nb < fe->max && (nl = memchr(line, '\n', fe->have - (size_t)(line - fe->buf)))) {
+    *nl = 0; fe->lines++;
+    upd_t u;
+    int pr = parse_line(line, &u);
+    line = nl + 1;
+    if (pr < 0) { fe->skipped++; fprintf(stderr, "feed line %ld skipped\n", fe->lines); continue; }
+    if (pr == 0 || hmap_get(&fe->finished, u.event)) continue;
+    clock_gettime(CLOCK_MONOTONIC, &u.seen);
+    bool created = false;
+    int* ix = (int*)hmap_put(&fe->slot, u.event, &created);
+    if (!ix) return -1;
+    if (created) { *ix = ++fe->nb; if (fe->nb == 1) fe->first = u.seen; }
+    else if (fe->batch[*ix - 1].status != UPD_LIVE) continue;   /* already over */
+    fe->batch[*ix - 1] = u;
+  }
+  fe->have -= (size_t)(line - fe->buf);
+  memmove(fe->buf, line, fe->have);
+  return 0;
+}
+
+/* One UPDATE for the batch, on every shard; finished events are never
+ * reopened, so a late or repeated line cannot undo a settlement. */
+static int write_batch(MYSQL* const* conns, int nconn, const upd_t* b, int n) {
+  char* sql = NULL; size_t len = 0;
+  FILE* f = open_memstream(&sql, &len);
+  if (!f) return -1;
+  fputs("UPDATE events SET home_score=CASE id", f);
+  for (int i=0;i<n;i++) if (b[i].status != UPD_VOID) fprintf(f, " WHEN %ld THEN %d", b[i].event, b[i].home);
+  fputs(" ELSE home_score END, away_score=CASE id", f);
+  for (int i=0;i<n;i++) if (b[i].status != UPD_VOID) fprintf(f, " WHEN %ld THEN %d", b[i].event, b[i].away);
+  fputs(" ELSE away_score END, status=CASE id", f);
+  static const char* const st[] = { "live", "final", "void" };
+  for (int i=0;i<n;i++) fprintf(f, " WHEN %ld THEN '%s'", b[i].event, st[b[i].status]);
+  fputs(" ELSE status END WHERE id IN (", f);
+  for (int i=0;i<n;i++) fprintf(f, "%s%ld", i ? "," : "", b[i].event);
+  fputs(") AND status IN ('scheduled','live')", f);
+  fclose(f);
+  int rc = db_exec_all(conns, nconn, sql);
+  free(sql);
+  return rc;
+}
+
+int settle_follow(MYSQL* const* conns, const shard_map_t* shards, const settle_feed_opts_t* o) {
+  int fd = strcmp(o->feed, "-") ? open(o->feed, O_RDONLY) : 0;
+  if (fd < 0) { fprintf(stderr, "cannot open feed %s: %s\n", o->feed, strerror(errno)); return 1; }
+
+  squeue_t q;
+  memset(&q, 0, sizeof(q));
+  pthread_mutex_init(&q.mu, NULL);
+  pthread_cond_init(&q.not_empty, NULL);
+  pthread_cond_init(&q.not_full, NULL);
+  q.cap = o->queue; q.shards = shards; q.chunk_rows = o->chunk_rows;
+  q.ring = (sjob_t*)calloc((size_t)q.cap, sizeof(sjob_t));
+  upd_t* batch = (upd_t*)calloc((size_t)o->batch, sizeof(upd_t));
+  pthread_t* th = (pthread_t*)calloc((size_t)o->workers, sizeof(pthread_t));
+  if (!q.ring || !batch || !th) { free(q.ring); free(batch); free(th); if (fd) close(fd); return 1; }
+
+  int nth = 0;
+  for (int i=0;i<o->workers;i++) if (pthread_create(&th[nth], NULL, settle_worker, &q) == 0) nth++;
+  if (nth == 0) {   /* nothing would drain the queue: the reader would block on it */
+    fprintf(stderr, "settle follow: cannot start any worker\n");
+    free(batch); free(th); free(q.ring);
+    pthread_cond_destroy(&q.not_empty); pthread_cond_destroy(&q.not_full);
+    pthread_mutex_destroy(&q.mu);
+    if (fd) close(fd);
+    return 5;
+  }
+
+  printf("event_id\tbets_settled\tfinal_to_settled_ms\n");
+  fflush(stdout);
+
+  feed_t fe;
+  memset(&fe, 0, sizeof(fe));
+  fe.batch = batch; fe.max = o->batch;
+  hmap_init(&fe.slot, sizeof(int));
+  hmap_init(&fe.finished, sizeof(char));
+  int rc = 0, eof = 0;
+  long batches = 0;
+
+  for (;;) {
+    if (feed_parse(&fe) < 0) { rc = 1; break; }
+    int flush = fe.nb == fe.max || (eof && fe.nb);
+    if (!flush && eof) break;
+    if (!flush) {
+      int wait = -1;
+      if (fe.nb) { wait = o->batch_ms - (int)ms_since(&fe.first); if (wait < 0) wait = 0; }
+      struct pollfd p = { fd, POLLIN, 0 };
+      int pr = poll(&p, 1, wait);
+      if (pr < 0 && errno == EINTR) continue;
+      if (pr == 0) flush = 1;
+      else {
+        if (fe.have == sizeof(fe.buf) - 1) { fprintf(stderr, "feed line %ld too long\n", fe.lines + 1); rc = 1; break; }
+        ssize_t r = read(fd, fe.buf + fe.have, sizeof(fe.buf) - 1 - fe.have);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) { fprintf(stderr, "feed read: %s\n", strerror(errno)); rc = 1; eof = 1; }
+        else if (r == 0) { eof = 1; if (fe.have) fe.buf[fe.have++] = '\n'; }
+        else fe.have += (size_t)r;
+        continue;
+      }
+    }
+    if (!fe.nb) continue;
+
+    if (write_batch(conns, shards->n, batch, fe.nb) != 0) { rc = 5; break; }
+    batches++;
+    for (int i=0;i<fe.nb;i++) {
+      if (batch[i].status == UPD_LIVE) continue;
+      bool created = false;
+      char* f = (char*)hmap_put(&fe.finished, batch[i].event, &created);
+      if (f && !created) continue;
+      sjob_t j = { batch[i].event, batch[i].seen };
+      sq_push(&q, &j);
+    }
+    hmap_free(&fe.slot); hmap_init(&fe.slot, sizeof(int));
+    fe.nb = 0;
+  }
+  if (fd) close(fd);
+
+  pthread_mutex_lock(&q.mu);
+  q.closed = 1;
+  pthread_cond_broadcast(&q.not_empty);
+  pthread_mutex_unlock(&q.mu);
+  for (int i=0;i<nth;i++) pthread_join(th[i], NULL);
+
+  if (rc == 0 && q.failed) rc = 5;
+
+  double p50 = 0, p95 = 0, mx = 0;
+  if (q.nlat) {
+    for (size_t i=1;i<q.nlat;i++) {   /* insertion sort: one entry per event of the day */
+      double v = q.lat_ms[i]; size_t k = i;
+      while (k && q.lat_ms[k-1] > v) { q.lat_ms[k] = q.lat_ms[k-1]; k--; }
+      q.lat_ms[k] = v;
+    }
+    p50 = q.lat_ms[(q.nlat - 1) / 2];
+    p95 = q.lat_ms[(size_t)((q.nlat - 1) * 0.95)];
+    mx = q.lat_ms[q.nlat - 1];
+  }
+  fprintf(stderr, "%s lines=%ld skipped=%ld batches=%ld events=%ld failed=%ld bets=%lld p50_ms=%.1f p95_ms=%.1f max_ms=%.1f\n",
+          rc ? "ERR" : "OK", fe.lines, fe.skipped, batches, q.events, q.failed, q.bets, p50, p95, mx);
+
+  hmap_free(&fe.slot); hmap_free(&fe.finished);
+  free(batch); free(th); free(q.ring); free(q.lat_ms);
+  pthread_cond_destroy(&q.not_empty); pthread_cond_destroy(&q.not_full);
+  pthread_mutex_destroy(&q.mu);
+  return rc;
+}
@@ -0,0 +1,147 @@
+#include "shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+static int perr(char* err, size_t n, int line, const char* why, const char* what) {
+  snprintf(err, n, "line %d: %s%s%s", line, why, what ? ": " : "", what ? what : "");
+  return -1;
+}
+
+/* host[:port][/dbname] over the base config */
+static int parse_endpoint(const char* ep, const db_config_t* base, db_config_t* cfg) {
+  *cfg = *base;
+  char buf[256];
+  snprintf(buf, sizeof(buf), "%s", ep);
+  char* db = strchr(buf, '/');
+  if (db) {
+    *db++ = '\0';
+    if (!*db) return -1;
+    snprintf(cfg->dbname, sizeof(cfg->dbname), "%s", db);
+  }
+  char* port = strrchr(buf, ':');
+  if (port) {
+    *port++ = '\0';
+    char* end; long v = strtol(port, &end, 10);
+    if (end == port || *end || v <= 0 || v > 65535) return -1;
+    cfg->port = (int)v;
+  }
+  size_t n = strlen(buf);
+  if (!n || n >= sizeof(cfg->host)) return -1;
+  memcpy(cfg->host, buf, n + 1);
+  return 0;
+}
+
+/* "1-99,150,200-,*" -> rules of shard s */
+static int parse_ids(shard_map_t* m, int s, char* ids, int line, char* err, size_t n) {
+  for (char* p = ids; *p; ) {
+    char* comma = strchr(p, ',');
+    if (comma) *comma = '\0';
+    if (!strcmp(p, "*")) {
+      if (m->fallback >= 0) return perr(err, n, line, "'*' given twice", NULL);
+      m->fallback = s;
+    } else {
+      char* end; long lo = strtol(p, &end, 10), hi = lo;
+      if (end == p || lo <= 0) return perr(err, n, line, "bad bookmaker ids", p);
+      if (*end == '-') {
+        char* h = end + 1;
+        if (!*h) { hi = LONG_MAX; end = h; }
+        else { hi = strtol(h, &end, 10); if (end == h || hi < lo) return perr(err, n, line, "bad bookmaker ids", p); }
+      }
+      if (*end) return perr(err, n, line, "bad bookmaker ids", p);
+      if (m->nrule == SHARD_RULES_MAX) return perr(err, n, line, "too many id ranges", NULL);
+      for (int i=0;i<m->nrule;i++) {
+        const shard_rule_t* r = &m->rule[i];
+        if (r->shard != s && lo <= r->hi && r->lo <= hi) return perr(err, n, line, "ids also mapped to shard", m->s[r->shard].name);
+      }
+      m->rule[m->nrule++] = (shard_rule_t){ lo, hi, s };
+    }
+    if (!comma) break;
+    p = comma + 1;
+  }
+  return 0;
+}
+
+int shard_map_parse(shard_map_t* m, const char* text, const db_config_t* base, char* err, size_t errsz) {
+  memset(m, 0, sizeof(*m));
+  m->fallback = -1;
+  int line = 0;
+  for (const char* p = text; *p; ) {
+    size_t len = strcspn(p, "\n;");
+    char buf[1024];
+    snprintf(buf, sizeof(buf), "%.*s", (int)(len < sizeof(buf) ? len : sizeof(buf)-1), p);
+    p += len; if (*p) p++;
+    line++;
+    char* hash = strchr(buf, '#');
+    if (hash) *hash = '\0';
+    char name[64], ep[256], ids[640], extra;
+    int k = sscanf(buf, "%63s %255s %639s %c", name, ep, ids, &extra);
+    if (k <= 0) continue;
+    if (k != 3) return perr(err, errsz, line, "expected: name host[:port][/db] ids", NULL);
+    if (strlen(name) >= sizeof(m->s[0].name)) return perr(err, errsz, line, "shard name too long", name);
+    for (int i=0;i<m->n;i++) if (!strcmp(m->s[i].name, name)) return perr(err, errsz, line, "shard listed twice", name);
+    if (m->n == SHARD_MAX) return perr(err, errsz, line, "too many shards", NULL);
+    shard_t* s = &m->s[m->n];
+    snprintf(s->name, sizeof(s->name), "%s", name);
+    if (parse_endpoint(ep, base, &s->cfg) != 0) return perr(err, errsz, line, "bad host[:port][/db]", ep);
+    if (parse_ids(m, m->n, ids, line, err, errsz) != 0) return -1;
+    m->n++;
+  }
+  if (!m->n) { snprintf(err, errsz, "no shards"); return -1; }
+  return 0;
+}
+
+int shard_map_load(shard_map_t* m) {
+  db_config_t base; db_load_env(&base);
+  const char* path = getenv("GIGAM_SHARDS");
+  const char* inline_map = getenv("GIGAM_SHARD_MAP");
+  char* text = NULL;
+  if (path && *path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) { fprintf(stderr, "GIGAM_SHARDS: unable to read %s\n", path); return -1; }
+    size_t cap = 4096, len = 0;
+    text = (char*)malloc(cap);
+    while (text) {
+      len += fread(text + len, 1, cap - len - 1, f);
+      if (len < cap - 1) break;
+      char* t = (char*)realloc(text, cap *= 2);
+      if (!t) { free(text); text = NULL; }
+      else text = t;
+    }
+    int rerr = ferror(f);
+    fclose(f);
+    if (!text || rerr) { free(text); fprintf(stderr, "GIGAM_SHARDS: unable to read %s\n", path); return -1; }
+    text[len] = '\0';
+  }
+
+  int rc = 0;
+  char err[256];
+  if (text || (inline_map && *inline_map)) {
+    rc = shard_map_parse(m, text ? text : inline_map, &base, err, sizeof(err));
+    if (rc) fprintf(stderr, "%s: %s\n", text ? path : "GIGAM_SHARD_MAP", err);
+  } else {
+    memset(m, 0, sizeof(*m));
+    snprintf(m->s[0].name, sizeof(m->s[0].name), "default");
+    m->s[0].cfg = base;
+    m->n = 1;
+  }
+  free(text);
+  if (rc) return -1;
+
+  const char* home = getenv("GIGAM_SHARD");
+  if (home && *home) {
+    m->home = -1;
+    for (int i=0;i<m->n;i++) if (!strcmp(m->s[i].name, home)) m->home = i;
+    if (m->home < 0) { fprintf(stderr, "GIGAM_SHARD: no shard named %s\n", home); return -1; }
+  }
+  return 0;
+}
+
+int shard_of(const shard_map_t* m, long bookmaker_id) {
+  if (m->n == 1 && !m->nrule && m->fallback < 0) return 0;   /* no map: one database */
+  for (int i=0;i<m->nrule;i++) {
+    if (bookmaker_id >= m->rule[i].lo && bookmaker_id <= m->rule[i].hi) return m->rule[i].shard;
+  }
+  return m->fallback;
+}
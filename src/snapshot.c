@@ -0,0 +1,486 @@
+#define _POSIX_C_SOURCE 200809L
+#include "snapshot.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* ---------- Write side ---------- */
+
+typedef struct { unsigned char* data; size_t len, cap; } snap_buf_t;
+
+static int buf_append(snap_buf_t* b, const void* p, size_t n) {
+  if (b->len + n > b->cap) {
+    size_t nc = b->cap ? b->cap * 2 : 4096;
+    while (nc < b->len + n) nc *= 2;
+    unsigned char* nd = (unsigned char*)realloc(b->data, nc);
+    if (!nd) return -1;
+    b->data = nd; b->cap = nc;
+  }
+  memcpy(b->data + b->len, p, n);
+  b->len += n;
+  return 0;
+}
+
+static size_t col_width(uint32_t type) {
+  switch (type) {
+    case SNAP_I64: return 8;
+    case SNAP_I32: return 4;
+    case SNAP_U32: return 4;
+    default:       return 1;
+  }
+}
+
+/* Column types per table; snap_write lays tables out this way and
+ * snap_open accepts nothing else, since readers index columns blind. */
+static const uint32_t t_bets[SB_NCOLS] = { SNAP_I64,SNAP_I64,SNAP_I64,SNAP_I64,SNAP_I64,SNAP_I64,SNAP_I32,SNAP_U8,SNAP_U8,SNAP_U8 };
+static const uint32_t t_comm[SC_NCOLS] = { SNAP_I64,SNAP_I64,SNAP_I64,SNAP_I64,SNAP_I64,SNAP_I32,SNAP_U8 };
+static const uint32_t t_pay[SP_NCOLS]  = { SNAP_I64,SNAP_I64,SNAP_I64,SNAP_I32 };
+static const uint32_t t_dim[SD_NCOLS]  = { SNAP_I64,SNAP_I64,SNAP_U32 };
+static const struct { const uint32_t* types; uint32_t ncols; int32_t day_col; } snap_layout[SNAP_NTABLES] = {
+  { t_bets, SB_NCOLS, SB_DAY }, { t_comm, SC_NCOLS, SC_DAY },
+  { t_pay, SP_NCOLS, SP_DAY },  { t_pay, SP_NCOLS, SP_DAY },
+  { t_dim, SD_NCOLS, -1 },      { t_dim, SD_NCOLS, -1 },
+};
+
+typedef struct {
+  snap_table_t* desc;
+  snap_buf_t cols[SNAP_MAX_COLS];
+  snap_buf_t blocks;        /* snap_block_t[] */
+  snap_block_t cur;
+} snap_tbuild_t;
+
+static uint32_t heap_add(snap_buf_t* heap, const char* s) {
+  uint32_t off = (uint32_t)heap->len;
+  if (buf_append(heap, s, strlen(s) + 1) != 0) return UINT32_MAX;
+  return off;
+}
+
+static int dict_code(snap_col_t* col, snap_buf_t* heap, const char* s) {
+  for (uint32_t i=0;i<col->ndict;i++) {
+    if (!strcmp((const char*)heap->data + col->dict[i], s)) return (int)i;
+  }
+  if (col->ndict >= SNAP_MAX_DICT) return -1;
+  uint32_t off = heap_add(heap, s);
+  if (off == UINT32_MAX) return -1;
+  col->dict[col->ndict] = off;
+  return (int)col->ndict++;
+}
+
+static int tb_flush_block(snap_tbuild_t* tb) {
+  if (!tb->cur.nrows) return 0;
+  if (buf_append(&tb->blocks, &tb->cur, sizeof(tb->cur)) != 0) return -1;
+  tb->desc->nblocks++;
+  tb->cur.row_start += tb->cur.nrows;
+  tb->cur.nrows = 0;
+  return 0;
+}
+
+/* Append one result row; field i feeds column i. */
+static int tb_row(snap_tbuild_t* tb, snap_buf_t* heap, MYSQL_ROW row) {
+  snap_table_t* t = tb->desc;
+  if (tb->cur.nrows == 0) { tb->cur.min_day = INT32_MAX; tb->cur.max_day = INT32_MIN; }
+  for (uint32_t i=0;i<t->ncols;i++) {
+    const char* v = row[i];
+    int rc = 0;
+    switch (t->cols[i].type) {
+      case SNAP_I64: { int64_t x = v ? (int64_t)atoll(v) : 0; rc = buf_append(&tb->cols[i], &x, 8); break; }
+      case SNAP_I32: {
+        int32_t x = v ? (int32_t)atol(v) : 0;
+        if ((int32_t)i == t->day_col) {
+          if (x < tb->cur.min_day) tb->cur.min_day = x;
+          if (x > tb->cur.max_day) tb->cur.max_day = x;
+        }
+        rc = buf_append(&tb->cols[i], &x, 4);
+        break;
+      }
+      case SNAP_U32: { uint32_t x = heap_add(heap, v ? v : ""); rc = (x==UINT32_MAX) ? -1 : buf_append(&tb->cols[i], &x, 4); break; }
+      default: {
+        int code = dict_code(&t->cols[i], heap, v ? v : "");
+        uint8_t x = (uint8_t)code;
+        rc = code < 0 ? -1 : buf_append(&tb->cols[i], &x, 1);
+        break;
+      }
+    }
+    if (rc != 0) return -1;
+  }
+  t->nrows++;
+  if (t->day_col < 0) { tb->cur.min_day = INT32_MIN; tb->cur.max_day = INT32_MAX; }
+  if (++tb->cur.nrows == SNAP_BLOCK_ROWS) return tb_flush_block(tb);
+  return 0;
+}
+
+static int tb_load(MYSQL* c, const char* sql, snap_tbuild_t* tb, snap_buf_t* heap) {
+  if (db_exec(c, sql) != 0) return -1;
+  MYSQL_RES* r = mysql_use_result(c);
+  if (!r) { fprintf(stderr, "SQL error: %s\n", mysql_error(c)); return -1; }
+  if (mysql_num_fields(r) != tb->desc->ncols) { mysql_free_result(r); return -1; }
+  MYSQL_ROW row; int rc = 0;
+  while ((row = mysql_fetch_row(r))) {
+    if (rc == 0 && tb_row(tb, heap, row) != 0) rc = -1;  /* keep draining */
+  }
+  if (mysql_errno(c)) { fprintf(stderr, "SQL error: %s\n", mysql_error(c)); rc = -1; }
+  mysql_free_result(r);
+  return rc == 0 ? tb_flush_block(tb) : -1;
+}
+
+static int write_pad8(FILE* f, uint64_t* pos) {
+  static const unsigned char z[8] = {0};
+  size_t pad = (size_t)((8 - (*pos & 7)) & 7);
+  if (pad && fwrite(z, 1, pad, f) != pad) return -1;
+  *pos += pad;
+  return 0;
+}
+
+static int write_at(FILE* f, uint64_t* pos, const void* p, size_t n) {
+  if (write_pad8(f, pos) != 0) return -1;
+  if (n && fwrite(p, 1, n, f) != n) return -1;
+  *pos += n;
+  return 0;
+}
+
+static void range_sql(const snap_scope_t* sc, const char* col, char* out, size_t n) {
+  out[0] = '\0';
+  if (sc->from && sc->to) {
+    snprintf(out, n,
+      " AND %s>=STR_TO_DATE('%s','%%Y-%%m-%%d') AND %s<DATE_ADD(STR_TO_DATE('%s','%%Y-%%m-%%d'), INTERVAL 1 DAY)",
+      col, sc->from, col, sc->to);
+  }
+}
+
+int snap_write(MYSQL* c, const snap_scope_t* scope, const char* path, snap_stats_t* st) {
+  char bm_b[64] = "", bm_c[64] = "", bm_pb[160] = "", bm_pr[128] = "";
+  char rg_b[256], rg_c[256], rg_pb[256], rg_pr[256];
+  if (scope->bookmaker_id > 0) {
+    snprintf(bm_b, sizeof(bm_b), " AND bookmaker_id=%ld", scope->bookmaker_id);
+    snprintf(bm_c, sizeof(bm_c), " AND b.bookmaker_id=%ld", scope->bookmaker_id);
+    /* a payout belongs to its owner's bookmaker, as in the SQL reports */
+    snprintf(bm_pb, sizeof(bm_pb), " AND p.bettor_id IN (SELECT bt.id FROM bettors bt JOIN runners r ON r.id=bt.runner_id WHERE r.bookmaker_id=%ld)",
+             scope->bookmaker_id);
+    snprintf(bm_pr, sizeof(bm_pr), " AND p.runner_id IN (SELECT id FROM runners WHERE bookmaker_id=%ld)", scope->bookmaker_id);
+  }
+  range_sql(scope, "settled_at", rg_b, sizeof(rg_b));
+  range_sql(scope, "b.settled_at", rg_c, sizeof(rg_c));
+  range_sql(scope, "p.created_at", rg_pb, sizeof(rg_pb));
+  range_sql(scope, "p.created_at", rg_pr, sizeof(rg_pr));
+
+  char q[SNAP_NTABLES][1024];
+  snprintf(q[SNAP_BETS], sizeof(q[0]),
+    "SELECT id,bookmaker_id,runner_id,bettor_id,stake_cents,COALESCE(profit_cents,0),DATEDIFF(settled_at,'1970-01-01'),"
+    "COALESCE(result,''),market_type,pick_side FROM bets WHERE status='settled' AND settled_at IS NOT NULL%s%s "
+    "ORDER BY settled_at,id", bm_b, rg_b);
+  snprintf(q[SNAP_COMMISSIONS], sizeof(q[0]),
+    "SELECT rc.id,rc.bet_id,rc.runner_id,b.bookmaker_id,rc.commission_cents,DATEDIFF(b.settled_at,'1970-01-01'),rc.scheme "
+    "FROM runner_commissions rc JOIN bets b ON b.id=rc.bet_id WHERE b.settled_at IS NOT NULL%s%s "
+    "ORDER BY b.settled_at,rc.id", bm_c, rg_c);
+  snprintf(q[SNAP_BETTOR_PAYOUTS], sizeof(q[0]),
+    "SELECT p.id,p.bettor_id,p.amount_cents,DATEDIFF(p.created_at,'1970-01-01') FROM payouts_bettor p WHERE 1=1%s%s "
+    "ORDER BY p.created_at,p.id", bm_pb, rg_pb);
+  snprintf(q[SNAP_RUNNER_PAYOUTS], sizeof(q[0]),
+    "SELECT p.id,p.runner_id,p.amount_cents,DATEDIFF(p.created_at,'1970-01-01') FROM payouts_runner p WHERE 1=1%s%s "
+    "ORDER BY p.created_at,p.id", bm_pr, rg_pr);
+  snprintf(q[SNAP_RUNNERS], sizeof(q[0]), "SELECT id,bookmaker_id,name FROM runners ORDER BY id");
+  snprintf(q[SNAP_BETTORS], sizeof(q[0]), "SELECT id,runner_id,code FROM bettors ORDER BY id");
+
+  snap_header_t* hdr = (snap_header_t*)calloc(1, sizeof(*hdr));
+  snap_tbuild_t* tb = (snap_tbuild_t*)calloc(SNAP_NTABLES, sizeof(*tb));
+  snap_buf_t heap = {0};
+  int rc = -1;
+  FILE* f = NULL;
+  char tmp[PATH_MAX + 32];
+  if (!hdr || !tb) goto done;
+  if (snprintf(tmp, sizeof(tmp), "%s.%ld.tmp", path, (long)getpid()) >= (int)sizeof(tmp)) {
+    fprintf(stderr, "snapshot: output path too long: %s\n", path);
+    goto done;
+  }
+
+  memcpy(hdr->magic, SNAP_MAGIC, 8);
+  hdr->version = SNAP_VERSION;
+  hdr->ntables = SNAP_NTABLES;
+  hdr->created_unix = (int64_t)time(NULL);
+  if (buf_append(&heap, "", 1) != 0) goto done;   /* offset 0 == empty string */
+
+  for (int t=0;t<SNAP_NTABLES;t++) {
+    snap_table_t* d = &hdr->tables[t];
+    d->ncols = snap_layout[t].ncols;
+    d->day_col = snap_layout[t].day_col;
+    for (uint32_t i=0;i<d->ncols;i++) d->cols[i].type = snap_layout[t].types[i];
+    tb[t].desc = d;
+    if (tb_load(c, q[t], &tb[t], &heap) != 0) goto done;
+    if (st) st->rows[t] = d->nrows;
+  }
+
+  /* written aside and renamed over path: a reader maps the old file or the
+   * new one, never a half-written one */
+  f = fopen(tmp, "wb");
+  if (!f) { fprintf(stderr, "snapshot: unable to open output file: %s\n", tmp); goto done; }
+  uint64_t pos = 0;
+  if (write_at(f, &pos, hdr, sizeof(*hdr)) != 0) goto done;   /* placeholder */
+  for (int t=0;t<SNAP_NTABLES;t++) {
+    snap_table_t* d = &hdr->tables[t];
+    if (write_pad8(f, &pos) != 0) goto done;
+    d->blocks_off = pos;
+    if (write_at(f, &pos, tb[t].blocks.data, tb[t].blocks.len) != 0) goto done;
+    for (uint32_t i=0;i<d->ncols;i++) {
+      if (write_pad8(f, &pos) != 0) goto done;
+      d->cols[i].off = pos;
+      if (write_at(f, &pos, tb[t].cols[i].data, tb[t].cols[i].len) != 0) goto done;
+    }
+  }
+  if (write_pad8(f, &pos) != 0) goto done;
+  hdr->heap_off = pos;
+  hdr->heap_len = heap.len;
+  if (write_at(f, &pos, heap.data, heap.len) != 0) goto done;
+  if (fseek(f, 0, SEEK_SET) != 0 || fwrite(hdr, 1, sizeof(*hdr), f) != sizeof(*hdr)) goto done;
+  rc = 0;
+
+done:
+  if (f && fclose(f) != 0) rc = -1;
+  if (f && rc == 0 && rename(tmp, path) != 0) {
+    fprintf(stderr, "snapshot: unable to replace %s\n", path);
+    rc = -1;
+  }
+  if (f && rc != 0) remove(tmp);
+  if (tb) {
+    for (int t=0;t<SNAP_NTABLES;t++) {
+      for (int i=0;i<SNAP_MAX_COLS;i++) free(tb[t].cols[i].data);
+      free(tb[t].blocks.data);
+    }
+  }
+  free(tb); free(hdr); free(heap.data);
+  return rc;
+}
+
+/* ---------- Read side ---------- */
+
+int snap_open(const char* path, snap_t* s) {
+  memset(s, 0, sizeof(*s));
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) { fprintf(stderr, "snapshot: cannot open %s\n", path); return -1; }
+  struct stat sb;
+  if (fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(snap_header_t)) {
+    fprintf(stderr, "snapshot: %s is not a snapshot file\n", path);
+    close(fd); return -1;
+  }
+  void* p = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) { fprintf(stderr, "snapshot: mmap failed for %s\n", path); return -1; }
+  s->base = (const unsigned char*)p;
+  s->size = (size_t)sb.st_size;
+  s->hdr = (const snap_header_t*)p;
+
+  const snap_header_t* h = s->hdr;
+  int ok = !memcmp(h->magic, SNAP_MAGIC, 8) && h->version == SNAP_VERSION && h->ntables == SNAP_NTABLES
+        && h->heap_len > 0 && h->heap_off <= s->size && h->heap_len <= s->size - h->heap_off
+        && s->base[h->heap_off + h->heap_len - 1] == '\0';   /* no string runs off the heap */
+  /* every offset and count is checked before it is used, in a form that
+   * cannot overflow: the readers index the mapping without checks */
+  for (int t=0; ok && t<SNAP_NTABLES; t++) {
+    const snap_table_t* d = &h->tables[t];
+    ok = d->ncols == snap_layout[t].ncols && d->day_col == snap_layout[t].day_col
+      && d->nrows <= s->size
+      && d->nblocks <= (d->nrows + SNAP_BLOCK_ROWS - 1) / SNAP_BLOCK_ROWS
+      && d->blocks_off % 8 == 0 && d->blocks_off <= s->size
+      && (uint64_t)d->nblocks * sizeof(snap_block_t) <= s->size - d->blocks_off;
+    for (uint32_t i=0; ok && i<d->ncols; i++) {
+      const snap_col_t* col = &d->cols[i];
+      ok = col->type == snap_layout[t].types[i]
+        && col->off % 8 == 0 && col->off <= s->size
+        && d->nrows * col_width(col->type) <= s->size - col->off
+        && col->ndict <= SNAP_MAX_DICT;
+    }
+    /* the blocks tile [0, nrows) in order */
+    const snap_block_t* b = ok ? (const snap_block_t*)(s->base + d->blocks_off) : NULL;
+    uint64_t next = 0;
+    for (uint32_t k=0; ok && k<d->nblocks; k++) {
+      ok = b[k].row_start == next && b[k].nrows > 0 && b[k].nrows <= SNAP_BLOCK_ROWS
+        && b[k].nrows <= d->nrows - b[k].row_start;
+      next = b[k].row_start + b[k].nrows;
+    }
+    if (ok) ok = next == d->nrows;
+  }
+  if (!ok) {
+    fprintf(stderr, "snapshot: %s is corrupt or from another version\n", path);
+    snap_close(s);
+    return -1;
+  }
+  return 0;
+}
+
+void snap_close(snap_t* s) {
+  if (s->base) munmap((void*)s->base, s->size);
+  memset(s, 0, sizeof(*s));
+}
+
+const void* snap_column(const snap_t* s, int table, int col) {
+  return s->base + s->hdr->tables[table].cols[col].off;
+}
+
+const char* snap_string(const snap_t* s, uint32_t heap_off) {
+  if (heap_off >= s->hdr->heap_len) return NULL;
+  return (const char*)(s->base + s->hdr->heap_off + heap_off);
+}
+
+/* ---------- Multi-threaded aggregation ---------- */
+
+typedef struct { int table; uint32_t block; } snap_work_t;
+
+/* row of id in a dimension (sorted by id), -1 if absent */
+static long dim_find(const snap_t* s, int table, long long id) {
+  const int64_t* ids = (const int64_t*)snap_column(s, table, SD_ID);
+  size_t lo = 0, hi = (size_t)s->hdr->tables[table].nrows;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (ids[mid] < id) lo = mid + 1;
+    else if (ids[mid] > id) hi = mid;
+    else return (long)mid;
+  }
+  return -1;
+}
+
+/* bookmaker of a payout's owner: runner -> bookmaker, bettor -> runner -> bookmaker */
+static long long owner_bookmaker(const snap_t* s, int table, long long owner) {
+  if (table == SNAP_BETTOR_PAYOUTS) {
+    long i = dim_find(s, SNAP_BETTORS, owner);
+    if (i < 0) return 0;
+    owner = ((const int64_t*)snap_column(s, SNAP_BETTORS, SD_PARENT))[i];
+  }
+  long i = dim_find(s, SNAP_RUNNERS, owner);
+  return i < 0 ? 0 : ((const int64_t*)snap_column(s, SNAP_RUNNERS, SD_PARENT))[i];
+}
+
+typedef struct {
+  const snap_t* s;
+  long bm;
+  int from_day, to_day;
+  const snap_work_t* work;
+  size_t nwork;
+  atomic_size_t* next;
+  rpt_agg_t agg;
+  int failed;
+} snap_worker_t;
+
+static void agg_block(snap_worker_t* w, int table, const snap_block_t* b) {
+  const snap_t* s = w->s;
+  size_t lo = (size_t)b->row_start, hi = lo + b->nrows;
+  if (table == SNAP_BETS) {
+    const int64_t* bm = (const int64_t*)snap_column(s, table, SB_BOOKMAKER);
+    const int64_t* rn = (const int64_t*)snap_column(s, table, SB_RUNNER);
+    const int64_t* bt = (const int64_t*)snap_column(s, table, SB_BETTOR);
+    const int64_t* sk = (const int64_t*)snap_column(s, table, SB_STAKE);
+    const int64_t* pf = (const int64_t*)snap_column(s, table, SB_PROFIT);
+    const int32_t* dy = (const int32_t*)snap_column(s, table, SB_DAY);
+    for (size_t i=lo;i<hi;i++) {
+      if (dy[i] < w->from_day || dy[i] > w->to_day || (w->bm && bm[i] != w->bm)) continue;
+      rpt_add_bet(&w->agg, rn[i], bt[i], sk[i], pf[i]);
+    }
+  } else if (table == SNAP_COMMISSIONS) {
+    const int64_t* bm = (const int64_t*)snap_column(s, table, SC_BOOKMAKER);
+    const int64_t* rn = (const int64_t*)snap_column(s, table, SC_RUNNER);
+    const int64_t* ct = (const int64_t*)snap_column(s, table, SC_CENTS);
+    const int32_t* dy = (const int32_t*)snap_column(s, table, SC_DAY);
+    for (size_t i=lo;i<hi;i++) {
+      if (dy[i] < w->from_day || dy[i] > w->to_day || (w->bm && bm[i] != w->bm)) continue;
+      rpt_add_commission(&w->agg, rn[i], ct[i]);
+    }
+  } else {
+    /* payouts carry no bookmaker: it comes from the owner's dimension row */
+    const int64_t* ow = (const int64_t*)snap_column(s, table, SP_OWNER);
+    const int64_t* ct = (const int64_t*)snap_column(s, table, SP_CENTS);
+    const int32_t* dy = (const int32_t*)snap_column(s, table, SP_DAY);
+    for (size_t i=lo;i<hi;i++) {
+      if (dy[i] < w->from_day || dy[i] > w->to_day) continue;
+      if (w->bm && owner_bookmaker(s, table, ow[i]) != w->bm) continue;
+      if (table == SNAP_BETTOR_PAYOUTS) rpt_add_bettor_payout(&w->agg, ow[i], ct[i]);
+      else                              rpt_add_runner_payout(&w->agg, ow[i], ct[i]);
+    }
+  }
+}
+
+static void* snap_worker_main(void* arg) {
+  snap_worker_t* w = (snap_worker_t*)arg;
+  for (;;) {
+    size_t k = atomic_fetch_add(w->next, 1);
+    if (k >= w->nwork) break;
+    const snap_table_t* d = &w->s->hdr->tables[w->work[k].table];
+    const snap_block_t* blocks = (const snap_block_t*)(w->s->base + d->blocks_off);
+    agg_block(w, w->work[k].table, &blocks[w->work[k].block]);
+  }
+  return NULL;
+}
+
+static const char* dim_name(const snap_t* s, int table, long long id) {
+  long i = dim_find(s, table, id);
+  return i < 0 ? NULL : snap_string(s, ((const uint32_t*)snap_column(s, table, SD_NAME))[i]);
+}
+
+int snap_aggregate(const snap_t* s, long bm, int from_day, int to_day, int nthreads, rpt_agg_t* out) {
+  static const int fact_tables[] = { SNAP_BETS, SNAP_COMMISSIONS, SNAP_BETTOR_PAYOUTS, SNAP_RUNNER_PAYOUTS };
+  size_t nwork = 0;
+  for (size_t t=0;t<sizeof(fact_tables)/sizeof(fact_tables[0]);t++) nwork += s->hdr->tables[fact_tables[t]].nblocks;
+  snap_work_t* work = (snap_work_t*)malloc((nwork ? nwork : 1) * sizeof(*work));
+  if (!work) return -1;
+
+  /* block skipping: only blocks whose [min_day,max_day] meets the range */
+  size_t k = 0;
+  for (size_t t=0;t<sizeof(fact_tables)/sizeof(fact_tables[0]);t++) {
+    const snap_table_t* d = &s->hdr->tables[fact_tables[t]];
+    const snap_block_t* blocks = (const snap_block_t*)(s->base + d->blocks_off);
+    for (uint32_t b=0;b<d->nblocks;b++) {
+      if (blocks[b].max_day < from_day || blocks[b].min_day > to_day) continue;
+      work[k].table = fact_tables[t]; work[k].block = b; k++;
+    }
+  }
+  nwork = k;
+
+  if (nthreads < 1) {
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = ncpu > 0 ? (int)ncpu : 1;
+  }
+  if ((size_t)nthreads > nwork) nthreads = nwork ? (int)nwork : 1;
+  snap_worker_t* ws = (snap_worker_t*)calloc((size_t)nthreads, sizeof(*ws));
+  pthread_t* th = (pthread_t*)calloc((size_t)nthreads, sizeof(*th));
+  if (!ws || !th) { free(work); free(ws); free(th); return -1; }
+  atomic_size_t next;
+  atomic_init(&next, 0);
+
+  int rc = 0;
+  for (int i=0;i<nthreads;i++) {
+    ws[i].s = s; ws[i].bm = bm; ws[i].from_day = from_day; ws[i].to_day = to_day;
+    ws[i].work = work; ws[i].nwork = nwork; ws[i].next = &next;
+    rpt_agg_init(&ws[i].agg);
+  }
+  /* worker 0 runs on the calling thread */
+  for (int i=1;i<nthreads;i++) {
+    if (pthread_create(&th[i], NULL, snap_worker_main, &ws[i]) != 0) ws[i].failed = 1;
+  }
+  snap_worker_main(&ws[0]);
+  for (int i=1;i<nthreads;i++) if (!ws[i].failed) pthread_join(th[i], NULL);
+
+  for (int i=0;i<nthreads;i++) {
+    if (rc == 0 && rpt_agg_merge(out, &ws[i].agg) != 0) rc = -1;
+    rpt_agg_free(&ws[i].agg);
+  }
+  free(ws); free(th); free(work);
+  if (rc != 0) return rc;
+
+  /* names point straight into the mapping, which outlives emission */
+  size_t pos = 0; long long id; void* v;
+  while (hmap_next(&out->runners, &pos, &id, &v)) {
+    rpt_acc_t* acc = (rpt_acc_t*)v;
+    if (!acc->name) acc->name = dim_name(s, SNAP_RUNNERS, id);
+  }
+  pos = 0;
+  while (hmap_next(&out->bettors, &pos, &id, &v)) {
+    rpt_acc_t* acc = (rpt_acc_t*)v;
+    if (!acc->name) acc->name = dim_name(s, SNAP_BETTORS, id);
+  }
+  return 0;
+}
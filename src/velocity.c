@@ -0,0 +1,235 @@
+#include "velocity.h"
+#include "hmap.h"
+#include "rptagg.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+enum { VF_RATE = 0, VF_STAKE, VF_FOLLOW };
+
+typedef struct {
+  int runner;                  /* entity: 0 bettor, 1 runner */
+  int kind;
+  long long id;
+  char first_at[20];
+  long long peak_n, peak_stake;
+  long long leader, follows;
+} vflag_t;
+
+typedef struct { vflag_t* f; size_t n, cap; } vflags_t;
+
+/* index + 1 of a new flag, 0 on OOM */
+static size_t flag_new(vflags_t* fl, int runner, int kind, long long id, const char* at) {
+  if (fl->n == fl->cap) {
+    size_t cap = fl->cap ? fl->cap*2 : 64;
+    vflag_t* nf = (vflag_t*)realloc(fl->f, cap*sizeof(vflag_t));
+    if (!nf) return 0;
+    fl->f = nf; fl->cap = cap;
+  }
+  vflag_t* f = &fl->f[fl->n++];
+  memset(f, 0, sizeof(*f));
+  f->runner = runner; f->kind = kind; f->id = id;
+  snprintf(f->first_at, sizeof(f->first_at), "%s", at);
+  return fl->n;
+}
+
+/* ---------- Sliding window ---------- */
+
+typedef struct {
+  long long t, bettor, runner, stake;
+  long long pick;              /* key in the pick map; 0 = not followed */
+} vbet_t;
+
+/* Bets by sequence number, slot = seq & (cap-1). head_w is the oldest bet
+ * still counted in the window, head_f the oldest still remembered as the
+ * last bettor of its pick; both trail tail and the ring keeps from the
+ * lower of the two. */
+typedef struct {
+  vbet_t* a; size_t cap;
+  unsigned long long tail, head_w, head_f;
+} vring_t;
+
+static int ring_push(vring_t* r, const vbet_t* b) {
+  unsigned long long lo = r->head_w < r->head_f ? r->head_w : r->head_f;
+  if (r->tail - lo == r->cap) {
+    size_t cap = r->cap ? r->cap*2 : 1024;
+    vbet_t* na = (vbet_t*)malloc(cap*sizeof(vbet_t));
+    if (!na) return -1;
+    for (unsigned long long s=lo; s<r->tail; s++) na[s & (cap-1)] = r->a[s & (r->cap-1)];
+    free(r->a); r->a = na; r->cap = cap;
+  }
+  r->a[r->tail++ & (r->cap-1)] = *b;
+  return 0;
+}
+
+/* bettors this one followed while active, most followed kept */
+#define VEL_LEADERS 4
+typedef struct { long long leader, n; size_t ix; } vlead_t;   /* ix: follow flag index + 1 */
+
+/* bettor or runner: what it has in the window, and its open flags */
+typedef struct {
+  long long n, stake;
+  size_t rate_ix, stake_ix;    /* flag index + 1, 0 = none open */
+  vlead_t lead[VEL_LEADERS];   /* bettors only */
+} vent_t;
+
+static int ent_add(hmap_t* m, int runner, long long id, long long stake, long max_n, long long max_stake,
+                   const char* at, vflags_t* fl) {
+  vent_t* e = (vent_t*)hmap_put(m, id, NULL);
+  if (!e) return -1;
+  e->n++; e->stake += stake;
+  if (max_n && e->n > max_n && !e->rate_ix && !(e->rate_ix = flag_new(fl, runner, VF_RATE, id, at))) return -1;
+  if (max_stake && e->stake > max_stake && !e->stake_ix && !(e->stake_ix = flag_new(fl, runner, VF_STAKE, id, at))) return -1;
+  size_t ix[2] = { e->rate_ix, e->stake_ix };
+  for (int i=0;i<2;i++) {
+    if (!ix[i]) continue;
+    vflag_t* f = &fl->f[ix[i]-1];
+    if (e->n > f->peak_n) f->peak_n = e->n;
+    if (e->stake > f->peak_stake) f->peak_stake = e->stake;
+  }
+  return 0;
+}
+
+/* a bet leaves the window; an entity left with none is dropped, which also
+ * closes its flags */
+static void ent_sub(hmap_t* m, long long id, long long stake) {
+  vent_t* e = (vent_t*)hmap_get(m, id);
+  if (!e) return;
+  e->n--; e->stake -= stake;
+  if (e->n <= 0) hmap_del(m, id);
+}
+
+/* ---------- Follow detection ---------- */
+
+typedef struct {
+  long event; int market, side, line_q, line_b_q;
+  long long bettor, t;
+} vpick_t;
+
+static long long pick_key(long event, int market, int side, int line_q, int line_b_q) {
+  unsigned long long h = 1469598103934665603ULL;
+  long long f[5] = { event, market, side, line_q, line_b_q };
+  for (int i=0;i<5;i++) { h ^= (unsigned long long)f[i]; h *= 1099511628211ULL; h ^= h >> 29; }
+  return h ? (long long)h : 1;
+}
+
+/* follower f landed on leader's pick: count it in f's slot for the leader,
+ * taking a free slot or the least followed unflagged one */
+static int follow(vent_t* f, long long follower, long long leader, long min, const char* at, vflags_t* fl) {
+  vlead_t* s = NULL;
+  for (int i=0;i<VEL_LEADERS && !s;i++) if (f->lead[i].n && f->lead[i].leader == leader) s = &f->lead[i];
+  if (!s) {
+    for (int i=0;i<VEL_LEADERS;i++) {
+      vlead_t* x = &f->lead[i];
+      if (x->ix) continue;
+      if (!s || x->n < s->n) s = x;
+    }
+    if (!s) return 0;          /* every slot holds a flagged leader */
+    s->leader = leader; s->n = 0; s->ix = 0;
+  }
+  s->n++;
+  if (s->n < min) return 0;
+  if (!s->ix) {
+    if (!(s->ix = flag_new(fl, 0, VF_FOLLOW, follower, at))) return -1;
+    fl->f[s->ix-1].leader = leader;
+  }
+  fl->f[s->ix-1].follows = s->n;
+  return 0;
+}
+
+/* ---------- Output ---------- */
+
+static int velocity_emit(const vflags_t* fl, rf_format_t fmt, const char* out_path) {
+  static const char* kinds[] = { "rate", "stake", "follow" };
+  const char* hdr[8] = { "entity","id","flag","first_at","peak_bets","peak_stake_usd","leader_id","follows" };
+  rf_ctx_t* rf = rf_begin(fmt, stdout, out_path, hdr, 8);
+  if (!rf) {
+    fprintf(stderr,"risk velocity: unable to open output file: %s\n", out_path ? out_path : "");
+    return 1;
+  }
+  for (size_t i=0;i<fl->n;i++) {
+    const vflag_t* f = &fl->f[i];
+    char id[24], pn[24], ps[32], ld[24], fw[24];
+    snprintf(id,sizeof(id),"%lld",f->id);
+    snprintf(pn,sizeof(pn),"%lld",f->peak_n);
+    rpt_fmt_cents(f->peak_stake,ps,sizeof(ps));
+    snprintf(ld,sizeof(ld),"%lld",f->leader);
+    snprintf(fw,sizeof(fw),"%lld",f->follows);
+    bool follow = f->kind == VF_FOLLOW;
+    const char* row[8] = { f->runner ? "runner" : "bettor", id, kinds[f->kind], f->first_at,
+                           follow ? NULL : pn, follow ? NULL : ps, follow ? ld : NULL, follow ? fw : NULL };
+    rf_row(rf,row);
+  }
+  return rf_end(rf) ? 0 : 1;
+}
+
+int velocity_run(MYSQL* c, const velocity_opts_t* o, rf_format_t fmt, const char* out_path) {
+  char q[1024];
+  snprintf(q,sizeof(q),
+    "SELECT UNIX_TIMESTAMP(b.placed_at),DATE_FORMAT(b.placed_at,'%%Y-%%m-%%d %%H:%%i:%%s'),b.bettor_id,b.runner_id,b.stake_cents,"
+    "b.bet_type='single',b.event_id,b.market_type+0,b.pick_side+0,COALESCE(b.line_q,0),COALESCE(b.line_b_q,0) "
+    "FROM bets b WHERE b.bookmaker_id=%ld AND b.placed_at>=DATE_SUB(NOW(), INTERVAL %ld SECOND) "
+    "ORDER BY b.placed_at,b.id", o->bookmaker_id, o->since_s);
+  if (db_exec(c,q)!=0) return 5;
+  MYSQL_RES* r = mysql_use_result(c);
+  if (!r) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); return 5; }
+
+  vring_t ring; memset(&ring, 0, sizeof(ring));
+  vflags_t fl; memset(&fl, 0, sizeof(fl));
+  hmap_t bettors, runners, picks;
+  hmap_init(&bettors, sizeof(vent_t)); hmap_init(&runners, sizeof(vent_t));
+  hmap_init(&picks, sizeof(vpick_t));
+  int rc = 0;
+  MYSQL_ROW row;
+  while ((row = mysql_fetch_row(r))) {
+    vbet_t b = { atoll(row[0]), atoll(row[2]), atoll(row[3]), atoll(row[4]), 0 };
+    const char* at = row[1] ? row[1] : "";
+
+    while (ring.head_w < ring.tail) {
+      const vbet_t* x = &ring.a[ring.head_w & (ring.cap-1)];
+      if (x->t + o->window_s > b.t) break;
+      ent_sub(&bettors, x->bettor, x->stake);
+      ent_sub(&runners, x->runner, x->stake);
+      ring.head_w++;
+    }
+    while (ring.head_f < ring.tail) {
+      const vbet_t* x = &ring.a[ring.head_f & (ring.cap-1)];
+      if (x->t + o->follow_s >= b.t) break;
+      const vpick_t* p = x->pick ? (const vpick_t*)hmap_get(&picks, x->pick) : NULL;
+      if (p && p->bettor == x->bettor && p->t == x->t) hmap_del(&picks, x->pick);
+      ring.head_f++;
+    }
+
+    if (ring_push(&ring, &b) != 0 ||
+        ent_add(&bettors, 0, b.bettor, b.stake, o->max_bets, o->max_stake_cents, at, &fl) != 0 ||
+        ent_add(&runners, 1, b.runner, b.stake, o->runner_max_bets, o->runner_max_stake_cents, at, &fl) != 0) {
+      rc = 5; break;
+    }
+
+    if (o->follow_s > 0 && atoi(row[5])) {
+      vpick_t k = { atol(row[6]), atoi(row[7]), atoi(row[8]), atoi(row[9]), atoi(row[10]), b.bettor, b.t };
+      long long key = pick_key(k.event, k.market, k.side, k.line_q, k.line_b_q);
+      ring.a[(ring.tail-1) & (ring.cap-1)].pick = key;
+      bool created;
+      vpick_t* p = (vpick_t*)hmap_put(&picks, key, &created);
+      if (!p) { rc = 5; break; }
+      /* a 64-bit key collision just hands the slot to the newer pick */
+      bool same = !created && p->event == k.event && p->market == k.market && p->side == k.side &&
+                  p->line_q == k.line_q && p->line_b_q == k.line_b_q;
+      if (same && p->bettor != b.bettor && b.t - p->t <= o->follow_s &&
+          follow((vent_t*)hmap_get(&bettors, b.bettor), b.bettor, p->bettor, o->follow_min, at, &fl) != 0) {
+        rc = 5; break;
+      }
+      *p = k;
+    }
+  }
+  if (rc) fprintf(stderr,"risk velocity: out of memory\n");
+  else if (mysql_errno(c)) { fprintf(stderr,"SQL error: %s\n", mysql_error(c)); rc = 5; }
+  mysql_free_result(r);
+  hmap_free(&bettors); hmap_free(&runners); hmap_free(&picks);
+  free(ring.a);
+  if (!rc) rc = velocity_emit(&fl, fmt, out_path);
+  free(fl.f);
+  return rc;
+}